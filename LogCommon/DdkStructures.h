@@ -478,6 +478,16 @@ typedef struct T_PROCESS_BASIC_INFORMATION {
 
 typedef NTSTATUS (NTAPI *NtCloseFunc)(HANDLE);
 
+typedef NTSTATUS (NTAPI *NtDuplicateObjectFunc)(
+    __in HANDLE, //Source process handle
+    __in HANDLE, //Source handle
+    __in_opt HANDLE, //Target process handle
+    __out_opt HANDLE*, //Target handle
+    __in ACCESS_MASK, //Desired access
+    __in ULONG, //Handle attributes
+    __in ULONG //Options
+    );
+
 typedef NTSTATUS (NTAPI *NtOpenProcessTokenFunc)(
     IN HANDLE,
     IN ACCESS_MASK,
@@ -657,6 +667,11 @@ typedef NTSTATUS (NTAPI *NtQueryValueKeyFunc)(
     __out      PULONG ResultLength
     );
 
+typedef NTSTATUS (NTAPI *NtDeleteValueKeyFunc)(
+    __in       HANDLE KeyHandle,
+    __in       PUNICODE_STRING ValueName
+    );
+
 typedef NTSTATUS (NTAPI *NtSetValueKeyFunc)(
     __in       HANDLE KeyHandle,
     __in       PUNICODE_STRING ValueName,
@@ -665,6 +680,14 @@ typedef NTSTATUS (NTAPI *NtSetValueKeyFunc)(
     __in_opt   PVOID Data,
     __in       ULONG DataSize
     );
+
+typedef NTSTATUS (NTAPI *RtlFindMessageFunc)(
+    __in       PVOID DllHandle,
+    __in       ULONG MessageTableId,
+    __in       ULONG MessageLanguageId,
+    __in       ULONG MessageId,
+    __out      PMESSAGE_RESOURCE_ENTRY *MessageEntry
+    );
 }
 
 inline UNICODE_STRING WstringToUnicodeString(std::wstring const& target)
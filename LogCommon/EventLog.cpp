@@ -4,8 +4,10 @@
 
 #include <vector>
 #include <sstream>
+#include <utility>
 #include <boost/algorithm/string/predicate.hpp>
 #include "EventLog.hpp"
+#include "EventMessageCache.hpp"
 #include "Win32Exception.hpp"
 #include "Win32Glue.hpp"
 #include "StockOutputFormats.hpp"
@@ -56,7 +58,8 @@ OldEventLogEntry::OldEventLogEntry(PEVENTLOGRECORD pRecord)
 }
 
 OldEventLogEntry::OldEventLogEntry( OldEventLogEntry && e )
-        : eventIdWithExtras(e.eventIdWithExtras)
+        : EventLogEntry(std::move(e))
+        , eventIdWithExtras(e.eventIdWithExtras)
         , source(e.source)
         , strings(std::move(e.strings))
         , dataString(std::move(e.dataString))
@@ -65,7 +68,14 @@ OldEventLogEntry::OldEventLogEntry( OldEventLogEntry && e )
     e.source.clear();
 }
 
-std::string OldEventLogEntry::GetDescription()
+/// @brief    Opens the message module named by a legacy event source's
+///         EventMessageFile value.
+///
+/// @param    source    Name of the event source.
+///
+/// @return    The module, or null if the source does not name one.
+static std::shared_ptr<FormattedMessageLoader>
+OpenEventMessageFile(std::string const& source)
 {
     RegistryKey eventKey = RegistryKey::Open("\\Registry\\Machine\\System\\CurrentControlSet\\services\\eventlog\\System\\" +
             source,
@@ -83,15 +93,34 @@ std::string OldEventLogEntry::GetDescription()
             eventMessageFileValue.GetStringStrict();
         Path::ResolveFromCommandLine(eventMessageFilePath);
 
-        FormattedMessageLoader eventMessageFile(GetThrowingErrorReporter(), eventMessageFilePath);
-        return eventMessageFile.GetFormattedMessage(GetThrowingErrorReporter(), eventIdWithExtras, strings);
+        return std::make_shared<FormattedMessageLoader>(
+            GetThrowingErrorReporter(), eventMessageFilePath);
     }
     catch (ErrorFileNotFoundException const&)
+    {
+        return nullptr;
+    }
+}
+
+std::string OldEventLogEntry::GetDescription()
+{
+    EventMessageCache& cache = GetEventMessageCache();
+    std::shared_ptr<FormattedMessageLoader> eventMessageFile =
+        cache.GetMessageModule(source,
+                               [this] { return OpenEventMessageFile(source); });
+    if (!eventMessageFile)
     {
         // We don't know what library to use so just return the short data
         // string
         return utf8::ToUtf8(dataString);
     }
+
+    auto const messageTemplate = cache.GetTemplate(
+        source, eventIdWithExtras, LANG_SYSTEM_DEFAULT, [&] {
+            return eventMessageFile->GetMessageDefinition(
+                GetThrowingErrorReporter(), eventIdWithExtras);
+        });
+    return messageTemplate->Format(strings);
 }
 
 std::string OldEventLogEntry::GetSource()
@@ -117,10 +146,24 @@ std::vector<std::unique_ptr<EventLogEntry>> OldEventLog::ReadEvents()
 {
     std::vector<std::unique_ptr<EventLogEntry>> eventLogEntries;
     eventLogEntries.reserve(16 * 1024 /* approximate based on dev machine */);
+    ReadEvents([&](EventLogEntry& entry) {
+        eventLogEntries.emplace_back(std::unique_ptr<EventLogEntry>(
+            new OldEventLogEntry(std::move(static_cast<OldEventLogEntry&>(entry)))));
+        return true;
+    });
+
+    return eventLogEntries;
+}
 
+void OldEventLog::ReadEvents(
+    std::function<bool(EventLogEntry&)> const& visitor)
+{
     DWORD lastError = ERROR_SUCCESS;
-    std::vector<char> buffer(
-        0x7ffff /* (max size of buffer) */); // http://msdn.microsoft.com/en-us/library/aa363674.aspx
+    // Each read returns as many whole records as fit, so a smaller buffer
+    // only means more reads; it is grown if a single record does not fit.
+    // The maximum is 0x7ffff; see
+    // http://msdn.microsoft.com/en-us/library/aa363674.aspx
+    std::vector<char> buffer(64 * 1024);
     DWORD bytesRead;
     DWORD minNumberOfBytesNeeded;
 
@@ -159,13 +202,14 @@ std::vector<std::unique_ptr<EventLogEntry>> OldEventLog::ReadEvents()
                  pRecord = reinterpret_cast<PEVENTLOGRECORD>(
                      reinterpret_cast<char*>(pRecord) + pRecord->Length))
             {
-                eventLogEntries.emplace_back(std::unique_ptr<EventLogEntry>(
-                    new OldEventLogEntry(pRecord)));
+                OldEventLogEntry entry(pRecord);
+                if (!visitor(entry))
+                {
+                    return;
+                }
             }
         }
     }
-
-    return eventLogEntries;
 }
 
 typedef enum _EVT_QUERY_FLAGS
@@ -383,22 +427,35 @@ static EvtFunctionHandles const& EvtFunctions()
 
 std::string XmlEventLogEntry::FormatEventMessage(DWORD messageFlag)
 {
-    HANDLE publisherHandle = EvtFunctions().EvtOpenPublisherMetadata(
-        NULL, providerName.c_str(), NULL, 0, 0);
-    ScopeExit onExit([publisherHandle]() { EvtFunctions().EvtClose(publisherHandle); });
-    if (publisherHandle == NULL)
+    // The cache is created after the event API, so that it is destroyed, and
+    // closes its publisher handles, before the event API is unloaded.
+    EvtFunctionHandles const& evtFunctions = EvtFunctions();
+    std::shared_ptr<void> const publisher =
+        GetEventMessageCache().GetPublisherMetadata(
+            utf8::ToUtf8(providerName), [&]() -> std::shared_ptr<void> {
+                HANDLE publisherHandle = evtFunctions.EvtOpenPublisherMetadata(
+                    NULL, providerName.c_str(), NULL, 0, 0);
+                if (publisherHandle == NULL)
+                {
+                    DWORD lastError = ::GetLastError();
+                    if (lastError == ERROR_FILE_NOT_FOUND)
+                    {
+                        return nullptr;
+                    }
+
+                    Win32Exception::Throw(lastError);
+                }
+
+                return std::shared_ptr<void>(
+                    publisherHandle,
+                    [](HANDLE handle) { EvtFunctions().EvtClose(handle); });
+            });
+    if (!publisher)
     {
-        DWORD lastError = ::GetLastError();
-        if (lastError == ERROR_FILE_NOT_FOUND)
-        {
-            return "No Description Available.";
-        }
-        else
-        {
-            Win32Exception::Throw(lastError);
-        }
+        return "No Description Available.";
     }
 
+    HANDLE const publisherHandle = publisher.get();
     std::vector<wchar_t> buffer;
     DWORD bufferUsed = 0;
     while (EvtFunctions().EvtFormatMessage(publisherHandle,
@@ -481,7 +538,9 @@ XmlEventLogEntry::XmlEventLogEntry(HANDLE handle) : eventHandle(handle)
 }
 
 XmlEventLogEntry::XmlEventLogEntry(XmlEventLogEntry&& x)
-    : eventHandle(x.eventHandle)
+    : EventLogEntry(std::move(x))
+    , eventHandle(x.eventHandle)
+    , providerName(std::move(x.providerName))
 {
     x.eventHandle = NULL;
 }
@@ -522,8 +581,8 @@ std::string XmlEventLogEntry::GetSource()
     }
 }
 
-XmlEventLog::XmlEventLog(char* logPath /*= L"System"*/,
-                         char* query /*= L"Event/System"*/)
+XmlEventLog::XmlEventLog(char const* logPath /*= L"System"*/,
+                         char const* query /*= L"Event/System"*/)
     : queryHandle(
           EvtFunctions().EvtQuery(NULL, utf8::ToUtf16(logPath).c_str(), utf8::ToUtf16(query).c_str(), EvtQueryChannelPath))
 {
@@ -540,8 +599,21 @@ XmlEventLog::~XmlEventLog()
 
 std::vector<std::unique_ptr<EventLogEntry>> XmlEventLog::ReadEvents()
 {
-    auto const maxHandlesPerCall = 100;
     std::vector<std::unique_ptr<EventLogEntry>> eventLogEntries;
+    ReadEvents([&](EventLogEntry& entry) {
+        eventLogEntries.emplace_back(std::unique_ptr<EventLogEntry>(
+            new XmlEventLogEntry(
+                std::move(static_cast<XmlEventLogEntry&>(entry)))));
+        return true;
+    });
+
+    return eventLogEntries;
+}
+
+void XmlEventLog::ReadEvents(
+    std::function<bool(EventLogEntry&)> const& visitor)
+{
+    auto const maxHandlesPerCall = 100;
     HANDLE eventHandles[maxHandlesPerCall];
     DWORD numReturned = 0;
 
@@ -554,8 +626,23 @@ std::vector<std::unique_ptr<EventLogEntry>> XmlEventLog::ReadEvents()
     {
         for (std::size_t i = 0; i < numReturned; ++i)
         {
-            eventLogEntries.emplace_back(
-                std::make_unique<XmlEventLogEntry>(eventHandles[i]));
+            bool keepReading;
+            {
+                XmlEventLogEntry entry(eventHandles[i]);
+                keepReading = visitor(entry);
+            }
+
+            if (!keepReading)
+            {
+                // The entries for the rest of this batch were never made,
+                // so their handles are closed here.
+                for (std::size_t j = i + 1; j < numReturned; ++j)
+                {
+                    EvtFunctions().EvtClose(eventHandles[j]);
+                }
+
+                return;
+            }
         }
     }
 
@@ -564,8 +651,38 @@ std::vector<std::unique_ptr<EventLogEntry>> XmlEventLog::ReadEvents()
     {
         Win32Exception::Throw(errorStatus);
     }
+}
 
-    return eventLogEntries;
+std::string MakeEventQuery(std::vector<WORD> const& levels,
+                           std::uint64_t maxAgeMilliseconds,
+                           std::vector<DWORD> const& excludedEventIds)
+{
+    std::string query("Event/System[(");
+    for (std::size_t idx = 0; idx < levels.size(); ++idx)
+    {
+        if (idx != 0)
+        {
+            query.append(" or ");
+        }
+        write(query, "Level=", levels[idx]);
+    }
+    query.push_back(')');
+
+    if (maxAgeMilliseconds != 0)
+    {
+        write(query,
+              " and TimeCreated[timediff(@SystemTime) <= ",
+              maxAgeMilliseconds,
+              ']');
+    }
+
+    for (DWORD eventId : excludedEventIds)
+    {
+        write(query, " and EventID!=", eventId);
+    }
+
+    query.push_back(']');
+    return query;
 }
 
 EventLogEntry::EventLogEntry( EventLogEntry && e )
@@ -4,6 +4,8 @@
 
 #pragma once
 #include <boost/noncopyable.hpp>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <memory>
 #include <vector>
@@ -141,6 +143,15 @@ struct EventLog : boost::noncopyable
     ///
     /// @return    The events.
     virtual std::vector<std::unique_ptr<EventLogEntry>> ReadEvents() = 0;
+
+    /// @brief    Reads the applicable events one at a time, without holding
+    ///         more than one read buffer's worth of them.
+    ///
+    /// @param    visitor    Called with each event, which is only valid for
+    ///                      the duration of the call. Returns false to stop
+    ///                      reading.
+    virtual void
+    ReadEvents(std::function<bool(EventLogEntry&)> const& visitor) = 0;
 };
 
 /// @brief    Wrapper around the old Win32 event log
@@ -151,6 +162,9 @@ class OldEventLog : public EventLog
     public:
     /// @brief    Constructor.
     ///
+    /// @remarks Events are read newest first, so a visitor looking for
+    ///          recent events can stop at the first one which is too old.
+    ///
     /// @param    sourceName    (optional) name of the log source.
     OldEventLog(std::string sourceName = "System");
 
@@ -161,8 +175,29 @@ class OldEventLog : public EventLog
     ///
     /// @return    The events.
     std::vector<std::unique_ptr<EventLogEntry>> ReadEvents();
+
+    /// @brief    Reads the applicable events one at a time.
+    ///
+    /// @param    visitor    Called with each event. Returns false to stop
+    ///                      reading.
+    void ReadEvents(std::function<bool(EventLogEntry&)> const& visitor);
 };
 
+/// @brief    Builds an XPath query for XmlEventLog which selects events by
+///         level, age, and event ID, so that filtering is done by the event
+///         log service rather than by the caller.
+///
+/// @param    levels              The levels to select. Must not be empty.
+/// @param    maxAgeMilliseconds  Events created longer ago than this are
+///                               not selected. Zero selects any age.
+/// @param    excludedEventIds    Event IDs which are not selected.
+///
+/// @return    The query, such as
+///            "Event/System[(Level=1 or Level=2) and EventID!=1000]".
+std::string MakeEventQuery(std::vector<WORD> const& levels,
+                           std::uint64_t maxAgeMilliseconds,
+                           std::vector<DWORD> const& excludedEventIds);
+
 /// @brief    Wrapper around the new (Vista and later) XML Win32 event log
 class XmlEventLog : public EventLog
 {
@@ -175,7 +210,8 @@ class XmlEventLog : public EventLog
     /// @param    query      (optional) the query.
     ///
     /// @throws FileNotFoundException on incompatible machines
-    XmlEventLog(char* logPath = "System", char* query = "Event/System");
+    XmlEventLog(char const* logPath = "System",
+                char const* query = "Event/System");
 
     /// @brief    Destructor, frees the handle
     ~XmlEventLog();
@@ -184,6 +220,12 @@ class XmlEventLog : public EventLog
     ///
     /// @return    The events.
     std::vector<std::unique_ptr<EventLogEntry>> ReadEvents();
+
+    /// @brief    Reads the applicable events one at a time.
+    ///
+    /// @param    visitor    Called with each event. Returns false to stop
+    ///                      reading.
+    void ReadEvents(std::function<bool(EventLogEntry&)> const& visitor);
 };
 }
 }
\ No newline at end of file
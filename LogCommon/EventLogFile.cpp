@@ -0,0 +1,1081 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "EventLogFile.hpp"
+#include "Utf8.hpp"
+#include "WorkerThreads.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+// Layout constants for the .evtx format. Chunk offsets are relative to the
+// start of the chunk; binary XML refers to names and templates by chunk
+// offset as well.
+static std::size_t const fileHeaderSize = 4096;
+static std::size_t const chunkSize = 65536;
+static std::size_t const chunkHeaderSize = 512;
+static std::size_t const chunkFirstRecordNumberOffset = 8;
+static std::size_t const chunkFreeSpaceOffset = 48;
+
+static std::uint32_t const recordSignature = 0x00002a2a;
+static std::size_t const recordSizeOffset = 4;
+static std::size_t const recordIdOffset = 8;
+static std::size_t const recordWrittenOffset = 16;
+static std::size_t const recordHeaderSize = 24;
+
+// Binary XML tokens. Tokens may also carry binXmlMoreBit, which marks an
+// element with attributes, or a value or attribute followed by another.
+static unsigned char const binXmlEndOfStream = 0x00;
+static unsigned char const binXmlOpenStartElement = 0x01;
+static unsigned char const binXmlCloseStartElement = 0x02;
+static unsigned char const binXmlCloseEmptyElement = 0x03;
+static unsigned char const binXmlEndElement = 0x04;
+static unsigned char const binXmlValue = 0x05;
+static unsigned char const binXmlAttribute = 0x06;
+static unsigned char const binXmlCData = 0x07;
+static unsigned char const binXmlCharRef = 0x08;
+static unsigned char const binXmlEntityRef = 0x09;
+static unsigned char const binXmlPITarget = 0x0A;
+static unsigned char const binXmlPIData = 0x0B;
+static unsigned char const binXmlTemplateInstance = 0x0C;
+static unsigned char const binXmlNormalSubstitution = 0x0D;
+static unsigned char const binXmlOptionalSubstitution = 0x0E;
+static unsigned char const binXmlFragmentHeader = 0x0F;
+static unsigned char const binXmlMoreBit = 0x40;
+
+// Substitution value types.
+static unsigned char const valueNull = 0x00;
+static unsigned char const valueString = 0x01;
+static unsigned char const valueAnsiString = 0x02;
+static unsigned char const valueInt8 = 0x03;
+static unsigned char const valueUInt8 = 0x04;
+static unsigned char const valueInt16 = 0x05;
+static unsigned char const valueUInt16 = 0x06;
+static unsigned char const valueInt32 = 0x07;
+static unsigned char const valueUInt32 = 0x08;
+static unsigned char const valueInt64 = 0x09;
+static unsigned char const valueUInt64 = 0x0A;
+static unsigned char const valueReal32 = 0x0B;
+static unsigned char const valueReal64 = 0x0C;
+static unsigned char const valueBool = 0x0D;
+static unsigned char const valueBinary = 0x0E;
+static unsigned char const valueGuid = 0x0F;
+static unsigned char const valueSizeT = 0x10;
+static unsigned char const valueFileTime = 0x11;
+static unsigned char const valueSystemTime = 0x12;
+static unsigned char const valueSid = 0x13;
+static unsigned char const valueHexInt32 = 0x14;
+static unsigned char const valueHexInt64 = 0x15;
+static unsigned char const valueBinXml = 0x21;
+static unsigned char const valueArrayBit = 0x80;
+
+// Nested templates only occur through BinXml substitutions, which are rarely
+// more than a level or two deep.
+static unsigned const maximumNesting = 16;
+
+static std::uint16_t ReadU16(unsigned char const* source)
+{
+    std::uint16_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint32_t ReadU32(unsigned char const* source)
+{
+    std::uint32_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint64_t ReadU64(unsigned char const* source)
+{
+    std::uint64_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::wstring ReadUtf16(unsigned char const* source,
+                              std::size_t characters)
+{
+    std::wstring result;
+    result.reserve(characters);
+    for (std::size_t idx = 0; idx < characters; ++idx)
+    {
+        result.push_back(static_cast<wchar_t>(ReadU16(source + idx * 2)));
+    }
+
+    return result;
+}
+
+static void TrimNulls(std::wstring& text)
+{
+    while (!text.empty() && text.back() == L'\0')
+    {
+        text.pop_back();
+    }
+}
+
+static void AppendHex(std::wstring& target,
+                      std::uint64_t value,
+                      std::size_t minimumDigits)
+{
+    static wchar_t const digits[] = L"0123456789ABCDEF";
+    wchar_t buffer[16];
+    std::size_t length = 0;
+    do
+    {
+        buffer[length++] = digits[value & 0xF];
+        value >>= 4;
+    } while (value != 0 || length < minimumDigits);
+
+    while (length != 0)
+    {
+        target.push_back(buffer[--length]);
+    }
+}
+
+static void AppendPadded(std::wstring& target,
+                         std::uint64_t value,
+                         std::size_t digits)
+{
+    std::wstring number = std::to_wstring(value);
+    if (number.size() < digits)
+    {
+        target.append(digits - number.size(), L'0');
+    }
+
+    target.append(number);
+}
+
+/// @brief    Formats a FILETIME in integer form as the event log's XML
+///         rendering does, such as 2014-01-31T12:34:56.1234567Z.
+static std::wstring FormatFileTime(std::uint64_t fileTime)
+{
+    std::uint64_t const ticksPerSecond = 10000000;
+    std::uint64_t const secondsPerDay = 86400;
+    std::uint64_t const seconds = fileTime / ticksPerSecond;
+    std::uint64_t const secondOfDay = seconds % secondsPerDay;
+
+    // Civil date from days since 0000-03-01, as in Howard Hinnant's
+    // days_from_civil algorithms. 1601-01-01 is day 584694 of that calendar.
+    std::uint64_t const days = seconds / secondsPerDay + 584694;
+    std::uint64_t const era = days / 146097;
+    std::uint64_t const dayOfEra = days - era * 146097;
+    std::uint64_t const yearOfEra =
+        (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) /
+        365;
+    std::uint64_t const dayOfYear =
+        dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    std::uint64_t const shiftedMonth = (5 * dayOfYear + 2) / 153;
+    std::uint64_t const day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    std::uint64_t const month =
+        shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    std::uint64_t const year =
+        yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    std::wstring result;
+    AppendPadded(result, year, 4);
+    result.push_back(L'-');
+    AppendPadded(result, month, 2);
+    result.push_back(L'-');
+    AppendPadded(result, day, 2);
+    result.push_back(L'T');
+    AppendPadded(result, secondOfDay / 3600, 2);
+    result.push_back(L':');
+    AppendPadded(result, secondOfDay / 60 % 60, 2);
+    result.push_back(L':');
+    AppendPadded(result, secondOfDay % 60, 2);
+    result.push_back(L'.');
+    AppendPadded(result, fileTime % ticksPerSecond, 7);
+    result.push_back(L'Z');
+    return result;
+}
+
+static std::uint64_t ParseNumber(std::wstring const& text)
+{
+    std::uint64_t result = 0;
+    if (text.size() > 2 && text[0] == L'0' && (text[1] == L'x' || text[1] == L'X'))
+    {
+        for (std::size_t idx = 2; idx < text.size(); ++idx)
+        {
+            wchar_t const ch = text[idx];
+            if (ch >= L'0' && ch <= L'9')
+                result = result * 16 + (ch - L'0');
+            else if (ch >= L'a' && ch <= L'f')
+                result = result * 16 + (ch - L'a' + 10);
+            else if (ch >= L'A' && ch <= L'F')
+                result = result * 16 + (ch - L'A' + 10);
+            else
+                break;
+        }
+    }
+    else
+    {
+        for (wchar_t ch : text)
+        {
+            if (ch < L'0' || ch > L'9')
+                break;
+            result = result * 10 + (ch - L'0');
+        }
+    }
+
+    return result;
+}
+
+namespace
+{
+
+/// @brief    A substitution value, referring into the chunk.
+struct BinXmlValue
+{
+    unsigned char type;
+    unsigned char const* data;
+    std::size_t size;
+};
+
+/// @brief    Bounds checked access to one chunk of an .evtx file.
+class ChunkView
+{
+    unsigned char const* chunk_;
+
+    public:
+    explicit ChunkView(unsigned char const* chunk) : chunk_(chunk)
+    {
+    }
+
+    unsigned char const* At(std::size_t offset, std::size_t length) const
+    {
+        if (offset > chunkSize || length > chunkSize - offset)
+        {
+            throw InvalidEventLogFileException();
+        }
+
+        return chunk_ + offset;
+    }
+
+    std::size_t OffsetOf(unsigned char const* pointer) const
+    {
+        return static_cast<std::size_t>(pointer - chunk_);
+    }
+
+    unsigned char U8(std::size_t offset) const
+    {
+        return *At(offset, 1);
+    }
+
+    std::uint16_t U16(std::size_t offset) const
+    {
+        return ReadU16(At(offset, 2));
+    }
+
+    std::uint32_t U32(std::size_t offset) const
+    {
+        return ReadU32(At(offset, 4));
+    }
+
+    std::uint64_t U64(std::size_t offset) const
+    {
+        return ReadU64(At(offset, 8));
+    }
+
+    /// @brief    Reads a name referred to by offset. Names appear inline the
+    ///         first time they are used in a chunk, in which case position is
+    ///         moved past them.
+    std::wstring Name(std::uint32_t nameOffset, std::size_t& position) const
+    {
+        std::size_t const characters = U16(nameOffset + 6);
+        if (nameOffset == position)
+        {
+            position += 8 + characters * 2 + 2;
+        }
+
+        return ReadUtf16(At(nameOffset + 8, characters * 2), characters);
+    }
+};
+
+static std::wstring ScalarToString(unsigned char type,
+                                   unsigned char const* data,
+                                   std::size_t size)
+{
+    std::wstring result;
+    switch (type)
+    {
+    case valueNull:
+        break;
+    case valueString:
+        result = ReadUtf16(data, size / 2);
+        TrimNulls(result);
+        break;
+    case valueAnsiString:
+        result.assign(data, data + size);
+        TrimNulls(result);
+        break;
+    case valueInt8:
+        result = std::to_wstring(static_cast<signed char>(data[0]));
+        break;
+    case valueUInt8:
+        result = std::to_wstring(data[0]);
+        break;
+    case valueInt16:
+        result = std::to_wstring(static_cast<std::int16_t>(ReadU16(data)));
+        break;
+    case valueUInt16:
+        result = std::to_wstring(ReadU16(data));
+        break;
+    case valueInt32:
+        result = std::to_wstring(static_cast<std::int32_t>(ReadU32(data)));
+        break;
+    case valueUInt32:
+        result = std::to_wstring(ReadU32(data));
+        break;
+    case valueInt64:
+        result = std::to_wstring(static_cast<std::int64_t>(ReadU64(data)));
+        break;
+    case valueUInt64:
+        result = std::to_wstring(ReadU64(data));
+        break;
+    case valueReal32:
+    {
+        float value;
+        std::memcpy(&value, data, sizeof(value));
+        result = std::to_wstring(value);
+        break;
+    }
+    case valueReal64:
+    {
+        double value;
+        std::memcpy(&value, data, sizeof(value));
+        result = std::to_wstring(value);
+        break;
+    }
+    case valueBool:
+        result = ReadU32(data) != 0 ? L"true" : L"false";
+        break;
+    case valueGuid:
+        result.push_back(L'{');
+        AppendHex(result, ReadU32(data), 8);
+        result.push_back(L'-');
+        AppendHex(result, ReadU16(data + 4), 4);
+        result.push_back(L'-');
+        AppendHex(result, ReadU16(data + 6), 4);
+        result.push_back(L'-');
+        for (std::size_t idx = 8; idx < 16; ++idx)
+        {
+            if (idx == 10)
+            {
+                result.push_back(L'-');
+            }
+            AppendHex(result, data[idx], 2);
+        }
+        result.push_back(L'}');
+        break;
+    case valueHexInt32:
+        result = L"0x";
+        AppendHex(result, ReadU32(data), 1);
+        break;
+    case valueSizeT:
+        // Four or eight bytes, depending on the bitness of the writer.
+        if (size != 4 && size != 8)
+        {
+            throw InvalidEventLogFileException();
+        }
+        result = L"0x";
+        AppendHex(result, size == 4 ? ReadU32(data) : ReadU64(data), 1);
+        break;
+    case valueHexInt64:
+        result = L"0x";
+        AppendHex(result, ReadU64(data), 1);
+        break;
+    case valueFileTime:
+        result = FormatFileTime(ReadU64(data));
+        break;
+    case valueSystemTime:
+        AppendPadded(result, ReadU16(data), 4);
+        result.push_back(L'-');
+        AppendPadded(result, ReadU16(data + 2), 2);
+        result.push_back(L'-');
+        AppendPadded(result, ReadU16(data + 6), 2);
+        result.push_back(L'T');
+        AppendPadded(result, ReadU16(data + 8), 2);
+        result.push_back(L':');
+        AppendPadded(result, ReadU16(data + 10), 2);
+        result.push_back(L':');
+        AppendPadded(result, ReadU16(data + 12), 2);
+        result.push_back(L'.');
+        AppendPadded(result, ReadU16(data + 14), 3);
+        result.push_back(L'Z');
+        break;
+    case valueSid:
+    {
+        std::uint64_t authority = 0;
+        for (std::size_t idx = 2; idx < 8; ++idx)
+        {
+            authority = (authority << 8) | data[idx];
+        }
+        result = L"S-" + std::to_wstring(data[0]) + L"-" +
+                 std::to_wstring(authority);
+        std::size_t const subAuthorities =
+            (std::min)(static_cast<std::size_t>(data[1]), (size - 8) / 4);
+        for (std::size_t idx = 0; idx < subAuthorities; ++idx)
+        {
+            result.push_back(L'-');
+            result.append(std::to_wstring(ReadU32(data + 8 + idx * 4)));
+        }
+        break;
+    }
+    default:
+        for (std::size_t idx = 0; idx < size; ++idx)
+        {
+            AppendHex(result, data[idx], 2);
+        }
+        break;
+    }
+
+    return result;
+}
+
+/// @brief    Gets the size of each element of a fixed size value type, or
+///         zero if the type's size varies. For SizeT this is the smaller of
+///         its two sizes.
+static std::size_t ScalarSize(unsigned char type)
+{
+    switch (type)
+    {
+    case valueInt8:
+    case valueUInt8:
+        return 1;
+    case valueInt16:
+    case valueUInt16:
+        return 2;
+    case valueInt32:
+    case valueUInt32:
+    case valueReal32:
+    case valueBool:
+    case valueHexInt32:
+    case valueSizeT: // At least; ScalarToString checks for 4 or 8.
+        return 4;
+    case valueInt64:
+    case valueUInt64:
+    case valueReal64:
+    case valueFileTime:
+    case valueHexInt64:
+        return 8;
+    case valueGuid:
+    case valueSystemTime:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+/// @brief    Renders a value as text. Array elements are separated by ", ".
+static std::wstring ValueToString(BinXmlValue const& value)
+{
+    if ((value.type & valueArrayBit) == 0)
+    {
+        std::size_t const minimumSize = ScalarSize(value.type);
+        if (value.size < minimumSize ||
+            (value.type == valueSid && value.size < 8))
+        {
+            throw InvalidEventLogFileException();
+        }
+
+        return ScalarToString(value.type, value.data, value.size);
+    }
+
+    unsigned char const type = static_cast<unsigned char>(value.type & ~valueArrayBit);
+    std::wstring result;
+    if (type == valueString)
+    {
+        // Strings in an array are each null terminated.
+        std::wstring const all = ReadUtf16(value.data, value.size / 2);
+        std::size_t start = 0;
+        while (start < all.size())
+        {
+            std::size_t end = all.find(L'\0', start);
+            if (end == std::wstring::npos)
+            {
+                end = all.size();
+            }
+            if (!result.empty())
+            {
+                result.append(L", ");
+            }
+            result.append(all, start, end - start);
+            start = end + 1;
+        }
+
+        return result;
+    }
+
+    // Elements of a SizeT array could be either width, so the array is
+    // rendered as bytes.
+    std::size_t const elementSize = type == valueSizeT ? 0 : ScalarSize(type);
+    if (elementSize == 0)
+    {
+        return ScalarToString(valueBinary, value.data, value.size);
+    }
+
+    for (std::size_t offset = 0; offset + elementSize <= value.size;
+         offset += elementSize)
+    {
+        if (offset != 0)
+        {
+            result.append(L", ");
+        }
+        result.append(ScalarToString(type, value.data + offset, elementSize));
+    }
+
+    return result;
+}
+
+/// @brief    Decodes the binary XML of one event record, keeping only the
+///         parts an EventLogFileEntry holds.
+///
+/// @remarks Elements are tracked by name as they are opened and closed; the
+///          System section supplies the provider, ID, level and time, and
+///          the leaf elements of EventData or UserData supply the strings.
+///          Decoding stops as soon as the System section shows the event is
+///          not selected.
+class RecordDecoder
+{
+    struct Element
+    {
+        std::wstring name;
+        std::wstring text;
+        bool hasChildren;
+    };
+
+    ChunkView const& chunk_;
+    EventLogFileFilter const& filter_;
+    std::vector<Element> elements_;
+    std::wstring attribute_;
+    bool systemDone_;
+    bool rejected_;
+
+    std::wstring provider_;
+    std::uint16_t level_;
+    std::uint32_t eventId_;
+    std::uint16_t qualifiers_;
+    std::uint64_t created_;
+    std::vector<std::string> strings_;
+
+    bool InSection(wchar_t const* name) const
+    {
+        return elements_.size() >= 2 && elements_[1].name == name;
+    }
+
+    void OnValue(BinXmlValue const& value, unsigned depth)
+    {
+        if (value.type == valueBinXml)
+        {
+            std::size_t const first = chunk_.OffsetOf(value.data);
+            DecodeFragment(first, first + value.size, nullptr, depth + 1);
+            return;
+        }
+
+        if (value.type == valueFileTime && attribute_ == L"SystemTime" &&
+            !elements_.empty() && elements_.back().name == L"TimeCreated" &&
+            value.size >= 8)
+        {
+            created_ = ReadU64(value.data);
+            return;
+        }
+
+        OnText(ValueToString(value));
+    }
+
+    void OnText(std::wstring const& text)
+    {
+        if (elements_.empty())
+        {
+            return;
+        }
+
+        if (attribute_.empty())
+        {
+            elements_.back().text.append(text);
+            return;
+        }
+
+        std::wstring const& element = elements_.back().name;
+        if (element == L"Provider" && attribute_ == L"Name")
+        {
+            provider_.append(text);
+        }
+        else if (element == L"EventID" && attribute_ == L"Qualifiers")
+        {
+            qualifiers_ = static_cast<std::uint16_t>(ParseNumber(text));
+        }
+    }
+
+    void OpenElement(std::wstring name)
+    {
+        if (!elements_.empty())
+        {
+            elements_.back().hasChildren = true;
+        }
+
+        Element element = {std::move(name), std::wstring(), false};
+        elements_.emplace_back(std::move(element));
+    }
+
+    void CloseElement()
+    {
+        attribute_.clear();
+        if (elements_.empty())
+        {
+            throw InvalidEventLogFileException();
+        }
+
+        Element const& element = elements_.back();
+        std::size_t const depth = elements_.size() - 1;
+        if (depth == 2 && InSection(L"System"))
+        {
+            if (element.name == L"EventID")
+            {
+                eventId_ = static_cast<std::uint32_t>(ParseNumber(element.text));
+            }
+            else if (element.name == L"Level")
+            {
+                level_ = static_cast<std::uint16_t>(ParseNumber(element.text));
+            }
+        }
+        else if (depth == 1 && element.name == L"System")
+        {
+            systemDone_ = true;
+            rejected_ = !filter_.Matches(level_, eventId_, created_);
+        }
+        else if (depth >= 2 && !element.hasChildren &&
+                 element.name != L"Binary" &&
+                 (InSection(L"EventData") || InSection(L"UserData")))
+        {
+            strings_.emplace_back(utf8::ToUtf8(element.text));
+        }
+
+        elements_.pop_back();
+    }
+
+    std::size_t DecodeTemplateInstance(std::size_t position, unsigned depth)
+    {
+        std::uint32_t const definition = chunk_.U32(position + 6);
+        position += 10;
+        std::size_t const bodySize = chunk_.U32(definition + 20);
+        std::size_t const body = definition + 24;
+        if (definition == position)
+        {
+            // The definition appears inline the first time it is used.
+            position = body + bodySize;
+        }
+
+        std::size_t const count = chunk_.U32(position);
+        position += 4;
+        if (count > chunkSize / 4)
+        {
+            throw InvalidEventLogFileException();
+        }
+
+        std::vector<BinXmlValue> values;
+        values.reserve(count);
+        std::size_t data = position + count * 4;
+        for (std::size_t idx = 0; idx < count; ++idx)
+        {
+            std::size_t const size = chunk_.U16(position + idx * 4);
+            BinXmlValue value = {chunk_.U8(position + idx * 4 + 2),
+                                 chunk_.At(data, size),
+                                 size};
+            values.push_back(value);
+            data += size;
+        }
+
+        DecodeFragment(body, body + bodySize, &values, depth + 1);
+        return data;
+    }
+
+    void DecodeFragment(std::size_t position,
+                        std::size_t last,
+                        std::vector<BinXmlValue> const* values,
+                        unsigned depth)
+    {
+        if (depth > maximumNesting)
+        {
+            throw InvalidEventLogFileException();
+        }
+
+        while (!rejected_ && position < last)
+        {
+            unsigned char const token = chunk_.U8(position);
+            switch (token & ~binXmlMoreBit)
+            {
+            case binXmlEndOfStream:
+                return;
+            case binXmlFragmentHeader:
+                position += 4;
+                break;
+            case binXmlTemplateInstance:
+                position = DecodeTemplateInstance(position, depth);
+                break;
+            case binXmlOpenStartElement:
+            {
+                std::uint32_t const nameOffset = chunk_.U32(position + 7);
+                position += 11;
+                std::wstring name = chunk_.Name(nameOffset, position);
+                if (token & binXmlMoreBit)
+                {
+                    // Size of the attribute list
+                    position += 4;
+                }
+                OpenElement(std::move(name));
+                break;
+            }
+            case binXmlCloseStartElement:
+                attribute_.clear();
+                position += 1;
+                break;
+            case binXmlCloseEmptyElement:
+            case binXmlEndElement:
+                position += 1;
+                CloseElement();
+                break;
+            case binXmlValue:
+            {
+                if (chunk_.U8(position + 1) != valueString)
+                {
+                    throw InvalidEventLogFileException();
+                }
+                std::size_t const characters = chunk_.U16(position + 2);
+                OnText(ReadUtf16(chunk_.At(position + 4, characters * 2),
+                                 characters));
+                position += 4 + characters * 2;
+                break;
+            }
+            case binXmlAttribute:
+            {
+                std::uint32_t const nameOffset = chunk_.U32(position + 1);
+                position += 5;
+                attribute_ = chunk_.Name(nameOffset, position);
+                break;
+            }
+            case binXmlCData:
+            {
+                std::size_t const characters = chunk_.U16(position + 1);
+                OnText(ReadUtf16(chunk_.At(position + 3, characters * 2),
+                                 characters));
+                position += 3 + characters * 2;
+                break;
+            }
+            case binXmlCharRef:
+                OnText(std::wstring(
+                    1, static_cast<wchar_t>(chunk_.U16(position + 1))));
+                position += 3;
+                break;
+            case binXmlEntityRef:
+            {
+                std::uint32_t const nameOffset = chunk_.U32(position + 1);
+                position += 5;
+                std::wstring const entity = chunk_.Name(nameOffset, position);
+                if (entity == L"amp")
+                    OnText(L"&");
+                else if (entity == L"lt")
+                    OnText(L"<");
+                else if (entity == L"gt")
+                    OnText(L">");
+                else if (entity == L"quot")
+                    OnText(L"\"");
+                else if (entity == L"apos")
+                    OnText(L"'");
+                break;
+            }
+            case binXmlPITarget:
+            {
+                std::uint32_t const nameOffset = chunk_.U32(position + 1);
+                position += 5;
+                chunk_.Name(nameOffset, position);
+                break;
+            }
+            case binXmlPIData:
+                position += 3 + chunk_.U16(position + 1) * 2;
+                break;
+            case binXmlNormalSubstitution:
+            case binXmlOptionalSubstitution:
+            {
+                std::size_t const id = chunk_.U16(position + 1);
+                position += 4;
+                if (values != nullptr && id < values->size())
+                {
+                    OnValue((*values)[id], depth);
+                }
+                break;
+            }
+            default:
+                throw InvalidEventLogFileException();
+            }
+        }
+    }
+
+    public:
+    RecordDecoder(ChunkView const& chunk,
+                  EventLogFileFilter const& filter,
+                  std::uint64_t written)
+        : chunk_(chunk)
+        , filter_(filter)
+        , systemDone_(false)
+        , rejected_(false)
+        , level_(0)
+        , eventId_(0)
+        , qualifiers_(0)
+        , created_(written)
+    {
+    }
+
+    /// @brief    Decodes the record's binary XML.
+    ///
+    /// @return    true if the event is selected by the filter.
+    bool Decode(std::size_t first, std::size_t last)
+    {
+        DecodeFragment(first, last, nullptr, 0);
+        if (!systemDone_)
+        {
+            rejected_ = !filter_.Matches(level_, eventId_, created_);
+        }
+
+        return !rejected_;
+    }
+
+    EventLogFileEntry TakeEntry(std::uint64_t recordId)
+    {
+        return EventLogFileEntry(utf8::ToUtf8(provider_),
+                                 level_,
+                                 eventId_,
+                                 qualifiers_,
+                                 created_,
+                                 recordId,
+                                 std::move(strings_));
+    }
+};
+
+static std::vector<EventLogFileEntry>
+DecodeChunk(unsigned char const* chunk, EventLogFileFilter const& filter)
+{
+    ChunkView const view(chunk);
+    std::size_t last = view.U32(chunkFreeSpaceOffset);
+    if (last < chunkHeaderSize || last > chunkSize)
+    {
+        last = chunkSize;
+    }
+
+    std::vector<EventLogFileEntry> entries;
+    std::size_t position = chunkHeaderSize;
+    while (last - position >= recordHeaderSize + 4 &&
+           view.U32(position) == recordSignature)
+    {
+        std::size_t const size = view.U32(position + recordSizeOffset);
+        if (size < recordHeaderSize + 4 || size > last - position ||
+            view.U32(position + size - 4) != size)
+        {
+            break;
+        }
+
+        try
+        {
+            RecordDecoder decoder(
+                view, filter, view.U64(position + recordWrittenOffset));
+            if (decoder.Decode(position + recordHeaderSize,
+                               position + size - 4))
+            {
+                entries.emplace_back(
+                    decoder.TakeEntry(view.U64(position + recordIdOffset)));
+            }
+        }
+        catch (std::exception const&)
+        {
+            // Records which cannot be decoded are skipped; the record size
+            // still leads to the next one.
+        }
+
+        position += size;
+    }
+
+    return entries;
+}
+}
+
+EventLogFileFilter::EventLogFileFilter() : notBefore(0)
+{
+}
+
+bool EventLogFileFilter::Matches(std::uint16_t level,
+                                 std::uint32_t eventId,
+                                 std::uint64_t created) const
+{
+    if (!levels.empty() &&
+        std::find(levels.cbegin(), levels.cend(), level) == levels.cend())
+    {
+        return false;
+    }
+
+    if (created < notBefore)
+    {
+        return false;
+    }
+
+    return std::find(excludedEventIds.cbegin(),
+                     excludedEventIds.cend(),
+                     eventId) == excludedEventIds.cend();
+}
+
+EventLogFileEntry::EventLogFileEntry(std::string sourceName,
+                                     std::uint16_t eventLevel,
+                                     std::uint32_t id,
+                                     std::uint16_t eventQualifiers,
+                                     std::uint64_t creationTime,
+                                     std::uint64_t eventRecordId,
+                                     std::vector<std::string> eventStrings)
+    : source(std::move(sourceName))
+    , level(eventLevel)
+    , eventId(id)
+    , qualifiers(eventQualifiers)
+    , created(creationTime)
+    , recordId(eventRecordId)
+    , strings(std::move(eventStrings))
+{
+}
+
+std::string const& EventLogFileEntry::GetSource() const
+{
+    return source;
+}
+
+std::uint16_t EventLogFileEntry::GetLevel() const
+{
+    return level;
+}
+
+std::uint32_t EventLogFileEntry::GetEventId() const
+{
+    return eventId;
+}
+
+std::uint16_t EventLogFileEntry::GetQualifiers() const
+{
+    return qualifiers;
+}
+
+std::uint64_t EventLogFileEntry::GetCreated() const
+{
+    return created;
+}
+
+std::uint64_t EventLogFileEntry::GetRecordId() const
+{
+    return recordId;
+}
+
+std::vector<std::string> const& EventLogFileEntry::GetStrings() const
+{
+    return strings;
+}
+
+std::string EventLogFileEntry::GetDescription() const
+{
+    if (strings.empty())
+    {
+        return "No Description Available.";
+    }
+
+    std::string result(strings[0]);
+    for (std::size_t idx = 1; idx < strings.size(); ++idx)
+    {
+        result.append("; ");
+        result.append(strings[idx]);
+    }
+
+    return result;
+}
+
+EventLogFile::EventLogFile(unsigned char const* first,
+                           unsigned char const* last,
+                           EventLogFileFilter filter)
+    : filter_(std::move(filter))
+{
+    std::size_t const totalSize = static_cast<std::size_t>(last - first);
+    if (totalSize < fileHeaderSize || std::memcmp(first, "ElfFile", 8) != 0)
+    {
+        throw InvalidEventLogFileException();
+    }
+
+    first_ = first;
+
+    // The file is a ring of chunks, so the oldest chunk need not be the first
+    // one in the file. Unused chunks have no signature, or no records.
+    std::vector<std::pair<std::uint64_t, std::size_t>> ordered;
+    for (std::size_t offset = fileHeaderSize; totalSize - offset >= chunkSize;
+         offset += chunkSize)
+    {
+        unsigned char const* const chunk = first + offset;
+        if (std::memcmp(chunk, "ElfChnk", 8) != 0 ||
+            ReadU32(chunk + chunkFreeSpaceOffset) <= chunkHeaderSize)
+        {
+            continue;
+        }
+
+        ordered.emplace_back(ReadU64(chunk + chunkFirstRecordNumberOffset),
+                             offset);
+    }
+
+    std::sort(ordered.begin(), ordered.end());
+    chunks_.reserve(ordered.size());
+    for (auto const& chunk : ordered)
+    {
+        chunks_.push_back(chunk.second);
+    }
+}
+
+std::size_t EventLogFile::GetChunkCount() const
+{
+    return chunks_.size();
+}
+
+std::vector<EventLogFileEntry> EventLogFile::ReadChunk(std::size_t index) const
+{
+    return DecodeChunk(first_ + chunks_[index], filter_);
+}
+
+void EventLogFile::ReadEvents(
+    std::function<bool(EventLogFileEntry&)> const& visitor) const
+{
+    // Decode a couple of chunks per worker ahead of the visitor, so that
+    // memory stays bounded and stopping early skips the rest of the file.
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    std::size_t const batchSize = workerCount * 2;
+    for (std::size_t batch = 0; batch < chunks_.size(); batch += batchSize)
+    {
+        std::size_t const count = (std::min)(batchSize, chunks_.size() - batch);
+        std::vector<std::vector<EventLogFileEntry>> decoded(count);
+        ParallelFor(count,
+                    [&](std::size_t index) {
+                        decoded[index] = ReadChunk(batch + index);
+                    },
+                    workerCount);
+
+        for (auto& entries : decoded)
+        {
+            for (auto& entry : entries)
+            {
+                if (!visitor(entry))
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
+}
+}
@@ -0,0 +1,174 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/config.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    Exception for signaling a file which is not in the .evtx format.
+struct InvalidEventLogFileException : public std::exception
+{
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return "Invalid Event Log File";
+    }
+};
+
+/// @brief    Selects events while an EventLogFile is decoded, so that events
+///         which are not wanted are never fully decoded.
+struct EventLogFileFilter
+{
+    /// @summary    The levels to select, or empty to select every level.
+    std::vector<std::uint16_t> levels;
+
+    /// @summary    Events created before this time, as a FILETIME in
+    ///             integer form, are not selected.
+    std::uint64_t notBefore;
+
+    /// @summary    Event IDs which are not selected.
+    std::vector<std::uint32_t> excludedEventIds;
+
+    /// @brief    Default constructor. Constructs a filter selecting every
+    ///         event.
+    EventLogFileFilter();
+
+    /// @brief    Checks whether an event is selected.
+    ///
+    /// @param    level      The event's level.
+    /// @param    eventId    The event's ID, without qualifiers.
+    /// @param    created    The event's creation time, as a FILETIME in
+    ///                      integer form.
+    bool Matches(std::uint16_t level,
+                 std::uint32_t eventId,
+                 std::uint64_t created) const;
+};
+
+/// @brief    An event decoded from an .evtx file.
+///
+/// @remarks OfflineEventLog adapts these to EventLogEntry on Windows.
+class EventLogFileEntry
+{
+    std::string source;
+    std::uint16_t level;
+    std::uint32_t eventId;
+    std::uint16_t qualifiers;
+    std::uint64_t created;
+    std::uint64_t recordId;
+    std::vector<std::string> strings;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    sourceName         The provider name.
+    /// @param    eventLevel         The event's level.
+    /// @param    id                 The event ID, without qualifiers.
+    /// @param    eventQualifiers    The event ID qualifiers, or zero.
+    /// @param    creationTime       The creation time, as a FILETIME in
+    ///                              integer form.
+    /// @param    eventRecordId      The event record identifier.
+    /// @param    eventStrings       The event's EventData or UserData
+    ///                              values.
+    EventLogFileEntry(std::string sourceName,
+                      std::uint16_t eventLevel,
+                      std::uint32_t id,
+                      std::uint16_t eventQualifiers,
+                      std::uint64_t creationTime,
+                      std::uint64_t eventRecordId,
+                      std::vector<std::string> eventStrings);
+
+    /// @brief    Gets the provider name of the event.
+    std::string const& GetSource() const;
+
+    /// @brief    Gets the event's level, such as 2 for errors.
+    std::uint16_t GetLevel() const;
+
+    /// @brief    Gets the event ID, without qualifiers.
+    std::uint32_t GetEventId() const;
+
+    /// @brief    Gets the event ID qualifiers, as set by legacy sources.
+    std::uint16_t GetQualifiers() const;
+
+    /// @brief    Gets the creation time, as a FILETIME in integer form.
+    std::uint64_t GetCreated() const;
+
+    /// @brief    Gets the event record identifier.
+    std::uint64_t GetRecordId() const;
+
+    /// @brief    Gets the event's EventData or UserData values, in order.
+    std::vector<std::string> const& GetStrings() const;
+
+    /// @brief    Gets the description of the event.
+    ///
+    /// @remarks Message files belong to the machine which wrote the log, so
+    ///          they are not consulted; the description is the event's
+    ///          values, separated by "; ".
+    ///
+    /// @return    The description.
+    std::string GetDescription() const;
+};
+
+/// @brief    Reader for event log files in the .evtx format, which does not
+///         use the event log service.
+///
+/// @remarks The file's 64 KiB chunks are decoded in parallel, each on its
+///          own. Events are visited in record order (oldest first), and only
+///          those selected by the filter are decoded past their System
+///          section. Chunk and record checksums are not verified; records
+///          which cannot be decoded are skipped. This allows reading logs
+///          from disks which are not running, or logs which the event log
+///          service cannot open. OfflineEventLog maps .evtx files and reads
+///          them through this class.
+class EventLogFile : boost::noncopyable
+{
+    unsigned char const* first_;
+    std::vector<std::size_t> chunks_;
+    EventLogFileFilter filter_;
+
+    public:
+    /// @brief    Constructor. Reads an .evtx image already in memory.
+    ///
+    /// @remarks The memory is not copied, and must outlive this instance.
+    ///
+    /// @param    first     Pointer to the start of the .evtx image.
+    /// @param    last      Pointer one past the end of the .evtx image.
+    /// @param    filter    (optional) The events to select.
+    ///
+    /// @throws InvalidEventLogFileException The image is not an .evtx file.
+    EventLogFile(unsigned char const* first,
+                 unsigned char const* last,
+                 EventLogFileFilter filter = EventLogFileFilter());
+
+    /// @brief    Gets the number of chunks which hold events.
+    std::size_t GetChunkCount() const;
+
+    /// @brief    Decodes the selected events in one chunk.
+    ///
+    /// @param    index    Zero-based index of the chunk, in record order.
+    ///
+    /// @return    The events, in record order.
+    std::vector<EventLogFileEntry> ReadChunk(std::size_t index) const;
+
+    /// @brief    Reads the selected events one at a time.
+    ///
+    /// @remarks Chunks are decoded a few at a time ahead of the visitor, so
+    ///          stopping early saves decoding the rest of the file.
+    ///
+    /// @param    visitor    Called with each event. Returns false to stop
+    ///                      reading.
+    void ReadEvents(
+        std::function<bool(EventLogFileEntry&)> const& visitor) const;
+};
+}
+}
@@ -0,0 +1,225 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "EventMessageCache.hpp"
+#include "Library.hpp"
+#include "LogSink.hpp"
+#include "Utf8.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+MessageTemplate::MessageTemplate()
+{
+}
+
+MessageTemplate::MessageTemplate(std::wstring const& definition)
+{
+    std::wstring text;
+    auto const flushText = [&] {
+        if (!text.empty())
+        {
+            Segment segment = {std::move(text), 0};
+            segments.emplace_back(std::move(segment));
+            text.clear();
+        }
+    };
+
+    std::size_t const length = definition.size();
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        wchar_t const ch = definition[idx];
+        if (ch != L'%' || idx + 1 == length)
+        {
+            text.push_back(ch);
+            continue;
+        }
+
+        wchar_t const next = definition[++idx];
+        if (next >= L'1' && next <= L'9')
+        {
+            std::size_t insert = next - L'0';
+            if (idx + 1 < length && definition[idx + 1] >= L'0' &&
+                definition[idx + 1] <= L'9')
+            {
+                insert = insert * 10 + (definition[++idx] - L'0');
+            }
+
+            // Skip a !printf format!; every insertion string is a string.
+            if (idx + 1 < length && definition[idx + 1] == L'!')
+            {
+                std::size_t const close = definition.find(L'!', idx + 2);
+                if (close != std::wstring::npos)
+                {
+                    idx = close;
+                }
+            }
+
+            flushText();
+            Segment segment = {std::wstring(), insert};
+            segments.emplace_back(std::move(segment));
+            continue;
+        }
+
+        switch (next)
+        {
+        case L'0':
+            // Ends the message without a trailing newline.
+            flushText();
+            return;
+        case L'n':
+            text.append(L"\r\n");
+            break;
+        case L'r':
+            text.push_back(L'\r');
+            break;
+        case L't':
+            text.push_back(L'\t');
+            break;
+        case L'b':
+            text.push_back(L' ');
+            break;
+        default:
+            // %%, %., %!, "% ", and anything unknown produce the character
+            // itself.
+            text.push_back(next);
+            break;
+        }
+    }
+
+    flushText();
+}
+
+std::string
+MessageTemplate::Format(std::vector<std::wstring> const& arguments) const
+{
+    std::wstring result;
+    for (Segment const& segment : segments)
+    {
+        if (segment.insert == 0)
+        {
+            result.append(segment.text);
+        }
+        else if (segment.insert <= arguments.size())
+        {
+            result.append(arguments[segment.insert - 1]);
+        }
+        else
+        {
+            result.push_back(L'%');
+            result.append(utf8::ToUtf16(std::to_string(segment.insert)));
+        }
+    }
+
+    return utf8::ToUtf8(result);
+}
+
+std::string format_value(EventMessageCacheStatistics const& statistics)
+{
+    std::size_t const total = statistics.hits + statistics.misses;
+    std::size_t const percent =
+        total == 0 ? 0 : statistics.hits * 100 / total;
+    std::string result;
+    write(result,
+          statistics.hits,
+          " hits, ",
+          statistics.misses,
+          " misses (",
+          percent,
+          "% hit rate)");
+    return result;
+}
+
+bool EventMessageCache::TemplateKey::operator==(TemplateKey const& other) const
+{
+    return eventId == other.eventId && language == other.language &&
+           provider == other.provider;
+}
+
+std::size_t EventMessageCache::TemplateKeyHash::
+operator()(TemplateKey const& key) const
+{
+    std::size_t hash = std::hash<std::string>()(key.provider);
+    hash ^= std::hash<DWORD>()(key.eventId) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+    hash ^= std::hash<LANGID>()(key.language) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+    return hash;
+}
+
+EventMessageCache::EventMessageCache() : hits(0), misses(0)
+{
+}
+
+template <typename T, typename Map, typename Key>
+T EventMessageCache::GetOrLoad(Map& entries,
+                               Key const& key,
+                               std::function<T()> const& load)
+{
+    std::shared_ptr<Entry<T>> entry;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::shared_ptr<Entry<T>>& slot = entries[key];
+        if (!slot)
+        {
+            slot = std::make_shared<Entry<T>>();
+        }
+
+        entry = slot;
+    }
+
+    // Loading happens outside the lock, as loaders open modules and
+    // publishers, which can be slow.
+    bool loadedHere = false;
+    std::call_once(entry->loaded, [&] {
+        entry->value = load();
+        loadedHere = true;
+    });
+    ++(loadedHere ? misses : hits);
+    return entry->value;
+}
+
+std::shared_ptr<FormattedMessageLoader> EventMessageCache::GetMessageModule(
+    std::string const& provider,
+    std::function<std::shared_ptr<FormattedMessageLoader>()> const& open)
+{
+    return GetOrLoad(messageModules, provider, open);
+}
+
+std::shared_ptr<void> EventMessageCache::GetPublisherMetadata(
+    std::string const& provider,
+    std::function<std::shared_ptr<void>()> const& open)
+{
+    return GetOrLoad(publishers, provider, open);
+}
+
+std::shared_ptr<MessageTemplate const>
+EventMessageCache::GetTemplate(std::string const& provider,
+                               DWORD eventId,
+                               LANGID language,
+                               std::function<std::wstring()> const& load)
+{
+    TemplateKey const key = {provider, eventId, language};
+    return GetOrLoad<std::shared_ptr<MessageTemplate const>>(
+        templates, key, [&] {
+        return std::make_shared<MessageTemplate const>(load());
+    });
+}
+
+EventMessageCacheStatistics EventMessageCache::GetStatistics() const
+{
+    EventMessageCacheStatistics const statistics = {hits.load(),
+                                                    misses.load()};
+    return statistics;
+}
+
+EventMessageCache& GetEventMessageCache()
+{
+    static EventMessageCache cache;
+    return cache;
+}
+}
+}
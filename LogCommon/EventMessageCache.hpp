@@ -0,0 +1,165 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+class FormattedMessageLoader;
+
+/// @brief    A message definition in FormatMessage syntax, split into literal
+///         text and insert references so that it can be formatted any number
+///         of times without calling FormatMessage.
+class MessageTemplate
+{
+    struct Segment
+    {
+        std::wstring text;
+        /// @summary    The one-based insert number, or zero for literal text.
+        std::size_t insert;
+    };
+    std::vector<Segment> segments;
+
+    public:
+    /// @brief    Default constructor. Constructs an empty template.
+    MessageTemplate();
+
+    /// @brief    Parses a message definition.
+    ///
+    /// @remarks Inserts (%1 through %99, optionally followed by a !format!
+    ///          which is ignored as all insertion strings are strings) and the
+    ///          escapes %n, %r, %t, %b, %0, %%, %., %! and "% " are understood
+    ///          as FormatMessage understands them.
+    ///
+    /// @param    definition    The message definition, as stored in a
+    ///                         message table; see
+    ///                         FormattedMessageLoader::GetMessageDefinition.
+    explicit MessageTemplate(std::wstring const& definition);
+
+    /// @brief    Substitutes insertion strings into the template.
+    ///
+    /// @param    arguments    The insertion strings; %1 is the first one.
+    ///                        Inserts with no matching string are left as
+    ///                        they appear in the definition.
+    ///
+    /// @return    The formatted message.
+    std::string Format(std::vector<std::wstring> const& arguments) const;
+};
+
+/// @brief    Counts of the lookups an EventMessageCache has served.
+struct EventMessageCacheStatistics
+{
+    std::size_t hits;
+    std::size_t misses;
+};
+
+/// @brief    Formats cache statistics for a log, such as
+///         "90 hits, 10 misses (90% hit rate)".
+std::string format_value(EventMessageCacheStatistics const& statistics);
+
+/// @brief    Remembers the message modules, publisher metadata, and parsed
+///         message templates used to describe events, so that a log full of
+///         the same event only loads and parses its message once.
+///
+/// @remarks Each getter calls its loader only on the first request for a
+///          key. A null result from a loader is remembered as well, and a
+///          loader which throws leaves nothing behind. All members may be
+///          called from several threads. Loaders run outside the cache's
+///          lock, so different keys load in parallel and a loader may use
+///          the cache for other keys; concurrent requests for a key which is
+///          being loaded wait for that load.
+class EventMessageCache : boost::noncopyable
+{
+    template <typename T> struct Entry
+    {
+        std::once_flag loaded;
+        T value;
+    };
+
+    typedef Entry<std::shared_ptr<FormattedMessageLoader>> ModuleEntry;
+    typedef Entry<std::shared_ptr<void>> PublisherEntry;
+    typedef Entry<std::shared_ptr<MessageTemplate const>> TemplateEntry;
+
+    struct TemplateKey
+    {
+        std::string provider;
+        DWORD eventId;
+        LANGID language;
+
+        bool operator==(TemplateKey const& other) const;
+    };
+
+    struct TemplateKeyHash
+    {
+        std::size_t operator()(TemplateKey const& key) const;
+    };
+
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<ModuleEntry>>
+        messageModules;
+    std::unordered_map<std::string, std::shared_ptr<PublisherEntry>>
+        publishers;
+    std::unordered_map<TemplateKey, std::shared_ptr<TemplateEntry>,
+                       TemplateKeyHash> templates;
+    std::atomic<std::size_t> hits;
+    std::atomic<std::size_t> misses;
+
+    template <typename T, typename Map, typename Key>
+    T GetOrLoad(Map& entries, Key const& key, std::function<T()> const& load);
+
+    public:
+    /// @brief    Default constructor. Constructs an empty cache.
+    EventMessageCache();
+
+    /// @brief    Gets the message module of a legacy event source.
+    ///
+    /// @param    provider    Name of the event source.
+    /// @param    open        Opens the module, or returns null if the source
+    ///                       has none.
+    std::shared_ptr<FormattedMessageLoader> GetMessageModule(
+        std::string const& provider,
+        std::function<std::shared_ptr<FormattedMessageLoader>()> const& open);
+
+    /// @brief    Gets the publisher metadata handle of an event provider.
+    ///
+    /// @param    provider    Name of the provider.
+    /// @param    open        Opens the metadata, returning a handle which
+    ///                       closes itself, or null if the provider has none.
+    std::shared_ptr<void>
+    GetPublisherMetadata(std::string const& provider,
+                         std::function<std::shared_ptr<void>()> const& open);
+
+    /// @brief    Gets the parsed message template of an event.
+    ///
+    /// @param    provider    Name of the event source or provider.
+    /// @param    eventId     The event ID, including any qualifiers.
+    /// @param    language    The language of the message.
+    /// @param    load        Loads the message definition.
+    std::shared_ptr<MessageTemplate const>
+    GetTemplate(std::string const& provider,
+                DWORD eventId,
+                LANGID language,
+                std::function<std::wstring()> const& load);
+
+    /// @brief    Gets the number of lookups served so far.
+    EventMessageCacheStatistics GetStatistics() const;
+};
+
+/// @brief    Gets the cache shared by the event log readers.
+EventMessageCache& GetEventMessageCache();
+}
+}
@@ -5,14 +5,11 @@
 #include "File.hpp"
 #include <algorithm>
 #include <iterator>
-#include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include <limits>
 #include "Utf8.hpp"
 #include "Win32Exception.hpp"
-#include "OptimisticBuffer.hpp"
 #include "Utf8.hpp"
-
-#pragma comment(lib, "Version.lib")
+#include "VersionResource.hpp"
 
 namespace Instalog
 {
@@ -102,44 +99,24 @@ std::vector<char> File::ReadBytes(unsigned int bytesToRead) const
     return bytes;
 }
 
-std::vector<std::string> File::ReadAllLines() const
+LineReader File::Lines() const
 {
-    std::string buffer;
     if (::SetFilePointer(hFile, 0, 0, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
     {
         Win32Exception::ThrowFromLastError();
     }
 
-    auto const readSize = 4096u;
-    DWORD bytesRead = readSize;
-    while (bytesRead != 0)
+    HANDLE const handle = hFile;
+    return LineReader([handle](unsigned char* buffer, std::size_t size) -> std::size_t
     {
-        char stackBuff[readSize];
-        if (::ReadFile(hFile, stackBuff, readSize, &bytesRead, nullptr) == false)
+        DWORD bytesRead;
+        if (::ReadFile(handle, buffer, static_cast<DWORD>(size), &bytesRead, nullptr) == false)
         {
             Win32Exception::ThrowFromLastError();
         }
 
-        buffer.append(stackBuff, bytesRead);
-    }
-    
-    std::size_t isTextUnicodeLength = std::min(buffer.size(), static_cast<std::size_t>(std::numeric_limits<int>::max()));
-
-    // If the input is UTF-16, convert it to UTF-8.
-    if (::IsTextUnicode(buffer.c_str(), static_cast<int>(isTextUnicodeLength), nullptr))
-    {
-        buffer = utf8::ToUtf8(reinterpret_cast<wchar_t const*const>(buffer.c_str()), buffer.size() / sizeof(wchar_t));
-    }
-
-    // If the input contained a byte order mark, remove it.
-    if (boost::algorithm::starts_with(buffer, "\xEF\xBB\xBF"))
-    {
-        buffer.erase(0, 3);
-    }
-
-    std::vector<std::string> result;
-    boost::algorithm::split(result, buffer, [](char c) { return c == '\r' || c == '\n'; }, boost::algorithm::token_compress_on);
-    return result;
+        return bytesRead;
+    });
 }
 
 bool File::WriteBytes(std::vector<char> const& bytes)
@@ -202,54 +179,22 @@ bool File::IsExecutable(std::string const& filename)
 
 std::string File::GetCompany(std::string const& filenameUtf8)
 {
-    std::wstring filename(utf8::ToUtf16(filenameUtf8));
-
-    // The version data is usually <= 4k
-    auto const initialTry = 4096;
-    OptimisticBuffer<4096> buff(initialTry);
-    if (::GetFileVersionInfoW(filename.c_str(),
-        0,
-        static_cast<DWORD>(buff.Size()),
-        buff.Get()) == 0)
+    // Only the resource directory and version block are read from the
+    // mapping, rather than loading the image as GetFileVersionInfo does.
+    MemoryMappedFile image(filenameUtf8);
+    VersionResource version(image.cbegin(), image.cend());
+    if (!version.HasVersionInfo())
     {
-        DWORD lastError = ::GetLastError();
-        if (lastError != ERROR_INSUFFICIENT_BUFFER)
-        {
-            Win32Exception::Throw(lastError);
-        }
-
-        // Optimistic attempt failed, figure out the actual size and use that.
-        DWORD infoSize = ::GetFileVersionInfoSizeW(filename.c_str(), 0);
-        if (infoSize == 0)
-        {
-            Win32Exception::ThrowFromLastError();
-        }
-
-        buff.Resize(infoSize);
-        if (::GetFileVersionInfoW(filename.c_str(),
-                                  0,
-                                  static_cast<DWORD>(buff.Size()),
-                                  buff.Get()) == 0)
-        {
-            Win32Exception::ThrowFromLastError();
-        }
+        Win32Exception::Throw(ERROR_RESOURCE_TYPE_NOT_FOUND);
     }
 
-    wchar_t const targetPath[] = L"\\StringFileInfo\\040904B0\\CompanyName";
-    void* companyData;
-    UINT len;
-    if (::VerQueryValueW(buff.Get(), targetPath, &companyData, &len) == 0)
+    expected<Utf16View> company = version.GetCompanyName();
+    if (!company.is_valid())
     {
-        Win32Exception::ThrowFromLastError();
-    }
-    
-    std::wstring wideResult;
-    if (len != 0)
-    {
-        wideResult.assign(static_cast<wchar_t*>(companyData), len - 1);
+        Win32Exception::Throw(ERROR_RESOURCE_NAME_NOT_FOUND);
     }
 
-    return utf8::ToUtf8(wideResult);
+    return company.get().ToUtf8();
 }
 
 std::uint64_t File::GetSize(std::string const& filename)
@@ -726,5 +671,121 @@ bool FindFiles::OnEndShouldLeave() BOOST_NOEXCEPT_OR_NOTHROW
 {
     return this->lastError == ERROR_NO_MORE_FILES && !this->handleStack.empty();
 }
+
+MemoryMappedFile::MemoryMappedFile() BOOST_NOEXCEPT_OR_NOTHROW
+    : hMapping(nullptr),
+      view(nullptr),
+      viewSize(0)
+{
+}
+
+MemoryMappedFile::MemoryMappedFile(std::string const& filename)
+    : hMapping(nullptr), view(nullptr), viewSize(0)
+{
+    HANDLE hFile = ::CreateFileW(utf8::ToUtf16(filename).c_str(),
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        Win32Exception::ThrowFromLastError();
+    }
+
+    // The mapping object keeps the file open; the file handle itself is only
+    // needed until the mapping is created.
+    LARGE_INTEGER fileSize;
+    if (::GetFileSizeEx(hFile, &fileSize) == FALSE)
+    {
+        DWORD const lastError = ::GetLastError();
+        ::CloseHandle(hFile);
+        Win32Exception::Throw(lastError);
+    }
+
+    if (fileSize.QuadPart == 0)
+    {
+        // CreateFileMapping refuses to map empty files; model them as an
+        // empty view instead.
+        ::CloseHandle(hFile);
+        return;
+    }
+
+    if (static_cast<std::uint64_t>(fileSize.QuadPart) >
+        std::numeric_limits<std::size_t>::max())
+    {
+        ::CloseHandle(hFile);
+        Win32Exception::Throw(ERROR_NOT_ENOUGH_MEMORY);
+    }
+
+    hMapping =
+        ::CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    DWORD const mappingError = ::GetLastError();
+    ::CloseHandle(hFile);
+    if (hMapping == nullptr)
+    {
+        Win32Exception::Throw(mappingError);
+    }
+
+    view = static_cast<unsigned char const*>(
+        ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (view == nullptr)
+    {
+        DWORD const lastError = ::GetLastError();
+        ::CloseHandle(hMapping);
+        hMapping = nullptr;
+        Win32Exception::Throw(lastError);
+    }
+
+    viewSize = static_cast<std::size_t>(fileSize.QuadPart);
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other)
+    BOOST_NOEXCEPT_OR_NOTHROW : hMapping(other.hMapping),
+                                view(other.view),
+                                viewSize(other.viewSize)
+{
+    other.hMapping = nullptr;
+    other.view = nullptr;
+    other.viewSize = 0;
+}
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other)
+    BOOST_NOEXCEPT_OR_NOTHROW
+{
+    std::swap(hMapping, other.hMapping);
+    std::swap(view, other.view);
+    std::swap(viewSize, other.viewSize);
+    return *this;
+}
+
+MemoryMappedFile::~MemoryMappedFile() BOOST_NOEXCEPT_OR_NOTHROW
+{
+    if (view != nullptr)
+    {
+        ::UnmapViewOfFile(view);
+    }
+
+    if (hMapping != nullptr)
+    {
+        ::CloseHandle(hMapping);
+    }
+}
+
+unsigned char const* MemoryMappedFile::cbegin() const BOOST_NOEXCEPT_OR_NOTHROW
+{
+    return view;
+}
+
+unsigned char const* MemoryMappedFile::cend() const BOOST_NOEXCEPT_OR_NOTHROW
+{
+    return view + viewSize;
+}
+
+std::size_t MemoryMappedFile::size() const BOOST_NOEXCEPT_OR_NOTHROW
+{
+    return viewSize;
+}
 }
 }
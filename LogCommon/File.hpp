@@ -10,6 +10,7 @@
 #include <boost/noncopyable.hpp>
 #include <windows.h>
 #include "Expected.hpp"
+#include "LineReader.hpp"
 
 namespace Instalog
 {
@@ -97,7 +98,14 @@ class File : boost::noncopyable
     /// fails.</exception>
     bool WriteBytes(std::vector<char> const& bytes);
 
-    std::vector<std::string> ReadAllLines() const;
+    /// <summary>Reads the lines of the file from the start, a chunk at a
+    /// time, rather than all at once.</summary>
+    /// <returns>A reader over the lines of the file, which must outlive it.
+    /// See <c>LineReader</c> for how encodings and line breaks are
+    /// handled.</returns>
+    /// <exception cref="Win32Exception">Thrown when the underlying
+    /// <c>SetFilePointer</c> or <c>ReadFile</c> calls fail.</exception>
+    LineReader Lines() const;
 
     /// <summary>Gets the size of a file without opening the file.</summary>
     /// <param name="filename">Filename of the file.</param>
@@ -147,9 +155,12 @@ class File : boost::noncopyable
     /// <returns>true if executable; otherwise, false.</returns>
     static bool IsExecutable(std::string const& filename);
 
-    /// <summary>Gets the company of the given file.</summary>
+    /// <summary>Gets the company of the given file, from the CompanyName in
+    /// its version resource.</summary>
     /// <param name="target">File name of the file to check.</param>
     /// <returns>The company.</returns>
+    /// <exception cref="Win32Exception">Thrown when the file cannot be mapped,
+    /// or has no version resource or no company name.</exception>
     static std::string GetCompany(std::string const& target);
 };
 
@@ -334,5 +345,51 @@ inline void swap(FindFiles& lhs, FindFiles& rhs) BOOST_NOEXCEPT_OR_NOTHROW
 {
     lhs.Swap(rhs);
 }
+
+/// <summary>A read-only view of an entire file mapped into memory.</summary>
+class MemoryMappedFile : boost::noncopyable
+{
+    HANDLE hMapping;
+    unsigned char const* view;
+    std::size_t viewSize;
+
+    public:
+    /// <summary>Default constructor. Constructs an empty mapping.</summary>
+    MemoryMappedFile() BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Constructor. Maps the whole of the given file for
+    /// reading.</summary>
+    /// <param name="filename">Filename of the file to map.</param>
+    /// <exception cref="Win32Exception">Thrown when the file cannot be opened
+    /// or mapped.</exception>
+    explicit MemoryMappedFile(std::string const& filename);
+
+    /// <summary>Move constructor.</summary>
+    /// <param name="other">[in,out] The mapping to move from. It is left
+    /// empty.</param>
+    MemoryMappedFile(MemoryMappedFile&& other) BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Move assignment operator.</summary>
+    /// <param name="other">[in,out] The mapping to move from.</param>
+    /// <returns>*this</returns>
+    MemoryMappedFile& operator=(MemoryMappedFile&& other) BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Destructor. Unmaps the view.</summary>
+    ~MemoryMappedFile() BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Gets a pointer to the first byte of the mapped view.</summary>
+    /// <returns>The start of the view, or nullptr for an empty
+    /// mapping.</returns>
+    unsigned char const* cbegin() const BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Gets a pointer one past the last byte of the mapped
+    /// view.</summary>
+    /// <returns>The end of the view.</returns>
+    unsigned char const* cend() const BOOST_NOEXCEPT_OR_NOTHROW;
+
+    /// <summary>Gets the size of the mapped view in bytes.</summary>
+    /// <returns>The size of the view.</returns>
+    std::size_t size() const BOOST_NOEXCEPT_OR_NOTHROW;
+};
 }
 }
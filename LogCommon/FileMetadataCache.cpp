@@ -0,0 +1,127 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <exception>
+#include <locale>
+#include <boost/algorithm/string/case_conv.hpp>
+#include "File.hpp"
+#include "FileMetadataCache.hpp"
+#include "Win32Exception.hpp"
+#include "WorkerThreads.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+FileMetadata::FileMetadata()
+    : exists(false), size(0), creationTime(0), hasCompany(false)
+{
+}
+
+FileMetadata LoadFileMetadata(std::string const& path)
+{
+    FileMetadata metadata;
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    try
+    {
+        fad = File::GetExtendedAttributes(path);
+    }
+    catch (ErrorFileNotFoundException const&)
+    {
+        return metadata;
+    }
+    catch (ErrorPathNotFoundException const&)
+    {
+        return metadata;
+    }
+
+    metadata.exists = true;
+    metadata.size =
+        static_cast<std::uint64_t>(fad.nFileSizeHigh) << 32 | fad.nFileSizeLow;
+    metadata.creationTime =
+        static_cast<std::uint64_t>(fad.ftCreationTime.dwHighDateTime) << 32 |
+        fad.ftCreationTime.dwLowDateTime;
+    try
+    {
+        metadata.company = File::GetCompany(path);
+        metadata.hasCompany = true;
+    }
+    catch (Win32Exception const&)
+    {
+        // No version resource, or no company name in it.
+    }
+
+    return metadata;
+}
+
+FileMetadataCache::FileMetadataCache() : load(LoadFileMetadata)
+{
+}
+
+FileMetadataCache::FileMetadataCache(
+    std::function<FileMetadata(std::string const&)> loader)
+    : load(std::move(loader))
+{
+}
+
+FileMetadata const& FileMetadataCache::Get(std::string const& path)
+{
+    std::shared_ptr<Entry> entry;
+    {
+        std::string key(
+            boost::algorithm::to_upper_copy(path, std::locale::classic()));
+        std::lock_guard<std::mutex> guard(lock);
+        std::shared_ptr<Entry>& slot = entries[key];
+        if (!slot)
+        {
+            slot = std::make_shared<Entry>();
+        }
+
+        entry = slot;
+    }
+
+    // Loading happens outside the lock, so that different paths load in
+    // parallel.
+    std::call_once(entry->loaded, [&] { entry->metadata = load(path); });
+    return entry->metadata;
+}
+
+void FileMetadataCache::Prefetch(std::vector<std::string> const& paths)
+{
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    ParallelFor(paths.size(), [&](std::size_t index) {
+        try
+        {
+            Get(paths[index]);
+        }
+        catch (std::exception const&)
+        {
+            // Not cached; the caller sees the error when it asks for the
+            // file.
+        }
+    }, workerCount);
+}
+
+void FileMetadataCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+}
+
+std::size_t FileMetadataCache::GetSize() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
+
+FileMetadataCache& GetFileMetadataCache()
+{
+    static FileMetadataCache cache;
+    return cache;
+}
+}
+}
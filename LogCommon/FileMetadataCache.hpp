@@ -0,0 +1,117 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    The facts about a file which the log prints next to its path.
+struct FileMetadata
+{
+    /// @summary    false if the file or its directory does not exist, in
+    ///             which case the other members are not set.
+    bool exists;
+
+    /// @summary    The size of the file, in bytes.
+    std::uint64_t size;
+
+    /// @summary    The creation time, as a FILETIME in integer form.
+    std::uint64_t creationTime;
+
+    /// @summary    true if the file has a company name in its version
+    ///             resource.
+    bool hasCompany;
+
+    /// @summary    The company name, if hasCompany is set.
+    std::string company;
+
+    /// @brief    Default constructor. Describes a file which does not exist.
+    FileMetadata();
+};
+
+/// @brief    Reads the metadata of a file from disk.
+///
+/// @param    path    Full path of the file.
+///
+/// @return    The metadata.
+///
+/// @throws Win32Exception The file exists but could not be read.
+FileMetadata LoadFileMetadata(std::string const& path);
+
+/// @brief    A thread safe cache of file metadata, keyed by full path.
+///
+/// @remarks The same few hundred system binaries are referenced by many
+///          services, drivers and load points, so each path is loaded at
+///          most once per run; concurrent requests for a path which is being
+///          loaded wait for that load. Paths are compared without regard to
+///          case. A load which throws is not cached, and is retried by the
+///          next request.
+class FileMetadataCache : boost::noncopyable
+{
+    struct Entry
+    {
+        std::once_flag loaded;
+        FileMetadata metadata;
+    };
+
+    std::function<FileMetadata(std::string const&)> load;
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+
+    public:
+    /// @brief    Default constructor. Loads metadata with LoadFileMetadata.
+    FileMetadataCache();
+
+    /// @brief    Constructor.
+    ///
+    /// @param    loader    Called with a path to load its metadata.
+    explicit FileMetadataCache(
+        std::function<FileMetadata(std::string const&)> loader);
+
+    /// @brief    Gets the metadata of a file, loading it if it is not cached.
+    ///
+    /// @param    path    Full path of the file.
+    ///
+    /// @return    The metadata, which stays valid for the life of the cache.
+    FileMetadata const& Get(std::string const& path);
+
+    /// @brief    Loads the metadata of several files in parallel, so that
+    ///         later calls to Get for them do not touch the disk.
+    ///
+    /// @remarks Files which fail to load are skipped; Get reports the
+    ///          failure if they are asked for.
+    ///
+    /// @param    paths    Full paths of the files.
+    void Prefetch(std::vector<std::string> const& paths);
+
+    /// @brief    Forgets all cached metadata, so that files are read from disk
+    ///         again.
+    ///
+    /// @remarks References returned by Get before the call become invalid, so
+    ///          this must not race with any other member.
+    void Clear();
+
+    /// @brief    Gets the number of paths which have been requested.
+    std::size_t GetSize() const;
+};
+
+/// @brief    Gets the file metadata cache shared by the whole run.
+///
+/// @remarks Script::Run clears the cache as it starts, so that a run does not
+///          report files as a previous run in the same process saw them.
+FileMetadataCache& GetFileMetadataCache();
+}
+}
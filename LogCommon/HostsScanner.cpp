@@ -0,0 +1,113 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <string>
+#include "HostsScanner.hpp"
+#include "LogSink.hpp"
+#include "StringUtilities.hpp"
+
+namespace Instalog
+{
+
+static bool IsHostsWhitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f';
+}
+
+HostsScanner::HostsScanner(unsigned char const* first, unsigned char const* last)
+    : lines(first, last)
+{
+}
+
+bool HostsScanner::Next(boost::string_ref& entry)
+{
+    boost::string_ref line;
+    while (lines.Next(line))
+    {
+        std::size_t first = 0;
+        while (first != line.size() && IsHostsWhitespace(line[first]))
+        {
+            ++first;
+        }
+
+        if (first == line.size() || line[first] == '#')
+        {
+            continue;
+        }
+
+        std::size_t last = line.size();
+        while (IsHostsWhitespace(line[last - 1]))
+        {
+            --last;
+        }
+
+        entry = line.substr(first, last - first);
+        return true;
+    }
+
+    return false;
+}
+
+bool IsLoopbackHostsEntry(boost::string_ref entry)
+{
+    std::size_t addressLength = 0;
+    while (addressLength != entry.size() &&
+           !IsHostsWhitespace(entry[addressLength]))
+    {
+        ++addressLength;
+    }
+
+    boost::string_ref const address(entry.data(), addressLength);
+    return address == "127.0.0.1" || address == "0.0.0.0" || address == "::1";
+}
+
+void WriteHostsEntries(log_sink& output,
+                       HostsScanner& scanner,
+                       std::size_t entryLimit)
+{
+    std::size_t written = 0;
+    std::size_t otherWritten = 0;
+    std::size_t loopbackOmitted = 0;
+    std::size_t otherOmitted = 0;
+    boost::string_ref entry;
+    while (scanner.Next(entry))
+    {
+        bool const loopback = IsLoopbackHostsEntry(entry);
+        if (written < entryLimit)
+        {
+            ++written;
+        }
+        else if (loopback)
+        {
+            ++loopbackOmitted;
+            continue;
+        }
+        else if (otherWritten < entryLimit)
+        {
+            ++otherWritten;
+        }
+        else
+        {
+            ++otherOmitted;
+            continue;
+        }
+
+        std::string line(entry.data(), entry.size());
+        HttpEscape(line);
+        writeln(output, "Hosts: ", line);
+    }
+
+    if (loopbackOmitted != 0 || otherOmitted != 0)
+    {
+        writeln(output,
+                "Hosts: ",
+                loopbackOmitted + otherOmitted,
+                " more entries not shown (",
+                loopbackOmitted,
+                " to loopback or null addresses, ",
+                otherOmitted,
+                " to other addresses)");
+    }
+}
+}
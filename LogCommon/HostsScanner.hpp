@@ -0,0 +1,60 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "LineReader.hpp"
+
+namespace Instalog
+{
+struct log_sink;
+
+/// @brief    Reads the entries of a hosts file held in memory, such as a
+///         mapped view, one line at a time.
+///
+/// @remarks Blank lines and comment lines are skipped, and entries are
+///          trimmed of surrounding whitespace. Lines are read, and UTF-16
+///          files converted, by LineReader.
+class HostsScanner : boost::noncopyable
+{
+    LineReader lines;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    first    Pointer to the start of the file. The memory must
+    ///                    outlive the scanner.
+    /// @param    last     Pointer one past the end of the file.
+    HostsScanner(unsigned char const* first, unsigned char const* last);
+
+    /// @brief    Gets the next entry.
+    ///
+    /// @param [out]    entry    The entry, valid until the next call.
+    ///
+    /// @return    false if there are no more entries.
+    bool Next(boost::string_ref& entry);
+};
+
+/// @brief    Checks whether a hosts entry redirects to 127.0.0.1, 0.0.0.0 or
+///         ::1, as ad blocking hosts files do.
+///
+/// @param    entry    The trimmed entry.
+bool IsLoopbackHostsEntry(boost::string_ref entry);
+
+/// @brief    Writes hosts entries to the log, keeping the output bounded for
+///         very large hosts files.
+///
+/// @remarks The first entryLimit entries are written, then up to entryLimit
+///          more which redirect somewhere other than a loopback or null
+///          address. A summary counts the entries left out.
+///
+/// @param [in,out]    output        The log to write to.
+/// @param [in,out]    scanner       The scanner to read entries from.
+/// @param    entryLimit    The number of entries to write in each pass.
+void WriteHostsEntries(log_sink& output,
+                       HostsScanner& scanner,
+                       std::size_t entryLimit);
+}
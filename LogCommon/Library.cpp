@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include "Library.hpp"
+#include "DdkStructures.h"
 #include "ScopeExit.hpp"
 #include "Utf8.hpp"
 
@@ -141,5 +142,82 @@ std::string FormattedMessageLoader::GetFormattedMessage(
 
     return FormatMessageU(reporter, this->hModule, messageId, argPtr);
 }
+
+#ifndef MESSAGE_RESOURCE_UTF8
+#define MESSAGE_RESOURCE_UTF8 0x0002
+#endif
+
+// Converts a raw message table entry, which may be stored in any of the
+// three encodings message compilers produce, to UTF-16.
+static std::wstring MessageEntryText(MESSAGE_RESOURCE_ENTRY const* entry)
+{
+    std::size_t const textLength =
+        entry->Length - FIELD_OFFSET(MESSAGE_RESOURCE_ENTRY, Text);
+    if (entry->Flags & MESSAGE_RESOURCE_UNICODE)
+    {
+        wchar_t const* const text =
+            reinterpret_cast<wchar_t const*>(entry->Text);
+        std::size_t length = textLength / sizeof(wchar_t);
+        length = std::find(text, text + length, L'\0') - text;
+        return std::wstring(text, length);
+    }
+
+    char const* const text = reinterpret_cast<char const*>(entry->Text);
+    int const length =
+        static_cast<int>(std::find(text, text + textLength, '\0') - text);
+    UINT const codePage =
+        (entry->Flags & MESSAGE_RESOURCE_UTF8) ? CP_UTF8 : CP_ACP;
+    std::wstring result(length, L'\0');
+    if (length != 0)
+    {
+        result.resize(static_cast<std::size_t>(::MultiByteToWideChar(
+            codePage, 0, text, length, &result[0], length)));
+    }
+
+    return result;
+}
+
+// The module FormatMessage takes FORMAT_MESSAGE_FROM_SYSTEM messages from.
+static HMODULE GetSystemMessageModule()
+{
+    HMODULE const kernelBase = ::GetModuleHandleW(L"kernelbase.dll");
+    return kernelBase == nullptr ? ::GetModuleHandleW(L"kernel32.dll")
+                                 : kernelBase;
+}
+
+std::wstring FormattedMessageLoader::GetMessageDefinition(
+    IErrorReporter& reporter,
+    DWORD messageId,
+    LANGID language)
+{
+    this->RequireValid();
+    // FormatMessage expands escapes such as %% and %n even when told to
+    // ignore inserts, so the entry is read from the message table directly,
+    // with the same lookup FormatMessage uses.
+    static RtlFindMessageFunc PRtlFindMessage =
+        GetNtDll().GetProcAddress<RtlFindMessageFunc>(
+            GetThrowingErrorReporter(), "RtlFindMessage");
+    ULONG const messageTable =
+        static_cast<ULONG>(reinterpret_cast<ULONG_PTR>(RT_MESSAGETABLE));
+    PMESSAGE_RESOURCE_ENTRY entry = nullptr;
+    NTSTATUS status =
+        PRtlFindMessage(hModule, messageTable, language, messageId, &entry);
+    if (!NT_SUCCESS(status))
+    {
+        status = PRtlFindMessage(GetSystemMessageModule(),
+                                 messageTable,
+                                 language,
+                                 messageId,
+                                 &entry);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        reporter.ReportNtError(status, "RtlFindMessage");
+        return std::wstring();
+    }
+
+    return MessageEntryText(entry);
+}
 }
 }
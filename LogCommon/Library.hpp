@@ -133,6 +133,21 @@ class FormattedMessageLoader : public Library
     std::string
     GetFormattedMessage(IErrorReporter& reporter, DWORD messageId,
                         std::vector<std::string> const& arguments);
+
+    /// @brief Gets the definition of a message, with its inserts and escapes left in place.
+    ///
+    /// @remarks The definition is read from the module's message table, or from the system's
+    ///          as FORMAT_MESSAGE_FROM_SYSTEM would, rather than through FormatMessage, which
+    ///          expands escapes even when told to ignore inserts.
+    ///
+    /// @param [in,out] reporter Error reporting strategy to use. If the function fails and the
+    ///                          reporter does not throw an exception, returns an empty string.
+    /// @param messageId         Identifier for the message.
+    /// @param language          The language of the message.
+    ///
+    /// @return The message definition, suitable for parsing into a MessageTemplate.
+    std::wstring GetMessageDefinition(IErrorReporter& reporter, DWORD messageId,
+                                      LANGID language = LANG_SYSTEM_DEFAULT);
 };
 }
 }
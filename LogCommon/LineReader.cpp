@@ -0,0 +1,357 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "LineReader.hpp"
+
+namespace Instalog
+{
+
+// The number of bytes requested from the read function at a time.
+static std::size_t const readChunkSize = 64 * 1024;
+
+// The number of leading bytes the encoding is detected from.
+static std::size_t const encodingSampleSize = 256;
+
+static bool IsUtf16(unsigned char const* first, std::size_t size)
+{
+    if (size < 2)
+    {
+        return false;
+    }
+
+    if (first[0] == 0xFF && first[1] == 0xFE)
+    {
+        return true;
+    }
+
+    std::size_t const sample =
+        (std::min)(size, encodingSampleSize) & ~static_cast<std::size_t>(1);
+    for (std::size_t idx = 0; idx < sample; idx += 2)
+    {
+        if (first[idx] == 0 || first[idx + 1] != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool HasUtf8ByteOrderMark(unsigned char const* first, std::size_t size)
+{
+    return size >= 3 && first[0] == 0xEF && first[1] == 0xBB &&
+           first[2] == 0xBF;
+}
+
+static void AppendUtf8(std::vector<char>& target, std::uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        target.push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800)
+    {
+        target.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        target.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else if (codePoint < 0x10000)
+    {
+        target.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        target.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else
+    {
+        target.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        target.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        target.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+LineReader::iterator::iterator() : reader(nullptr)
+{
+}
+
+LineReader::iterator::iterator(LineReader& reader) : reader(&reader)
+{
+    ++*this;
+}
+
+boost::string_ref const& LineReader::iterator::operator*() const
+{
+    return line;
+}
+
+boost::string_ref const* LineReader::iterator::operator->() const
+{
+    return &line;
+}
+
+LineReader::iterator& LineReader::iterator::operator++()
+{
+    if (!reader->Next(line))
+    {
+        reader = nullptr;
+    }
+
+    return *this;
+}
+
+bool LineReader::iterator::operator==(iterator const& other) const
+{
+    return reader == other.reader;
+}
+
+bool LineReader::iterator::operator!=(iterator const& other) const
+{
+    return reader != other.reader;
+}
+
+LineReader::LineReader(ReadFunction read)
+    : read(std::move(read)),
+      encoding(Undetected),
+      endOfInput(false),
+      current(nullptr),
+      last(nullptr),
+      lineFeed(nullptr)
+{
+}
+
+LineReader::LineReader(unsigned char const* first, unsigned char const* last)
+    : encoding(Undetected),
+      endOfInput(false),
+      current(nullptr),
+      last(nullptr),
+      lineFeed(nullptr)
+{
+    std::size_t const size = static_cast<std::size_t>(last - first);
+    if (IsUtf16(first, size))
+    {
+        // Transcode a chunk at a time, as for any other source.
+        read = [first, last](unsigned char* buffer, std::size_t bufferSize) mutable
+        {
+            std::size_t const count =
+                (std::min)(bufferSize, static_cast<std::size_t>(last - first));
+            std::memcpy(buffer, first, count);
+            first += count;
+            return count;
+        };
+        return;
+    }
+
+    // 8 bit text needs no decoding, so lines are handed out in place.
+    encoding = Narrow;
+    endOfInput = true;
+    current = reinterpret_cast<char const*>(first);
+    this->last = reinterpret_cast<char const*>(last);
+    if (HasUtf8ByteOrderMark(first, size))
+    {
+        current += 3;
+    }
+}
+
+LineReader::LineReader(LineReader&& other)
+    : read(std::move(other.read)),
+      encoding(other.encoding),
+      endOfInput(other.endOfInput),
+      raw(std::move(other.raw)),
+      text(std::move(other.text)),
+      current(other.current),
+      last(other.last),
+      lineFeed(other.lineFeed)
+{
+    other.endOfInput = true;
+    other.current = nullptr;
+    other.last = nullptr;
+    other.lineFeed = nullptr;
+}
+
+LineReader& LineReader::operator=(LineReader&& other)
+{
+    read = std::move(other.read);
+    encoding = other.encoding;
+    endOfInput = other.endOfInput;
+    raw = std::move(other.raw);
+    text = std::move(other.text);
+    current = other.current;
+    last = other.last;
+    lineFeed = other.lineFeed;
+    other.endOfInput = true;
+    other.current = nullptr;
+    other.last = nullptr;
+    other.lineFeed = nullptr;
+    return *this;
+}
+
+bool LineReader::Next(boost::string_ref& line)
+{
+    for (;;)
+    {
+        if (current == last)
+        {
+            if (endOfInput)
+            {
+                return false;
+            }
+
+            Refill();
+            continue;
+        }
+
+        // memchr is vectorized by the CRT, so the line feed is found a
+        // register at a time. Carriage returns are only searched for within
+        // the line, and the line feed is remembered across lines so files
+        // with bare carriage returns are not rescanned.
+        if (lineFeed == nullptr || lineFeed < current)
+        {
+            void const* const found = std::memchr(
+                current, '\n', static_cast<std::size_t>(last - current));
+            lineFeed = found == nullptr ? last : static_cast<char const*>(found);
+        }
+
+        char const* lineEnd = lineFeed;
+        void const* const carriageReturn = std::memchr(
+            current, '\r', static_cast<std::size_t>(lineEnd - current));
+        if (carriageReturn != nullptr)
+        {
+            lineEnd = static_cast<char const*>(carriageReturn);
+        }
+
+        if (lineEnd == last || (*lineEnd == '\r' && lineEnd + 1 == last))
+        {
+            // The line, or its "\r\n", may continue in the next chunk.
+            if (!endOfInput)
+            {
+                Refill();
+                continue;
+            }
+        }
+
+        line = boost::string_ref(current,
+                                 static_cast<std::size_t>(lineEnd - current));
+        if (lineEnd == last)
+        {
+            current = last;
+        }
+        else
+        {
+            current = lineEnd + 1;
+            if (*lineEnd == '\r' && current != last && *current == '\n')
+            {
+                ++current;
+            }
+        }
+
+        return true;
+    }
+}
+
+LineReader::iterator LineReader::begin()
+{
+    return iterator(*this);
+}
+
+LineReader::iterator LineReader::end()
+{
+    return iterator();
+}
+
+void LineReader::Refill()
+{
+    // Keep the unconsumed text, which is the start of the next line, and
+    // discard the rest. This invalidates the last line handed out.
+    std::size_t const consumed =
+        current == nullptr ? 0 : static_cast<std::size_t>(current - text.data());
+    text.erase(text.begin(), text.begin() + consumed);
+
+    do
+    {
+        std::size_t const carried = raw.size();
+        raw.resize(carried + readChunkSize);
+        std::size_t const count = read(raw.data() + carried, readChunkSize);
+        raw.resize(carried + count);
+        endOfInput = count == 0;
+    } while (encoding == Undetected && !endOfInput &&
+             raw.size() < encodingSampleSize);
+
+    if (encoding == Undetected)
+    {
+        if (IsUtf16(raw.data(), raw.size()))
+        {
+            encoding = Utf16;
+            if (raw[0] == 0xFF && raw[1] == 0xFE)
+            {
+                raw.erase(raw.begin(), raw.begin() + 2);
+            }
+        }
+        else
+        {
+            encoding = Narrow;
+            if (HasUtf8ByteOrderMark(raw.data(), raw.size()))
+            {
+                raw.erase(raw.begin(), raw.begin() + 3);
+            }
+        }
+    }
+
+    Decode();
+    current = text.data();
+    last = text.data() + text.size();
+    lineFeed = nullptr;
+}
+
+void LineReader::Decode()
+{
+    if (encoding == Narrow)
+    {
+        text.insert(text.end(), raw.begin(), raw.end());
+        raw.clear();
+        return;
+    }
+
+    // A trailing odd byte, or a high surrogate whose low surrogate is in the
+    // next chunk, is carried over to the next call.
+    std::size_t units = raw.size() / 2;
+    if (!endOfInput && units != 0 && raw[units * 2 - 1] >= 0xD8 &&
+        raw[units * 2 - 1] <= 0xDB)
+    {
+        --units;
+    }
+
+    // Unpaired surrogates become U+FFFD, as input is not trusted.
+    for (std::size_t idx = 0; idx < units; ++idx)
+    {
+        std::uint32_t const unit = raw[idx * 2] | (raw[idx * 2 + 1] << 8);
+        if (unit < 0xD800 || unit > 0xDFFF)
+        {
+            AppendUtf8(text, unit);
+            continue;
+        }
+
+        if (unit <= 0xDBFF && idx + 1 < units)
+        {
+            std::uint32_t const low = raw[idx * 2 + 2] | (raw[idx * 2 + 3] << 8);
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+                AppendUtf8(text,
+                           0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                ++idx;
+                continue;
+            }
+        }
+
+        AppendUtf8(text, 0xFFFD);
+    }
+
+    raw.erase(raw.begin(), raw.begin() + units * 2);
+    if (endOfInput)
+    {
+        raw.clear();
+    }
+}
+}
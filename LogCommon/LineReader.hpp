@@ -0,0 +1,114 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace Instalog
+{
+
+/// @brief    Reads the lines of a text file, in constant memory apart from
+///         the longest line.
+///
+/// @remarks The encoding is detected once, from the start of the file. UTF-16
+///          files are recognized by their byte order mark, or by ASCII text
+///          with every other byte zero, and are converted to UTF-8 a chunk at
+///          a time; anything else is passed through, less any UTF-8 byte
+///          order mark. Lines end at "\r\n", "\n" or "\r", and a line ending
+///          at the end of the file does not start another line. Lines are
+///          only valid until the next line is read.
+class LineReader
+{
+    public:
+    /// @brief    Reads up to size bytes into buffer, returning how many were
+    ///         read; zero means the end of the input.
+    typedef std::function<std::size_t(unsigned char* buffer, std::size_t size)>
+        ReadFunction;
+
+    /// @brief    An input iterator over the remaining lines.
+    class iterator
+    {
+        LineReader* reader;
+        boost::string_ref line;
+
+        public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef boost::string_ref value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef boost::string_ref const* pointer;
+        typedef boost::string_ref const& reference;
+
+        /// @brief    Constructs the end iterator.
+        iterator();
+
+        /// @brief    Constructs an iterator at the next line of reader.
+        explicit iterator(LineReader& reader);
+
+        boost::string_ref const& operator*() const;
+        boost::string_ref const* operator->() const;
+        iterator& operator++();
+        bool operator==(iterator const& other) const;
+        bool operator!=(iterator const& other) const;
+    };
+
+    /// @brief    Constructor. Reads lines through a fixed size buffer.
+    ///
+    /// @param    read    The function which supplies the bytes of the file.
+    explicit LineReader(ReadFunction read);
+
+    /// @brief    Constructor. Reads lines from memory, such as a mapped view.
+    ///         Lines of 8 bit files refer directly into the memory.
+    ///
+    /// @param    first    Pointer to the start of the file. The memory must
+    ///                    outlive the reader.
+    /// @param    last     Pointer one past the end of the file.
+    LineReader(unsigned char const* first, unsigned char const* last);
+
+    LineReader(LineReader const&) = delete;
+    LineReader& operator=(LineReader const&) = delete;
+
+    /// @brief    Move constructor.
+    LineReader(LineReader&& other);
+
+    /// @brief    Move assignment operator.
+    LineReader& operator=(LineReader&& other);
+
+    /// @brief    Gets the next line.
+    ///
+    /// @param [out]    line    The line, without its line break.
+    ///
+    /// @return    false if there are no more lines.
+    bool Next(boost::string_ref& line);
+
+    /// @brief    Gets an iterator at the next line.
+    iterator begin();
+
+    /// @brief    Gets the end iterator.
+    iterator end();
+
+    private:
+    enum Encoding
+    {
+        Undetected,
+        Narrow,
+        Utf16
+    };
+
+    ReadFunction read;
+    Encoding encoding;
+    bool endOfInput;
+    std::vector<unsigned char> raw;
+    std::vector<char> text;
+    char const* current;
+    char const* last;
+    char const* lineFeed;
+
+    void Refill();
+    void Decode();
+};
+}
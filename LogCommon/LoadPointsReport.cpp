@@ -9,6 +9,12 @@
 #include <string>
 #include <regex>
 #include <iterator>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <windows.h>
@@ -17,7 +23,6 @@
 #include <Wbemidl.h>
 #include <Objbase.h>
 #include <ObjIdl.h>
-#include <shobjidl.h>
 #include "Com.hpp"
 #include "SecurityCenter.hpp"
 #include "StockOutputFormats.hpp"
@@ -25,9 +30,12 @@
 #include "LoadPointsReport.hpp"
 #include "Path.hpp"
 #include "ScopeExit.hpp"
+#include "HostsScanner.hpp"
+#include "ShellLink.hpp"
 #include "Dns.hpp"
 #include "Utf8.hpp"
 #include "Library.hpp"
+#include "WorkerThreads.hpp"
 
 namespace Instalog
 {
@@ -119,6 +127,52 @@ static void HttpProcess(log_sink& out, std::string& target)
     write(out, target);
 }
 
+/**
+* How a processing function treats registry values which are not strings.
+*/
+enum class NonStringValues
+{
+    /** Their hex or dword text is passed through the processing function. */
+    Process,
+    /**
+    * The processing function leaves their hex or dword text unchanged, as
+    * GeneralProcess and HttpProcess do, so it is written straight to the
+    * output without an intermediate string.
+    */
+    WriteUnchanged
+};
+
+/**
+* Writes the data in a registry value through a processing function.
+*
+* @param [in,out] out    The output stream.
+* @param value           The value to write.
+* @param dataProcess     The process applied to the data before it is
+*printed.
+* @param nonStrings      How dataProcess treats values which are not strings.
+* @param [in,out] scratch Storage the data is formatted into before it is
+*                        processed; its contents are replaced.
+*/
+static void ProcessValueData(
+    log_sink& out,
+    BasicRegistryValue const& value,
+    std::function<void(log_sink& out, std::string& source)> const& dataProcess,
+    NonStringValues nonStrings,
+    std::string& scratch)
+{
+    DWORD const type = value.GetType();
+    if (nonStrings == NonStringValues::WriteUnchanged && type != REG_SZ &&
+        type != REG_EXPAND_SZ)
+    {
+        write_registry_value(out, value);
+        return;
+    }
+
+    scratch.clear();
+    value.AppendString(scratch);
+    dataProcess(out, scratch);
+}
+
 /**
 * Value major based enumeration; general method to enumerate a registry key,
 *where a single
@@ -132,36 +186,52 @@ static void HttpProcess(log_sink& out, std::string& target)
 * @param dataProcess     (optional) The processing function which generates the
 *report of the
 *                        values' data. The default writes the data as a file.
+* @param nonStrings      (optional) How dataProcess treats values which are not
+*                        strings.
 */
 static void ValueMajorBasedEnumeration(
     log_sink& output,
     std::string const& root,
     std::string const& prefix,
     std::function<void(log_sink& out, std::string& source)> dataProcess =
-        FileProcess)
+        FileProcess,
+    NonStringValues nonStrings = NonStringValues::Process)
 {
     RegistryKey key(RegistryKey::Open(root, KEY_QUERY_VALUE));
     if (key.Invalid())
     {
         return;
     }
-    auto values = key.EnumerateValues();
-    std::vector<std::pair<std::string, std::string>> pods;
-    for (RegistryValueAndData const& val : values)
+    // Run keys are enumerated for every hive, so the value storage, and the
+    // strings each value is formatted into, are kept around rather than
+    // allocated per value.
+    static thread_local RegistryValueArena values;
+    static thread_local std::vector<RegistryValueView const*> sorted;
+    static thread_local std::string name;
+    static thread_local std::string data;
+    key.EnumerateValues(values);
+    sorted.clear();
+    for (RegistryValueView const& val : values)
     {
-        pods.emplace_back(std::make_pair(val.GetName(), val.GetString()));
+        sorted.push_back(&val);
     }
-    ;
 
-    std::sort(pods.begin(), pods.end());
-    for (auto& current : pods)
+    std::sort(sorted.begin(),
+              sorted.end(),
+              [](RegistryValueView const * a, RegistryValueView const * b) {
+        return *a < *b;
+    });
+    for (RegistryValueView const* current : sorted)
     {
-        GeneralEscape(current.first, '#', ']');
-        write(output, prefix, ": [", current.first, "] ");
-        dataProcess(output, current.second);
+        boost::wstring_ref const nameView(current->GetNameView());
+        name.clear();
+        utf8::utf16to8(
+            nameView.begin(), nameView.end(), std::back_inserter(name));
+        GeneralEscape(name, '#', ']');
+        write(output, prefix, ": [", name, "] ");
+        ProcessValueData(output, *current, dataProcess, nonStrings, data);
         writeln(output);
     }
-    ;
 }
 
 #pragma warning(push)
@@ -185,6 +255,8 @@ static void ValueMajorBasedEnumeration(
 * @param dataProcess     (optional) [in,out] The process applied to the data
 *before it is
 *                        printed.
+* @param nonStrings      (optional) How dataProcess treats values which are not
+*                        strings.
 */
 static void ValueMajorBasedEnumerationBitless(
     log_sink& output,
@@ -193,14 +265,17 @@ static void ValueMajorBasedEnumerationBitless(
     std::string const& subkey64,
     std::string const& prefix,
     std::function<void(log_sink& out, std::string& source)> dataProcess =
-        FileProcess)
+        FileProcess,
+    NonStringValues nonStrings = NonStringValues::Process)
 {
 #ifdef _M_X64
     ValueMajorBasedEnumeration(
-        output, root + subkey64, prefix + "64", dataProcess);
-    ValueMajorBasedEnumeration(output, root + subkey32, prefix, dataProcess);
+        output, root + subkey64, prefix + "64", dataProcess, nonStrings);
+    ValueMajorBasedEnumeration(
+        output, root + subkey32, prefix, dataProcess, nonStrings);
 #else
-    ValueMajorBasedEnumeration(output, root + subkey64, prefix, dataProcess);
+    ValueMajorBasedEnumeration(
+        output, root + subkey64, prefix, dataProcess, nonStrings);
 #endif
 }
 #pragma warning(pop)
@@ -262,20 +337,15 @@ static void SubkeyMajorBasedEnumeration(
             Win32Exception::ThrowFromNtError(::GetLastError());
         }
     }
-    auto values = key.EnumerateSubKeys(KEY_QUERY_VALUE);
     std::vector<std::pair<std::string, std::string>> pods;
-    for (RegistryKey const& val : values)
-    {
-        try
+    key.ForEachSubKey({valueName},
+                      [&](std::string const& name, RegistryKey const& val) {
+        auto value = val.TryGetValue(valueName);
+        if (value.is_valid())
         {
-            pods.emplace_back(val.GetLocalName(), val[valueName].GetString());
+            pods.emplace_back(name, value.get().GetString());
         }
-        catch (ErrorFileNotFoundException const&)
-        {
-            // Expected
-        }
-    }
-    ;
+    });
     std::sort(pods.begin(), pods.end());
     for (auto& current : pods)
     {
@@ -408,10 +478,214 @@ enum MasterName
     CLASS_ROOT_DEFAULT
 };
 
+/**
+* Memoizes the registration of COM classes for the sections which print
+* CLSIDs, along with the rendered output for the files they point to.
+*
+* The same handful of CLSIDs are listed by the BHO, toolbar, URL search hook,
+* shell hook and IE extension sections, for both views of the registry and
+* once more for each user hive, and each lookup used to open the CLSID key and
+* its InProcServer32 key again. Results are keyed by the full native path of
+* the CLSID key, so the 32 and 64 bit views and each user's classes are kept
+* apart, while classes registered machine wide are resolved once for all
+* users. User hives are scanned concurrently, so all members are thread safe.
+*/
+class ClsidResolver : boost::noncopyable
+{
+public:
+    struct Registration
+    {
+        bool registered;
+        std::string name;
+        bool hasServerKey;
+        bool hasServer;
+        std::string server;
+        std::string threadingModel;
+    };
+
+    /**
+    * Resolves a CLSID.
+    *
+    * @param clsidRoot The native path of a Classes\\CLSID key, including the
+    *                  trailing backslash.
+    * @param clsid     The CLSID, in registry format.
+    *
+    * @return The registration. Names and values missing in the registry are
+    *empty.
+    */
+    Registration const& Resolve(std::string const& clsidRoot,
+                                std::string const& clsid)
+    {
+        std::string path(clsidRoot + clsid);
+        std::string lookup(
+            boost::algorithm::to_upper_copy(path, std::locale::classic()));
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto cached = registrations_.find(lookup);
+            if (cached != registrations_.end())
+            {
+                return cached->second;
+            }
+        }
+
+        Registration result;
+        result.registered = false;
+        result.hasServerKey = false;
+        result.hasServer = false;
+        RegistryKey clsidKey(RegistryKey::Open(path, KEY_QUERY_VALUE));
+        if (clsidKey.Valid())
+        {
+            result.registered = true;
+            auto name = clsidKey.TryGetValue("");
+            if (name.is_valid())
+            {
+                result.name = name.get().GetString();
+            }
+
+            RegistryKey serverKey(
+                RegistryKey::Open(clsidKey, "InProcServer32", KEY_QUERY_VALUE));
+            if (serverKey.Valid())
+            {
+                result.hasServerKey = true;
+                auto server = serverKey.TryGetValue("");
+                if (server.is_valid())
+                {
+                    result.hasServer = true;
+                    result.server = server.get().GetString();
+                }
+
+                auto threadingModel = serverKey.TryGetValue("ThreadingModel");
+                if (threadingModel.is_valid())
+                {
+                    result.threadingModel = threadingModel.get().GetString();
+                }
+            }
+        }
+
+        // Another thread may have resolved the same CLSID in the meantime;
+        // emplace keeps whichever got there first.
+        std::lock_guard<std::mutex> guard(lock_);
+        return registrations_.emplace(std::move(lookup), std::move(result))
+            .first->second;
+    }
+
+    /**
+    * Resolves a CLSID, preferring a per-user registration to the machine
+    * wide one, as COM does.
+    *
+    * @param userClsidRoot    The user's Classes\\CLSID key path.
+    * @param machineClsidRoot The machine's Classes\\CLSID key path for the
+    *                         same view.
+    * @param clsid            The CLSID.
+    *
+    * @return The user registration if there is one, otherwise the machine
+    *registration.
+    */
+    Registration const& Resolve(std::string const& userClsidRoot,
+                                std::string const& machineClsidRoot,
+                                std::string const& clsid)
+    {
+        Registration const& user = Resolve(userClsidRoot, clsid);
+        if (user.registered)
+        {
+            return user;
+        }
+
+        return Resolve(machineClsidRoot, clsid);
+    }
+
+    /**
+    * Writes the default file output for a file, rendering it only the first
+    * time that file is seen.
+    *
+    * @param [in,out] output The output stream.
+    * @param file            The file, as it appears in the registry.
+    */
+    void WriteFile(log_sink& output, std::string const& file)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto cached = files_.find(file);
+            if (cached != files_.end())
+            {
+                write(output, cached->second);
+                return;
+            }
+        }
+
+        string_sink rendered;
+        WriteDefaultFileOutput(rendered, file);
+        write(output, rendered.get());
+        std::lock_guard<std::mutex> guard(lock_);
+        files_.emplace(file, rendered.get());
+    }
+
+private:
+    std::mutex lock_;
+    std::unordered_map<std::string, Registration> registrations_;
+    std::unordered_map<std::string, std::string> files_;
+};
+
+/**
+* Writes CLSID entries, resolving each through the CLASSES key.
+*
+* @param [in,out] output The output stream.
+* @param [in,out] clsids The CLSID resolver.
+* @param prefix          The prefix applied to each log line.
+* @param rootKey         The root key.
+* @param clsidKey        The clsid key for the current bitness.
+* @param backupClsidKey  The backup clsid key (the machine cLSID key for the
+*right bitness)
+* @param nameSource      Which name "wins" between the local name and the remote
+*name.
+* @param [in,out] values The CLSIDs, each paired with its local name.
+*/
+static void WriteClsidEntries(
+    log_sink& output,
+    ClsidResolver& clsids,
+    std::string const& prefix,
+    std::string const& rootKey,
+    std::string const& clsidKey,
+    std::string const& backupClsidKey,
+    MasterName nameSource,
+    std::vector<std::pair<std::string, std::string>>& values)
+{
+    std::string const userClsidRoot(rootKey + clsidKey);
+    for (auto& currentEntry : values)
+    {
+        // Try the user specific CLSID key, then the machine CLSID key.
+        ClsidResolver::Registration const& registration =
+            clsids.Resolve(userClsidRoot, backupClsidKey, currentEntry.first);
+        // The CLSID key's name is used if the remote name is the "boss", or if
+        // the current try
+        // is empty
+        if (registration.registered &&
+            (nameSource == CLASS_ROOT_DEFAULT || currentEntry.second.empty()))
+        {
+            // Don't clobber the existing name in the event the actual name in
+            // the key is empty.
+            if (!registration.name.empty())
+            {
+                currentEntry.second = registration.name;
+            }
+        }
+        if (currentEntry.second.empty())
+        {
+            currentEntry.second = "N/A";
+        }
+        GeneralEscape(currentEntry.first, '#', '=');
+        GeneralEscape(currentEntry.second, '#', ':');
+        write(output, prefix, ": ", currentEntry.second, ": ", currentEntry.first, '=');
+        clsids.WriteFile(output, registration.server);
+        writeln(output);
+    }
+}
+
 /**
 * Clsid value based output with the bitness things applied.
 *
 * @param [in,out] output The output stream.
+* @param [in,out] clsids The CLSID resolver.
 * @param prefix          The prefix applied to each log line.
 * @param rootKey         The root key.
 * @param subKey          The sub key where the values are located.
@@ -423,6 +697,7 @@ enum MasterName
 *name.
 */
 static void ClsidValueBasedOutputWithBits(log_sink& output,
+                                          ClsidResolver& clsids,
                                           std::string const& prefix,
                                           std::string const& rootKey,
                                           std::string const& subKey,
@@ -451,59 +726,21 @@ static void ClsidValueBasedOutputWithBits(log_sink& output,
         }
     }
 
-    for (auto& currentEntry : values)
-    {
-        // First try the user specific CLSID key.
-        RegistryKey clsidKey(RegistryKey::Open(
-            rootKey + clsidKey + currentEntry.first, KEY_QUERY_VALUE));
-        if (clsidKey.Invalid())
-        {
-            // Next try the machine CLSID key.
-            clsidKey = RegistryKey::Open(backupClsidKey + currentEntry.first,
-                                         KEY_QUERY_VALUE);
-        }
-        RegistryKey inProcKey;
-        if (clsidKey.Valid())
-        {
-            // Open the InProcServer32 subkey of that.
-            inProcKey =
-                RegistryKey::Open(clsidKey, "InProcServer32", KEY_QUERY_VALUE);
-        }
-        // The CLSID key's name is used if the remote name is the "boss", or if
-        // the current try
-        // is empty
-        if (clsidKey.Valid() &&
-            (nameSource == CLASS_ROOT_DEFAULT || currentEntry.second.empty()))
-        {
-            std::string remoteName(clsidKey[""].GetString());
-            // Don't clobber the existing name in the event the actual name in
-            // the key is empty.
-            if (!remoteName.empty())
-            {
-                currentEntry.second = std::move(remoteName);
-            }
-        }
-        std::string file;
-        if (inProcKey.Valid())
-        {
-            file = inProcKey[""].GetString();
-        }
-        if (currentEntry.second.empty())
-        {
-            currentEntry.second = "N/A";
-        }
-        GeneralEscape(currentEntry.first, '#', '=');
-        GeneralEscape(currentEntry.second, '#', ':');
-        write(output, prefix, ": ", currentEntry.second, ": ", currentEntry.first, '=');
-        WriteDefaultFileOutput(output, file);
-        writeln(output);
-    }
+    WriteClsidEntries(output,
+                      clsids,
+                      prefix,
+                      rootKey,
+                      clsidKey,
+                      backupClsidKey,
+                      nameSource,
+                      values);
 }
 
 /**
 * CLSID value based output.
 *
 * @param [in,out] output The stream to write the output to.
+* @param [in,out] clsids The CLSID resolver.
 * @param prefix          The prefix used to identify the type of line generated
 *in the report.
 * @param rootKey         The root key where the check is rooted. The CLASSES key
@@ -519,6 +756,7 @@ static void ClsidValueBasedOutputWithBits(log_sink& output,
 *                        stored with the CLASSES key.
 */
 static void ClsidValueBasedOutput(log_sink& output,
+                                  ClsidResolver& clsids,
                                   std::string const& prefix,
                                   std::string const& rootKey,
                                   std::string const& subKey,
@@ -528,6 +766,7 @@ static void ClsidValueBasedOutput(log_sink& output,
 #ifdef _M_X64
     ClsidValueBasedOutputWithBits(
         output,
+        clsids,
         prefix,
         rootKey,
         "\\Software\\Wow6432Node" + subKey,
@@ -538,6 +777,7 @@ static void ClsidValueBasedOutput(log_sink& output,
 #endif
     ClsidValueBasedOutputWithBits(
         output,
+        clsids,
         prefix + Get64Suffix(),
         rootKey,
         "\\Software" + subKey,
@@ -547,22 +787,22 @@ static void ClsidValueBasedOutput(log_sink& output,
         nameSource);
 }
 
-// TODO: Make the common bits of these two go together.
 /**
 * Clsid subkey based output with the bitness things applied.
 *
 * @param [in,out] output The output stream.
+* @param [in,out] clsids The CLSID resolver.
 * @param prefix          The prefix applied to each log line.
 * @param rootKey         The root key.
 * @param subKey          The sub key where the values are located.
 * @param clsidKey        The clsid key for the current bitness.
 * @param backupClsidKey  The backup clsid key (the machine cLSID key for the
 *right bitness)
-* @param source          Source for the CLSID (name or value).
 * @param nameSource      Which name "wins" between the local name and the remote
 *name.
 */
 static void ClsidSubkeyBasedOutputWithBits(log_sink& output,
+                                           ClsidResolver& clsids,
                                            std::string const& prefix,
                                            std::string const& rootKey,
                                            std::string const& subKey,
@@ -576,79 +816,34 @@ static void ClsidSubkeyBasedOutputWithBits(log_sink& output,
     {
         return;
     }
-    auto rawValues = itemKey.EnumerateSubKeys(KEY_QUERY_VALUE);
     std::vector<std::pair<std::string, std::string>> values;
-    values.reserve(rawValues.size());
-    for (auto const& entry : rawValues)
-    {
+    itemKey.ForEachSubKey(std::vector<std::string>(),
+                          [&](std::string const& clsid,
+                              RegistryKey const& entry) {
         std::string name;
-        try
-        {
-            name = entry[""].GetString();
-        }
-        catch (ErrorFileNotFoundException const&)
+        auto defaultValue = entry.TryGetValue("");
+        if (defaultValue.is_valid())
         {
-            // Expected
+            name = defaultValue.get().GetString();
         }
-        std::string clsid(entry.GetName());
-        clsid.erase(clsid.begin(),
-                    std::find(clsid.rbegin(), clsid.rend(), '\\').base());
-        values.emplace_back(std::move(clsid), std::move(name));
-    }
+        values.emplace_back(clsid, std::move(name));
+    });
 
-    for (auto& currentEntry : values)
-    {
-        // First try the user specific CLSID key.
-        RegistryKey clsidKey(RegistryKey::Open(
-            rootKey + clsidKey + currentEntry.first, KEY_QUERY_VALUE));
-        if (clsidKey.Invalid())
-        {
-            // Next try the machine CLSID key.
-            clsidKey = RegistryKey::Open(backupClsidKey + currentEntry.first,
-                                         KEY_QUERY_VALUE);
-        }
-        RegistryKey inProcKey;
-        if (clsidKey.Valid())
-        {
-            // Open the InProcServer32 subkey of that.
-            inProcKey =
-                RegistryKey::Open(clsidKey, "InProcServer32", KEY_QUERY_VALUE);
-        }
-        // The CLSID key's name is used if the remote name is the "boss", or if
-        // the current try
-        // is empty
-        if (clsidKey.Valid() &&
-            (nameSource == CLASS_ROOT_DEFAULT || currentEntry.second.empty()))
-        {
-            std::string remoteName(clsidKey[""].GetString());
-            // Don't clobber the existing name in the event the actual name in
-            // the key is empty.
-            if (!remoteName.empty())
-            {
-                currentEntry.second = std::move(remoteName);
-            }
-        }
-        std::string file;
-        if (inProcKey.Valid())
-        {
-            file = inProcKey[""].GetString();
-        }
-        if (currentEntry.second.empty())
-        {
-            currentEntry.second = "N/A";
-        }
-        GeneralEscape(currentEntry.first, '#', '=');
-        GeneralEscape(currentEntry.second, '#', ':');
-        write(output, prefix, ": ", currentEntry.second, ": ", currentEntry.first, '=');
-        WriteDefaultFileOutput(output, file);
-        writeln(output);
-    }
+    WriteClsidEntries(output,
+                      clsids,
+                      prefix,
+                      rootKey,
+                      clsidKey,
+                      backupClsidKey,
+                      nameSource,
+                      values);
 }
 
 /**
 * CLSID value based output.
 *
 * @param [in,out] output The stream to write the output to.
+* @param [in,out] clsids The CLSID resolver.
 * @param prefix          The prefix used to identify the type of line generated
 * in the report.
 * @param rootKey         The root key where the check is rooted. The CLASSES key
@@ -663,6 +858,7 @@ static void ClsidSubkeyBasedOutputWithBits(log_sink& output,
 * or the name stored with the CLASSES key.
 */
 static void ClsidSubkeyBasedOutput(log_sink& output,
+                                   ClsidResolver& clsids,
                                    std::string const& prefix,
                                    std::string const& rootKey,
                                    std::string const& subKey,
@@ -671,6 +867,7 @@ static void ClsidSubkeyBasedOutput(log_sink& output,
 #ifdef _M_X64
     ClsidSubkeyBasedOutputWithBits(
         output,
+        clsids,
         prefix,
         rootKey,
         "\\Software\\Wow6432Node" + subKey,
@@ -680,6 +877,7 @@ static void ClsidSubkeyBasedOutput(log_sink& output,
 #endif
     ClsidSubkeyBasedOutputWithBits(
         output,
+        clsids,
         prefix + Get64Suffix(),
         rootKey,
         "\\Software" + subKey,
@@ -698,6 +896,8 @@ static void ClsidSubkeyBasedOutput(log_sink& output,
 * @param dataProcess     (optional) [in,out] The process by which the line data
 *is written.
 *                        The default escapes using the general escaping format.
+* @param nonStrings      (optional) How dataProcess treats values which are not
+*                        strings.
 */
 static void SingleRegistryValueOutput(
     log_sink& output,
@@ -705,24 +905,22 @@ static void SingleRegistryValueOutput(
     std::string const& valueName,
     std::string const& prefix,
     std::function<void(log_sink& out, std::string& source)> dataProcess =
-        GeneralProcess)
+        GeneralProcess,
+    NonStringValues nonStrings = NonStringValues::Process)
 {
     if (key.Invalid())
     {
         return;
     }
-    try
+    auto value = key.TryGetValue(valueName);
+    if (!value.is_valid())
     {
-        auto value = key[valueName];
-        write(output, prefix, ": ");
-        std::string val(value.GetString());
-        dataProcess(output, val);
-        writeln(output);
-    }
-    catch (ErrorFileNotFoundException const&)
-    {
-        // Expected error.
+        return;
     }
+    write(output, prefix, ": ");
+    std::string data;
+    ProcessValueData(output, value.get(), dataProcess, nonStrings, data);
+    writeln(output);
 }
 
 /**
@@ -751,106 +949,169 @@ static void InternetExplorerMainOutput(log_sink& output,
                               ieMain,
                               "Default_Page_Url",
                               "DefaultPageUrl" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Default_Page_Url", "DefaultPageUrl", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Default_Page_Url",
+                              "DefaultPageUrl",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieMain,
                               "Default_Search_Url",
                               "DefaultSearchUrl" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
     SingleRegistryValueOutput(output,
                               ieMain32,
                               "Default_Search_Url",
                               "DefaultSearchUrl",
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
-    SingleRegistryValueOutput(
-        output, ieMain, "Local Page", "LocalPage" + suffix64, HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain,
+                              "Local Page",
+                              "LocalPage" + suffix64,
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Local Page", "LocalPage", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Local Page",
+                              "LocalPage",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
-    SingleRegistryValueOutput(
-        output, ieMain, "Start Page", "StartPage" + suffix64, HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain,
+                              "Start Page",
+                              "StartPage" + suffix64,
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Start Page", "StartPage", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Start Page",
+                              "StartPage",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
-    SingleRegistryValueOutput(
-        output, ieMain, "Search Page", "SearchPage" + suffix64, HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain,
+                              "Search Page",
+                              "SearchPage" + suffix64,
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Search Page", "SearchPage", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Search Page",
+                              "SearchPage",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
-    SingleRegistryValueOutput(
-        output, ieMain, "Search Bar", "SearchBar" + suffix64, HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain,
+                              "Search Bar",
+                              "SearchBar" + suffix64,
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Search Bar", "SearchBar", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Search Bar",
+                              "SearchBar",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieMain,
                               "SearchMigratedDefaultUrl",
                               "SearchMigratedDefaultUrl" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
     SingleRegistryValueOutput(output,
                               ieMain32,
                               "SearchMigratedDefaultUrl",
                               "SearchMigratedDefaultUrl",
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieMain,
                               "Security Risk Page",
                               "SecurityPage" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Security Risk Page", "SecurityPage", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Security Risk Page",
+                              "SecurityPage",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieMain,
                               "Window Title",
                               "WindowTitle" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "Window Title", "WindowTitle", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "Window Title",
+                              "WindowTitle",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
-    SingleRegistryValueOutput(
-        output, ieMain, "SearchURL", "SearchUrl" + suffix64, HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain,
+                              "SearchURL",
+                              "SearchUrl" + suffix64,
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
-    SingleRegistryValueOutput(
-        output, ieMain32, "SearchURL", "SearchUrl", HttpProcess);
+    SingleRegistryValueOutput(output,
+                              ieMain32,
+                              "SearchURL",
+                              "SearchUrl",
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieSearch,
                               "SearchAssistant",
                               "SearchAssistant" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
     SingleRegistryValueOutput(output,
                               ieSearch32,
                               "SearchAssistant",
                               "SearchAssistant",
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
     SingleRegistryValueOutput(output,
                               ieSearch,
                               "CustomizeSearch",
                               "CustomizeSearch" + suffix64,
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #ifdef _M_X64
     SingleRegistryValueOutput(output,
                               ieSearch32,
                               "CustomizeSearch",
                               "CustomizeSearch",
-                              HttpProcess);
+                              HttpProcess,
+                              NonStringValues::WriteUnchanged);
 #endif
 }
 
@@ -868,120 +1129,227 @@ static void ProcessIeScript(log_sink& out,
                             std::string const& valueName,
                             RegistryKey const& subKey)
 {
-    try
-    {
-        std::string name(subKey.GetName());
-        std::string command(subKey[valueName].GetString());
-        GeneralEscape(name, '#', ']');
-        GeneralEscape(command);
-        writeln(out, "IeScript", suffix, ": [", std::move(name), "] ", command);
-    }
-    catch (ErrorFileNotFoundException const&)
+    std::string name(subKey.GetName());
+    auto commandValue = subKey.TryGetValue(valueName);
+    if (!commandValue.is_valid())
     {
-        // Expected
+        return;
     }
+    std::string command(commandValue.get().GetString());
+    GeneralEscape(name, '#', ']');
+    GeneralEscape(command);
+    writeln(out, "IeScript", suffix, ": [", std::move(name), "] ", command);
 }
 
 /**
 * Process a single IE COM entry.
 *
-* @param [in,out] out The output stream where the output is written.
-* @param suffix       The suffix applied to the script entry (either "64" or
+* @param [in,out] out    The output stream where the output is written.
+* @param [in,out] clsids The CLSID resolver.
+* @param suffix          The suffix applied to the script entry (either "64" or
 *nothing)
-* @param valueName    Name of the value in question.
-* @param subKey       The sub key to which the query of script is being posed.
+* @param valueName       Name of the value in question.
+* @param subKey          The sub key to which the query of script is being
+*posed.
 */
 static void ProcessIeCom(log_sink& out,
+                         ClsidResolver& clsids,
                          std::string const& suffix,
                          std::string const& valueName,
                          RegistryKey const& subKey,
                          std::string const& hiveRootPath,
                          std::string const& software)
 {
-    try
+    std::string name(subKey.GetName());
+    auto clsidValue = subKey.TryGetValue(valueName);
+    if (!clsidValue.is_valid())
     {
-        std::string name(subKey.GetName());
-        std::string clsid(subKey[valueName].GetString());
-        std::string file("N/A");
-        RegistryKey clsidKey(RegistryKey::Open(hiveRootPath + "\\" + software +
-                                                   "\\Classes\\CLSID\\" +
-                                                   clsid + "\\InProcServer32",
-                                               KEY_QUERY_VALUE));
-        if (clsidKey.Invalid())
+        return;
+    }
+    std::string clsid(clsidValue.get().GetString());
+    std::string file("N/A");
+    // Unlike the other CLSID sections, the machine registration is used
+    // whenever the user's lacks an InProcServer32 key.
+    ClsidResolver::Registration const* registration = &clsids.Resolve(
+        hiveRootPath + "\\" + software + "\\Classes\\CLSID\\", clsid);
+    if (!registration->hasServerKey)
+    {
+        registration = &clsids.Resolve(
+            "\\Registry\\Machine\\" + software + "\\Classes\\CLSID\\", clsid);
+    }
+    if (registration->hasServerKey)
+    {
+        if (!registration->hasServer)
         {
-            clsidKey = RegistryKey::Open("\\Registry\\Machine\\" + software +
-                                             "\\Classes\\CLSID\\" + clsid +
-                                             "\\InProcServer32",
-                                         KEY_QUERY_VALUE);
+            return;
         }
-        if (clsidKey.Valid())
+        if (!registration->server.empty())
         {
-            std::string fileTry(clsidKey[""].GetString());
-            if (!fileTry.empty())
-            {
-                file = std::move(fileTry);
-            }
+            file = registration->server;
         }
-
-        name.erase(name.cbegin(),
-                   std::find(name.crbegin(), name.crend(), '\\').base());
-        GeneralEscape(name, '#', ' ');
-        GeneralEscape(clsid, '#', ']');
-        write(out, "IeCom", suffix , ": [", name, ' ', clsid, "] ");
-        WriteDefaultFileOutput(out, file);
-        writeln(out);
-    }
-    catch (ErrorFileNotFoundException const&)
-    {
-        // Expected
     }
+
+    name.erase(name.cbegin(),
+               std::find(name.crbegin(), name.crend(), '\\').base());
+    GeneralEscape(name, '#', ' ');
+    GeneralEscape(clsid, '#', ']');
+    write(out, "IeCom", suffix , ": [", name, ' ', clsid, "] ");
+    clsids.WriteFile(out, file);
+    writeln(out);
 }
 
-static void TrustedZoneRecursive(log_sink& out,
-                                 std::string const& rootKey,
-                                 std::string const& domainToEnter,
-                                 std::string const& prefix)
+/**
+* Walks a ZoneMap domains tree, writing the domains assigned to the trusted
+* zone.
+*
+* Blocklists such as SpywareBlaster's put tens of thousands of domains here.
+* Each key is opened relative to its parent, sub key names are read into one
+* reused buffer, and the current domain is built in place by prepending labels
+* to a single string on the way down and removing them on the way back up.
+*
+* With a nonzero summary limit, a list longer than the limit is reduced to a
+* count, and the number of restricted sites is written as well.
+*/
+class ZoneMapWalker : boost::noncopyable
 {
-    RegistryKey currentDomainKey =
-        RegistryKey::Open(rootKey, KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE);
+public:
+    ZoneMapWalker(log_sink& out,
+                  std::string const& prefix,
+                  std::size_t summaryLimit)
+        : out_(out)
+        , prefix_(prefix)
+        , summaryLimit_(summaryLimit)
+        , trusted_(0)
+        , restricted_(0)
+    {
+    }
 
-    for (auto const& value : currentDomainKey.EnumerateValues())
+    /**
+    * Walks the domains under a ZoneMap\\Domains (or EscDomains) key.
+    *
+    * @param domainsRoot The domains key, opened with KEY_ENUMERATE_SUB_KEYS.
+    */
+    void Walk(RegistryKey const& domainsRoot)
     {
-        if (value.GetType() != REG_DWORD)
+        WalkSubKeys(domainsRoot, true);
+    }
+
+    /**
+    * Writes the held back list or its summary. Does nothing unless a summary
+    * limit was given.
+    */
+    void Finish()
+    {
+        if (summaryLimit_ == 0)
         {
-            continue;
+            return;
         }
 
-        DWORD domainClass = value.GetDWordStrict();
-        if (domainClass != 2) // Trusted zone marker
+        if (trusted_ > summaryLimit_)
         {
-            continue;
+            writeln(out_, prefix_, ": ", trusted_, " entries in Trusted Sites");
+        }
+        else
+        {
+            write(out_, held_.get());
         }
 
-        std::string outputUrl(value.GetName());
-        outputUrl += "://";
-        outputUrl += domainToEnter;
-        HttpEscape(outputUrl);
-
-        writeln(out, prefix, ": ", outputUrl);
+        if (restricted_ != 0)
+        {
+            writeln(out_, prefix_, ": ", restricted_, " entries in Restricted Sites");
+        }
     }
 
-    auto const& subKeys = currentDomainKey.EnumerateSubKeyNames();
-    currentDomainKey.Close();
+private:
+    void WalkSubKeys(RegistryKey const& parent, bool topLevel)
+    {
+        UNICODE_STRING name;
+        for (std::uint32_t index = 0;
+             parent.EnumerateSubKeyName(index, nameBuffer_, name);
+             ++index)
+        {
+            RegistryKey domainKey(RegistryKey::Open(
+                parent, name, KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE));
+            if (domainKey.Invalid())
+            {
+                continue;
+            }
 
-    for (auto const& key : subKeys)
+            // A sub key is the next label to the left: www under example.com
+            // is www.example.com.
+            label_.clear();
+            utf8::utf16to8(name.Buffer,
+                           name.Buffer + name.Length / sizeof(wchar_t),
+                           std::back_inserter(label_));
+            if (!topLevel)
+            {
+                label_.push_back('.');
+            }
+            domain_.insert(0, label_);
+            std::size_t const labelLength = label_.size();
+
+            WriteTrustedValues(domainKey);
+            WalkSubKeys(domainKey, false);
+
+            domain_.erase(0, labelLength);
+        }
+    }
+
+    void WriteTrustedValues(RegistryKey const& domainKey)
     {
-        std::string subDomain(key);
-        subDomain += '.';
-        subDomain += domainToEnter;
+        domainKey.EnumerateValues(values_);
+        for (RegistryValueView const& value : values_)
+        {
+            if (value.GetType() != REG_DWORD)
+            {
+                continue;
+            }
+
+            DWORD domainClass = value.GetDWordStrict();
+            if (domainClass == 4) // Restricted zone marker
+            {
+                ++restricted_;
+                continue;
+            }
+
+            if (domainClass != 2) // Trusted zone marker
+            {
+                continue;
+            }
+
+            url_ = value.GetName();
+            url_ += "://";
+            url_ += domain_;
+            HttpEscape(url_);
 
-        TrustedZoneRecursive(out, rootKey + "\\" + key, subDomain, prefix);
+            if (summaryLimit_ == 0)
+            {
+                writeln(out_, prefix_, ": ", url_);
+            }
+            else if (++trusted_ <= summaryLimit_)
+            {
+                writeln(held_, prefix_, ": ", url_);
+            }
+        }
     }
-}
+
+    log_sink& out_;
+    std::string const& prefix_;
+    std::size_t summaryLimit_;
+    string_sink held_;
+    std::size_t trusted_;
+    std::size_t restricted_;
+    std::vector<unsigned char> nameBuffer_;
+    std::string domain_;
+    std::string label_;
+    std::string url_;
+    RegistryValueArena values_;
+};
 
 static void TrustedZone(log_sink& out,
                         std::string const& keyPath,
-                        std::string const& prefix)
+                        std::string const& prefix,
+                        std::size_t summaryLimit)
 {
     RegistryKey domainsRoot =
         RegistryKey::Open(keyPath, KEY_ENUMERATE_SUB_KEYS);
@@ -990,12 +1358,9 @@ static void TrustedZone(log_sink& out,
         return;
     }
 
-    auto rootDomains = domainsRoot.EnumerateSubKeyNames();
-    for (auto const& rootDomain : rootDomains)
-    {
-        TrustedZoneRecursive(
-            out, keyPath + "\\" + rootDomain, rootDomain, prefix);
-    }
+    ZoneMapWalker walker(out, prefix, summaryLimit);
+    walker.Walk(domainsRoot);
+    walker.Finish();
 }
 
 static void TrustedDefaults(log_sink& out,
@@ -1063,21 +1428,28 @@ static void TrustedIpRange(log_sink& out,
 /**
 * Explorer extensions output.
 *
-* @param [in,out] out The output stream.
-* @param rootKey      The root key where the IE settings are rooted. (user or
-*machine hive
-*                     root)
+* @param [in,out] out    The output stream.
+* @param [in,out] clsids The CLSID resolver.
+* @param rootKey         The root key where the IE settings are rooted. (user
+*or machine hive
+*                        root)
+* @param zoneSummaryLimit The longest trusted zone list written in full, or 0
+*to write every list in full.
 */
 static void ExplorerExtensionsOutput(log_sink& out,
-                                     std::string const& rootKey)
+                                     ClsidResolver& clsids,
+                                     std::string const& rootKey,
+                                     std::size_t zoneSummaryLimit)
 {
     std::string suffix(Get64Suffix());
     std::string software("Software");
     auto keyProcessor = [&](RegistryKey const & subKey) {
         ProcessIeScript(out, suffix, "Exec", subKey);
         ProcessIeScript(out, suffix, "Script", subKey);
-        ProcessIeCom(out, suffix, "clsidextension", subKey, rootKey, software);
-        ProcessIeCom(out, suffix, "bandclsid", subKey, rootKey, software);
+        ProcessIeCom(
+            out, clsids, suffix, "clsidextension", subKey, rootKey, software);
+        ProcessIeCom(
+            out, clsids, suffix, "bandclsid", subKey, rootKey, software);
     };
     RegistryKey key(RegistryKey::Open(
         rootKey + "\\Software\\Microsoft\\Internet Explorer\\Extensions",
@@ -1104,25 +1476,29 @@ static void ExplorerExtensionsOutput(log_sink& out,
         out,
         rootKey +
             "\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains",
-        "Trusted Zone" + Get64Suffix());
+        "Trusted Zone" + Get64Suffix(),
+        zoneSummaryLimit);
 #ifdef _M_X64
     TrustedZone(
         out,
         rootKey +
             "\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains",
-        "Trusted Zone");
+        "Trusted Zone",
+        zoneSummaryLimit);
 #endif
     TrustedZone(
         out,
         rootKey +
             "\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\EscDomains",
-        "ESC Trusted Zone" + Get64Suffix());
+        "ESC Trusted Zone" + Get64Suffix(),
+        zoneSummaryLimit);
 #ifdef _M_X64
     TrustedZone(
         out,
         rootKey +
             "\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\EscDomains",
-        "ESC Trusted Zone");
+        "ESC Trusted Zone",
+        zoneSummaryLimit);
 #endif
     TrustedDefaults(
         out,
@@ -1156,14 +1532,21 @@ static void ExplorerExtensionsOutput(log_sink& out,
 * each user's registry.
 *
 * @param [in,out] output The output stream to which the log is written.
+* @param [in,out] clsids The CLSID resolver.
 * @param rootKey         The root key to check. (e.g. \\Registry\\Machine or
 *\\Registry\\User\\
 *                        ${Sid}
+* @param zoneSummaryLimit The longest trusted zone list written in full, or 0
+*to write every list in full.
 */
-static void CommonHjt(log_sink& output, std::string const& rootKey)
+static void CommonHjt(log_sink& output,
+                      ClsidResolver& clsids,
+                      std::string const& rootKey,
+                      std::size_t zoneSummaryLimit)
 {
     InternetExplorerMainOutput(output, rootKey);
     ClsidValueBasedOutput(output,
+                          clsids,
                           "UrlSearchHook",
                           rootKey,
                           "\\Microsoft\\Internet Explorer\\URLSearchHooks",
@@ -1192,9 +1575,10 @@ static void CommonHjt(log_sink& output, std::string const& rootKey)
         output, winlogon, "TaskMan", "TaskMan", FileProcess);
     if (winlogon.Valid())
     {
-        try
+        auto sfcValue = winlogon.TryGetValue("SFCDisable");
+        if (sfcValue.is_valid())
         {
-            DWORD sfc = winlogon["SFCDisable"].GetDWord();
+            DWORD sfc = sfcValue.get().GetDWord();
             if (sfc)
             {
                 writeln(output, "SFC: Disabled");
@@ -1204,18 +1588,16 @@ static void CommonHjt(log_sink& output, std::string const& rootKey)
                 writeln(output, "SFC: Enabled");
             }
         }
-        catch (ErrorFileNotFoundException const&)
-        {
-            // Expected
-        }
     }
     ClsidSubkeyBasedOutput(
         output,
+        clsids,
         "BHO",
         rootKey,
         "\\Microsoft\\Windows\\CurrentVersion\\Explorer\\Browser Helper Objects",
         CLASS_ROOT_DEFAULT);
     ClsidValueBasedOutput(output,
+                          clsids,
                           "TB",
                           rootKey,
                           "\\Microsoft\\Internet Explorer\\Toolbar",
@@ -1223,12 +1605,14 @@ static void CommonHjt(log_sink& output, std::string const& rootKey)
                           CLASS_ROOT_DEFAULT);
     ClsidValueBasedOutput(
         output,
+        clsids,
         "TB",
         rootKey,
         "\\Microsoft\\Internet Explorer\\Toolbar\\WebBrowser",
         NAME,
         CLASS_ROOT_DEFAULT);
     ClsidValueBasedOutput(output,
+                          clsids,
                           "EB",
                           rootKey,
                           "\\Microsoft\\Internet Explorer\\Explorer Bars",
@@ -1245,21 +1629,24 @@ static void CommonHjt(log_sink& output, std::string const& rootKey)
         "\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies\\Explorer",
         "\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Policies\\Explorer",
         "PoliciesExplorer",
-        GeneralProcess);
+        GeneralProcess,
+        NonStringValues::WriteUnchanged);
     ValueMajorBasedEnumerationBitless(
         output,
         rootKey,
         "\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies\\System",
         "\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Policies\\System",
         "PoliciesSystem",
-        GeneralProcess);
+        GeneralProcess,
+        NonStringValues::WriteUnchanged);
     ValueMajorBasedEnumerationBitless(
         output,
         rootKey,
         "\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies\\Explorer\\DisallowRun",
         "\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Policies\\Explorer\\DisallowRun",
         "PoliciesDisallowRun",
-        GeneralProcess);
+        GeneralProcess,
+        NonStringValues::WriteUnchanged);
     SubkeyMajorBasedEnumerationBitless(
         output,
         rootKey,
@@ -1268,7 +1655,7 @@ static void CommonHjt(log_sink& output, std::string const& rootKey)
         "",
         "IeMenu",
         GeneralProcess);
-    ExplorerExtensionsOutput(output, rootKey);
+    ExplorerExtensionsOutput(output, clsids, rootKey, zoneSummaryLimit);
 }
 
 /**
@@ -1495,25 +1882,25 @@ static void TcpSettingForInterface(log_sink& output,
                                    std::string const& interfaceName,
                                    std::string const& value)
 {
-    try
+    auto nameServerValue = parametersKey.TryGetValue(value);
+    if (!nameServerValue.is_valid())
     {
-        std::string nameServer(parametersKey[value].GetStringStrict());
-        if (nameServer.empty())
-        {
-            return;
-        }
+        return;
+    }
 
-        if (interfaceName.empty())
-        {
-            writeln(output, "Tcp", value, ": ", nameServer);
-        }
-        else
-        {
-            writeln(output, "Tcp", value, ": [", interfaceName, "] ", nameServer);
-        }
+    std::string nameServer(nameServerValue.get().GetStringStrict());
+    if (nameServer.empty())
+    {
+        return;
+    }
+
+    if (interfaceName.empty())
+    {
+        writeln(output, "Tcp", value, ": ", nameServer);
     }
-    catch (ErrorFileNotFoundException const&)
+    else
     {
+        writeln(output, "Tcp", value, ": [", interfaceName, "] ", nameServer);
     }
 }
 
@@ -1552,15 +1939,18 @@ static void ProtocolsSectionRecursive(log_sink& output,
     RegistryKey currentNamespaceKey =
         RegistryKey::Open(rootKey, KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE);
 
-    try
+    auto clsidValue = currentNamespaceKey.TryGetValue("Clsid");
+    if (clsidValue.is_valid())
     {
         std::string itemName(namespaceToEnter);
-        std::string clsid = currentNamespaceKey["Clsid"].GetStringStrict();
+        std::string clsid = clsidValue.get().GetStringStrict();
         std::string clsidKeyName = "\\Registry\\Machine\\SOFTWARE\\Classes\\CLSID\\" + clsid + "\\InProcServer32";
         RegistryKey clsidKey = RegistryKey::Open(clsidKeyName, KEY_QUERY_VALUE);
-        if (clsidKey.Valid())
+        auto fileValue = clsidKey.Valid() ? clsidKey.TryGetValue("")
+                                          : expected<RegistryValue>();
+        if (fileValue.is_valid())
         {
-            std::string file = clsidKey[""].GetStringStrict();
+            std::string file = fileValue.get().GetStringStrict();
             GeneralEscape(itemName, '#', ' ');
             GeneralEscape(clsid, '#', ']');
             write(output, prefix, ": [", itemName, " ", clsid, "] ");
@@ -1568,9 +1958,6 @@ static void ProtocolsSectionRecursive(log_sink& output,
             writeln(output);
         }
     }
-    catch (ErrorFileNotFoundException const&)
-    {
-    }
 
     auto const& subKeys = currentNamespaceKey.EnumerateSubKeyNames();
     currentNamespaceKey.Close();
@@ -1623,22 +2010,22 @@ static void SingleCommaValueBitless(log_sink& output, std::string const& rootKey
         return;
     }
 
-    try
+    auto dlls = key.TryGetValue(valueName);
+    if (!dlls.is_valid())
     {
-        for (auto const& dll : key[valueName].GetCommaStringArray())
-        {
-            if (dll.empty())
-            {
-                continue;
-            }
-
-            write(output, prefix, suffix, ": ");
-            WriteDefaultFileOutput(output, dll);
-            writeln(output);
-        }
+        return;
     }
-    catch (ErrorFileNotFoundException const&)
+
+    for (auto const& dll : dlls.get().GetCommaStringArray())
     {
+        if (dll.empty())
+        {
+            continue;
+        }
+
+        write(output, prefix, suffix, ": ");
+        WriteDefaultFileOutput(output, dll);
+        writeln(output);
     }
 }
 
@@ -1655,10 +2042,11 @@ static void AppinitDlls(log_sink& output)
     SingleCommaValue(output, "Microsoft\\Windows NT\\CurrentVersion\\Windows", "Appinit_DLLs", "AppinitDll");
 }
 
-static void ShellServiceObjectDelayLoad(log_sink& output)
+static void ShellServiceObjectDelayLoad(log_sink& output, ClsidResolver& clsids)
 {
     ClsidValueBasedOutput(
         output,
+        clsids,
         "Ssodl",
         "\\Registry\\Machine",
         "\\Microsoft\\Windows\\CurrentVersion\\ShellServiceObjectDelayLoad",
@@ -1666,10 +2054,11 @@ static void ShellServiceObjectDelayLoad(log_sink& output)
         CLASS_ROOT_DEFAULT);
 }
 
-static void SharedTaskScheduler(log_sink& output)
+static void SharedTaskScheduler(log_sink& output, ClsidResolver& clsids)
 {
     ClsidValueBasedOutput(
         output,
+        clsids,
         "Sts",
         "\\Registry\\Machine",
         "\\Microsoft\\Windows\\CurrentVersion\\Explorer\\SharedTaskScheduler",
@@ -1677,10 +2066,11 @@ static void SharedTaskScheduler(log_sink& output)
         CLASS_ROOT_DEFAULT);
 }
 
-static void ShellExecuteHooks(log_sink& output)
+static void ShellExecuteHooks(log_sink& output, ClsidResolver& clsids)
 {
     ClsidValueBasedOutput(
         output,
+        clsids,
         "Seh",
         "\\Registry\\Machine",
         "\\Microsoft\\Windows\\CurrentVersion\\Explorer\\ShellExecuteHooks",
@@ -1708,6 +2098,7 @@ static void LocalSecurityAuthorityValue(log_sink& output, RegistryKey const& key
     }
 
     std::sort(entries.begin(), entries.end());
+    PrefetchDefaultFileOutput(entries);
     for (std::string const& entry : entries)
     {
         write(output, value, "Package: ");
@@ -1745,6 +2136,7 @@ static void CsrssDll(log_sink& output)
 
     std::sort(values.begin(), values.end());
     values.erase(std::unique(values.begin(), values.end()), values.end());
+    PrefetchDefaultFileOutput(values);
     for (std::string& str : values)
     {
         write(output, "SubSystems: ");
@@ -1782,12 +2174,11 @@ static void FileAssociation(log_sink& output, std::string const& association)
     std::string namedExtension = key[""].GetStringStrict();
     key = RegistryKey::Open("\\Registry\\Machine\\Software\\Classes\\" + namedExtension + "\\Shell");
     std::string defaultVerb("open");
-    try
+    auto defaultVerbValue = key.TryGetValue("");
+    if (defaultVerbValue.is_valid())
     {
-        defaultVerb = key[""].GetStringStrict();
+        defaultVerb = defaultVerbValue.get().GetStringStrict();
     }
-    catch (ErrorFileNotFoundException const&)
-    {}
 
     key = RegistryKey::Open("\\Registry\\Machine\\Software\\Classes\\" + namedExtension + "\\Shell\\" + defaultVerb + "\\Command");
     std::string command = key[""].GetStringStrict();
@@ -1825,33 +2216,22 @@ static void FileAssociations(log_sink& output)
     }
 }
 
+// Ad blocking hosts files can run to hundreds of thousands of entries; past
+// this many, entries redirecting to loopback addresses are only counted.
+static std::size_t const hostsEntryLimit = 100;
+
 static void HostsFile(log_sink& output)
 {
     RegistryKey key(RegistryKey::Open("\\Registry\\Machine\\System\\CurrentControlSet\\Services\\Tcpip\\Parameters"));
     std::string dataBasePath = key["DataBasePath"].GetStringStrict();
     dataBasePath += "\\Hosts";
     dataBasePath = Path::ExpandEnvStrings(std::move(dataBasePath));
-    File hostsFile(dataBasePath);
+    MemoryMappedFile hostsFile(dataBasePath);
+    HostsScanner scanner(hostsFile.cbegin(), hostsFile.cend());
 
-    std::vector<std::string> hostsLines = hostsFile.ReadAllLines();
     GeneralEscape(dataBasePath);
     writeln(output, "HostsFile: ", dataBasePath);
-    for (std::string& hostsLine : hostsLines)
-    {
-        boost::algorithm::trim(hostsLine);
-        if (hostsLine.empty())
-        {
-            continue;
-        }
-
-        if (boost::algorithm::starts_with(hostsLine, "#"))
-        {
-            continue;
-        }
-
-        HttpEscape(hostsLine);
-        writeln(output, "Hosts: ", hostsLine);
-    }
+    WriteHostsEntries(output, scanner, hostsEntryLimit);
 }
 
 #pragma comment(lib, "Rpcrt4.lib")
@@ -1913,7 +2293,7 @@ static void GenuineWindows(log_sink& output)
     }
 }
 
-static void MachineSpecificHjt(log_sink& output)
+static void MachineSpecificHjt(log_sink& output, ClsidResolver& clsids)
 {
     ExecuteDpf(output);
     ExecuteWinsock2Parameters(output);
@@ -1921,9 +2301,9 @@ static void MachineSpecificHjt(log_sink& output)
     Protocols(output);
     WinlogonNotify(output);
     AppinitDlls(output);
-    ShellServiceObjectDelayLoad(output);
-    SharedTaskScheduler(output);
-    ShellExecuteHooks(output);
+    ShellServiceObjectDelayLoad(output, clsids);
+    SharedTaskScheduler(output, clsids);
+    ShellExecuteHooks(output, clsids);
     SecurityProviders(output);
     LocalSecurityAuthority(output);
     CsrssDll(output);
@@ -1942,14 +2322,13 @@ static void InternetConnectionWizardShellNext(log_sink& output, std::string cons
         return;
     }
 
-    try
+    auto shellNextValue = key.TryGetValue("ShellNext");
+    if (shellNextValue.is_valid())
     {
-        std::string shellNext = key["ShellNext"].GetStringStrict();
+        std::string shellNext = shellNextValue.get().GetStringStrict();
         HttpEscape(shellNext);
         writeln(output, "InternetConnectionWizard: ", shellNext);
     }
-    catch (ErrorFileNotFoundException const&)
-    { }
 }
 
 static void ProxySettings(log_sink& output, std::string const& rootKey)
@@ -1960,23 +2339,21 @@ static void ProxySettings(log_sink& output, std::string const& rootKey)
         return;
     }
 
-    try
+    auto proxyServerValue = key.TryGetValue("ProxyServer");
+    if (proxyServerValue.is_valid())
     {
-        std::string proxyServer = key["ProxyServer"].GetStringStrict();
+        std::string proxyServer = proxyServerValue.get().GetStringStrict();
         GeneralEscape(proxyServer);
         writeln(output, "ProxyServer: ", proxyServer);
     }
-    catch (ErrorFileNotFoundException const&)
-    { }
 
-    try
+    auto proxyOverrideValue = key.TryGetValue("ProxyOverride");
+    if (proxyOverrideValue.is_valid())
     {
-        std::string proxyOverride = key["ProxyOverride"].GetStringStrict();
+        std::string proxyOverride = proxyOverrideValue.get().GetStringStrict();
         GeneralEscape(proxyOverride);
         writeln(output, "ProxyOverride: ", proxyOverride);
     }
-    catch (ErrorFileNotFoundException const&)
-    { }
 }
 
 static void IniAutostarts(log_sink& output, std::string const& rootKey)
@@ -1987,56 +2364,47 @@ static void IniAutostarts(log_sink& output, std::string const& rootKey)
         return;
     }
 
-    try
+    auto loadValue = key.TryGetValue("load");
+    if (loadValue.is_valid())
     {
-        std::string load = key["load"].GetStringStrict();
+        std::string load = loadValue.get().GetStringStrict();
         GeneralEscape(load);
         writeln(output, "IniLoad: ", load);
     }
-    catch (ErrorFileNotFoundException const&)
-    { }
 
+    auto runValue = key.TryGetValue("run");
+    if (runValue.is_valid())
+    {
+        std::string run = runValue.get().GetStringStrict();
+        GeneralEscape(run);
+        writeln(output, "IniRun: ", run);
+    }
+}
+
+// Gets the command line a startup folder shortcut runs, or an empty string if
+// the file is not a shortcut to a file system path. Links are parsed rather
+// than loaded through IShellLink, so this needs no COM apartment.
+static std::string ResolveLink(std::string const& lnkPath)
+{
     try
     {
-    std::string run = key["run"].GetStringStrict();
-    GeneralEscape(run);
-    writeln(output, "IniRun: ", run);
-    }
-    catch (ErrorFileNotFoundException const&)
-    { }
-}
-
-static std::string ResolveLink(std::string const& lnkPathNarrow)
-{
-    // Stolen from PEV
-    std::string result;
-    std::wstring lnkPath(utf8::ToUtf16(lnkPathNarrow));
-    IPersistFile * persistFile;
-    IShellLink * theLink;
-    HRESULT errorCheck = 0;
-    wchar_t linkTarget[MAX_PATH];
-    wchar_t expandedTarget[MAX_PATH];
-    wchar_t arguments[INFOTIPSIZE];
-    errorCheck = CoCreateInstance(CLSID_ShellLink, NULL, CLSCTX_INPROC_SERVER, IID_IPersistFile, reinterpret_cast<void **>(&persistFile));
-    if (!SUCCEEDED(errorCheck)) goto error;
-    if (!SUCCEEDED(persistFile->Load(lnkPath.c_str(), 0))) goto unloadPersist;
-    errorCheck = persistFile->QueryInterface(IID_IShellLinkW, reinterpret_cast<void **>(&theLink));
-    if (!SUCCEEDED(errorCheck)) goto unloadPersist;
-    if (!SUCCEEDED(theLink->Resolve(NULL, SLR_NO_UI))) goto unloadLink;
-    if (!SUCCEEDED(theLink->GetPath(linkTarget, MAX_PATH, NULL, SLGP_RAWPATH))) goto unloadLink;
-    errorCheck = theLink->GetArguments(arguments, INFOTIPSIZE);
-    if (!SUCCEEDED(errorCheck)) arguments[0] = L'\0';
-    ExpandEnvironmentStringsW(linkTarget, expandedTarget, MAX_PATH);
-    persistFile->Release();
-    theLink->Release();
-    result = utf8::ToUtf8(static_cast<std::wstring>(expandedTarget)+L" " + arguments);
-
-unloadLink:
-    theLink->Release();
-unloadPersist:
-    persistFile->Release();
-error:
-    return result;
+        ShellLink const link(ShellLink::Load(lnkPath));
+        if (link.GetTarget().empty())
+        {
+            return std::string();
+        }
+
+        return Path::ExpandEnvStrings(link.GetTarget()) + " " +
+               link.GetArguments();
+    }
+    catch (InvalidShellLinkException const&)
+    {
+        return std::string();
+    }
+    catch (Win32Exception const&)
+    {
+        return std::string();
+    }
 }
 
 static void StartupFolder(log_sink& output, std::string const& rootKey)
@@ -2092,37 +2460,124 @@ static void WriteMachineIdentity(log_sink& output)
     writeln(output, "Identity: [", narrowName, "] MACHINE");
 }
 
+/**
+* Reads the trusted zone summary limit from the section's script options. The
+* option line "ZoneSummary <limit>" collapses trusted zone lists longer than
+* the limit into a count. Without a limit, or with one which is not a number,
+* the limit is 50; "ZoneSummary 0" writes every list in full, as leaving the
+* option out does. Other options, including ones which merely begin with
+* "ZoneSummary", are ignored.
+*
+* @param scriptOptions The option lines given to the section.
+*
+* @return The limit, or 0 if zone lists are written in full.
+*/
+static std::size_t GetZoneSummaryLimit(
+    std::vector<std::string> const& scriptOptions)
+{
+    static char const optionName[] = "ZoneSummary";
+    std::size_t const optionLength = sizeof(optionName) - 1;
+    std::size_t limit = 0;
+    for (std::string const& option : scriptOptions)
+    {
+        if (!boost::algorithm::istarts_with(option, optionName) ||
+            (option.size() != optionLength && option[optionLength] != ' ' &&
+             option[optionLength] != '\t'))
+        {
+            continue;
+        }
+
+        std::size_t const first = option.find_first_not_of(" \t", optionLength);
+        std::size_t const last =
+            first == std::string::npos
+                ? first
+                : option.find_first_not_of("0123456789", first);
+        bool const isNumber =
+            first != std::string::npos && last != first &&
+            option.find_first_not_of(" \t", last) == std::string::npos;
+        limit = isNumber ? std::strtoul(option.c_str() + first, nullptr, 10)
+                         : 50;
+    }
+
+    return limit;
+}
+
 void LoadPointsReport::Execute(ExecutionOptions options) const
 {
     auto& output = options.GetOutput();
+    std::size_t const zoneSummaryLimit =
+        GetZoneSummaryLimit(options.GetOptions());
     WriteMachineIdentity(output);
     SecurityCenterOutput(output);
-    CommonHjt(output, "\\Registry\\Machine");
-    MachineSpecificHjt(output);
+    ClsidResolver clsids;
+    CommonHjt(output, clsids, "\\Registry\\Machine", zoneSummaryLimit);
+    MachineSpecificHjt(output, clsids);
 
     auto hives = EnumerateUserHives();
-    for (std::string const& hive : hives)
+
+    // Hives are independent of each other, so they are scanned concurrently
+    // and then written out in enumeration order. A hive whose scan failed
+    // rethrows at the point the serial loop would have, after all hives
+    // before it are written.
+    struct UserHiveResult
+    {
+        std::string settings;
+        std::string sid;
+        std::string user;
+        std::exception_ptr error;
+    };
+    std::vector<UserHiveResult> results(hives.size());
+    WorkCounter counter(hives.size());
+    RunOnWorkerThreads(
+        (std::min)(hives.size(), GetDefaultWorkerCount()), [&]() {
+        std::size_t index;
+        while (counter.Next(index))
+        {
+            std::string const& hive = hives[index];
+            UserHiveResult& result = results[index];
+            try
+            {
+                string_sink userSink;
+                CommonHjt(userSink, clsids, hive, zoneSummaryLimit);
+                UserSpecificHjt(userSink, hive);
+                result.settings = userSink.get();
+                if (result.settings.empty())
+                {
+                    continue;
+                }
+
+                result.sid.assign(
+                    std::find(hive.crbegin(), hive.crend(), '\\').base(),
+                    hive.end());
+                result.user = LookupAccountNameBySid(result.sid);
+                GeneralEscape(result.user, '#', ']');
+            }
+            catch (...)
+            {
+                result.error = std::current_exception();
+            }
+        }
+    });
+
+    for (UserHiveResult const& result : results)
     {
-        string_sink userSink;
-        CommonHjt(userSink, hive);
-        UserSpecificHjt(userSink, hive);
-        std::string const& userSettings = userSink.get();
-        if (userSettings.empty())
+        if (result.error)
+        {
+            std::rethrow_exception(result.error);
+        }
+
+        if (result.settings.empty())
         {
             continue;
         }
 
         std::string head("User Settings");
         Header(head);
-        std::string sid(std::find(hive.crbegin(), hive.crend(), '\\').base(),
-                         hive.end());
-        std::string user(LookupAccountNameBySid(sid));
-        GeneralEscape(user, '#', ']');
         writeln(output);
         writeln(output, head);
         writeln(output);
-        writeln(output, "Identity: [", user, "] ", sid);
-        write(output, userSettings);
+        writeln(output, "Identity: [", result.user, "] ", result.sid);
+        write(output, result.settings);
     }
 }
 }
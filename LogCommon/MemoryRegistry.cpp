@@ -0,0 +1,1250 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/config.hpp>
+#include "LineReader.hpp"
+#include "Utf8.hpp"
+#include "MemoryRegistry.hpp"
+
+#define STATUS_INVALID_HANDLE ((std::int32_t)0xC0000008)
+#define STATUS_INVALID_PARAMETER ((std::int32_t)0xC000000D)
+#define STATUS_ACCESS_DENIED ((std::int32_t)0xC0000022)
+#define STATUS_BUFFER_TOO_SMALL ((std::int32_t)0xC0000023)
+#define STATUS_BUFFER_OVERFLOW ((std::int32_t)0x80000005)
+#define STATUS_NO_MORE_ENTRIES ((std::int32_t)0x8000001A)
+#define STATUS_OBJECT_NAME_INVALID ((std::int32_t)0xC0000033)
+#define STATUS_OBJECT_NAME_NOT_FOUND ((std::int32_t)0xC0000034)
+#define STATUS_OBJECT_PATH_NOT_FOUND ((std::int32_t)0xC000003A)
+#define STATUS_OBJECT_PATH_SYNTAX_BAD ((std::int32_t)0xC000003B)
+#define STATUS_CANNOT_DELETE ((std::int32_t)0xC0000121)
+#define STATUS_KEY_DELETED ((std::int32_t)0xC000017C)
+#define NT_SUCCESS(Status) ((Status) >= 0)
+
+// Values of ACCESS_MASK and the registry value types used by the .reg file
+// loader.
+static std::uint32_t const keyAllAccess = 0xF003F;
+static std::uint32_t const regSz = 1;
+static std::uint32_t const regBinary = 3;
+static std::uint32_t const regDword = 4;
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+static std::wstring Fold(wchar_t const* first, std::size_t length)
+{
+    std::wstring result(first, length);
+    for (wchar_t& character : result)
+    {
+        character = static_cast<wchar_t>(std::towupper(character));
+    }
+
+    return result;
+}
+
+struct MemoryRegistryValue
+{
+    std::wstring name;
+    std::wstring foldedName;
+    std::uint32_t type;
+    std::vector<unsigned char> data;
+};
+
+struct MemoryRegistryBackend::Node
+{
+    std::wstring name;
+    std::wstring foldedName;
+    Node* parent;
+    bool deleted;
+    std::vector<std::shared_ptr<Node>> children;
+    std::vector<MemoryRegistryValue> values;
+
+    Node(std::wstring const& name_, Node* parent_)
+        : name(name_)
+        , foldedName(Fold(name_.data(), name_.size()))
+        , parent(parent_)
+        , deleted(false)
+    {
+    }
+
+    static bool FoldedLess(std::shared_ptr<Node> const& lhs,
+                           std::wstring const& rhs)
+    {
+        return lhs->foldedName < rhs;
+    }
+
+    std::vector<std::shared_ptr<Node>>::iterator
+    LowerBound(std::wstring const& folded)
+    {
+        if (children.empty() || children.back()->foldedName < folded)
+        {
+            // Keys usually arrive in sorted order; don't search for them.
+            return children.end();
+        }
+
+        return std::lower_bound(
+            children.begin(), children.end(), folded, FoldedLess);
+    }
+
+    Node* FindChild(std::wstring const& folded)
+    {
+        auto child = LowerBound(folded);
+        if (child == children.end() || (*child)->foldedName != folded)
+        {
+            return nullptr;
+        }
+
+        return child->get();
+    }
+
+    MemoryRegistryValue* FindValue(std::wstring const& folded)
+    {
+        for (MemoryRegistryValue& value : values)
+        {
+            if (value.foldedName == folded)
+            {
+                return &value;
+            }
+        }
+
+        return nullptr;
+    }
+
+    std::wstring GetPath() const
+    {
+        if (parent == nullptr)
+        {
+            return name;
+        }
+
+        std::wstring result(parent->GetPath());
+        if (parent->parent != nullptr)
+        {
+            result.push_back(L'\\');
+        }
+
+        result.append(name);
+        return result;
+    }
+};
+
+// Copies an information record into a caller supplied buffer, following the
+// NT conventions for buffers which are too small.
+static std::int32_t CopyInformation(std::vector<unsigned char> const& record,
+                                    std::size_t fixedLength,
+                                    void* information,
+                                    std::uint32_t length,
+                                    std::uint32_t* resultLength)
+{
+    *resultLength = static_cast<std::uint32_t>(record.size());
+    if (length < fixedLength)
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    if (length < record.size())
+    {
+        std::memcpy(information, record.data(), fixedLength);
+        return STATUS_BUFFER_OVERFLOW;
+    }
+
+    std::memcpy(information, record.data(), record.size());
+    return 0;
+}
+
+static void AppendName(std::vector<unsigned char>& record,
+                       std::size_t offset,
+                       std::wstring const& name)
+{
+    std::size_t const nameBytes = name.size() * sizeof(wchar_t);
+    record.resize((std::max)(record.size(), offset + nameBytes));
+    if (nameBytes != 0)
+    {
+        std::memcpy(&record[offset], name.data(), nameBytes);
+    }
+}
+
+template <typename Info>
+static Info& RecordHeader(std::vector<unsigned char>& record)
+{
+    return *reinterpret_cast<Info*>(record.data());
+}
+
+std::int32_t MemoryRegistryBackend::WriteKeyInformation(
+    Node const& node,
+    std::uint32_t informationClass,
+    void* information,
+    std::uint32_t length,
+    std::uint32_t* resultLength)
+{
+    std::vector<unsigned char> record;
+    std::size_t fixedLength;
+    switch (informationClass)
+    {
+    case keyBasicInformation:
+    {
+        fixedLength = offsetof(KeyBasicRecord, Name);
+        record.resize((std::max)(fixedLength, sizeof(KeyBasicRecord)));
+        auto& header = RecordHeader<KeyBasicRecord>(record);
+        header.LastWriteTime = 0;
+        header.TitleIndex = 0;
+        header.NameLength =
+            static_cast<std::uint32_t>(node.name.size() * sizeof(wchar_t));
+        record.resize(fixedLength);
+        AppendName(record, fixedLength, node.name);
+        break;
+    }
+    case keyNameInformation:
+    {
+        std::wstring path(node.GetPath());
+        fixedLength = offsetof(KeyNameRecord, Name);
+        record.resize((std::max)(fixedLength, sizeof(KeyNameRecord)));
+        RecordHeader<KeyNameRecord>(record).NameLength =
+            static_cast<std::uint32_t>(path.size() * sizeof(wchar_t));
+        record.resize(fixedLength);
+        AppendName(record, fixedLength, path);
+        break;
+    }
+    case keyFullInformation:
+    {
+        fixedLength = offsetof(KeyFullRecord, Class);
+        record.resize(sizeof(KeyFullRecord));
+        auto& header = RecordHeader<KeyFullRecord>(record);
+        header.LastWriteTime = 0;
+        header.TitleIndex = 0;
+        header.ClassOffset = static_cast<std::uint32_t>(-1);
+        header.ClassLength = 0;
+        header.SubKeys = static_cast<std::uint32_t>(node.children.size());
+        header.MaxNameLen = 0;
+        for (auto const& child : node.children)
+        {
+            header.MaxNameLen = (std::max)(
+                header.MaxNameLen,
+                static_cast<std::uint32_t>(child->name.size() * sizeof(wchar_t)));
+        }
+        header.MaxClassLen = 0;
+        header.Values = static_cast<std::uint32_t>(node.values.size());
+        header.MaxValueNameLen = 0;
+        header.MaxValueDataLen = 0;
+        for (MemoryRegistryValue const& value : node.values)
+        {
+            header.MaxValueNameLen = (std::max)(
+                header.MaxValueNameLen,
+                static_cast<std::uint32_t>(value.name.size() * sizeof(wchar_t)));
+            header.MaxValueDataLen = (std::max)(
+                header.MaxValueDataLen, static_cast<std::uint32_t>(value.data.size()));
+        }
+        record.resize(fixedLength);
+        break;
+    }
+    default:
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return CopyInformation(
+        record, fixedLength, information, length, resultLength);
+}
+
+static std::int32_t
+WriteValueInformation(MemoryRegistryValue const& value,
+                      std::uint32_t informationClass,
+                      void* information,
+                      std::uint32_t length,
+                      std::uint32_t* resultLength)
+{
+    std::vector<unsigned char> record;
+    std::size_t fixedLength;
+    std::uint32_t const nameBytes =
+        static_cast<std::uint32_t>(value.name.size() * sizeof(wchar_t));
+    std::uint32_t const dataBytes =
+        static_cast<std::uint32_t>(value.data.size());
+    switch (informationClass)
+    {
+    case keyValueBasicInformation:
+    {
+        fixedLength = offsetof(KeyValueBasicRecord, Name);
+        record.resize(sizeof(KeyValueBasicRecord));
+        auto& header = RecordHeader<KeyValueBasicRecord>(record);
+        header.TitleIndex = 0;
+        header.Type = value.type;
+        header.NameLength = nameBytes;
+        record.resize(fixedLength);
+        AppendName(record, fixedLength, value.name);
+        break;
+    }
+    case keyValuePartialInformation:
+    {
+        fixedLength = offsetof(KeyValuePartialRecord, Data);
+        record.resize(sizeof(KeyValuePartialRecord));
+        auto& header = RecordHeader<KeyValuePartialRecord>(record);
+        header.TitleIndex = 0;
+        header.Type = value.type;
+        header.DataLength = dataBytes;
+        record.resize(fixedLength);
+        record.insert(record.end(), value.data.begin(), value.data.end());
+        break;
+    }
+    case keyValueFullInformation:
+    {
+        fixedLength = offsetof(KeyValueFullRecord, Name);
+        std::size_t const alignment = sizeof(std::uint32_t);
+        std::size_t const dataOffset =
+            (fixedLength + nameBytes + alignment - 1) & ~(alignment - 1);
+        record.resize(sizeof(KeyValueFullRecord));
+        auto& header = RecordHeader<KeyValueFullRecord>(record);
+        header.TitleIndex = 0;
+        header.Type = value.type;
+        header.DataOffset = static_cast<std::uint32_t>(dataOffset);
+        header.DataLength = dataBytes;
+        header.NameLength = nameBytes;
+        record.resize(fixedLength);
+        AppendName(record, fixedLength, value.name);
+        record.resize(dataOffset);
+        record.insert(record.end(), value.data.begin(), value.data.end());
+        break;
+    }
+    default:
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return CopyInformation(
+        record, fixedLength, information, length, resultLength);
+}
+
+MemoryRegistryBackend::MemoryRegistryBackend()
+    : root_(std::make_shared<Node>(L"\\", nullptr))
+    , nextHandle_(0)
+    , keyCount_(4)
+{
+    auto registry = std::make_shared<Node>(L"REGISTRY", root_.get());
+    registry->children.push_back(
+        std::make_shared<Node>(L"MACHINE", registry.get()));
+    registry->children.push_back(
+        std::make_shared<Node>(L"USER", registry.get()));
+    root_->children.push_back(registry);
+}
+
+MemoryRegistryBackend::~MemoryRegistryBackend()
+{
+}
+
+void* MemoryRegistryBackend::AddHandle(std::shared_ptr<Node> const& node)
+{
+    // Handle values are multiples of 4, like kernel handles, and are never 0
+    // or nullptr.
+    nextHandle_ += 4;
+    handles_.emplace(nextHandle_, node);
+    return reinterpret_cast<void*>(nextHandle_);
+}
+
+MemoryRegistryBackend::Node* MemoryRegistryBackend::GetNode(void* key) const
+{
+    auto handle = handles_.find(reinterpret_cast<std::uintptr_t>(key));
+    if (handle == handles_.end())
+    {
+        return nullptr;
+    }
+
+    return handle->second.get();
+}
+
+std::int32_t MemoryRegistryBackend::Resolve(void* root,
+                                            wchar_t const* path,
+                                            std::size_t pathLength,
+                                            bool create,
+                                            std::shared_ptr<Node>& result)
+{
+    Node* current;
+    std::shared_ptr<Node> currentOwner;
+    if (root == nullptr)
+    {
+        if (pathLength == 0 || path[0] != L'\\')
+        {
+            return STATUS_OBJECT_PATH_SYNTAX_BAD;
+        }
+
+        currentOwner = root_;
+        ++path;
+        --pathLength;
+    }
+    else
+    {
+        auto handle = handles_.find(reinterpret_cast<std::uintptr_t>(root));
+        if (handle == handles_.end())
+        {
+            return STATUS_INVALID_HANDLE;
+        }
+
+        if (pathLength != 0 && path[0] == L'\\')
+        {
+            return STATUS_OBJECT_PATH_SYNTAX_BAD;
+        }
+
+        currentOwner = handle->second;
+    }
+
+    current = currentOwner.get();
+    if (current->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    wchar_t const* const end = path + pathLength;
+    while (path != end)
+    {
+        wchar_t const* separator = std::find(path, end, L'\\');
+        if (separator == path || (separator != end && separator + 1 == end))
+        {
+            return STATUS_OBJECT_NAME_INVALID;
+        }
+
+        std::wstring folded(Fold(path, separator - path));
+        bool const last = separator == end;
+        auto child = current->LowerBound(folded);
+        if (child == current->children.end() ||
+            (*child)->foldedName != folded)
+        {
+            if (!last)
+            {
+                return STATUS_OBJECT_PATH_NOT_FOUND;
+            }
+
+            if (!create)
+            {
+                return STATUS_OBJECT_NAME_NOT_FOUND;
+            }
+
+            child = current->children.insert(
+                child,
+                std::make_shared<Node>(std::wstring(path, separator), current));
+            ++keyCount_;
+        }
+
+        currentOwner = *child;
+        current = currentOwner.get();
+        path = last ? end : separator + 1;
+    }
+
+    result = std::move(currentOwner);
+    return 0;
+}
+
+std::int32_t MemoryRegistryBackend::OpenKey(void** key,
+                                            std::uint32_t,
+                                            void* root,
+                                            wchar_t const* path,
+                                            std::size_t pathLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    std::shared_ptr<Node> node;
+    std::int32_t status = Resolve(root, path, pathLength, false, node);
+    if (NT_SUCCESS(status))
+    {
+        *key = AddHandle(node);
+    }
+
+    return status;
+}
+
+std::int32_t MemoryRegistryBackend::CreateKey(void** key,
+                                              std::uint32_t,
+                                              void* root,
+                                              wchar_t const* path,
+                                              std::size_t pathLength,
+                                              std::uint32_t)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    std::shared_ptr<Node> node;
+    std::int32_t status = Resolve(root, path, pathLength, true, node);
+    if (status == STATUS_OBJECT_PATH_NOT_FOUND)
+    {
+        // NtCreateKey creates only the last component of the path.
+        status = STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        *key = AddHandle(node);
+    }
+
+    return status;
+}
+
+std::int32_t MemoryRegistryBackend::DuplicateKey(void* key,
+                                                 void** duplicate)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto handle = handles_.find(reinterpret_cast<std::uintptr_t>(key));
+    if (handle == handles_.end())
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    std::shared_ptr<Node> node(handle->second);
+    *duplicate = AddHandle(node);
+    return 0;
+}
+
+std::int32_t MemoryRegistryBackend::Close(void* key)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    if (handles_.erase(reinterpret_cast<std::uintptr_t>(key)) == 0)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    return 0;
+}
+
+std::int32_t MemoryRegistryBackend::DeleteKey(void* key)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    // \\, \\REGISTRY, and the hive roots below it may not be deleted.
+    if (node->parent == nullptr || node->parent->parent == nullptr ||
+        node->parent->parent->parent == nullptr)
+    {
+        return STATUS_ACCESS_DENIED;
+    }
+
+    if (!node->children.empty())
+    {
+        return STATUS_CANNOT_DELETE;
+    }
+
+    // Open handles keep the node alive; they see it as deleted.
+    Node* parent = node->parent;
+    auto self = parent->LowerBound(node->foldedName);
+    parent->children.erase(self);
+    node->deleted = true;
+    node->parent = nullptr;
+    --keyCount_;
+    return 0;
+}
+
+std::int32_t MemoryRegistryBackend::QueryKey(void* key,
+                                             std::uint32_t informationClass,
+                                             void* information,
+                                             std::uint32_t length,
+                                             std::uint32_t* resultLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    return WriteKeyInformation(
+        *node, informationClass, information, length, resultLength);
+}
+
+std::int32_t MemoryRegistryBackend::EnumerateKey(void* key,
+                                                 std::uint32_t index,
+                                                 std::uint32_t informationClass,
+                                                 void* information,
+                                                 std::uint32_t length,
+                                                 std::uint32_t* resultLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    if (index >= node->children.size())
+    {
+        return STATUS_NO_MORE_ENTRIES;
+    }
+
+    if (informationClass == keyNameInformation)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return WriteKeyInformation(*node->children[index],
+                               informationClass,
+                               information,
+                               length,
+                               resultLength);
+}
+
+std::int32_t MemoryRegistryBackend::QueryValueKey(
+    void* key,
+    wchar_t const* valueName,
+    std::size_t valueNameLength,
+    std::uint32_t informationClass,
+    void* information,
+    std::uint32_t length,
+    std::uint32_t* resultLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    MemoryRegistryValue* value =
+        node->FindValue(Fold(valueName, valueNameLength));
+    if (value == nullptr)
+    {
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    return WriteValueInformation(
+        *value, informationClass, information, length, resultLength);
+}
+
+std::int32_t MemoryRegistryBackend::EnumerateValueKey(
+    void* key,
+    std::uint32_t index,
+    std::uint32_t informationClass,
+    void* information,
+    std::uint32_t length,
+    std::uint32_t* resultLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    if (index >= node->values.size())
+    {
+        return STATUS_NO_MORE_ENTRIES;
+    }
+
+    return WriteValueInformation(node->values[index],
+                                 informationClass,
+                                 information,
+                                 length,
+                                 resultLength);
+}
+
+std::int32_t MemoryRegistryBackend::DeleteValueKey(
+    void* key,
+    wchar_t const* valueName,
+    std::size_t valueNameLength)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    MemoryRegistryValue* value =
+        node->FindValue(Fold(valueName, valueNameLength));
+    if (value == nullptr)
+    {
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    node->values.erase(node->values.begin() + (value - node->values.data()));
+    return 0;
+}
+
+std::int32_t MemoryRegistryBackend::SetValueKey(void* key,
+                                                wchar_t const* valueName,
+                                                std::size_t valueNameLength,
+                                                std::uint32_t type,
+                                                void const* data,
+                                                std::uint32_t dataSize)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    Node* node = GetNode(key);
+    if (node == nullptr)
+    {
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (node->deleted)
+    {
+        return STATUS_KEY_DELETED;
+    }
+
+    std::wstring folded(Fold(valueName, valueNameLength));
+    MemoryRegistryValue* value = node->FindValue(folded);
+    if (value == nullptr)
+    {
+        node->values.emplace_back();
+        value = &node->values.back();
+        value->name.assign(valueName, valueNameLength);
+        value->foldedName = std::move(folded);
+    }
+
+    auto first = static_cast<unsigned char const*>(data);
+    value->type = type;
+    value->data.assign(first, first + dataSize);
+    return 0;
+}
+
+std::size_t MemoryRegistryBackend::GetKeyCount() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return keyCount_;
+}
+
+std::size_t MemoryRegistryBackend::GetOpenHandleCount() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return handles_.size();
+}
+
+RegFileParseException::RegFileParseException(std::size_t line,
+                                             std::string const& description)
+    : message("Line " + std::to_string(line) + ": " + description)
+{
+}
+
+RegFileLoadException::RegFileLoadException(std::size_t line,
+                                           std::int32_t status_)
+    : status(status_)
+{
+    std::ostringstream text;
+    text << "Line " << line << ": The registry rejected the change (NTSTATUS "
+         << "0x" << std::hex << std::uppercase << std::setw(8)
+         << std::setfill('0') << static_cast<std::uint32_t>(status) << ")";
+    message = text.str();
+}
+
+std::int32_t RegFileLoadException::GetStatus() const
+{
+    return status;
+}
+
+/// @brief    Loads .reg file text into a registry backend, one logical line
+///         at a time.
+class RegFileLoader : boost::noncopyable
+{
+    IRegistryBackend& target;
+    std::string const& currentUserPath;
+    void* currentKey;
+    std::size_t lineNumber;
+
+    void CloseCurrentKey()
+    {
+        if (currentKey != nullptr)
+        {
+            target.Close(currentKey);
+            currentKey = nullptr;
+        }
+    }
+
+    BOOST_NORETURN void Fail(std::string const& description)
+    {
+        throw RegFileParseException(lineNumber, description);
+    }
+
+    void Check(std::int32_t status)
+    {
+        if (!NT_SUCCESS(status))
+        {
+            throw RegFileLoadException(lineNumber, status);
+        }
+    }
+
+    std::wstring MapPath(std::string const& path)
+    {
+        static char const* const roots[][2] = {
+            {"HKEY_LOCAL_MACHINE", "\\Registry\\Machine"},
+            {"HKLM", "\\Registry\\Machine"},
+            {"HKEY_USERS", "\\Registry\\User"},
+            {"HKU", "\\Registry\\User"},
+            {"HKEY_CLASSES_ROOT", "\\Registry\\Machine\\Software\\Classes"},
+            {"HKCR", "\\Registry\\Machine\\Software\\Classes"},
+            {"HKEY_CURRENT_CONFIG",
+             "\\Registry\\Machine\\System\\CurrentControlSet\\Hardware "
+             "Profiles\\Current"},
+            {"HKCC",
+             "\\Registry\\Machine\\System\\CurrentControlSet\\Hardware "
+             "Profiles\\Current"},
+            {"HKEY_CURRENT_USER", nullptr},
+            {"HKCU", nullptr}};
+
+        if (boost::istarts_with(path, "\\Registry\\") ||
+            boost::iequals(path, "\\Registry"))
+        {
+            return utf8::ToUtf16(path);
+        }
+
+        std::size_t const rootLength = path.find('\\');
+        std::string const rootName(path.substr(0, rootLength));
+        for (auto const& root : roots)
+        {
+            if (boost::iequals(rootName, root[0]))
+            {
+                std::string mapped(root[1] == nullptr ? currentUserPath
+                                                      : root[1]);
+                if (rootLength != std::string::npos)
+                {
+                    mapped.append(path, rootLength, std::string::npos);
+                }
+
+                return utf8::ToUtf16(mapped);
+            }
+        }
+
+        Fail("Unknown root key " + rootName);
+    }
+
+    // Creates the key at the given native path, and any missing parents.
+    void* CreatePath(std::wstring const& path)
+    {
+        void* result;
+        std::int32_t status = target.CreateKey(
+            &result, keyAllAccess, nullptr, path.data(), path.size(), 0);
+        if (status != STATUS_OBJECT_NAME_NOT_FOUND)
+        {
+            Check(status);
+            return result;
+        }
+
+        // Usually the parent was created by the previous key line; if not,
+        // create the path one level at a time.
+        std::size_t separator = path.find(L'\\', 1);
+        while (separator != std::wstring::npos)
+        {
+            Check(target.CreateKey(
+                &result, keyAllAccess, nullptr, path.data(), separator, 0));
+            target.Close(result);
+            separator = path.find(L'\\', separator + 1);
+        }
+
+        Check(target.CreateKey(
+            &result, keyAllAccess, nullptr, path.data(), path.size(), 0));
+        return result;
+    }
+
+    void DeleteTree(void* key)
+    {
+        std::vector<unsigned char> buffer(1024);
+        for (;;)
+        {
+            // Always enumerate index 0, since each pass deletes it.
+            std::uint32_t resultLength;
+            std::int32_t status = target.EnumerateKey(
+                key,
+                0,
+                keyBasicInformation,
+                buffer.data(),
+                static_cast<std::uint32_t>(buffer.size()),
+                &resultLength);
+            if (status == STATUS_BUFFER_OVERFLOW ||
+                status == STATUS_BUFFER_TOO_SMALL)
+            {
+                buffer.resize(resultLength);
+                continue;
+            }
+
+            if (status == STATUS_NO_MORE_ENTRIES)
+            {
+                break;
+            }
+
+            Check(status);
+            auto info = reinterpret_cast<KeyBasicRecord const*>(buffer.data());
+            void* child;
+            Check(target.OpenKey(&child,
+                                 keyAllAccess,
+                                 key,
+                                 info->Name,
+                                 info->NameLength / sizeof(wchar_t)));
+            DeleteTree(child);
+            target.Close(child);
+        }
+
+        Check(target.DeleteKey(key));
+    }
+
+    void KeyLine(std::string const& line)
+    {
+        CloseCurrentKey();
+        if (line.back() != ']')
+        {
+            Fail("Key line is missing its closing bracket");
+        }
+
+        bool const deleting = line.size() > 1 && line[1] == '-';
+        std::string const path(
+            line.substr(deleting ? 2 : 1, line.size() - (deleting ? 3 : 2)));
+        std::wstring const nativePath(MapPath(path));
+        if (!deleting)
+        {
+            currentKey = CreatePath(nativePath);
+            return;
+        }
+
+        void* key;
+        std::int32_t status = target.OpenKey(&key,
+                                             keyAllAccess,
+                                             nullptr,
+                                             nativePath.data(),
+                                             nativePath.size());
+        if (status == STATUS_OBJECT_NAME_NOT_FOUND ||
+            status == STATUS_OBJECT_PATH_NOT_FOUND)
+        {
+            return;
+        }
+
+        Check(status);
+
+        DeleteTree(key);
+        target.Close(key);
+    }
+
+    // Parses a quoted string starting at position, which must be the
+    // opening quote. Returns the position after the closing quote.
+    std::size_t QuotedString(std::string const& line,
+                             std::size_t position,
+                             std::string& result)
+    {
+        result.clear();
+        for (++position; position < line.size(); ++position)
+        {
+            char const character = line[position];
+            if (character == '"')
+            {
+                return position + 1;
+            }
+
+            if (character == '\\' && position + 1 < line.size())
+            {
+                ++position;
+            }
+
+            result.push_back(line[position]);
+        }
+
+        Fail("Unterminated string");
+    }
+
+    static int HexDigit(char character)
+    {
+        if (character >= '0' && character <= '9')
+        {
+            return character - '0';
+        }
+
+        if (character >= 'a' && character <= 'f')
+        {
+            return character - 'a' + 10;
+        }
+
+        if (character >= 'A' && character <= 'F')
+        {
+            return character - 'A' + 10;
+        }
+
+        return -1;
+    }
+
+    void HexBytes(std::string const& text,
+                  std::size_t position,
+                  std::vector<unsigned char>& data)
+    {
+        data.clear();
+        int pending = -1;
+        for (; position < text.size(); ++position)
+        {
+            char const character = text[position];
+            if (character == ',' || character == ' ' || character == '\t')
+            {
+                if (pending >= 0)
+                {
+                    data.push_back(static_cast<unsigned char>(pending));
+                    pending = -1;
+                }
+
+                continue;
+            }
+
+            int const digit = HexDigit(character);
+            if (digit < 0 || pending >= 16)
+            {
+                Fail("Invalid hex data");
+            }
+
+            pending = pending < 0 ? digit : pending * 16 + digit;
+        }
+
+        if (pending >= 0)
+        {
+            data.push_back(static_cast<unsigned char>(pending));
+        }
+    }
+
+    void ValueLine(std::string const& line)
+    {
+        if (currentKey == nullptr)
+        {
+            Fail("Value outside of a key");
+        }
+
+        std::string name;
+        std::size_t position;
+        if (line[0] == '@')
+        {
+            position = 1;
+        }
+        else
+        {
+            position = QuotedString(line, 0, name);
+        }
+
+        if (position >= line.size() || line[position] != '=')
+        {
+            Fail("Expected '=' after value name");
+        }
+
+        ++position;
+        std::wstring const wideName(utf8::ToUtf16(name));
+        std::uint32_t type;
+        std::vector<unsigned char> data;
+        if (line.compare(position, std::string::npos, "-") == 0)
+        {
+            target.DeleteValueKey(
+                currentKey, wideName.data(), wideName.size());
+            return;
+        }
+        else if (position < line.size() && line[position] == '"')
+        {
+            std::string contents;
+            if (QuotedString(line, position, contents) != line.size())
+            {
+                Fail("Unexpected text after string value");
+            }
+
+            std::wstring wideContents(utf8::ToUtf16(contents));
+            auto first = reinterpret_cast<unsigned char const*>(
+                wideContents.c_str());
+            type = regSz;
+            data.assign(first,
+                        first + (wideContents.size() + 1) * sizeof(wchar_t));
+        }
+        else if (boost::istarts_with(line.c_str() + position, "dword:"))
+        {
+            std::string const digits(line.substr(position + 6));
+            if (digits.empty() || digits.size() > 8)
+            {
+                Fail("Invalid dword data");
+            }
+
+            std::uint32_t dword = 0;
+            for (char digit : digits)
+            {
+                int const nibble = HexDigit(digit);
+                if (nibble < 0)
+                {
+                    Fail("Invalid dword data");
+                }
+
+                dword = dword * 16 + nibble;
+            }
+
+            type = regDword;
+            auto first = reinterpret_cast<unsigned char const*>(&dword);
+            data.assign(first, first + sizeof(dword));
+        }
+        else if (boost::istarts_with(line.c_str() + position, "hex:"))
+        {
+            type = regBinary;
+            HexBytes(line, position + 4, data);
+        }
+        else if (boost::istarts_with(line.c_str() + position, "hex("))
+        {
+            std::size_t const close = line.find("):", position);
+            if (close == std::string::npos || close == position + 4)
+            {
+                Fail("Invalid hex type");
+            }
+
+            type = 0;
+            for (std::size_t idx = position + 4; idx < close; ++idx)
+            {
+                int const nibble = HexDigit(line[idx]);
+                if (nibble < 0)
+                {
+                    Fail("Invalid hex type");
+                }
+
+                type = type * 16 + nibble;
+            }
+
+            HexBytes(line, close + 2, data);
+        }
+        else
+        {
+            Fail("Unrecognized value data");
+        }
+
+        Check(target.SetValueKey(currentKey,
+                                 wideName.data(),
+                                 wideName.size(),
+                                 type,
+                                 data.data(),
+                                 static_cast<std::uint32_t>(data.size())));
+    }
+
+    static void TrimRight(std::string& line)
+    {
+        while (!line.empty() &&
+               (line.back() == '\r' || line.back() == ' ' ||
+                line.back() == '\t'))
+        {
+            line.pop_back();
+        }
+    }
+
+    public:
+    RegFileLoader(IRegistryBackend& target_,
+                  std::string const& currentUserPath_)
+        : target(target_)
+        , currentUserPath(currentUserPath_)
+        , currentKey(nullptr)
+        , lineNumber(0)
+    {
+    }
+
+    ~RegFileLoader()
+    {
+        CloseCurrentKey();
+    }
+
+    void Load(std::istream& source)
+    {
+        // regedit writes UTF-16LE with a byte order mark; LineReader converts
+        // that to UTF-8 and drops a UTF-8 byte order mark.
+        LineReader reader([&source](unsigned char* buffer, std::size_t size)
+        {
+            source.read(reinterpret_cast<char*>(buffer),
+                        static_cast<std::streamsize>(size));
+            return static_cast<std::size_t>(source.gcount());
+        });
+
+        boost::string_ref next;
+        std::string line;
+        std::string continuation;
+        bool sawHeader = false;
+        while (reader.Next(next))
+        {
+            ++lineNumber;
+            line.assign(next.begin(), next.end());
+            TrimRight(line);
+            std::size_t const startLine = lineNumber;
+
+            // Long hex data is wrapped onto indented lines ending in '\'.
+            while (!line.empty() && line.back() == '\\' &&
+                   line.find('=') != std::string::npos &&
+                   line.find("hex") != std::string::npos &&
+                   reader.Next(next))
+            {
+                ++lineNumber;
+                continuation.assign(next.begin(), next.end());
+                TrimRight(continuation);
+                line.pop_back();
+                line.append(continuation,
+                            (std::min)(continuation.find_first_not_of(" \t"),
+                                       continuation.size()),
+                            std::string::npos);
+            }
+
+            std::size_t const currentLine = lineNumber;
+            lineNumber = startLine;
+            if (line.empty() || line[0] == ';')
+            {
+                lineNumber = currentLine;
+                continue;
+            }
+
+            if (!sawHeader)
+            {
+                if (line != "Windows Registry Editor Version 5.00" &&
+                    line != "REGEDIT4")
+                {
+                    Fail("Missing .reg file header");
+                }
+
+                sawHeader = true;
+            }
+            else if (line[0] == '[')
+            {
+                KeyLine(line);
+            }
+            else if (line[0] == '"' || line[0] == '@')
+            {
+                ValueLine(line);
+            }
+            else
+            {
+                Fail("Unrecognized line");
+            }
+
+            lineNumber = currentLine;
+        }
+
+        if (!sawHeader)
+        {
+            Fail("Missing .reg file header");
+        }
+    }
+};
+
+void LoadRegFile(IRegistryBackend& target,
+                 std::istream& source,
+                 std::string const& currentUserPath)
+{
+    RegFileLoader loader(target, currentUserPath);
+    loader.Load(source);
+}
+}
+}
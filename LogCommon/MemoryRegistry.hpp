@@ -0,0 +1,184 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/config.hpp>
+#include <boost/noncopyable.hpp>
+#include "RegistryBackend.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    A registry held entirely in memory.
+///
+/// @remarks The tree initially contains \\REGISTRY, \\REGISTRY\\MACHINE,
+///          and \\REGISTRY\\USER. Paths are compared case insensitively,
+///          sub keys enumerate in case insensitive order, and values
+///          enumerate in the order they were created, as with the NT
+///          registry. Access masks, security, volatility, and symbolic links
+///          are not modeled. All members may be called from several threads.
+class MemoryRegistryBackend : public IRegistryBackend, boost::noncopyable
+{
+    struct Node;
+    std::shared_ptr<Node> root_;
+    std::unordered_map<std::uintptr_t, std::shared_ptr<Node>> handles_;
+    std::uintptr_t nextHandle_;
+    std::size_t keyCount_;
+    mutable std::mutex lock_;
+
+    void* AddHandle(std::shared_ptr<Node> const& node);
+    Node* GetNode(void* key) const;
+    std::int32_t Resolve(void* root,
+                         wchar_t const* path,
+                         std::size_t pathLength,
+                         bool create,
+                         std::shared_ptr<Node>& result);
+    static std::int32_t WriteKeyInformation(Node const& node,
+                                            std::uint32_t informationClass,
+                                            void* information,
+                                            std::uint32_t length,
+                                            std::uint32_t* resultLength);
+
+    public:
+    /// @brief    Default constructor. Constructs a registry containing only
+    ///         the hive roots.
+    MemoryRegistryBackend();
+
+    /// @brief    Destructor.
+    virtual ~MemoryRegistryBackend();
+
+    virtual std::int32_t OpenKey(void** key,
+                                 std::uint32_t desiredAccess,
+                                 void* root,
+                                 wchar_t const* path,
+                                 std::size_t pathLength);
+    virtual std::int32_t CreateKey(void** key,
+                                   std::uint32_t desiredAccess,
+                                   void* root,
+                                   wchar_t const* path,
+                                   std::size_t pathLength,
+                                   std::uint32_t options);
+    virtual std::int32_t DuplicateKey(void* key, void** duplicate);
+    virtual std::int32_t Close(void* key);
+    virtual std::int32_t DeleteKey(void* key);
+    virtual std::int32_t QueryKey(void* key,
+                                  std::uint32_t informationClass,
+                                  void* information,
+                                  std::uint32_t length,
+                                  std::uint32_t* resultLength);
+    virtual std::int32_t EnumerateKey(void* key,
+                                      std::uint32_t index,
+                                      std::uint32_t informationClass,
+                                      void* information,
+                                      std::uint32_t length,
+                                      std::uint32_t* resultLength);
+    virtual std::int32_t QueryValueKey(void* key,
+                                       wchar_t const* valueName,
+                                       std::size_t valueNameLength,
+                                       std::uint32_t informationClass,
+                                       void* information,
+                                       std::uint32_t length,
+                                       std::uint32_t* resultLength);
+    virtual std::int32_t EnumerateValueKey(void* key,
+                                           std::uint32_t index,
+                                           std::uint32_t informationClass,
+                                           void* information,
+                                           std::uint32_t length,
+                                           std::uint32_t* resultLength);
+    virtual std::int32_t DeleteValueKey(void* key,
+                                        wchar_t const* valueName,
+                                        std::size_t valueNameLength);
+    virtual std::int32_t SetValueKey(void* key,
+                                     wchar_t const* valueName,
+                                     std::size_t valueNameLength,
+                                     std::uint32_t type,
+                                     void const* data,
+                                     std::uint32_t dataSize);
+
+    /// @brief    Gets the number of keys in the registry, including the hive
+    ///         roots.
+    std::size_t GetKeyCount() const;
+
+    /// @brief    Gets the number of handles which have not been closed.
+    std::size_t GetOpenHandleCount() const;
+};
+
+/// @brief    Exception for signaling malformed .reg file text.
+class RegFileParseException : public std::exception
+{
+    std::string message;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    line           The line number at which the error occurred.
+    /// @param    description    Description of the error.
+    RegFileParseException(std::size_t line, std::string const& description);
+
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return message.c_str();
+    }
+};
+
+/// @brief    Exception for signaling that a registry backend rejected a
+///         change described by a .reg file.
+class RegFileLoadException : public std::exception
+{
+    std::string message;
+    std::int32_t status;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    line      The line number of the change.
+    /// @param    status    The NTSTATUS the backend returned.
+    RegFileLoadException(std::size_t line, std::int32_t status);
+
+    /// @brief    Gets the NTSTATUS the backend returned.
+    std::int32_t GetStatus() const;
+
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return message.c_str();
+    }
+};
+
+/// @brief    Applies the contents of a .reg file, as written by regedit, to a
+///         registry backend.
+///
+/// @remarks The source is read one line at a time, so arbitrarily large
+///          files are loaded without holding their text in memory. The text
+///          may be UTF-16LE, as regedit exports it, or UTF-8; the encoding is
+///          detected as LineReader detects it, and a byte order mark is
+///          skipped. Both the "Windows Registry Editor Version 5.00" and
+///          "REGEDIT4" formats are accepted, although hex(2) and hex(7) data
+///          is stored byte for byte in either case. Key paths may begin with
+///          a predefined key name, such as HKEY_LOCAL_MACHINE or HKLM, or
+///          with a native \\Registry path. Missing parent keys are created,
+///          and [-key] lines delete the key and all of its sub keys.
+///
+/// @param [in,out]    target    The backend to modify. This is usually a
+///                              MemoryRegistryBackend.
+/// @param [in,out]    source    The .reg file text.
+/// @param    currentUserPath    The native path HKEY_CURRENT_USER refers to.
+///
+/// @throws RegFileParseException The text is not a valid .reg file.
+/// @throws RegFileLoadException The backend rejected a change.
+void LoadRegFile(IRegistryBackend& target,
+                 std::istream& source,
+                 std::string const& currentUserPath =
+                     "\\Registry\\User\\.DEFAULT");
+}
+}
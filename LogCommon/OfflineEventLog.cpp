@@ -0,0 +1,73 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// The adapter from EventLogFile to EventLog lives apart from the parser so
+// that EventLogFile.cpp builds without windows.h.
+
+#include <utility>
+#include "OfflineEventLog.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+OfflineEventLogEntry::OfflineEventLogEntry(EventLogFileEntry&& decoded)
+    : entry(std::move(decoded))
+{
+    std::uint64_t const created = entry.GetCreated();
+    date.dwLowDateTime = static_cast<DWORD>(created & 0xFFFFFFFF);
+    date.dwHighDateTime = static_cast<DWORD>(created >> 32);
+    level = entry.GetLevel();
+    eventId = entry.GetEventId();
+}
+
+OfflineEventLogEntry::OfflineEventLogEntry(OfflineEventLogEntry&& e)
+    : EventLogEntry(std::move(e)), entry(std::move(e.entry))
+{
+}
+
+EventLogFileEntry const& OfflineEventLogEntry::GetFileEntry() const
+{
+    return entry;
+}
+
+std::string OfflineEventLogEntry::GetSource()
+{
+    return entry.GetSource();
+}
+
+std::string OfflineEventLogEntry::GetDescription()
+{
+    return entry.GetDescription();
+}
+
+OfflineEventLog::OfflineEventLog(std::string const& path,
+                                 EventLogFileFilter filter)
+    : file_(path), log_(file_.cbegin(), file_.cend(), std::move(filter))
+{
+}
+
+std::vector<std::unique_ptr<EventLogEntry>> OfflineEventLog::ReadEvents()
+{
+    std::vector<std::unique_ptr<EventLogEntry>> eventLogEntries;
+    log_.ReadEvents([&](EventLogFileEntry& entry) {
+        eventLogEntries.emplace_back(std::unique_ptr<EventLogEntry>(
+            new OfflineEventLogEntry(std::move(entry))));
+        return true;
+    });
+
+    return eventLogEntries;
+}
+
+void OfflineEventLog::ReadEvents(
+    std::function<bool(EventLogEntry&)> const& visitor)
+{
+    log_.ReadEvents([&](EventLogFileEntry& entry) {
+        OfflineEventLogEntry adapted(std::move(entry));
+        return visitor(adapted);
+    });
+}
+}
+}
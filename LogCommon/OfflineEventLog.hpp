@@ -0,0 +1,81 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "EventLog.hpp"
+#include "EventLogFile.hpp"
+#include "File.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    An event read from an .evtx file by OfflineEventLog. An
+///         implementation of EventLogEntry.
+class OfflineEventLogEntry : public EventLogEntry
+{
+    EventLogFileEntry entry;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param [in,out]    decoded    The event decoded from the file.
+    explicit OfflineEventLogEntry(EventLogFileEntry&& decoded);
+
+    /// @brief    Move constructor.
+    ///
+    /// @param [in,out]    e    The OfflineEventLogEntry being moved from.
+    OfflineEventLogEntry(OfflineEventLogEntry&& e);
+
+    /// @brief    Gets the event as decoded from the file, including its
+    ///         qualifiers, record identifier and values.
+    EventLogFileEntry const& GetFileEntry() const;
+
+    /// @brief    Gets the provider name of the event.
+    ///
+    /// @return    The source.
+    virtual std::string GetSource() override;
+
+    /// @brief    Gets the description of the event.
+    ///
+    /// @return    The description; see EventLogFileEntry::GetDescription.
+    virtual std::string GetDescription() override;
+};
+
+/// @brief    Event log read from an .evtx file with EventLogFile, rather than
+///         through the event log service.
+class OfflineEventLog : public EventLog
+{
+    MemoryMappedFile file_;
+    EventLogFile log_;
+
+    public:
+    /// @brief    Constructor. Maps the .evtx file at the given path.
+    ///
+    /// @param    path      Full path of the .evtx file.
+    /// @param    filter    (optional) The events to select.
+    ///
+    /// @throws Win32Exception The file could not be mapped.
+    /// @throws InvalidEventLogFileException The file is not an .evtx file.
+    explicit OfflineEventLog(std::string const& path,
+                             EventLogFileFilter filter = EventLogFileFilter());
+
+    /// @brief    Reads the selected events.
+    ///
+    /// @return    The events.
+    std::vector<std::unique_ptr<EventLogEntry>> ReadEvents();
+
+    /// @brief    Reads the selected events one at a time, oldest first.
+    ///
+    /// @param    visitor    Called with each event. Returns false to stop
+    ///                      reading.
+    void ReadEvents(std::function<bool(EventLogEntry&)> const& visitor);
+};
+}
+}
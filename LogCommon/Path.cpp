@@ -4,6 +4,7 @@
 
 #include <unordered_set>
 #include <limits>
+#include <mutex>
 #include <cstdlib>
 #include <boost/algorithm/string.hpp>
 #include "File.hpp"
@@ -152,26 +153,28 @@ static bool RundllCheck(std::string& path)
     return false;
 }
 
+// Load point scanning runs on several threads, so the cache is guarded.
+static std::mutex nonexistentCacheLock;
+static std::unordered_set<std::string> nonexistentCache;
+
 static bool IsExclusiveFileCached(std::string const& testPath)
 {
-    static std::unordered_set<std::string> nonexistentCache;
-    auto cacheValue = nonexistentCache.find(testPath);
-    if (cacheValue == nonexistentCache.end())
     {
-        if (SystemFacades::File::IsExclusiveFile(testPath))
-        {
-            return true;
-        }
-        else
+        std::lock_guard<std::mutex> guard(nonexistentCacheLock);
+        if (nonexistentCache.find(testPath) != nonexistentCache.end())
         {
-            nonexistentCache.emplace(testPath, 1);
             return false;
         }
     }
-    else
+
+    if (SystemFacades::File::IsExclusiveFile(testPath))
     {
-        return false;
+        return true;
     }
+
+    std::lock_guard<std::mutex> guard(nonexistentCacheLock);
+    nonexistentCache.emplace(testPath, 1);
+    return false;
 }
 
 static bool TryExtensions(std::string& searchpath,
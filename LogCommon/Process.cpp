@@ -2,8 +2,10 @@
 // This is under the 2 clause BSD license.
 // See the included LICENSE.TXT file for more details.
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
+#include <iterator>
 #include <windows.h>
 #include "Win32Exception.hpp"
 #include "Win32Glue.hpp"
@@ -25,29 +27,51 @@ namespace Instalog
 namespace SystemFacades
 {
 
-ProcessEnumerator::ProcessEnumerator()
+ProcessEnumerator::ProcessEnumerator() : snapshotLength_(0)
+{
+    Refresh();
+}
+
+void ProcessEnumerator::Refresh()
 {
     NtQuerySystemInformationFunc ntQuerySysInfo =
         GetNtDll().GetProcAddress<NtQuerySystemInformationFunc>(
             GetThrowingErrorReporter(),
             "NtQuerySystemInformation");
-    NTSTATUS errorCheck = 0xC0000004 /* STATUS_INFO_LENGTH_MISMATCH */;
-    ULONG goalLength = 0;
-    while (errorCheck == 0xC0000004)
+    if (informationBlock.empty())
     {
-        if (goalLength == 0)
-        {
-            informationBlock.resize(informationBlock.size() + 1024);
-        }
-        else
-        {
-            informationBlock.resize(goalLength);
-        }
+        // Enough for a few hundred processes; larger lists are sized from
+        // the length the first query reports.
+        informationBlock.resize(256 * 1024);
+    }
+
+    snapshotLength_ = 0;
+    NTSTATUS errorCheck;
+    for (;;)
+    {
+        ULONG goalLength = 0;
         errorCheck = ntQuerySysInfo(SystemProcessInformation,
                                     informationBlock.data(),
                                     static_cast<ULONG>(informationBlock.size()),
                                     &goalLength);
+        if (errorCheck != 0xC0000004 /* STATUS_INFO_LENGTH_MISMATCH */)
+        {
+            if (errorCheck == 0)
+            {
+                snapshotLength_ = goalLength;
+            }
+
+            break;
+        }
+
+        // Processes can start between this call and the next, so leave
+        // room for them rather than asking for exactly the reported size.
+        std::size_t const needed =
+            (std::max)(static_cast<std::size_t>(goalLength),
+                       informationBlock.size());
+        informationBlock.resize(needed + needed / 4);
     }
+
     if (errorCheck != 0)
     {
         Win32Exception::ThrowFromNtError(errorCheck);
@@ -56,12 +80,19 @@ ProcessEnumerator::ProcessEnumerator()
 
 ProcessIterator ProcessEnumerator::begin()
 {
-    return ProcessIterator(informationBlock.cbegin(), informationBlock.cend());
+    if (snapshotLength_ == 0)
+    {
+        return end();
+    }
+
+    return ProcessIterator(informationBlock.cbegin(),
+                           informationBlock.cbegin() + snapshotLength_);
 }
 
 ProcessIterator ProcessEnumerator::end()
 {
-    return ProcessIterator(informationBlock.cend(), informationBlock.cend());
+    auto const snapshotEnd = informationBlock.cbegin() + snapshotLength_;
+    return ProcessIterator(snapshotEnd, snapshotEnd);
 }
 
 ProcessIterator::ProcessIterator(
@@ -94,11 +125,216 @@ bool ProcessIterator::equal(ProcessIterator const& other) const
     return blockPtr == other.blockPtr && end_ == other.end_;
 }
 
-Process ProcessIterator::dereference() const
+ProcessView ProcessIterator::dereference() const
 {
-    SYSTEM_PROCESS_INFORMATION const* casted =
-        reinterpret_cast<SYSTEM_PROCESS_INFORMATION const*>(&*blockPtr);
-    return Process(casted->ProcessId);
+    return ProcessView(
+        reinterpret_cast<SYSTEM_PROCESS_INFORMATION const*>(&*blockPtr));
+}
+
+ProcessView::ProcessView(SYSTEM_PROCESS_INFORMATION const* information)
+    : information_(information)
+{
+}
+
+std::size_t ProcessView::GetProcessId() const
+{
+    return information_->ProcessId;
+}
+
+std::size_t ProcessView::GetParentProcessId() const
+{
+    return information_->InheritedFromProcessId;
+}
+
+std::uint32_t ProcessView::GetThreadCount() const
+{
+    return information_->NumberOfThreads;
+}
+
+std::uint64_t ProcessView::GetCreateTime() const
+{
+    return static_cast<std::uint64_t>(information_->CreateTime.QuadPart);
+}
+
+boost::wstring_ref ProcessView::GetImageName() const
+{
+    UNICODE_STRING const& name = information_->ImageName;
+    if (name.Buffer == nullptr)
+    {
+        return boost::wstring_ref();
+    }
+
+    return boost::wstring_ref(name.Buffer, name.Length / sizeof(wchar_t));
+}
+
+ProcessView::operator Process() const
+{
+    return Process(GetProcessId());
+}
+
+struct ProcessSampler::SampleEntry
+{
+    std::size_t processId;
+    std::uint64_t createTime;
+    SYSTEM_PROCESS_INFORMATION const* information;
+
+    bool operator<(SampleEntry const& other) const
+    {
+        if (processId != other.processId)
+        {
+            return processId < other.processId;
+        }
+
+        return createTime < other.createTime;
+    }
+};
+
+void ProcessSampler::BuildEntries(ProcessEnumerator& snapshot,
+                                  std::vector<SampleEntry>& entries)
+{
+    entries.clear();
+    for (ProcessView const process : snapshot)
+    {
+        SampleEntry entry;
+        entry.processId = process.GetProcessId();
+        entry.createTime = process.GetCreateTime();
+        entry.information = process.information_;
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end());
+}
+
+ProcessSampler::ProcessSampler(std::chrono::milliseconds interval)
+    : interval_(interval)
+    , current_(0)
+    , sampleCount_(1)
+    , stopping_(false)
+{
+    BuildEntries(snapshots_[current_], entries_[current_]);
+    thread_ = std::thread([this] { Run(); });
+}
+
+ProcessSampler::~ProcessSampler()
+{
+    StopThread();
+}
+
+static ProcessChange MakeProcessChange(bool started, ProcessView process)
+{
+    ProcessChange change;
+    change.started = started;
+    change.processId = process.GetProcessId();
+    change.parentProcessId = process.GetParentProcessId();
+    boost::wstring_ref const name(process.GetImageName());
+    change.imageName = utf8::ToUtf8(name.data(), name.size());
+    return change;
+}
+
+void ProcessSampler::Sample()
+{
+    // The previous snapshot is left alone until the comparison is done, so
+    // entries for exited processes can still be read from it.
+    std::size_t const next = 1 - current_;
+    snapshots_[next].Refresh();
+    BuildEntries(snapshots_[next], entries_[next]);
+
+    std::vector<ProcessChange> found;
+    auto before = entries_[current_].cbegin();
+    auto const beforeEnd = entries_[current_].cend();
+    auto after = entries_[next].cbegin();
+    auto const afterEnd = entries_[next].cend();
+    while (before != beforeEnd || after != afterEnd)
+    {
+        if (after == afterEnd || (before != beforeEnd && *before < *after))
+        {
+            found.push_back(
+                MakeProcessChange(false, ProcessView(before->information)));
+            ++before;
+        }
+        else if (before == beforeEnd || *after < *before)
+        {
+            found.push_back(
+                MakeProcessChange(true, ProcessView(after->information)));
+            ++after;
+        }
+        else
+        {
+            ++before;
+            ++after;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    current_ = next;
+    ++sampleCount_;
+    changes_.insert(changes_.end(),
+                    std::make_move_iterator(found.begin()),
+                    std::make_move_iterator(found.end()));
+}
+
+void ProcessSampler::Run()
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;)
+    {
+        wake_.wait_for(guard, interval_, [this] { return stopping_; });
+        if (stopping_)
+        {
+            return;
+        }
+
+        guard.unlock();
+        try
+        {
+            Sample();
+        }
+        catch (Win32Exception const&)
+        {
+            // A failed sample is skipped; the next one compares against the
+            // last good snapshot.
+        }
+        guard.lock();
+    }
+}
+
+bool ProcessSampler::StopThread()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (stopping_)
+        {
+            return false;
+        }
+
+        stopping_ = true;
+    }
+
+    wake_.notify_all();
+    thread_.join();
+    return true;
+}
+
+void ProcessSampler::Stop()
+{
+    if (StopThread())
+    {
+        Sample();
+    }
+}
+
+std::vector<ProcessChange> ProcessSampler::TakeChanges()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    std::vector<ProcessChange> result;
+    result.swap(changes_);
+    return result;
+}
+
+std::size_t ProcessSampler::GetSampleCount() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return sampleCount_;
 }
 
 std::size_t Process::GetProcessId() const
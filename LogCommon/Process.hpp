@@ -3,11 +3,20 @@
 // See the included LICENSE.TXT file for more details.
 
 #pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
 #include "Expected.hpp"
 
+struct T_SYSTEM_PROCESS_INFORMATION;
+
 namespace Instalog
 {
 namespace SystemFacades
@@ -43,19 +52,58 @@ class Process
     void Terminate();
 };
 
+/// @brief    A view of one process's entry in a ProcessEnumerator snapshot.
+///
+/// @remarks Nothing is copied out of the snapshot; a view is valid until the
+///          enumerator it came from is refreshed or destroyed.
+class ProcessView
+{
+    friend class ProcessSampler;
+    T_SYSTEM_PROCESS_INFORMATION const* information_;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    information    The snapshot entry.
+    explicit ProcessView(T_SYSTEM_PROCESS_INFORMATION const* information);
+
+    /// @brief    Gets the process identifier.
+    std::size_t GetProcessId() const;
+
+    /// @brief    Gets the identifier of the process which created this one.
+    std::size_t GetParentProcessId() const;
+
+    /// @brief    Gets the number of threads in the process.
+    std::uint32_t GetThreadCount() const;
+
+    /// @brief    Gets the creation time of the process, as a FILETIME value.
+    ///
+    /// @remarks Process identifiers are reused; the identifier and creation
+    ///          time together identify a process.
+    std::uint64_t GetCreateTime() const;
+
+    /// @brief    Gets the image name of the process, such as L"svchost.exe".
+    ///         The name is empty for the idle process.
+    boost::wstring_ref GetImageName() const;
+
+    /// @brief    Gets a Process for querying details which are not part of
+    ///         the snapshot.
+    operator Process() const;
+};
+
 /// @brief    Process iterator. An iterator which loops over processes in
 /// memory.
 class ProcessIterator
     : public boost::iterator_facade<ProcessIterator,
-                                    Process,
+                                    ProcessView,
                                     boost::forward_traversal_tag,
-                                    Process>
+                                    ProcessView>
 {
     friend class boost::iterator_core_access;
     std::vector<unsigned char>::const_iterator blockPtr, end_;
     void increment();
     bool equal(ProcessIterator const& other) const;
-    Process dereference() const;
+    ProcessView dereference() const;
 
     public:
     ProcessIterator()
@@ -66,17 +114,88 @@ class ProcessIterator
 };
 
 /// @brief    Process enumerator. Serves as a collection of processes in memory.
+///
+/// @remarks The enumerator holds a snapshot of the system's process list. The
+///          snapshot buffer is kept between calls to Refresh, and is grown
+///          with some headroom when the process list outgrows it, so
+///          repeated snapshots rarely need more than one kernel call.
 class ProcessEnumerator
 {
     std::vector<unsigned char> informationBlock;
+    std::size_t snapshotLength_;
 
     public:
     typedef ProcessIterator iterator;
 
+    /// @brief    Default constructor. Takes a snapshot of the process list.
     ProcessEnumerator();
+
+    /// @brief    Replaces the snapshot with the current process list.
+    ///
+    /// @remarks Invalidates all iterators and views into the snapshot.
+    void Refresh();
+
     iterator begin();
     iterator end();
 };
+
+/// @brief    A process which started or exited between two samples taken by
+///         a ProcessSampler.
+struct ProcessChange
+{
+    bool started;
+    std::size_t processId;
+    std::size_t parentProcessId;
+    std::string imageName;
+};
+
+/// @brief    Watches for processes starting and exiting while it is alive.
+///
+/// @remarks A background thread refreshes a pair of ProcessEnumerator
+///          snapshots on a fixed interval and compares them by process
+///          identifier and creation time. Only changed processes have their
+///          names copied out, so a sample of an unchanged system costs one
+///          kernel call and a sort.
+class ProcessSampler : boost::noncopyable
+{
+    struct SampleEntry;
+    std::chrono::milliseconds interval_;
+    ProcessEnumerator snapshots_[2];
+    std::vector<SampleEntry> entries_[2];
+    std::size_t current_;
+    std::vector<ProcessChange> changes_;
+    std::size_t sampleCount_;
+    bool stopping_;
+    mutable std::mutex lock_;
+    std::condition_variable wake_;
+    std::thread thread_;
+
+    static void BuildEntries(ProcessEnumerator& snapshot,
+                             std::vector<SampleEntry>& entries);
+    void Sample();
+    void Run();
+    bool StopThread();
+
+    public:
+    /// @brief    Constructor. Takes the first sample and starts sampling.
+    ///
+    /// @param    interval    The time between samples.
+    explicit ProcessSampler(std::chrono::milliseconds interval);
+
+    /// @brief    Destructor. Stops sampling.
+    ~ProcessSampler();
+
+    /// @brief    Takes a final sample and stops the background thread.
+    ///         Calling Stop more than once has no effect.
+    void Stop();
+
+    /// @brief    Gets the changes recorded since the last call, in the order
+    ///         they were seen.
+    std::vector<ProcessChange> TakeChanges();
+
+    /// @brief    Gets the number of samples taken, including the first.
+    std::size_t GetSampleCount() const;
+};
 inline bool operator==(Instalog::SystemFacades::Process const& lhs,
                        Instalog::SystemFacades::Process const& rhs)
 {
@@ -94,5 +213,17 @@ inline bool operator==(const std::size_t lhs,
 {
     return lhs == rhs.GetProcessId();
 }
+
+inline bool operator==(Instalog::SystemFacades::ProcessView const& lhs,
+                       const std::size_t rhs)
+{
+    return lhs.GetProcessId() == rhs;
+}
+
+inline bool operator==(const std::size_t lhs,
+                       Instalog::SystemFacades::ProcessView const& rhs)
+{
+    return lhs == rhs.GetProcessId();
+}
 }
 }
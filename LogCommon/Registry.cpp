@@ -9,42 +9,28 @@
 #include <iterator>
 #include <array>
 #include <functional>
+#include <cstring>
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include "Win32Exception.hpp"
 #include "StringUtilities.hpp"
-#include "Library.hpp"
 #include "Registry.hpp"
+#include "RegistryBackend.hpp"
 #include "Utf8.hpp"
 
 #define STATUS_BUFFER_TOO_SMALL 0xC0000023
 #define STATUS_BUFFER_OVERFLOW 0x80000005
 #define STATUS_NO_MORE_ENTRIES 0x8000001A
+#define STATUS_OBJECT_NAME_NOT_FOUND 0xC0000034
 
 namespace Instalog
 {
 namespace SystemFacades
 {
 
-static NtOpenKeyFunc PNtOpenKey =
-    GetNtDll().GetProcAddress<NtOpenKeyFunc>(GetThrowingErrorReporter(), "NtOpenKey");
-static NtCreateKeyFunc PNtCreateKey =
-    GetNtDll().GetProcAddress<NtCreateKeyFunc>(GetThrowingErrorReporter(), "NtCreateKey");
-static NtCloseFunc PNtClose = GetNtDll().GetProcAddress<NtCloseFunc>(GetThrowingErrorReporter(), "NtClose");
-static NtDeleteKeyFunc PNtDeleteKey =
-    GetNtDll().GetProcAddress<NtCloseFunc>(GetThrowingErrorReporter(), "NtDeleteKey");
-static NtQueryKeyFunc PNtQueryKey =
-    GetNtDll().GetProcAddress<NtQueryKeyFunc>(GetThrowingErrorReporter(), "NtQueryKey");
-static NtEnumerateKeyFunc PNtEnumerateKey =
-    GetNtDll().GetProcAddress<NtEnumerateKeyFunc>(GetThrowingErrorReporter(), "NtEnumerateKey");
-static NtEnumerateValueKeyFunc PNtEnumerateValueKeyFunc =
-    GetNtDll().GetProcAddress<NtEnumerateValueKeyFunc>(GetThrowingErrorReporter(), "NtEnumerateValueKey");
-static NtQueryValueKeyFunc PNtQueryValueKeyFunc =
-    GetNtDll().GetProcAddress<NtQueryValueKeyFunc>(GetThrowingErrorReporter(), "NtQueryValueKey");
-static NtSetValueKeyFunc PNtSetValueKeyFunc =
-    GetNtDll().GetProcAddress<NtSetValueKeyFunc>(GetThrowingErrorReporter(), "NtSetValueKey");
-
 RegistryKey::~RegistryKey()
 {
     this->Close();
@@ -54,9 +40,29 @@ void RegistryKey::Close()
 {
     if (hKey_ != INVALID_HANDLE_VALUE)
     {
-        PNtClose(hKey_);
+        if (owned_)
+        {
+            backend_->Close(hKey_);
+        }
+
         hKey_ = INVALID_HANDLE_VALUE;
     }
+
+    lease_.reset();
+}
+
+RegistryKey RegistryKey::Borrow(std::shared_ptr<void> const& hKey,
+                                IRegistryBackend& backend)
+{
+    RegistryKey result(hKey.get(), backend);
+    result.owned_ = false;
+    result.lease_ = hKey;
+    return result;
+}
+
+bool RegistryKey::OwnsHandle() const
+{
+    return owned_;
 }
 
 HANDLE RegistryKey::GetHkey() const
@@ -64,17 +70,38 @@ HANDLE RegistryKey::GetHkey() const
     return hKey_;
 }
 
+IRegistryBackend& RegistryKey::GetBackend() const
+{
+    return *backend_;
+}
+
 RegistryKey::RegistryKey(HANDLE hKey)
+    : hKey_(hKey)
+    , backend_(&GetRegistryBackend())
+    , owned_(true)
+{
+}
+
+RegistryKey::RegistryKey(HANDLE hKey, IRegistryBackend& backend)
+    : hKey_(hKey)
+    , backend_(&backend)
+    , owned_(true)
 {
-    hKey_ = hKey;
 }
 
-RegistryKey::RegistryKey(RegistryKey&& other) : hKey_(other.hKey_)
+RegistryKey::RegistryKey(RegistryKey&& other)
+    : hKey_(other.hKey_)
+    , backend_(other.backend_)
+    , owned_(other.owned_)
+    , lease_(std::move(other.lease_))
 {
     other.hKey_ = INVALID_HANDLE_VALUE;
 }
 
-RegistryKey::RegistryKey() : hKey_(INVALID_HANDLE_VALUE)
+RegistryKey::RegistryKey()
+    : hKey_(INVALID_HANDLE_VALUE)
+    , backend_(&GetRegistryBackend())
+    , owned_(true)
 {
 }
 
@@ -83,21 +110,29 @@ RegistryValue const RegistryKey::operator[](std::string const& name) const
     return GetValue(name);
 }
 
-RegistryValue const RegistryKey::GetValue(std::string const& name) const
+// Created once so that TryGetValue misses share one exception object instead
+// of allocating a new one per lookup.
+static std::exception_ptr const valueNotFound =
+    Win32Exception::FromWinError(ERROR_FILE_NOT_FOUND);
+
+static NTSTATUS QueryValue(IRegistryBackend& backend,
+                           HANDLE hKey,
+                           std::string const& name,
+                           std::vector<unsigned char>& buff)
 {
     std::wstring wideName(utf8::ToUtf16(name));
-    UNICODE_STRING valueName(WstringToUnicodeString(wideName));
-    std::vector<unsigned char> buff(MAX_PATH);
+    buff.resize(MAX_PATH);
     NTSTATUS errorCheck;
     do
     {
-        ULONG resultLength = 0;
-        errorCheck = PNtQueryValueKeyFunc(hKey_,
-                                          &valueName,
-                                          KeyValuePartialInformation,
-                                          buff.data(),
-                                          static_cast<ULONG>(buff.size()),
-                                          &resultLength);
+        std::uint32_t resultLength = 0;
+        errorCheck = backend.QueryValueKey(hKey,
+                                           wideName.data(),
+                                           wideName.size(),
+                                           KeyValuePartialInformation,
+                                           buff.data(),
+                                           static_cast<ULONG>(buff.size()),
+                                           &resultLength);
         if ((errorCheck == STATUS_BUFFER_TOO_SMALL ||
              errorCheck == STATUS_BUFFER_OVERFLOW) &&
             resultLength != 0)
@@ -106,10 +141,11 @@ RegistryValue const RegistryKey::GetValue(std::string const& name) const
         }
     } while (errorCheck == STATUS_BUFFER_TOO_SMALL ||
              errorCheck == STATUS_BUFFER_OVERFLOW);
-    if (!NT_SUCCESS(errorCheck))
-    {
-        Win32Exception::ThrowFromNtError(errorCheck);
-    }
+    return errorCheck;
+}
+
+static RegistryValue ValueFromPartialInformation(std::vector<unsigned char>& buff)
+{
     auto partialInfo =
         reinterpret_cast<KEY_VALUE_PARTIAL_INFORMATION const*>(buff.data());
     DWORD type = partialInfo->Type;
@@ -119,6 +155,34 @@ RegistryValue const RegistryKey::GetValue(std::string const& name) const
     return RegistryValue(type, std::move(buff));
 }
 
+RegistryValue const RegistryKey::GetValue(std::string const& name) const
+{
+    std::vector<unsigned char> buff;
+    NTSTATUS errorCheck = QueryValue(*backend_, hKey_, name, buff);
+    if (!NT_SUCCESS(errorCheck))
+    {
+        Win32Exception::ThrowFromNtError(errorCheck);
+    }
+    return ValueFromPartialInformation(buff);
+}
+
+expected<RegistryValue> RegistryKey::TryGetValue(std::string const& name) const
+{
+    std::vector<unsigned char> buff;
+    NTSTATUS errorCheck = QueryValue(*backend_, hKey_, name, buff);
+    if (NT_SUCCESS(errorCheck))
+    {
+        return ValueFromPartialInformation(buff);
+    }
+
+    if (errorCheck == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        return expected<RegistryValue>::from_exception(valueNotFound);
+    }
+
+    Win32Exception::ThrowFromNtError(errorCheck);
+}
+
 void RegistryKey::SetValue(std::string const& name,
                            std::size_t dataSize,
                            void const* data,
@@ -130,10 +194,9 @@ void RegistryKey::SetValue(std::string const& name,
     }
 
     std::wstring wideName(utf8::ToUtf16(name));
-    UNICODE_STRING valueName(WstringToUnicodeString(wideName));
     auto clippedSize = static_cast<ULONG>(dataSize);
-    NTSTATUS status = PNtSetValueKeyFunc(
-        hKey_, &valueName, 0, type, const_cast<PVOID>(data), clippedSize);
+    NTSTATUS status = backend_->SetValueKey(
+        hKey_, wideName.data(), wideName.size(), type, data, clippedSize);
     if (!NT_SUCCESS(status))
     {
         Win32Exception::ThrowFromNtError(status);
@@ -151,39 +214,61 @@ void RegistryKey::SetValue(std::string const& name,
         type);
 }
 
-static RegistryKey
-RegistryKeyOpen(HANDLE hRoot, UNICODE_STRING& key, REGSAM samDesired)
+static NTSTATUS OpenKeyHandle(IRegistryBackend& backend,
+                              HANDLE hRoot,
+                              wchar_t const* key,
+                              std::size_t keyLength,
+                              REGSAM samDesired,
+                              HANDLE& hOpened)
+{
+    NTSTATUS errorCheck =
+        backend.OpenKey(&hOpened, samDesired, hRoot, key, keyLength);
+    if (!NT_SUCCESS(errorCheck))
+    {
+        hOpened = INVALID_HANDLE_VALUE;
+    }
+
+    return errorCheck;
+}
+
+static RegistryKey RegistryKeyOpen(IRegistryBackend& backend,
+                                   HANDLE hRoot,
+                                   wchar_t const* key,
+                                   std::size_t keyLength,
+                                   REGSAM samDesired)
 {
     HANDLE hOpened;
-    OBJECT_ATTRIBUTES attribs;
-    attribs.Length = sizeof(attribs);
-    attribs.RootDirectory = hRoot;
-    attribs.ObjectName = &key;
-    attribs.Attributes = OBJ_CASE_INSENSITIVE;
-    attribs.SecurityDescriptor = NULL;
-    attribs.SecurityQualityOfService = NULL;
-    NTSTATUS errorCheck = PNtOpenKey(&hOpened, samDesired, &attribs);
+    NTSTATUS errorCheck =
+        OpenKeyHandle(backend, hRoot, key, keyLength, samDesired, hOpened);
     if (!NT_SUCCESS(errorCheck))
     {
         ::SetLastError(errorCheck);
-        hOpened = INVALID_HANDLE_VALUE;
     }
-    return RegistryKey(hOpened);
+    return RegistryKey(hOpened, backend);
 }
 
-static RegistryKey
-RegistryKeyOpen(HANDLE hRoot, std::string const& key, REGSAM samDesired)
+static RegistryKey RegistryKeyOpen(IRegistryBackend& backend,
+                                   HANDLE hRoot,
+                                   std::string const& key,
+                                   REGSAM samDesired)
 {
     std::wstring wideKey(utf8::ToUtf16(key));
-    UNICODE_STRING ustrKey = WstringToUnicodeString(wideKey);
-    return RegistryKeyOpen(hRoot, ustrKey, samDesired);
+    return RegistryKeyOpen(
+        backend, hRoot, wideKey.data(), wideKey.size(), samDesired);
 }
 
 RegistryKey RegistryKey::Open(
     std::string const& key,
     REGSAM samDesired /*= KEY_QUERY_VALUE | KEY_ENUMERATE_SUBKEYS*/)
 {
-    return RegistryKeyOpen(0, key, samDesired);
+    IRegistryBackend& backend = GetRegistryBackend();
+    RegistryHandleCache* cache = RegistryHandleCache::GetActive();
+    if (cache != nullptr && &cache->GetBackend() == &backend)
+    {
+        return cache->Open(key, samDesired);
+    }
+
+    return RegistryKeyOpen(backend, 0, key, samDesired);
 }
 
 RegistryKey RegistryKey::Open(
@@ -191,7 +276,8 @@ RegistryKey RegistryKey::Open(
     std::string const& key,
     REGSAM samDesired /*= KEY_QUERY_VALUE | KEY_ENUMERATE_SUBKEYS*/)
 {
-    return RegistryKeyOpen(parent.GetHkey(), key, samDesired);
+    return RegistryKeyOpen(
+        parent.GetBackend(), parent.GetHkey(), key, samDesired);
 }
 
 RegistryKey RegistryKey::Open(
@@ -199,32 +285,29 @@ RegistryKey RegistryKey::Open(
     UNICODE_STRING& key,
     REGSAM samDesired /*= KEY_QUERY_VALUE | KEY_ENUMERATE_SUBKEYS*/)
 {
-    return RegistryKeyOpen(parent.GetHkey(), key, samDesired);
+    return RegistryKeyOpen(parent.GetBackend(),
+                           parent.GetHkey(),
+                           key.Buffer,
+                           key.Length / sizeof(wchar_t),
+                           samDesired);
 }
 
-static RegistryKey RegistryKeyCreate(HANDLE hRoot,
+static RegistryKey RegistryKeyCreate(IRegistryBackend& backend,
+                                     HANDLE hRoot,
                                      std::string const& key,
                                      REGSAM samDesired,
                                      DWORD options)
 {
     HANDLE hOpened;
-    OBJECT_ATTRIBUTES attribs;
     std::wstring wideKey(utf8::ToUtf16(key));
-    UNICODE_STRING ustrKey = WstringToUnicodeString(wideKey);
-    attribs.Length = sizeof(attribs);
-    attribs.RootDirectory = hRoot;
-    attribs.ObjectName = &ustrKey;
-    attribs.Attributes = OBJ_CASE_INSENSITIVE;
-    attribs.SecurityDescriptor = NULL;
-    attribs.SecurityQualityOfService = NULL;
-    NTSTATUS errorCheck =
-        PNtCreateKey(&hOpened, samDesired, &attribs, NULL, NULL, options, NULL);
+    NTSTATUS errorCheck = backend.CreateKey(
+        &hOpened, samDesired, hRoot, wideKey.data(), wideKey.size(), options);
     if (!NT_SUCCESS(errorCheck))
     {
         ::SetLastError(errorCheck);
         hOpened = INVALID_HANDLE_VALUE;
     }
-    return RegistryKey(hOpened);
+    return RegistryKey(hOpened, backend);
 }
 
 RegistryKey RegistryKey::Create(
@@ -232,7 +315,13 @@ RegistryKey RegistryKey::Create(
     REGSAM samDesired /*= KEY_QUERY_VALUE | KEY_ENUMERATE_SUBKEYS*/,
     DWORD options /*= REG_OPTION_NON_VOLATILE */)
 {
-    return RegistryKeyCreate(0, key, samDesired, options);
+    RegistryHandleCache* cache = RegistryHandleCache::GetActive();
+    if (cache != nullptr)
+    {
+        cache->Clear();
+    }
+
+    return RegistryKeyCreate(GetRegistryBackend(), 0, key, samDesired, options);
 }
 
 RegistryKey RegistryKey::Create(
@@ -241,12 +330,25 @@ RegistryKey RegistryKey::Create(
     REGSAM samDesired /*= KEY_QUERY_VALUE | KEY_ENUMERATE_SUBKEYS*/,
     DWORD options /*= REG_OPTION_NON_VOLATILE */)
 {
-    return RegistryKeyCreate(parent.GetHkey(), key, samDesired, options);
+    RegistryHandleCache* cache = RegistryHandleCache::GetActive();
+    if (cache != nullptr)
+    {
+        cache->Clear();
+    }
+
+    return RegistryKeyCreate(
+        parent.GetBackend(), parent.GetHkey(), key, samDesired, options);
 }
 
 void RegistryKey::Delete()
 {
-    NTSTATUS errorCheck = PNtDeleteKey(GetHkey());
+    RegistryHandleCache* cache = RegistryHandleCache::GetActive();
+    if (cache != nullptr)
+    {
+        cache->Clear();
+    }
+
+    NTSTATUS errorCheck = backend_->DeleteKey(GetHkey());
     if (!NT_SUCCESS(errorCheck))
     {
         Win32Exception::ThrowFromNtError(errorCheck);
@@ -260,8 +362,8 @@ RegistryKeySizeInformation RegistryKey::GetSizeInformation() const
     auto keyFullInformation =
         reinterpret_cast<KEY_FULL_INFORMATION const*>(&buffer[0]);
     auto bufferPtr = reinterpret_cast<void*>(&buffer[0]);
-    ULONG resultLength = 0;
-    NTSTATUS errorCheck = PNtQueryKey(
+    std::uint32_t resultLength = 0;
+    NTSTATUS errorCheck = backend_->QueryKey(
         GetHkey(), KeyFullInformation, bufferPtr, buffSize, &resultLength);
     if (!NT_SUCCESS(errorCheck))
     {
@@ -280,8 +382,8 @@ std::string RegistryKey::GetName() const
     auto keyBasicInformation =
         reinterpret_cast<KEY_NAME_INFORMATION const*>(&buffer[0]);
     auto bufferPtr = reinterpret_cast<void*>(&buffer[0]);
-    ULONG resultLength = 0;
-    NTSTATUS errorCheck = PNtQueryKey(
+    std::uint32_t resultLength = 0;
+    NTSTATUS errorCheck = backend_->QueryKey(
         GetHkey(), KeyNameInformation, bufferPtr, buffSize, &resultLength);
     if (!NT_SUCCESS(errorCheck))
     {
@@ -311,18 +413,18 @@ std::vector<std::string> RegistryKey::EnumerateSubKeyNames() const
     std::vector<std::string> subkeys;
     NTSTATUS errorCheck;
     ULONG index = 0;
-    ULONG resultLength = 0;
+    std::uint32_t resultLength = 0;
     unsigned char buff[bufferLength];
     auto basicInformation =
         reinterpret_cast<KEY_BASIC_INFORMATION const*>(buff);
     for (;;)
     {
-        errorCheck = PNtEnumerateKey(GetHkey(),
-                                     index++,
-                                     KeyBasicInformation,
-                                     buff,
-                                     bufferLength,
-                                     &resultLength);
+        errorCheck = backend_->EnumerateKey(GetHkey(),
+                                            index++,
+                                            KeyBasicInformation,
+                                            buff,
+                                            bufferLength,
+                                            &resultLength);
         if (!NT_SUCCESS(errorCheck))
         {
             break;
@@ -337,9 +439,128 @@ std::vector<std::string> RegistryKey::EnumerateSubKeyNames() const
     return subkeys;
 }
 
+bool RegistryKey::EnumerateSubKeyName(std::uint32_t index,
+                                      std::vector<unsigned char>& buffer,
+                                      UNICODE_STRING& name) const
+{
+    this->Check();
+
+    if (buffer.size() < sizeof(KEY_BASIC_INFORMATION) + 256 * sizeof(wchar_t))
+    {
+        // Large enough for any key name the kernel accepts.
+        buffer.resize(sizeof(KEY_BASIC_INFORMATION) + 256 * sizeof(wchar_t));
+    }
+
+    NTSTATUS errorCheck;
+    for (;;)
+    {
+        std::uint32_t resultLength = 0;
+        errorCheck = backend_->EnumerateKey(GetHkey(),
+                                            index,
+                                            KeyBasicInformation,
+                                            buffer.data(),
+                                            static_cast<ULONG>(buffer.size()),
+                                            &resultLength);
+        if (errorCheck != STATUS_BUFFER_OVERFLOW &&
+            errorCheck != STATUS_BUFFER_TOO_SMALL)
+        {
+            break;
+        }
+
+        buffer.resize(resultLength);
+    }
+
+    if (errorCheck == STATUS_NO_MORE_ENTRIES)
+    {
+        return false;
+    }
+
+    if (!NT_SUCCESS(errorCheck))
+    {
+        Win32Exception::ThrowFromNtError(errorCheck);
+    }
+
+    auto basicInformation =
+        reinterpret_cast<KEY_BASIC_INFORMATION*>(buffer.data());
+    name.Buffer = basicInformation->Name;
+    name.Length = static_cast<USHORT>(basicInformation->NameLength);
+    name.MaximumLength = name.Length;
+    return true;
+}
+
+static bool HasAnyValue(IRegistryBackend& backend,
+                        HANDLE hKey,
+                        std::vector<std::wstring>& valueNames)
+{
+    for (std::wstring& valueName : valueNames)
+    {
+        // A zero length query reports whether the value exists without
+        // copying its data.
+        std::uint32_t resultLength = 0;
+        NTSTATUS errorCheck = backend.QueryValueKey(hKey,
+                                                    valueName.data(),
+                                                    valueName.size(),
+                                                    KeyValuePartialInformation,
+                                                    nullptr,
+                                                    0,
+                                                    &resultLength);
+        if (NT_SUCCESS(errorCheck) || errorCheck == STATUS_BUFFER_TOO_SMALL ||
+            errorCheck == STATUS_BUFFER_OVERFLOW)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RegistryKey::ForEachSubKey(
+    std::vector<std::string> const& predicateValueNames,
+    std::function<void(std::string const&, RegistryKey const&)> const&
+        callback,
+    REGSAM samDesired /* = KEY_QUERY_VALUE */) const
+{
+    std::vector<std::wstring> wideValueNames;
+    wideValueNames.reserve(predicateValueNames.size());
+    for (std::string const& valueName : predicateValueNames)
+    {
+        wideValueNames.emplace_back(utf8::ToUtf16(valueName));
+    }
+
+    if (!wideValueNames.empty())
+    {
+        samDesired |= KEY_QUERY_VALUE;
+    }
+
+    std::vector<unsigned char> nameBuffer;
+    UNICODE_STRING name;
+    for (std::uint32_t index = 0;
+         EnumerateSubKeyName(index, nameBuffer, name);
+         ++index)
+    {
+        RegistryKey subKey(Open(*this, name, samDesired));
+        if (subKey.Invalid())
+        {
+            continue;
+        }
+
+        if (!wideValueNames.empty() &&
+            !HasAnyValue(*backend_, subKey.GetHkey(), wideValueNames))
+        {
+            continue;
+        }
+
+        callback(utf8::ToUtf8(name.Buffer, name.Length / sizeof(wchar_t)),
+                 subKey);
+    }
+}
+
 RegistryKey& RegistryKey::operator=(RegistryKey other)
 {
     std::swap(hKey_, other.hKey_);
+    std::swap(backend_, other.backend_);
+    std::swap(owned_, other.owned_);
+    std::swap(lease_, other.lease_);
     return *this;
 }
 
@@ -380,13 +601,14 @@ std::vector<std::string> RegistryKey::EnumerateValueNames() const
         reinterpret_cast<KEY_VALUE_BASIC_INFORMATION*>(&buff);
     for (;;)
     {
-        ULONG resultLength;
-        NTSTATUS errorCheck = PNtEnumerateValueKeyFunc(hKey_,
-                                                       index++,
-                                                       KeyValueBasicInformation,
-                                                       basicValueInformation,
-                                                       valueNameStructSize,
-                                                       &resultLength);
+        std::uint32_t resultLength;
+        NTSTATUS errorCheck =
+            backend_->EnumerateValueKey(hKey_,
+                                        index++,
+                                        KeyValueBasicInformation,
+                                        basicValueInformation,
+                                        valueNameStructSize,
+                                        &resultLength);
         if (NT_SUCCESS(errorCheck))
         {
             result.emplace_back(utf8::ToUtf8(
@@ -412,17 +634,17 @@ std::vector<RegistryValueAndData> RegistryKey::EnumerateValues() const
     NTSTATUS errorCheck = 0;
     for (ULONG index = 0; NT_SUCCESS(errorCheck); ++index)
     {
-        ULONG elementSize = 260; // MAX_PATH
+        std::uint32_t elementSize = 260; // MAX_PATH
         do
         {
             buff.resize(elementSize);
             errorCheck =
-                PNtEnumerateValueKeyFunc(hKey_,
-                                         index,
-                                         KeyValueFullInformation,
-                                         buff.data(),
-                                         static_cast<ULONG>(buff.size()),
-                                         &elementSize);
+                backend_->EnumerateValueKey(hKey_,
+                                            index,
+                                            KeyValueFullInformation,
+                                            buff.data(),
+                                            static_cast<ULONG>(buff.size()),
+                                            &elementSize);
         } while (errorCheck == STATUS_BUFFER_OVERFLOW ||
                  errorCheck == STATUS_BUFFER_TOO_SMALL);
         if (NT_SUCCESS(errorCheck))
@@ -437,6 +659,61 @@ std::vector<RegistryValueAndData> RegistryKey::EnumerateValues() const
     return result;
 }
 
+void RegistryKey::EnumerateValues(RegistryValueArena& arena) const
+{
+    std::size_t const recordAlignment =
+        std::alignment_of<KEY_VALUE_FULL_INFORMATION>::value;
+    arena.clear();
+    if (arena.buffer_.empty())
+    {
+        arena.buffer_.resize(4096);
+    }
+    NTSTATUS errorCheck = 0;
+    for (ULONG index = 0; NT_SUCCESS(errorCheck); ++index)
+    {
+        std::uint32_t elementSize = 0;
+        for (;;)
+        {
+            errorCheck = backend_->EnumerateValueKey(
+                hKey_,
+                index,
+                KeyValueFullInformation,
+                arena.buffer_.data() + arena.used_,
+                static_cast<ULONG>(arena.buffer_.size() - arena.used_),
+                &elementSize);
+            if (errorCheck != STATUS_BUFFER_OVERFLOW &&
+                errorCheck != STATUS_BUFFER_TOO_SMALL)
+            {
+                break;
+            }
+            arena.buffer_.resize(
+                (std::max)(arena.buffer_.size() * 2,
+                           arena.used_ + elementSize + recordAlignment));
+        }
+        if (NT_SUCCESS(errorCheck))
+        {
+            arena.offsets_.push_back(arena.used_);
+            arena.used_ += (elementSize + recordAlignment - 1) &
+                           ~(recordAlignment - 1);
+        }
+    }
+    if (errorCheck != STATUS_NO_MORE_ENTRIES)
+    {
+        arena.clear();
+        Win32Exception::ThrowFromNtError(errorCheck);
+    }
+
+    // The buffer may move while it grows, so views are only created once
+    // every record is in place.
+    arena.views_.reserve(arena.offsets_.size());
+    for (std::size_t offset : arena.offsets_)
+    {
+        arena.views_.emplace_back(
+            reinterpret_cast<KEY_VALUE_FULL_INFORMATION const*>(
+                arena.buffer_.data() + offset));
+    }
+}
+
 void RegistryKey::Check() const
 {
     if (Invalid())
@@ -445,6 +722,163 @@ void RegistryKey::Check() const
     }
 }
 
+// Upper bound on the number of handles a cache keeps open. Past this, keys
+// are still opened relative to cached ancestors, but are not remembered.
+static std::size_t const maximumCachedHandles = 8192;
+
+// Read by worker threads while the thread running the script installs and
+// removes caches.
+static std::atomic<RegistryHandleCache*> activeCache(nullptr);
+
+// Shares a handle the cache opened; it is closed once neither the cache nor
+// any key handed out refers to it.
+static std::shared_ptr<void> ShareHandle(HANDLE hKey, IRegistryBackend& backend)
+{
+    IRegistryBackend* const owner = &backend;
+    return std::shared_ptr<void>(
+        hKey, [owner](HANDLE handle) { owner->Close(handle); });
+}
+
+RegistryHandleCache::RegistryHandleCache()
+    : backend_(&GetRegistryBackend())
+    , previous_(activeCache.load())
+    , opensSaved_(0)
+    , relativeOpens_(0)
+{
+    activeCache.store(this);
+}
+
+RegistryHandleCache::~RegistryHandleCache()
+{
+    activeCache.store(previous_);
+}
+
+RegistryKey RegistryHandleCache::Open(std::string const& key,
+                                      REGSAM samDesired)
+{
+    std::string normalized(
+        boost::algorithm::to_upper_copy(key, std::locale::classic()));
+
+    // The parent is shared for the duration of the open, in case the cache
+    // is cleared meanwhile.
+    std::shared_ptr<void> parent;
+    std::size_t parentLength = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        auto exact = entries_.find(std::make_pair(normalized, samDesired));
+        if (exact != entries_.end())
+        {
+            ++opensSaved_;
+            if (!exact->second.hKey)
+            {
+                ::SetLastError(exact->second.status);
+                return RegistryKey();
+            }
+
+            return RegistryKey::Borrow(exact->second.hKey, *backend_);
+        }
+
+        // Only parents opened with the same access are used; a relative open
+        // otherwise inherits the parent's WOW64 view.
+        for (std::size_t separator = normalized.find_last_of('\\');
+             separator != std::string::npos && separator != 0;
+             separator = normalized.find_last_of('\\', separator - 1))
+        {
+            auto cached = parents_.find(
+                std::make_pair(normalized.substr(0, separator), samDesired));
+            if (cached != parents_.end())
+            {
+                parent = cached->second;
+                parentLength = separator + 1;
+                break;
+            }
+        }
+    }
+
+    std::wstring wideKey(utf8::ToUtf16(key.substr(parentLength)));
+    HANDLE hOpened;
+    NTSTATUS status = OpenKeyHandle(*backend_,
+                                    static_cast<HANDLE>(parent.get()),
+                                    wideKey.data(),
+                                    wideKey.size(),
+                                    samDesired,
+                                    hOpened);
+    parent.reset();
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (parentLength != 0)
+    {
+        ++relativeOpens_;
+    }
+
+    if (entries_.size() < maximumCachedHandles)
+    {
+        Entry entry;
+        if (hOpened != INVALID_HANDLE_VALUE)
+        {
+            entry.hKey = ShareHandle(hOpened, *backend_);
+        }
+
+        entry.status = status;
+        auto inserted = entries_.insert(
+            std::make_pair(std::make_pair(normalized, samDesired), entry));
+        if (entry.hKey)
+        {
+            if (inserted.second)
+            {
+                parents_.insert(std::make_pair(
+                    std::make_pair(normalized, samDesired), entry.hKey));
+            }
+
+            // If another thread cached this path first, the key handed out
+            // is the only one sharing the handle opened here.
+            return RegistryKey::Borrow(entry.hKey, *backend_);
+        }
+    }
+
+    if (hOpened == INVALID_HANDLE_VALUE)
+    {
+        ::SetLastError(status);
+    }
+
+    return RegistryKey(hOpened, *backend_);
+}
+
+void RegistryHandleCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    entries_.clear();
+    parents_.clear();
+}
+
+std::size_t RegistryHandleCache::GetOpensSaved() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return opensSaved_;
+}
+
+std::size_t RegistryHandleCache::GetRelativeOpens() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return relativeOpens_;
+}
+
+std::size_t RegistryHandleCache::size() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return entries_.size();
+}
+
+IRegistryBackend& RegistryHandleCache::GetBackend() const
+{
+    return *backend_;
+}
+
+RegistryHandleCache* RegistryHandleCache::GetActive()
+{
+    return activeCache.load();
+}
+
 RegistryKeySizeInformation::RegistryKeySizeInformation( std::uint64_t lastWriteTime, std::uint32_t numberOfSubkeys, std::uint32_t numberOfValues ) : lastWriteTime_(lastWriteTime)
         , numberOfSubkeys_(numberOfSubkeys)
         , numberOfValues_(numberOfValues)
@@ -553,6 +987,100 @@ std::size_t RegistryValueAndData::size() const
     return Cast()->DataLength;
 }
 
+RegistryValueView::RegistryValueView(KEY_VALUE_FULL_INFORMATION const* info)
+    : info_(info)
+{
+}
+
+wchar_t const* RegistryValueView::GetNameData() const
+{
+    return info_->Name;
+}
+
+std::size_t RegistryValueView::GetNameLength() const
+{
+    return info_->NameLength / sizeof(wchar_t);
+}
+
+boost::wstring_ref RegistryValueView::GetNameView() const
+{
+    return boost::wstring_ref(GetNameData(), GetNameLength());
+}
+
+std::string RegistryValueView::GetName() const
+{
+    return utf8::ToUtf8(GetNameData(), GetNameLength());
+}
+
+DWORD RegistryValueView::GetType() const
+{
+    return info_->Type;
+}
+
+std::size_t RegistryValueView::size() const
+{
+    return info_->DataLength;
+}
+
+unsigned char const* RegistryValueView::cbegin() const
+{
+    return reinterpret_cast<unsigned char const*>(info_) + info_->DataOffset;
+}
+
+unsigned char const* RegistryValueView::cend() const
+{
+    return cbegin() + info_->DataLength;
+}
+
+bool RegistryValueView::operator<(RegistryValueView const& rhs) const
+{
+    return std::lexicographical_compare(GetNameData(),
+                                        GetNameData() + GetNameLength(),
+                                        rhs.GetNameData(),
+                                        rhs.GetNameData() + rhs.GetNameLength());
+}
+
+RegistryValueArena::RegistryValueArena() : used_(0)
+{
+}
+
+void RegistryValueArena::clear()
+{
+    offsets_.clear();
+    views_.clear();
+    used_ = 0;
+}
+
+std::size_t RegistryValueArena::size() const
+{
+    return views_.size();
+}
+
+bool RegistryValueArena::empty() const
+{
+    return views_.empty();
+}
+
+std::size_t RegistryValueArena::capacity() const
+{
+    return buffer_.size();
+}
+
+RegistryValueView const& RegistryValueArena::operator[](std::size_t index) const
+{
+    return views_[index];
+}
+
+RegistryValueArena::const_iterator RegistryValueArena::begin() const
+{
+    return views_.begin();
+}
+
+RegistryValueArena::const_iterator RegistryValueArena::end() const
+{
+    return views_.end();
+}
+
 static std::uint32_t BytestreamToDword(unsigned char const* first,
                                        unsigned char const* last)
 {
@@ -722,107 +1250,247 @@ std::uint64_t BasicRegistryValue::GetQWordStrict() const
     return GetQWord();
 }
 
-std::string BasicRegistryValue::GetString() const
+namespace
 {
-    std::string result;
-    switch (GetType())
+
+// Rendered text is gathered here and handed to the sink in large pieces.
+class RegistryValueWriter : boost::noncopyable
+{
+    log_sink& target_;
+    std::size_t used_;
+    char buffer_[4096];
+
+    public:
+    typedef char value_type;
+
+    static std::size_t const capacity = sizeof(buffer_);
+
+    explicit RegistryValueWriter(log_sink& target) : target_(target), used_(0)
+    {
+    }
+
+    // Gets room for at least length characters, which must not exceed
+    // capacity.
+    char* Reserve(std::size_t length)
+    {
+        if (capacity - used_ < length)
+        {
+            Flush();
+        }
+
+        return buffer_ + used_;
+    }
+
+    void Commit(std::size_t length)
+    {
+        used_ += length;
+    }
+
+    void Append(char const* data, std::size_t length)
+    {
+        std::memcpy(Reserve(length), data, length);
+        Commit(length);
+    }
+
+    void push_back(char character)
+    {
+        *Reserve(1) = character;
+        Commit(1);
+    }
+
+    void Flush()
+    {
+        if (used_ != 0)
+        {
+            target_.append(buffer_, used_);
+            used_ = 0;
+        }
+    }
+};
+
+// For each byte, its two hex digits followed by a comma, and the comma
+// followed by its two hex digits. Entries are four characters wide so that
+// each can be stored with a single unaligned copy.
+struct HexTable
+{
+    char digitsThenComma[256][4];
+    char commaThenDigits[256][4];
+
+    HexTable()
+    {
+        static char const chars[] = "0123456789ABCDEF";
+        for (std::size_t idx = 0; idx < 256; ++idx)
+        {
+            char const high = chars[idx >> 4];
+            char const low = chars[idx & 0x0F];
+            digitsThenComma[idx][0] = high;
+            digitsThenComma[idx][1] = low;
+            digitsThenComma[idx][2] = ',';
+            digitsThenComma[idx][3] = '\0';
+            commaThenDigits[idx][0] = ',';
+            commaThenDigits[idx][1] = high;
+            commaThenDigits[idx][2] = low;
+            commaThenDigits[idx][3] = '\0';
+        }
+    }
+};
+
+// Adapts a std::string to the log_sink interface so that GetString and
+// AppendString share write_registry_value's rendering.
+class StringAppendSink final : public log_sink
+{
+    std::string& target_;
+
+    public:
+    explicit StringAppendSink(std::string& target) : target_(target)
+    {
+    }
+
+    virtual void append(char const* data, std::size_t dataLength)
+    {
+        target_.append(data, dataLength);
+    }
+};
+}
+
+static HexTable const hexTable;
+
+// Writes bytes as comma separated hex pairs, as in a .reg file.
+static void WriteHexBytes(RegistryValueWriter& writer,
+                          unsigned char const* first,
+                          unsigned char const* last)
+{
+    if (first == last)
+    {
+        return;
+    }
+
+    std::memcpy(writer.Reserve(4), hexTable.digitsThenComma[*first], 4);
+    writer.Commit(2);
+    ++first;
+
+    // Each byte takes three characters; the fourth character copied with
+    // each entry is overwritten by the next one, so one character of slack
+    // is kept at the end of each block.
+    std::size_t const blockBytes = (RegistryValueWriter::capacity - 1) / 3;
+    while (first != last)
+    {
+        std::size_t const count =
+            (std::min)(blockBytes, static_cast<std::size_t>(last - first));
+        char* out = writer.Reserve(count * 3 + 1);
+        for (unsigned char const* const blockEnd = first + count;
+             first != blockEnd;
+             ++first)
+        {
+            std::memcpy(out, hexTable.commaThenDigits[*first], 4);
+            out += 3;
+        }
+
+        writer.Commit(count * 3);
+    }
+}
+
+// Writes bytes as one run of hex digits, most significant byte first.
+static void WriteHexNumber(RegistryValueWriter& writer,
+                           unsigned char const* first,
+                           std::size_t length,
+                           bool littleEndian)
+{
+    char* out = writer.Reserve(length * 2 + 2);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        unsigned char const current =
+            littleEndian ? first[length - idx - 1] : first[idx];
+        std::memcpy(out + idx * 2, hexTable.digitsThenComma[current], 4);
+    }
+
+    writer.Commit(length * 2);
+}
+
+void write_registry_value(log_sink& target, BasicRegistryValue const& value)
+{
+    RegistryValueWriter writer(target);
+    DWORD const type = value.GetType();
+    switch (type)
     {
     case REG_SZ:
     case REG_EXPAND_SZ:
-        if (empty())
+    {
+        if (value.empty())
         {
             break;
         }
 
-        if (*(wcend() - 1) == L'\0')
-        {
-            result = utf8::ToUtf8(wcbegin(), wcend() - 1);
-        }
-        else
+        wchar_t const* end = value.wcend();
+        if (*(end - 1) == L'\0')
         {
-            result = utf8::ToUtf8(wcbegin(), wcend());
+            --end;
         }
 
+        utf8::utf16to8(value.wcbegin(), end, std::back_inserter(writer));
         break;
+    }
     case REG_DWORD:
-        if (size() != 4)
+        if (value.size() != 4)
         {
             throw InvalidRegistryDataTypeException();
         }
-        result.reserve(14);
-        result.assign("dword:");
-        {
-            auto it = cbegin() + 3;
-            auto itEnd = cbegin() - 1;
-            for (; it != itEnd; --it)
-            {
-                HexCharacter(*it, result);
-            }
-        }
+        writer.Append("dword:", 6);
+        WriteHexNumber(writer, value.cbegin(), 4, true);
         break;
     case REG_QWORD:
-        if (size() != 8)
+        if (value.size() != 8)
         {
             throw InvalidRegistryDataTypeException();
         }
-        result.reserve(22);
-        result.assign("qword:");
-        {
-            auto it = cbegin() + 7;
-            auto itEnd = cbegin() - 1;
-            for (; it != itEnd; --it)
-            {
-                HexCharacter(*it, result);
-            }
-        }
+        writer.Append("qword:", 6);
+        WriteHexNumber(writer, value.cbegin(), 8, true);
         break;
     case REG_DWORD_BIG_ENDIAN:
-        if (size() != 4)
+        if (value.size() != 4)
         {
             throw InvalidRegistryDataTypeException();
         }
-        result.reserve(17);
-        result.assign("dword-be:");
-        {
-            auto it = cbegin();
-            auto itEnd = cbegin() + 4;
-            for (; it != itEnd; ++it)
-            {
-                HexCharacter(*it, result);
-            }
-        }
+        writer.Append("dword-be:", 9);
+        WriteHexNumber(writer, value.cbegin(), 4, false);
         break;
     default:
-        result.reserve(4 * size() + 7);
-        if (GetType() == REG_BINARY)
+        if (type == REG_BINARY)
         {
-            result.assign("hex:");
+            writer.Append("hex:", 4);
         }
         else
         {
-            char buff[16];
-            sprintf_s(buff, "hex(%d):", GetType());
-            result.assign(buff);
-        }
-        if (size() == 0)
-        {
-            break;
-        }
-        HexCharacter(*cbegin(), result);
-        {
-            auto it = cbegin() + 1;
-            auto end = cend();
-            for (; it != end; ++it)
-            {
-                result.push_back(',');
-                HexCharacter(*it, result);
-            }
+            // Formatted as a signed number, as hex(%d) always has been.
+            auto const number = format_value(static_cast<int>(type));
+            writer.Append("hex(", 4);
+            writer.Append(number.data(), number.size());
+            writer.Append("):", 2);
         }
+        WriteHexBytes(writer, value.cbegin(), value.cend());
     }
 
+    writer.Flush();
+}
+
+std::string BasicRegistryValue::GetString() const
+{
+    std::string result;
+    if (GetType() != REG_SZ && GetType() != REG_EXPAND_SZ)
+    {
+        result.reserve(3 * size() + 16);
+    }
+
+    AppendString(result);
     return result;
 }
 
+void BasicRegistryValue::AppendString(std::string& target) const
+{
+    StringAppendSink sink(target);
+    write_registry_value(sink, *this);
+}
+
 std::vector<std::string> BasicRegistryValue::GetMultiStringArray() const
 {
     if (GetType() != REG_MULTI_SZ)
@@ -5,13 +5,21 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
 #include <windows.h>
 #include <boost/noncopyable.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/utility/string_ref.hpp>
 #include "DdkStructures.h"
+#include "Expected.hpp"
+#include "LogSink.hpp"
 
 namespace Instalog
 {
@@ -133,6 +141,15 @@ class BasicRegistryValue
     /// @return    The value data interpreted as a string.
     std::string GetString() const;
 
+    /// @brief    Appends the data of this value to a string, formatted as
+    ///         GetString formats it.
+    ///
+    /// @remarks Lets callers which format many values reuse one string's
+    ///          storage rather than allocating a string per value.
+    ///
+    /// @param [in,out]    target    The string to append to.
+    void AppendString(std::string& target) const;
+
     /// @brief    Gets the data in this value as a string in a strict manner.
     ///
     /// @remarks This function will not attempt to convert the data in
@@ -165,6 +182,19 @@ class BasicRegistryValue
     std::vector<std::string> GetCommaStringArray() const;
 };
 
+/// @brief    Writes the data in a registry value to a log, in exactly the
+///         form returned by BasicRegistryValue::GetString.
+///
+/// @remarks The text is rendered through a fixed size buffer, so no string
+///          is allocated however large the value is.
+///
+/// @throws InvalidRegistryDataTypeException
+///         Thrown in the event a DWORD or QWORD value has the wrong size.
+///
+/// @param [out]    target    The log to write to.
+/// @param    value           The value to write.
+void write_registry_value(log_sink& target, BasicRegistryValue const& value);
+
 /// @brief    Registry value. An implementation of BasicRegistryValue.
 ///
 /// @remarks This class is used when registry values are asked for by name.
@@ -261,6 +291,109 @@ class RegistryValueAndData : public BasicRegistryValue
     bool operator<(RegistryValueAndData const& rhs) const;
 };
 
+/// @brief    Registry value view. An implementation of BasicRegistryValue
+///         which refers to a value record stored in a RegistryValueArena.
+///
+/// @remarks Views do not own their data. They are valid until the arena
+///          which produced them is cleared or refilled.
+class RegistryValueView : public BasicRegistryValue
+{
+    KEY_VALUE_FULL_INFORMATION const* info_;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    info    The value record this view refers to.
+    explicit RegistryValueView(KEY_VALUE_FULL_INFORMATION const* info);
+
+    /// @brief    Gets a pointer to the UTF-16 name of this value. The name is
+    ///         not null terminated.
+    wchar_t const* GetNameData() const;
+
+    /// @brief    Gets the length of the name of this value, in characters.
+    std::size_t GetNameLength() const;
+
+    /// @brief    Gets the name of this value as a view into the arena.
+    boost::wstring_ref GetNameView() const;
+
+    /// @brief    Gets the name of this value, converted to UTF-8.
+    std::string GetName() const;
+
+    /// @brief    Gets the type of data in this registry value.
+    ///
+    /// @return    The type of data.
+    virtual DWORD GetType() const;
+
+    /// @brief    Gets the size of data in this registry value.
+    ///
+    /// @return    The data size.
+    virtual std::size_t size() const;
+
+    /// @brief    Gets an iterator to the beginning of the data in this value.
+    virtual unsigned char const* cbegin() const;
+
+    /// @brief    Gets an iterator to the range end of the data in this value.
+    virtual unsigned char const* cend() const;
+
+    /// @brief    Less-than comparison operator. Compares the registry values
+    ///         based on their names.
+    ///
+    /// @param    rhs    The right hand side registry value.
+    ///
+    /// @return    true if this instance's name is lexicographically less than
+    ///         the right hand side instance's name.
+    bool operator<(RegistryValueView const& rhs) const;
+};
+
+/// @brief    Storage for the values of a registry key, filled by
+///         RegistryKey::EnumerateValues(RegistryValueArena&).
+///
+/// @remarks All of a key's value records are packed into a single buffer,
+///          rather than one heap block per value as with
+///          RegistryValueAndData. The buffer is kept when the arena is
+///          refilled, so reusing one arena across many keys stops allocating
+///          once it has grown to fit the largest key.
+class RegistryValueArena : boost::noncopyable
+{
+    friend class RegistryKey;
+    std::vector<unsigned char> buffer_;
+    std::vector<std::size_t> offsets_;
+    std::vector<RegistryValueView> views_;
+    std::size_t used_;
+
+    public:
+    typedef std::vector<RegistryValueView>::const_iterator const_iterator;
+
+    /// @brief    Default constructor. Constructs an empty arena.
+    RegistryValueArena();
+
+    /// @brief    Removes all values from the arena, keeping its storage.
+    void clear();
+
+    /// @brief    Gets the number of values in the arena.
+    std::size_t size() const;
+
+    /// @brief    Checks whether the arena contains no values.
+    bool empty() const;
+
+    /// @brief    Gets the number of bytes of value records the arena can hold
+    ///         without allocating.
+    std::size_t capacity() const;
+
+    /// @brief    Gets the value at the given index.
+    ///
+    /// @param    index    Zero-based index of the value.
+    ///
+    /// @return    A view of the value.
+    RegistryValueView const& operator[](std::size_t index) const;
+
+    /// @brief    Gets an iterator to the first value in the arena.
+    const_iterator begin() const;
+
+    /// @brief    Gets an iterator one past the last value in the arena.
+    const_iterator end() const;
+};
+
 /// @brief    Information about the registry key size.
 class RegistryKeySizeInformation
 {
@@ -295,21 +428,33 @@ class RegistryKeySizeInformation
     std::uint64_t GetLastWriteTime() const;
 };
 
+struct IRegistryBackend;
+
 /// @brief    Registry key.
 class RegistryKey : boost::noncopyable
 {
     HANDLE hKey_;
+    IRegistryBackend* backend_;
+    bool owned_;
+    std::shared_ptr<void> lease_;
 
     public:
     /// @brief    Default constructor. Constructs an invalid registry key.
     RegistryKey();
 
     /// @brief    Constructor. Constructs a registry key instance around a
-    ///         given handle.
+    ///         given handle from the active registry backend.
     ///
     /// @param    hKey    Handle of the key.
     explicit RegistryKey(HANDLE hKey);
 
+    /// @brief    Constructor. Constructs a registry key instance around a
+    ///         given handle.
+    ///
+    /// @param    hKey       Handle of the key.
+    /// @param    backend    The backend which produced the handle.
+    RegistryKey(HANDLE hKey, IRegistryBackend& backend);
+
     /// @brief    Move constructor. Takes ownership of the other key's handle.
     ///
     /// @param [in,out]    other    The other registry key instance.
@@ -325,7 +470,25 @@ class RegistryKey : boost::noncopyable
     /// @brief    Destructor. Closes the registry key handle contained here.
     ~RegistryKey();
 
-    /// @brief    Closes the registry key handle contained here.
+    /// @brief    Constructs a registry key instance around a handle shared
+    ///         with something else, such as a RegistryHandleCache.
+    ///
+    /// @remarks The instance keeps the handle open until it is closed or
+    ///          destroyed; the handle is closed once no one shares it.
+    ///
+    /// @param    hKey       Shared handle of the key, which closes itself.
+    /// @param    backend    The backend which produced the handle.
+    ///
+    /// @return    A registry key instance which does not own its handle.
+    static RegistryKey Borrow(std::shared_ptr<void> const& hKey,
+                              IRegistryBackend& backend);
+
+    /// @brief    Checks whether this instance closes its handle when it is
+    ///         closed or destroyed.
+    bool OwnsHandle() const;
+
+    /// @brief    Closes the registry key handle contained here, or releases
+    ///         this instance's share of it, and makes this instance invalid.
     void Close();
 
     /// @brief    Gets the raw kernel handle to the registry key.
@@ -333,6 +496,9 @@ class RegistryKey : boost::noncopyable
     /// @return    The raw key kernel handle.
     HANDLE GetHkey() const;
 
+    /// @brief    Gets the registry backend which owns this key's handle.
+    IRegistryBackend& GetBackend() const;
+
     /// @brief    Gets a registry value.
     ///
     /// @param    name    The name of the value to retrieve.
@@ -347,6 +513,21 @@ class RegistryKey : boost::noncopyable
     /// @return    The registry value retrieved from the given name.
     RegistryValue const operator[](std::string const& name) const;
 
+    /// @brief    Gets a registry value which may not exist.
+    ///
+    /// @remarks Unlike GetValue, a missing value is reported through the
+    ///          returned expected rather than by throwing, so probing for
+    ///          optional values does not pay for stack unwinding. The
+    ///          contained exception is a shared ErrorFileNotFoundException.
+    ///
+    /// @param    name    The name of the value to retrieve.
+    ///
+    /// @throws Win32Exception on failures other than the value not existing.
+    ///
+    /// @return    The value, or an invalid expected if the value does not
+    ///         exist.
+    expected<RegistryValue> TryGetValue(std::string const& name) const;
+
     /// Sets a registry value.
     /// @param name             The name of the value.
     /// @param dataSize         Size of the data.
@@ -410,6 +591,14 @@ class RegistryKey : boost::noncopyable
     /// @return    A vector of registry values.
     std::vector<RegistryValueAndData> EnumerateValues() const;
 
+    /// @brief    Gets the registry values contained in this key, storing them
+    ///         in the supplied arena.
+    ///
+    /// @remarks Any values already in the arena are discarded.
+    ///
+    /// @param [in,out]    arena    The arena receiving the values.
+    void EnumerateValues(RegistryValueArena& arena) const;
+
     /// @brief    Gets the name of this registry key.
     ///
     /// @return    The name.
@@ -430,6 +619,43 @@ class RegistryKey : boost::noncopyable
     /// @return    A vector of sub key names.
     std::vector<std::string> EnumerateSubKeyNames() const;
 
+    /// @brief    Reads the name of a single sub key into a caller supplied
+    ///         buffer, so that walking large trees does not allocate for each
+    ///         key.
+    ///
+    /// @param    index           Zero-based index of the sub key.
+    /// @param [in,out] buffer    Buffer receiving the name. It is grown as
+    ///                           needed, and may be reused across calls.
+    /// @param [out] name         Set to refer to the name inside buffer.
+    ///
+    /// @return    true if the sub key exists, false if index is past the last
+    ///         sub key.
+    bool EnumerateSubKeyName(std::uint32_t index,
+                             std::vector<unsigned char>& buffer,
+                             UNICODE_STRING& name) const;
+
+    /// @brief    Visits the sub keys of this key one at a time.
+    ///
+    /// @remarks Unlike EnumerateSubKeys, only one sub key is open at a time;
+    ///          each is closed as soon as the callback returns. Sub keys which
+    ///          have none of the values named in predicateValueNames are
+    ///          skipped before the callback is made, and checking for a value
+    ///          does not read its data. Sub keys which cannot be opened are
+    ///          skipped.
+    ///
+    /// @param    predicateValueNames    Names of the values a sub key must
+    ///                                  have at least one of to be visited.
+    ///                                  If empty, every sub key is visited.
+    /// @param    callback               Called with the name of each visited
+    ///                                  sub key and the open sub key.
+    /// @param    samDesired             (optional) The access rights desired
+    ///                                  when opening child keys.
+    void ForEachSubKey(
+        std::vector<std::string> const& predicateValueNames,
+        std::function<void(std::string const&, RegistryKey const&)> const&
+            callback,
+        REGSAM samDesired = KEY_QUERY_VALUE) const;
+
     /// @brief    Enumerates sub keys.
     ///
     /// @param    samDesired    (optional) The access rights desired when
@@ -538,5 +764,83 @@ class RegistryKey : boost::noncopyable
      */
     void Check() const;
 };
+
+/// @brief    Caches registry key handles opened by absolute path.
+///
+/// @remarks While an instance is alive, RegistryKey::Open(path) consults it
+///          before going to the kernel. The cache keeps the handles it opens
+///          and hands out keys which borrow them, so a repeated open with the
+///          same access mask makes no system call at all; keys which failed
+///          to open fail again the same way. Other keys are opened relative
+///          to the longest ancestor path cached with the same access mask,
+///          so the object manager parses only the remaining portion, and the
+///          child gets exactly the access and WOW64 view it asked for. Paths
+///          are compared ignoring ASCII case.
+///
+///          Keys handed out by the cache share its handles, which are closed
+///          once the cache has forgotten them and no key still uses them.
+///          Instances nest; the most recently constructed instance is the
+///          active one.
+///          Open may be called from several threads, but the cache must be
+///          constructed and destroyed on a thread which is not racing with
+///          them. Creating or deleting a key flushes the active cache.
+class RegistryHandleCache : boost::noncopyable
+{
+    struct Entry
+    {
+        /// @summary    The shared handle, or null if the open failed.
+        std::shared_ptr<void> hKey;
+        NTSTATUS status;
+    };
+    std::map<std::pair<std::string, REGSAM>, Entry> entries_;
+    std::map<std::pair<std::string, REGSAM>, std::shared_ptr<void>> parents_;
+    mutable std::mutex lock_;
+    IRegistryBackend* backend_;
+    RegistryHandleCache* previous_;
+    std::size_t opensSaved_;
+    std::size_t relativeOpens_;
+
+    public:
+    /// @brief    Constructor. Makes this the active cache. The cache applies
+    ///         only while the currently active registry backend is.
+    RegistryHandleCache();
+
+    /// @brief    Destructor. Releases all cached handles and restores the
+    ///         previously active cache.
+    ~RegistryHandleCache();
+
+    /// @brief    Opens a registry key through the cache.
+    ///
+    /// @param    key           The full native path to the key to open.
+    /// @param    samDesired    The access rights desired when opening the
+    ///                         key.
+    ///
+    /// @return    A RegistryKey instance, which usually borrows the cache's
+    ///         handle. In the event an error occurs, this instance will be
+    ///         invalid. Call GetLastError for extended error information.
+    RegistryKey Open(std::string const& key, REGSAM samDesired);
+
+    /// @brief    Forgets all cached handles and failures. Each handle is
+    ///         closed as soon as no key handed out earlier still uses it.
+    void Clear();
+
+    /// @brief    Gets the number of opens answered without parsing a path.
+    std::size_t GetOpensSaved() const;
+
+    /// @brief    Gets the number of opens performed relative to a cached
+    ///         ancestor key rather than from the registry root.
+    std::size_t GetRelativeOpens() const;
+
+    /// @brief    Gets the number of cached paths, including failures.
+    std::size_t size() const;
+
+    /// @brief    Gets the registry backend whose handles this cache holds.
+    IRegistryBackend& GetBackend() const;
+
+    /// @brief    Gets the active cache.
+    ///
+    /// @return    The active cache, or nullptr if no cache is active.
+    static RegistryHandleCache* GetActive();
+};
 }
 }
@@ -0,0 +1,228 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// The ntdll backend lives here, apart from the interface, so that
+// RegistryBackend.hpp and the backends built on it need no windows.h.
+
+#include <windows.h>
+#include "DdkStructures.h"
+#include "Library.hpp"
+#include "RegistryBackend.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+static NtOpenKeyFunc PNtOpenKey =
+    GetNtDll().GetProcAddress<NtOpenKeyFunc>(GetThrowingErrorReporter(), "NtOpenKey");
+static NtCreateKeyFunc PNtCreateKey =
+    GetNtDll().GetProcAddress<NtCreateKeyFunc>(GetThrowingErrorReporter(), "NtCreateKey");
+static NtDuplicateObjectFunc PNtDuplicateObject =
+    GetNtDll().GetProcAddress<NtDuplicateObjectFunc>(GetThrowingErrorReporter(), "NtDuplicateObject");
+static NtCloseFunc PNtClose = GetNtDll().GetProcAddress<NtCloseFunc>(GetThrowingErrorReporter(), "NtClose");
+static NtDeleteKeyFunc PNtDeleteKey =
+    GetNtDll().GetProcAddress<NtCloseFunc>(GetThrowingErrorReporter(), "NtDeleteKey");
+static NtQueryKeyFunc PNtQueryKey =
+    GetNtDll().GetProcAddress<NtQueryKeyFunc>(GetThrowingErrorReporter(), "NtQueryKey");
+static NtEnumerateKeyFunc PNtEnumerateKey =
+    GetNtDll().GetProcAddress<NtEnumerateKeyFunc>(GetThrowingErrorReporter(), "NtEnumerateKey");
+static NtEnumerateValueKeyFunc PNtEnumerateValueKeyFunc =
+    GetNtDll().GetProcAddress<NtEnumerateValueKeyFunc>(GetThrowingErrorReporter(), "NtEnumerateValueKey");
+static NtQueryValueKeyFunc PNtQueryValueKeyFunc =
+    GetNtDll().GetProcAddress<NtQueryValueKeyFunc>(GetThrowingErrorReporter(), "NtQueryValueKey");
+static NtDeleteValueKeyFunc PNtDeleteValueKeyFunc =
+    GetNtDll().GetProcAddress<NtDeleteValueKeyFunc>(GetThrowingErrorReporter(), "NtDeleteValueKey");
+static NtSetValueKeyFunc PNtSetValueKeyFunc =
+    GetNtDll().GetProcAddress<NtSetValueKeyFunc>(GetThrowingErrorReporter(), "NtSetValueKey");
+
+static UNICODE_STRING MakeUnicodeString(wchar_t const* name,
+                                        std::size_t length)
+{
+    UNICODE_STRING result;
+    result.Buffer = const_cast<wchar_t*>(name);
+    result.Length = static_cast<USHORT>(length * sizeof(wchar_t));
+    result.MaximumLength = result.Length;
+    return result;
+}
+
+static OBJECT_ATTRIBUTES MakeAttributes(HANDLE root, UNICODE_STRING& name)
+{
+    OBJECT_ATTRIBUTES attribs;
+    InitializeObjectAttributes(
+        &attribs, &name, OBJ_CASE_INSENSITIVE, root, NULL);
+    return attribs;
+}
+
+/// @brief    The registry backend for the running system.
+class NtRegistryBackend : public IRegistryBackend
+{
+    public:
+    virtual std::int32_t OpenKey(void** key,
+                                 std::uint32_t desiredAccess,
+                                 void* root,
+                                 wchar_t const* path,
+                                 std::size_t pathLength)
+    {
+        UNICODE_STRING name(MakeUnicodeString(path, pathLength));
+        OBJECT_ATTRIBUTES attribs(MakeAttributes(root, name));
+        return PNtOpenKey(key, desiredAccess, &attribs);
+    }
+
+    virtual std::int32_t CreateKey(void** key,
+                                   std::uint32_t desiredAccess,
+                                   void* root,
+                                   wchar_t const* path,
+                                   std::size_t pathLength,
+                                   std::uint32_t options)
+    {
+        UNICODE_STRING name(MakeUnicodeString(path, pathLength));
+        OBJECT_ATTRIBUTES attribs(MakeAttributes(root, name));
+        return PNtCreateKey(
+            key, desiredAccess, &attribs, 0, NULL, options, NULL);
+    }
+
+    virtual std::int32_t DuplicateKey(void* key, void** duplicate)
+    {
+        return PNtDuplicateObject(::GetCurrentProcess(),
+                                  key,
+                                  ::GetCurrentProcess(),
+                                  duplicate,
+                                  0,
+                                  0,
+                                  DUPLICATE_SAME_ACCESS);
+    }
+
+    virtual std::int32_t Close(void* key)
+    {
+        return PNtClose(key);
+    }
+
+    virtual std::int32_t DeleteKey(void* key)
+    {
+        return PNtDeleteKey(key);
+    }
+
+    virtual std::int32_t QueryKey(void* key,
+                                  std::uint32_t informationClass,
+                                  void* information,
+                                  std::uint32_t length,
+                                  std::uint32_t* resultLength)
+    {
+        ULONG ntResultLength = 0;
+        NTSTATUS status =
+            PNtQueryKey(key,
+                        static_cast<KEY_INFORMATION_CLASS>(informationClass),
+                        information,
+                        length,
+                        &ntResultLength);
+        *resultLength = ntResultLength;
+        return status;
+    }
+
+    virtual std::int32_t EnumerateKey(void* key,
+                                      std::uint32_t index,
+                                      std::uint32_t informationClass,
+                                      void* information,
+                                      std::uint32_t length,
+                                      std::uint32_t* resultLength)
+    {
+        ULONG ntResultLength = 0;
+        NTSTATUS status = PNtEnumerateKey(
+            key,
+            index,
+            static_cast<KEY_INFORMATION_CLASS>(informationClass),
+            information,
+            length,
+            &ntResultLength);
+        *resultLength = ntResultLength;
+        return status;
+    }
+
+    virtual std::int32_t QueryValueKey(void* key,
+                                       wchar_t const* valueName,
+                                       std::size_t valueNameLength,
+                                       std::uint32_t informationClass,
+                                       void* information,
+                                       std::uint32_t length,
+                                       std::uint32_t* resultLength)
+    {
+        UNICODE_STRING name(MakeUnicodeString(valueName, valueNameLength));
+        ULONG ntResultLength = 0;
+        NTSTATUS status = PNtQueryValueKeyFunc(
+            key,
+            &name,
+            static_cast<KEY_VALUE_INFORMATION_CLASS>(informationClass),
+            information,
+            length,
+            &ntResultLength);
+        *resultLength = ntResultLength;
+        return status;
+    }
+
+    virtual std::int32_t EnumerateValueKey(void* key,
+                                           std::uint32_t index,
+                                           std::uint32_t informationClass,
+                                           void* information,
+                                           std::uint32_t length,
+                                           std::uint32_t* resultLength)
+    {
+        ULONG ntResultLength = 0;
+        NTSTATUS status = PNtEnumerateValueKeyFunc(
+            key,
+            index,
+            static_cast<KEY_VALUE_INFORMATION_CLASS>(informationClass),
+            information,
+            length,
+            &ntResultLength);
+        *resultLength = ntResultLength;
+        return status;
+    }
+
+    virtual std::int32_t DeleteValueKey(void* key,
+                                        wchar_t const* valueName,
+                                        std::size_t valueNameLength)
+    {
+        UNICODE_STRING name(MakeUnicodeString(valueName, valueNameLength));
+        return PNtDeleteValueKeyFunc(key, &name);
+    }
+
+    virtual std::int32_t SetValueKey(void* key,
+                                     wchar_t const* valueName,
+                                     std::size_t valueNameLength,
+                                     std::uint32_t type,
+                                     void const* data,
+                                     std::uint32_t dataSize)
+    {
+        UNICODE_STRING name(MakeUnicodeString(valueName, valueNameLength));
+        return PNtSetValueKeyFunc(
+            key, &name, 0, type, const_cast<PVOID>(data), dataSize);
+    }
+};
+
+static NtRegistryBackend ntBackend;
+static IRegistryBackend* activeBackend = &ntBackend;
+
+IRegistryBackend& GetNtRegistryBackend()
+{
+    return ntBackend;
+}
+
+IRegistryBackend& GetRegistryBackend()
+{
+    return *activeBackend;
+}
+
+ScopedRegistryBackend::ScopedRegistryBackend(IRegistryBackend& backend)
+    : previous_(activeBackend)
+{
+    activeBackend = &backend;
+}
+
+ScopedRegistryBackend::~ScopedRegistryBackend()
+{
+    activeBackend = previous_;
+}
+}
+}
@@ -0,0 +1,208 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    The primitive registry operations used by RegistryKey.
+///
+/// @remarks Each member mirrors the ntdll routine of the same name, including
+///          its information classes, information record layouts, and
+///          NTSTATUS results, so that RegistryKey behaves identically
+///          whichever implementation is in use. The parameters are spelled
+///          with fixed width types rather than with the Windows types, so
+///          that backends other than the ntdll one build without windows.h:
+///          handles are void*, as HANDLE is, and are only meaningful to the
+///          backend which produced them; names are counted strings of
+///          wchar_t, rather than UNICODE_STRINGs, and are compared case
+///          insensitively, as with OBJ_CASE_INSENSITIVE; and key paths are
+///          relative to the root key handle, or are native paths such as
+///          \\Registry\\Machine\\Software if it is null.
+struct IRegistryBackend
+{
+    /// @brief    Destructor.
+    virtual ~IRegistryBackend()
+    {
+    }
+
+    /// @brief    Opens a key. Mirrors NtOpenKey.
+    virtual std::int32_t OpenKey(void** key,
+                                 std::uint32_t desiredAccess,
+                                 void* root,
+                                 wchar_t const* path,
+                                 std::size_t pathLength) = 0;
+
+    /// @brief    Opens or creates a key. Mirrors NtCreateKey.
+    virtual std::int32_t CreateKey(void** key,
+                                   std::uint32_t desiredAccess,
+                                   void* root,
+                                   wchar_t const* path,
+                                   std::size_t pathLength,
+                                   std::uint32_t options) = 0;
+
+    /// @brief    Creates a second handle to an open key, with the same
+    ///         access. Mirrors NtDuplicateObject with DUPLICATE_SAME_ACCESS.
+    virtual std::int32_t DuplicateKey(void* key, void** duplicate) = 0;
+
+    /// @brief    Closes a key handle. Mirrors NtClose.
+    virtual std::int32_t Close(void* key) = 0;
+
+    /// @brief    Deletes a key which has no sub keys. Mirrors NtDeleteKey.
+    virtual std::int32_t DeleteKey(void* key) = 0;
+
+    /// @brief    Queries information about a key. Mirrors NtQueryKey.
+    virtual std::int32_t QueryKey(void* key,
+                                  std::uint32_t informationClass,
+                                  void* information,
+                                  std::uint32_t length,
+                                  std::uint32_t* resultLength) = 0;
+
+    /// @brief    Queries information about a sub key. Mirrors
+    ///         NtEnumerateKey.
+    virtual std::int32_t EnumerateKey(void* key,
+                                      std::uint32_t index,
+                                      std::uint32_t informationClass,
+                                      void* information,
+                                      std::uint32_t length,
+                                      std::uint32_t* resultLength) = 0;
+
+    /// @brief    Queries a value by name. Mirrors NtQueryValueKey.
+    virtual std::int32_t QueryValueKey(void* key,
+                                       wchar_t const* valueName,
+                                       std::size_t valueNameLength,
+                                       std::uint32_t informationClass,
+                                       void* information,
+                                       std::uint32_t length,
+                                       std::uint32_t* resultLength) = 0;
+
+    /// @brief    Queries a value by index. Mirrors NtEnumerateValueKey.
+    virtual std::int32_t EnumerateValueKey(void* key,
+                                           std::uint32_t index,
+                                           std::uint32_t informationClass,
+                                           void* information,
+                                           std::uint32_t length,
+                                           std::uint32_t* resultLength) = 0;
+
+    /// @brief    Deletes a value. Mirrors NtDeleteValueKey.
+    virtual std::int32_t DeleteValueKey(void* key,
+                                        wchar_t const* valueName,
+                                        std::size_t valueNameLength) = 0;
+
+    /// @brief    Sets a value. Mirrors NtSetValueKey.
+    virtual std::int32_t SetValueKey(void* key,
+                                     wchar_t const* valueName,
+                                     std::size_t valueNameLength,
+                                     std::uint32_t type,
+                                     void const* data,
+                                     std::uint32_t dataSize) = 0;
+};
+
+// The information classes MemoryRegistryBackend answers, with the values of
+// KEY_INFORMATION_CLASS and KEY_VALUE_INFORMATION_CLASS.
+static std::uint32_t const keyBasicInformation = 0;
+static std::uint32_t const keyFullInformation = 2;
+static std::uint32_t const keyNameInformation = 3;
+static std::uint32_t const keyValueBasicInformation = 0;
+static std::uint32_t const keyValueFullInformation = 1;
+static std::uint32_t const keyValuePartialInformation = 2;
+
+// The information records written for those classes. These have the layouts
+// of KEY_BASIC_INFORMATION and so on wherever wchar_t is 16 bits, as it is
+// on Windows.
+
+struct KeyBasicRecord
+{
+    std::int64_t LastWriteTime;
+    std::uint32_t TitleIndex;
+    std::uint32_t NameLength;
+    wchar_t Name[1];
+};
+
+struct KeyFullRecord
+{
+    std::int64_t LastWriteTime;
+    std::uint32_t TitleIndex;
+    std::uint32_t ClassOffset;
+    std::uint32_t ClassLength;
+    std::uint32_t SubKeys;
+    std::uint32_t MaxNameLen;
+    std::uint32_t MaxClassLen;
+    std::uint32_t Values;
+    std::uint32_t MaxValueNameLen;
+    std::uint32_t MaxValueDataLen;
+    wchar_t Class[1];
+};
+
+struct KeyNameRecord
+{
+    std::uint32_t NameLength;
+    wchar_t Name[1];
+};
+
+struct KeyValueBasicRecord
+{
+    std::uint32_t TitleIndex;
+    std::uint32_t Type;
+    std::uint32_t NameLength;
+    wchar_t Name[1];
+};
+
+struct KeyValuePartialRecord
+{
+    std::uint32_t TitleIndex;
+    std::uint32_t Type;
+    std::uint32_t DataLength;
+    unsigned char Data[1];
+};
+
+struct KeyValueFullRecord
+{
+    std::uint32_t TitleIndex;
+    std::uint32_t Type;
+    std::uint32_t DataOffset;
+    std::uint32_t DataLength;
+    std::uint32_t NameLength;
+    wchar_t Name[1];
+};
+
+/// @brief    Gets the backend which talks to the running system's registry
+///         through ntdll.
+IRegistryBackend& GetNtRegistryBackend();
+
+/// @brief    Gets the backend used by RegistryKey for keys opened by path.
+///
+/// @return    The most recently installed ScopedRegistryBackend's backend,
+///         or the NT backend if none is installed.
+IRegistryBackend& GetRegistryBackend();
+
+/// @brief    Makes RegistryKey use another backend for the lifetime of an
+///         instance.
+///
+/// @remarks Keys remember the backend which opened them, so keys opened
+///          before an instance is constructed keep working afterwards.
+///          Instances nest, and must be destroyed in reverse order of
+///          construction on a thread not racing with registry access.
+class ScopedRegistryBackend : boost::noncopyable
+{
+    IRegistryBackend* previous_;
+
+    public:
+    /// @brief    Constructor. Installs the given backend.
+    ///
+    /// @param    backend    The backend to install. Must outlive this
+    ///                      instance and all keys it opens.
+    explicit ScopedRegistryBackend(IRegistryBackend& backend);
+
+    /// @brief    Destructor. Restores the previously installed backend.
+    ~ScopedRegistryBackend();
+};
+}
+}
@@ -0,0 +1,751 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <cstring>
+#include <algorithm>
+#include <boost/algorithm/string/split.hpp>
+#include "Utf8.hpp"
+#include "RegistryHive.hpp"
+#include "RegistryUpcase.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+// Layout constants for the regf format. Offsets within cells are relative to
+// the first byte after the cell's size field.
+static std::size_t const baseBlockSize = 4096;
+static std::size_t const baseBlockRootCellOffset = 36;
+static std::size_t const baseBlockBinsSizeOffset = 40;
+static std::size_t const baseBlockMinorVersionOffset = 24;
+
+static std::uint32_t const invalidCell = 0xFFFFFFFF;
+
+static std::size_t const nkFlagsOffset = 2;
+static std::size_t const nkLastWriteOffset = 4;
+static std::size_t const nkSubkeyCountOffset = 20;
+static std::size_t const nkSubkeyListOffset = 28;
+static std::size_t const nkValueCountOffset = 36;
+static std::size_t const nkValueListOffset = 40;
+static std::size_t const nkNameLengthOffset = 72;
+static std::size_t const nkNameOffset = 76;
+static std::uint16_t const nkCompressedName = 0x0020;
+
+static std::size_t const vkNameLengthOffset = 2;
+static std::size_t const vkDataSizeOffset = 4;
+static std::size_t const vkDataOffset = 8;
+static std::size_t const vkTypeOffset = 12;
+static std::size_t const vkFlagsOffset = 16;
+static std::size_t const vkNameOffset = 20;
+static std::uint16_t const vkCompressedName = 0x0001;
+static std::uint32_t const vkDataInline = 0x80000000;
+
+static std::size_t const bigDataSegmentSize = 16344;
+
+static std::uint16_t ReadU16(unsigned char const* source)
+{
+    std::uint16_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint32_t ReadU32(unsigned char const* source)
+{
+    std::uint32_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint64_t ReadU64(unsigned char const* source)
+{
+    std::uint64_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static bool HasSignature(unsigned char const* cell, char const* signature)
+{
+    return cell[0] == static_cast<unsigned char>(signature[0]) &&
+           cell[1] == static_cast<unsigned char>(signature[1]);
+}
+
+/// @brief    Gets a cell, checking that it is large enough and carries the
+///         expected two character signature.
+static unsigned char const* GetSignedCell(RegistryHive const& hive,
+                                          std::uint32_t cell,
+                                          char const* signature,
+                                          std::size_t minimumLength,
+                                          std::size_t& length)
+{
+    unsigned char const* result = hive.GetCell(cell, length);
+    if (length < minimumLength || !HasSignature(result, signature))
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    return result;
+}
+
+static unsigned char const* GetKeyNode(RegistryHive const& hive,
+                                       std::uint32_t cell)
+{
+    std::size_t length;
+    unsigned char const* node =
+        GetSignedCell(hive, cell, "nk", nkNameOffset, length);
+    if (nkNameOffset + ReadU16(node + nkNameLengthOffset) > length)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    return node;
+}
+
+static RegistryHiveName GetKeyNodeName(unsigned char const* node)
+{
+    return RegistryHiveName(
+        node + nkNameOffset,
+        ReadU16(node + nkNameLengthOffset),
+        (ReadU16(node + nkFlagsOffset) & nkCompressedName) != 0);
+}
+
+/// @brief    Calls the given callback with the key node cell of each entry of
+///         a subkey list, stopping early if the callback returns false.
+///
+/// @return    false if the callback stopped the walk, true otherwise.
+template <typename Callback>
+static bool WalkSubkeyList(RegistryHive const& hive,
+                           std::uint32_t listCell,
+                           bool allowIndexRoot,
+                           Callback& callback)
+{
+    std::size_t length;
+    unsigned char const* list = hive.GetCell(listCell, length);
+    if (length < 4)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    std::size_t const count = ReadU16(list + 2);
+    std::size_t stride;
+    if (HasSignature(list, "lf") || HasSignature(list, "lh"))
+    {
+        // Each element is a cell offset followed by a name hint or hash.
+        stride = 8;
+    }
+    else if (HasSignature(list, "li"))
+    {
+        stride = 4;
+    }
+    else if (HasSignature(list, "ri") && allowIndexRoot)
+    {
+        // Compare by division; count comes from the hive, and multiplying
+        // it can wrap on 32 bit builds.
+        if (count > (length - 4) / 4)
+        {
+            throw InvalidRegistryHiveException();
+        }
+
+        for (std::size_t idx = 0; idx < count; ++idx)
+        {
+            if (!WalkSubkeyList(
+                    hive, ReadU32(list + 4 + idx * 4), false, callback))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+    else
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    if (count > (length - 4) / stride)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    for (std::size_t idx = 0; idx < count; ++idx)
+    {
+        if (!callback(ReadU32(list + 4 + idx * stride)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Callback>
+static void WalkSubkeys(RegistryHive const& hive,
+                        unsigned char const* node,
+                        Callback callback)
+{
+    if (ReadU32(node + nkSubkeyCountOffset) == 0)
+    {
+        return;
+    }
+
+    WalkSubkeyList(hive, ReadU32(node + nkSubkeyListOffset), true, callback);
+}
+
+/// @brief    Calls the given callback with each value key cell of a key
+///         node, stopping early if the callback returns false.
+template <typename Callback>
+static void WalkValues(RegistryHive const& hive,
+                       unsigned char const* node,
+                       Callback callback)
+{
+    std::size_t const count = ReadU32(node + nkValueCountOffset);
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::size_t length;
+    unsigned char const* list =
+        hive.GetCell(ReadU32(node + nkValueListOffset), length);
+    if (count > length / 4)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    for (std::size_t idx = 0; idx < count; ++idx)
+    {
+        if (!callback(ReadU32(list + idx * 4)))
+        {
+            return;
+        }
+    }
+}
+
+static RegistryHiveName GetValueNodeName(RegistryHive const& hive,
+                                         std::uint32_t cell,
+                                         unsigned char const*& node)
+{
+    std::size_t length;
+    node = GetSignedCell(hive, cell, "vk", vkNameOffset, length);
+    std::size_t const nameLength = ReadU16(node + vkNameLengthOffset);
+    if (vkNameOffset + nameLength > length)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    return RegistryHiveName(node + vkNameOffset,
+                            nameLength,
+                            (ReadU16(node + vkFlagsOffset) & vkCompressedName) !=
+                                0);
+}
+
+static RegistryHiveValue MakeValue(RegistryHive const& hive,
+                                   RegistryHiveName const& name,
+                                   unsigned char const* node)
+{
+    std::uint32_t const type = ReadU32(node + vkTypeOffset);
+    std::uint32_t const rawSize = ReadU32(node + vkDataSizeOffset);
+    if ((rawSize & vkDataInline) != 0)
+    {
+        // Data of 4 bytes or less lives in the data offset field itself.
+        std::size_t const inlineSize = rawSize & ~vkDataInline;
+        if (inlineSize > 4)
+        {
+            throw InvalidRegistryHiveException();
+        }
+
+        return RegistryHiveValue(
+            name, type, node + vkDataOffset, node + vkDataOffset + inlineSize);
+    }
+
+    if (rawSize == 0)
+    {
+        return RegistryHiveValue(name, type, node, node);
+    }
+
+    std::size_t length;
+    unsigned char const* data =
+        hive.GetCell(ReadU32(node + vkDataOffset), length);
+    if (rawSize > bigDataSegmentSize && hive.GetMinorVersion() >= 4 &&
+        length >= 8 && HasSignature(data, "db"))
+    {
+        // Big data; the value is split across several segment cells which
+        // are not contiguous, so gather them into one buffer.
+        std::size_t const segmentCount = ReadU16(data + 2);
+        std::size_t segmentListLength;
+        unsigned char const* segmentList =
+            hive.GetCell(ReadU32(data + 4), segmentListLength);
+        if (segmentCount > segmentListLength / 4)
+        {
+            throw InvalidRegistryHiveException();
+        }
+
+        std::vector<unsigned char> gathered;
+        gathered.reserve(rawSize);
+        for (std::size_t idx = 0;
+             idx < segmentCount && gathered.size() < rawSize;
+             ++idx)
+        {
+            std::size_t segmentLength;
+            unsigned char const* segment =
+                hive.GetCell(ReadU32(segmentList + idx * 4), segmentLength);
+            std::size_t const toCopy =
+                (std::min)((std::min)(segmentLength, bigDataSegmentSize),
+                           rawSize - gathered.size());
+            gathered.insert(gathered.end(), segment, segment + toCopy);
+        }
+
+        if (gathered.size() != rawSize)
+        {
+            throw InvalidRegistryHiveException();
+        }
+
+        return RegistryHiveValue(name, type, std::move(gathered));
+    }
+
+    if (rawSize > length)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    return RegistryHiveValue(name, type, data, data + rawSize);
+}
+
+//
+// RegistryHiveName
+//
+
+RegistryHiveName::RegistryHiveName(unsigned char const* first,
+                                   std::size_t byteLength,
+                                   bool compressed)
+    : first_(first), byteLength_(byteLength), compressed_(compressed)
+{
+}
+
+bool RegistryHiveName::IsCompressed() const
+{
+    return compressed_;
+}
+
+std::size_t RegistryHiveName::size() const
+{
+    return compressed_ ? byteLength_ : byteLength_ / sizeof(std::uint16_t);
+}
+
+bool RegistryHiveName::empty() const
+{
+    return size() == 0;
+}
+
+wchar_t RegistryHiveName::operator[](std::size_t index) const
+{
+    if (compressed_)
+    {
+        return static_cast<wchar_t>(first_[index]);
+    }
+
+    return static_cast<wchar_t>(ReadU16(first_ + index * sizeof(std::uint16_t)));
+}
+
+std::string RegistryHiveName::ToUtf8() const
+{
+    std::wstring wide;
+    std::size_t const length = size();
+    wide.reserve(length);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        wide.push_back((*this)[idx]);
+    }
+
+    return utf8::ToUtf8(wide);
+}
+
+bool RegistryHiveName::EqualsIgnoreCase(std::wstring const& other) const
+{
+    std::size_t const length = size();
+    if (length != other.size())
+    {
+        return false;
+    }
+
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        if (UpcaseRegistryCharacter((*this)[idx]) !=
+            UpcaseRegistryCharacter(other[idx]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// RegistryHiveValue
+//
+
+RegistryHiveValue::RegistryHiveValue(RegistryHiveName name,
+                                     std::uint32_t type,
+                                     unsigned char const* first,
+                                     unsigned char const* last)
+    : name_(name), type_(type), first_(first), last_(last)
+{
+}
+
+RegistryHiveValue::RegistryHiveValue(RegistryHiveName name,
+                                     std::uint32_t type,
+                                     std::vector<unsigned char>&& data)
+    : name_(name), type_(type), bigData_(std::move(data))
+{
+    first_ = bigData_.data();
+    last_ = first_ + bigData_.size();
+}
+
+RegistryHiveValue::RegistryHiveValue(RegistryHiveValue const& other)
+    : name_(other.name_), type_(other.type_), bigData_(other.bigData_)
+{
+    if (other.first_ == other.bigData_.data() && !bigData_.empty())
+    {
+        first_ = bigData_.data();
+        last_ = first_ + bigData_.size();
+    }
+    else
+    {
+        first_ = other.first_;
+        last_ = other.last_;
+    }
+}
+
+RegistryHiveValue::RegistryHiveValue(RegistryHiveValue&& other)
+    : name_(other.name_),
+      type_(other.type_),
+      first_(other.first_),
+      last_(other.last_),
+      bigData_(std::move(other.bigData_))
+{
+    // Moving a vector keeps its buffer, so first_ and last_ remain valid.
+}
+
+RegistryHiveValue& RegistryHiveValue::operator=(RegistryHiveValue other)
+{
+    name_ = other.name_;
+    type_ = other.type_;
+    first_ = other.first_;
+    last_ = other.last_;
+    bigData_ = std::move(other.bigData_);
+    return *this;
+}
+
+RegistryHiveName const& RegistryHiveValue::GetNameView() const
+{
+    return name_;
+}
+
+std::string RegistryHiveValue::GetName() const
+{
+    return name_.ToUtf8();
+}
+
+std::uint32_t RegistryHiveValue::GetType() const
+{
+    return type_;
+}
+
+std::size_t RegistryHiveValue::size() const
+{
+    return static_cast<std::size_t>(last_ - first_);
+}
+
+bool RegistryHiveValue::empty() const
+{
+    return first_ == last_;
+}
+
+unsigned char const* RegistryHiveValue::cbegin() const
+{
+    return first_;
+}
+
+unsigned char const* RegistryHiveValue::cend() const
+{
+    return last_;
+}
+
+//
+// RegistryHiveKey
+//
+
+RegistryHiveKey::RegistryHiveKey() : hive_(nullptr), cell_(invalidCell)
+{
+}
+
+RegistryHiveKey::RegistryHiveKey(RegistryHive const& hive, std::uint32_t cell)
+    : hive_(&hive), cell_(cell)
+{
+}
+
+bool RegistryHiveKey::Valid() const
+{
+    return hive_ != nullptr && cell_ != invalidCell;
+}
+
+bool RegistryHiveKey::Invalid() const
+{
+    return !Valid();
+}
+
+void RegistryHiveKey::Check() const
+{
+    if (Invalid())
+    {
+        throw RegistryHiveNotFoundException();
+    }
+}
+
+RegistryHiveName RegistryHiveKey::GetNameView() const
+{
+    this->Check();
+    return GetKeyNodeName(GetKeyNode(*hive_, cell_));
+}
+
+std::string RegistryHiveKey::GetLocalName() const
+{
+    return GetNameView().ToUtf8();
+}
+
+std::uint64_t RegistryHiveKey::GetLastWriteTime() const
+{
+    this->Check();
+    return ReadU64(GetKeyNode(*hive_, cell_) + nkLastWriteOffset);
+}
+
+std::uint32_t RegistryHiveKey::GetNumberOfSubkeys() const
+{
+    this->Check();
+    return ReadU32(GetKeyNode(*hive_, cell_) + nkSubkeyCountOffset);
+}
+
+std::uint32_t RegistryHiveKey::GetNumberOfValues() const
+{
+    this->Check();
+    return ReadU32(GetKeyNode(*hive_, cell_) + nkValueCountOffset);
+}
+
+RegistryHiveValue RegistryHiveKey::GetValue(std::string const& name) const
+{
+    this->Check();
+    std::wstring const wideName(utf8::ToUtf16(name));
+    RegistryHive const& hive = *hive_;
+    std::vector<RegistryHiveValue> found;
+    WalkValues(hive,
+               GetKeyNode(hive, cell_),
+               [&](std::uint32_t valueCell)->bool {
+        unsigned char const* valueNode;
+        RegistryHiveName valueName(
+            GetValueNodeName(hive, valueCell, valueNode));
+        if (!valueName.EqualsIgnoreCase(wideName))
+        {
+            return true;
+        }
+
+        found.emplace_back(MakeValue(hive, valueName, valueNode));
+        return false;
+    });
+
+    if (found.empty())
+    {
+        throw RegistryHiveNotFoundException();
+    }
+
+    return std::move(found.front());
+}
+
+RegistryHiveValue RegistryHiveKey::operator[](std::string const& name) const
+{
+    return GetValue(name);
+}
+
+std::vector<std::string> RegistryHiveKey::EnumerateValueNames() const
+{
+    this->Check();
+    RegistryHive const& hive = *hive_;
+    std::vector<std::string> result;
+    WalkValues(hive,
+               GetKeyNode(hive, cell_),
+               [&](std::uint32_t valueCell)->bool {
+        unsigned char const* valueNode;
+        result.emplace_back(
+            GetValueNodeName(hive, valueCell, valueNode).ToUtf8());
+        return true;
+    });
+    return result;
+}
+
+std::vector<RegistryHiveValue> RegistryHiveKey::EnumerateValues() const
+{
+    this->Check();
+    RegistryHive const& hive = *hive_;
+    unsigned char const* node = GetKeyNode(hive, cell_);
+    std::vector<RegistryHiveValue> result;
+    result.reserve(ReadU32(node + nkValueCountOffset));
+    WalkValues(hive, node, [&](std::uint32_t valueCell)->bool {
+        unsigned char const* valueNode;
+        RegistryHiveName valueName(
+            GetValueNodeName(hive, valueCell, valueNode));
+        result.emplace_back(MakeValue(hive, valueName, valueNode));
+        return true;
+    });
+    return result;
+}
+
+std::vector<std::string> RegistryHiveKey::EnumerateSubKeyNames() const
+{
+    this->Check();
+    RegistryHive const& hive = *hive_;
+    std::vector<std::string> result;
+    WalkSubkeys(hive,
+                GetKeyNode(hive, cell_),
+                [&](std::uint32_t subkeyCell)->bool {
+        result.emplace_back(
+            GetKeyNodeName(GetKeyNode(hive, subkeyCell)).ToUtf8());
+        return true;
+    });
+    return result;
+}
+
+std::vector<RegistryHiveKey> RegistryHiveKey::EnumerateSubKeys() const
+{
+    this->Check();
+    RegistryHive const& hive = *hive_;
+    std::vector<RegistryHiveKey> result;
+    WalkSubkeys(hive,
+                GetKeyNode(hive, cell_),
+                [&](std::uint32_t subkeyCell)->bool {
+        GetKeyNode(hive, subkeyCell);
+        result.emplace_back(hive, subkeyCell);
+        return true;
+    });
+    return result;
+}
+
+RegistryHiveKey RegistryHiveKey::Open(std::string const& key) const
+{
+    this->Check();
+    RegistryHive const& hive = *hive_;
+    std::vector<std::string> components;
+    boost::algorithm::split(components,
+                            key,
+                            [](char c) { return c == '\\'; },
+                            boost::algorithm::token_compress_on);
+
+    std::uint32_t current = cell_;
+    for (auto const& component : components)
+    {
+        if (component.empty())
+        {
+            continue;
+        }
+
+        std::wstring const wideComponent(utf8::ToUtf16(component));
+        std::uint32_t next = invalidCell;
+        WalkSubkeys(hive,
+                    GetKeyNode(hive, current),
+                    [&](std::uint32_t subkeyCell)->bool {
+            if (GetKeyNodeName(GetKeyNode(hive, subkeyCell))
+                    .EqualsIgnoreCase(wideComponent))
+            {
+                next = subkeyCell;
+                return false;
+            }
+
+            return true;
+        });
+
+        if (next == invalidCell)
+        {
+            return RegistryHiveKey();
+        }
+
+        current = next;
+    }
+
+    return RegistryHiveKey(hive, current);
+}
+
+//
+// RegistryHive
+//
+
+RegistryHive::RegistryHive(unsigned char const* first,
+                           unsigned char const* last)
+{
+    Initialize(first, last);
+}
+
+void RegistryHive::Initialize(unsigned char const* first,
+                              unsigned char const* last)
+{
+    std::size_t const totalSize = static_cast<std::size_t>(last - first);
+    if (totalSize < baseBlockSize + 4 ||
+        std::memcmp(first, "regf", 4) != 0 ||
+        std::memcmp(first + baseBlockSize, "hbin", 4) != 0)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    bins_ = first + baseBlockSize;
+    binsSize_ = totalSize - baseBlockSize;
+    std::size_t const declaredBinsSize =
+        ReadU32(first + baseBlockBinsSizeOffset);
+    if (declaredBinsSize != 0 && declaredBinsSize < binsSize_)
+    {
+        // Anything past the declared end of the bins is slack space.
+        binsSize_ = declaredBinsSize;
+    }
+
+    rootCell_ = ReadU32(first + baseBlockRootCellOffset);
+    minorVersion_ = ReadU32(first + baseBlockMinorVersionOffset);
+    GetKeyNode(*this, rootCell_);
+}
+
+RegistryHiveKey RegistryHive::GetRootKey() const
+{
+    return RegistryHiveKey(*this, rootCell_);
+}
+
+RegistryHiveKey RegistryHive::Open(std::string const& key) const
+{
+    return GetRootKey().Open(key);
+}
+
+std::uint32_t RegistryHive::GetMinorVersion() const
+{
+    return minorVersion_;
+}
+
+unsigned char const* RegistryHive::GetCell(std::uint32_t cell,
+                                           std::size_t& length) const
+{
+    if (binsSize_ < sizeof(std::int32_t) ||
+        cell > binsSize_ - sizeof(std::int32_t))
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    // Allocated cells carry a negative size; free cells a positive one.
+    std::int32_t const rawSize =
+        static_cast<std::int32_t>(ReadU32(bins_ + cell));
+    std::size_t const cellSize =
+        rawSize < 0 ? static_cast<std::size_t>(-static_cast<std::int64_t>(rawSize))
+                    : static_cast<std::size_t>(rawSize);
+    if (cellSize < sizeof(std::int32_t) || cellSize > binsSize_ - cell)
+    {
+        throw InvalidRegistryHiveException();
+    }
+
+    length = cellSize - sizeof(std::int32_t);
+    return bins_ + cell + sizeof(std::int32_t);
+}
+}
+}
@@ -0,0 +1,334 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/config.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    Exception for signaling a malformed offline registry hive. This
+///         occurs when a cell reference points outside the hive, or a cell
+///         does not carry the signature its referrer expects.
+struct InvalidRegistryHiveException : public std::exception
+{
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return "Invalid Registry Hive";
+    }
+};
+
+/// @brief    Exception for signaling that a key or value asked for does not
+///         exist in an offline registry hive.
+struct RegistryHiveNotFoundException : public std::exception
+{
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return "Registry Hive Key or Value Not Found";
+    }
+};
+
+class RegistryHive;
+
+/// @brief    A view of a key or value name stored inside a hive.
+///
+/// @remarks Names are stored either as 8 bit (Latin-1) "compressed" strings
+///          or as UTF-16. The view refers directly to the hive's memory, and
+///          is valid only as long as the owning RegistryHive.
+class RegistryHiveName
+{
+    unsigned char const* first_;
+    std::size_t byteLength_;
+    bool compressed_;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    first         Pointer to the first byte of the name.
+    /// @param    byteLength    Length of the name in bytes.
+    /// @param    compressed    true if the name is stored as 8 bit characters.
+    RegistryHiveName(unsigned char const* first,
+                     std::size_t byteLength,
+                     bool compressed);
+
+    /// @brief    Checks whether the name is stored as 8 bit characters.
+    bool IsCompressed() const;
+
+    /// @brief    Gets the number of characters in the name.
+    std::size_t size() const;
+
+    /// @brief    Checks whether the name is empty, as it is for default
+    ///         values.
+    bool empty() const;
+
+    /// @brief    Gets the character at the given index, widened to UTF-16.
+    ///
+    /// @param    index    Zero-based index of the character.
+    ///
+    /// @return    The character.
+    wchar_t operator[](std::size_t index) const;
+
+    /// @brief    Converts the name to UTF-8.
+    ///
+    /// @return    The name as a UTF-8 string.
+    std::string ToUtf8() const;
+
+    /// @brief    Compares this name with a UTF-16 string using the registry's
+    ///         case insensitive rules.
+    ///
+    /// @param    other    The string to compare against.
+    ///
+    /// @return    true if the names are equal, ignoring case.
+    bool EqualsIgnoreCase(std::wstring const& other) const;
+};
+
+/// @brief    Registry value read from an offline hive.
+///
+/// @remarks The data range points directly into the hive's memory, except
+///          for values larger than a single cell ("big data"), which are
+///          gathered into an owned buffer when the value is constructed.
+///          The type and data are as stored; on Windows, a RegistryValue
+///          constructed from them renders them like any other value.
+class RegistryHiveValue
+{
+    RegistryHiveName name_;
+    std::uint32_t type_;
+    unsigned char const* first_;
+    unsigned char const* last_;
+    std::vector<unsigned char> bigData_;
+
+    public:
+    /// @brief    Constructor. Constructs a value referring to hive memory.
+    ///
+    /// @param    name     The value name.
+    /// @param    type     The registry type of the value.
+    /// @param    first    Pointer to the first byte of data.
+    /// @param    last     Pointer one past the last byte of data.
+    RegistryHiveValue(RegistryHiveName name,
+                      std::uint32_t type,
+                      unsigned char const* first,
+                      unsigned char const* last);
+
+    /// @brief    Constructor. Constructs a value which owns its data.
+    ///
+    /// @param    name       The value name.
+    /// @param    type       The registry type of the value.
+    /// @param [in,out]    data    The data.
+    RegistryHiveValue(RegistryHiveName name,
+                      std::uint32_t type,
+                      std::vector<unsigned char>&& data);
+
+    /// @brief    Copy constructor.
+    ///
+    /// @param    other    The value being copied.
+    RegistryHiveValue(RegistryHiveValue const& other);
+
+    /// @brief    Move constructor.
+    ///
+    /// @param [in,out]    other    The value being moved from.
+    RegistryHiveValue(RegistryHiveValue&& other);
+
+    /// @brief    Assignment operator.
+    ///
+    /// @param    other    The value being assigned from.
+    ///
+    /// @return    *this
+    RegistryHiveValue& operator=(RegistryHiveValue other);
+
+    /// @brief    Gets a view of the name of this value.
+    RegistryHiveName const& GetNameView() const;
+
+    /// @brief    Gets the name of this value as UTF-8.
+    std::string GetName() const;
+
+    /// @brief    Gets the registry type (REG_SZ, REG_DWORD, and so on) of
+    ///         the data in this registry value.
+    std::uint32_t GetType() const;
+
+    /// @brief    Gets the size of data in this registry value.
+    std::size_t size() const;
+
+    /// @brief    Checks whether this registry value has no data.
+    bool empty() const;
+
+    /// @brief    Gets an iterator to the beginning of the data in this value.
+    unsigned char const* cbegin() const;
+
+    /// @brief    Gets an iterator to the range end of the data in this value.
+    unsigned char const* cend() const;
+};
+
+/// @brief    Registry key read from an offline hive.
+///
+/// @remarks This is a lightweight reference to a key node inside a
+///          RegistryHive, and is valid only as long as that hive is.
+///          Unlike RegistryKey, no kernel handle is held, so instances are
+///          freely copyable.
+class RegistryHiveKey
+{
+    RegistryHive const* hive_;
+    std::uint32_t cell_;
+
+    public:
+    /// @brief    Default constructor. Constructs an invalid key.
+    RegistryHiveKey();
+
+    /// @brief    Constructor.
+    ///
+    /// @param    hive    The hive containing the key.
+    /// @param    cell    The offset of the key node cell.
+    RegistryHiveKey(RegistryHive const& hive, std::uint32_t cell);
+
+    /// @brief    Checks the validity of this instance.
+    ///
+    /// @return    true if this is a valid key, false otherwise.
+    bool Valid() const;
+
+    /// @brief    Checks the inverse of validity of this instance.
+    ///
+    /// @return    true if this instance is invalid, false otherwise.
+    bool Invalid() const;
+
+    /// @brief    Gets a view of the local name of this key.
+    RegistryHiveName GetNameView() const;
+
+    /// @brief    Gets the local name of this key as UTF-8.
+    std::string GetLocalName() const;
+
+    /// @brief    Gets the time of the last write to this key, as a FILETIME.
+    std::uint64_t GetLastWriteTime() const;
+
+    /// @brief    Gets the number of sub keys of this key.
+    std::uint32_t GetNumberOfSubkeys() const;
+
+    /// @brief    Gets the number of values in this key.
+    std::uint32_t GetNumberOfValues() const;
+
+    /// @brief    Gets a registry value.
+    ///
+    /// @param    name    The name of the value to retrieve.
+    ///
+    /// @throws RegistryHiveNotFoundException The value does not exist.
+    ///
+    /// @return    The value.
+    RegistryHiveValue GetValue(std::string const& name) const;
+
+    /// @brief    Array indexer operator. Forwards to GetValue()
+    ///
+    /// @param    name    The name of the value to retrieve.
+    ///
+    /// @return    The registry value retrieved from the given name.
+    RegistryHiveValue operator[](std::string const& name) const;
+
+    /// @brief    Gets the names of all values stored in this key.
+    ///
+    /// @return    A vector of value names.
+    std::vector<std::string> EnumerateValueNames() const;
+
+    /// @brief    Gets the values contained in this key.
+    ///
+    /// @return    A vector of values.
+    std::vector<RegistryHiveValue> EnumerateValues() const;
+
+    /// @brief    Gets the sub key names of this key.
+    ///
+    /// @return    A vector of sub key names.
+    std::vector<std::string> EnumerateSubKeyNames() const;
+
+    /// @brief    Enumerates sub keys.
+    ///
+    /// @return    A vector of child keys.
+    std::vector<RegistryHiveKey> EnumerateSubKeys() const;
+
+    /// @brief    Opens a sub key.
+    ///
+    /// @param    key    The backslash separated path of the sub key to open,
+    ///                  relative to this key.
+    ///
+    /// @return    The sub key. In the event the key does not exist, this
+    ///         instance will be invalid.
+    RegistryHiveKey Open(std::string const& key) const;
+
+    /// @brief    Checks this instance for validity and throws an exception if
+    ///         it is not.
+    ///
+    /// @throws RegistryHiveNotFoundException The key is invalid.
+    void Check() const;
+};
+
+/// @brief    Read-only parser for registry hive files in the on-disk "regf"
+///         format (SYSTEM, SOFTWARE, NTUSER.DAT, and so on).
+///
+/// @remarks The hive is memory mapped, and all names and data handed out
+///          refer directly to the mapped view. This allows scanning hives
+///          which are not loaded into the running system, such as those on a
+///          mounted disk, without a system call per key or value. Only the
+///          constructor which maps a file needs Windows; it lives in
+///          RegistryHiveFile.cpp.
+class RegistryHive : boost::noncopyable
+{
+    /// @summary    The mapped file, for hives constructed from a path.
+    std::shared_ptr<void> file_;
+    unsigned char const* bins_;
+    std::size_t binsSize_;
+    std::uint32_t rootCell_;
+    std::uint32_t minorVersion_;
+    void Initialize(unsigned char const* first, unsigned char const* last);
+
+    public:
+    /// @brief    Constructor. Maps the hive file at the given path.
+    ///
+    /// @param    hivePath    Full path of the hive file.
+    ///
+    /// @throws Win32Exception The file could not be mapped.
+    /// @throws InvalidRegistryHiveException The file is not a registry hive.
+    explicit RegistryHive(std::string const& hivePath);
+
+    /// @brief    Constructor. Parses a hive image already in memory.
+    ///
+    /// @remarks The memory is not copied, and must outlive this instance.
+    ///
+    /// @param    first    Pointer to the start of the hive image.
+    /// @param    last     Pointer one past the end of the hive image.
+    ///
+    /// @throws InvalidRegistryHiveException The image is not a registry hive.
+    RegistryHive(unsigned char const* first, unsigned char const* last);
+
+    /// @brief    Gets the root key of the hive.
+    RegistryHiveKey GetRootKey() const;
+
+    /// @brief    Opens a key relative to the root of the hive.
+    ///
+    /// @param    key    The backslash separated path of the key to open.
+    ///
+    /// @return    The key. In the event the key does not exist, this instance
+    ///         will be invalid.
+    RegistryHiveKey Open(std::string const& key) const;
+
+    /// @brief    Gets the minor version of the hive format.
+    std::uint32_t GetMinorVersion() const;
+
+    /// @brief    Locates a cell in the hive.
+    ///
+    /// @param    cell         The offset of the cell, relative to the first
+    ///                        hive bin.
+    /// @param [out]    length The usable length of the cell's data.
+    ///
+    /// @throws InvalidRegistryHiveException The cell is out of bounds.
+    ///
+    /// @return    Pointer to the cell's data, just past its size field.
+    unsigned char const* GetCell(std::uint32_t cell,
+                                 std::size_t& length) const;
+};
+}
+}
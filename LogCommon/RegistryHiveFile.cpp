@@ -0,0 +1,24 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// The constructor mapping a hive file lives apart from the parser so that
+// RegistryHive.cpp builds without windows.h.
+
+#include <memory>
+#include "File.hpp"
+#include "RegistryHive.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+RegistryHive::RegistryHive(std::string const& hivePath)
+{
+    auto file = std::make_shared<MemoryMappedFile>(hivePath);
+    Initialize(file->cbegin(), file->cend());
+    file_ = std::move(file);
+}
+}
+}
@@ -0,0 +1,501 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "Registry.hpp"
+#include "RegistrySnapshot.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+static char const snapshotMagic[4] = {'I', 'L', 'R', 'S'};
+static std::uint32_t const snapshotVersion = 1;
+
+static unsigned char FoldAscii(char character)
+{
+    unsigned char const result = static_cast<unsigned char>(character);
+    if (result >= 'a' && result <= 'z')
+    {
+        return static_cast<unsigned char>(result - ('a' - 'A'));
+    }
+
+    return result;
+}
+
+// Orders registry names the way the snapshot stores them. Only ASCII letters
+// are folded; this is enough to make the order consistent between snapshots,
+// which is all the merge needs.
+static int CompareIgnoreCase(boost::string_ref lhs, boost::string_ref rhs)
+{
+    std::size_t const common = (std::min)(lhs.size(), rhs.size());
+    for (std::size_t idx = 0; idx < common; ++idx)
+    {
+        unsigned char const left = FoldAscii(lhs[idx]);
+        unsigned char const right = FoldAscii(rhs[idx]);
+        if (left != right)
+        {
+            return left < right ? -1 : 1;
+        }
+    }
+
+    if (lhs.size() == rhs.size())
+    {
+        return 0;
+    }
+
+    return lhs.size() < rhs.size() ? -1 : 1;
+}
+
+// 64 bit FNV-1a.
+static std::uint64_t HashData(unsigned char const* first,
+                              unsigned char const* last)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (; first != last; ++first)
+    {
+        hash ^= *first;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+namespace
+{
+struct PendingValue
+{
+    std::string name;
+    DWORD type;
+    std::uint64_t hash;
+};
+
+struct PendingKey
+{
+    std::string path;
+    std::vector<PendingValue> values;
+};
+}
+
+static void CaptureKey(RegistryKey const& key,
+                       std::string& path,
+                       std::vector<PendingKey>& keys,
+                       RegistryValueArena& arena)
+{
+    keys.emplace_back();
+    PendingKey& pending = keys.back();
+    pending.path = path;
+    key.EnumerateValues(arena);
+    pending.values.reserve(arena.size());
+    for (RegistryValueView const& view : arena)
+    {
+        PendingValue value;
+        value.name = view.GetName();
+        value.type = view.GetType();
+        value.hash = HashData(view.cbegin(), view.cend());
+        pending.values.push_back(std::move(value));
+    }
+
+    std::sort(pending.values.begin(),
+              pending.values.end(),
+              [](PendingValue const& lhs, PendingValue const& rhs) {
+        return CompareIgnoreCase(lhs.name, rhs.name) < 0;
+    });
+
+    std::size_t const pathLength = path.size();
+    for (std::string const& subKeyName : key.EnumerateSubKeyNames())
+    {
+        RegistryKey subKey(RegistryKey::Open(
+            key, subKeyName, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS));
+        if (subKey.Invalid())
+        {
+            continue;
+        }
+
+        path.push_back('\\');
+        path.append(subKeyName);
+        CaptureKey(subKey, path, keys, arena);
+        path.resize(pathLength);
+    }
+}
+
+static std::uint32_t CheckedSize(std::size_t size)
+{
+    if (size > (std::numeric_limits<std::uint32_t>::max)())
+    {
+        throw std::length_error("Registry snapshot is too large.");
+    }
+
+    return static_cast<std::uint32_t>(size);
+}
+
+RegistrySnapshot::RegistrySnapshot()
+{
+}
+
+RegistrySnapshot::RegistrySnapshot(RegistrySnapshot&& other)
+    : strings_(std::move(other.strings_))
+    , keys_(std::move(other.keys_))
+    , values_(std::move(other.values_))
+{
+}
+
+RegistrySnapshot& RegistrySnapshot::operator=(RegistrySnapshot other)
+{
+    strings_.swap(other.strings_);
+    keys_.swap(other.keys_);
+    values_.swap(other.values_);
+    return *this;
+}
+
+RegistrySnapshot
+RegistrySnapshot::Capture(std::vector<std::string> const& roots)
+{
+    std::vector<PendingKey> pending;
+    RegistryValueArena arena;
+    for (std::string const& root : roots)
+    {
+        RegistryKey rootKey(RegistryKey::Open(
+            root, KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS));
+        if (rootKey.Invalid())
+        {
+            continue;
+        }
+
+        std::string path(root);
+        CaptureKey(rootKey, path, pending, arena);
+    }
+
+    std::sort(pending.begin(),
+              pending.end(),
+              [](PendingKey const& lhs, PendingKey const& rhs) {
+        return CompareIgnoreCase(lhs.path, rhs.path) < 0;
+    });
+    pending.erase(std::unique(pending.begin(),
+                              pending.end(),
+                              [](PendingKey const& lhs, PendingKey const& rhs) {
+        return CompareIgnoreCase(lhs.path, rhs.path) == 0;
+    }),
+                  pending.end());
+
+    RegistrySnapshot result;
+    result.keys_.reserve(pending.size());
+    for (PendingKey const& key : pending)
+    {
+        Key record;
+        record.pathOffset = CheckedSize(result.strings_.size());
+        record.pathLength = CheckedSize(key.path.size());
+        record.firstValue = CheckedSize(result.values_.size());
+        result.strings_.append(key.path);
+        result.keys_.push_back(record);
+        for (PendingValue const& value : key.values)
+        {
+            Value valueRecord;
+            valueRecord.nameOffset = CheckedSize(result.strings_.size());
+            valueRecord.nameLength = CheckedSize(value.name.size());
+            valueRecord.type = value.type;
+            valueRecord.hash = value.hash;
+            result.strings_.append(value.name);
+            result.values_.push_back(valueRecord);
+        }
+    }
+
+    return result;
+}
+
+static void Put32(std::ostream& target, std::uint32_t value)
+{
+    char bytes[4];
+    for (std::size_t idx = 0; idx < sizeof(bytes); ++idx)
+    {
+        bytes[idx] = static_cast<char>(value >> (idx * 8));
+    }
+
+    target.write(bytes, sizeof(bytes));
+}
+
+static void Put64(std::ostream& target, std::uint64_t value)
+{
+    Put32(target, static_cast<std::uint32_t>(value));
+    Put32(target, static_cast<std::uint32_t>(value >> 32));
+}
+
+static std::uint32_t Get32(std::istream& source)
+{
+    unsigned char bytes[4];
+    if (!source.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+    {
+        throw InvalidRegistrySnapshotException();
+    }
+
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+           (static_cast<std::uint32_t>(bytes[3]) << 24);
+}
+
+static std::uint64_t Get64(std::istream& source)
+{
+    std::uint64_t const low = Get32(source);
+    return low | (static_cast<std::uint64_t>(Get32(source)) << 32);
+}
+
+void RegistrySnapshot::Save(std::ostream& target) const
+{
+    target.write(snapshotMagic, sizeof(snapshotMagic));
+    Put32(target, snapshotVersion);
+    Put32(target, CheckedSize(keys_.size()));
+    Put32(target, CheckedSize(values_.size()));
+    Put32(target, CheckedSize(strings_.size()));
+    target.write(strings_.data(), strings_.size());
+    for (Key const& key : keys_)
+    {
+        Put32(target, key.pathOffset);
+        Put32(target, key.pathLength);
+        Put32(target, key.firstValue);
+    }
+
+    for (Value const& value : values_)
+    {
+        Put32(target, value.nameOffset);
+        Put32(target, value.nameLength);
+        Put32(target, value.type);
+        Put64(target, value.hash);
+    }
+}
+
+RegistrySnapshot RegistrySnapshot::Load(std::istream& source)
+{
+    char magic[sizeof(snapshotMagic)];
+    if (!source.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, snapshotMagic, sizeof(magic)) != 0 ||
+        Get32(source) != snapshotVersion)
+    {
+        throw InvalidRegistrySnapshotException();
+    }
+
+    std::uint32_t const keyCount = Get32(source);
+    std::uint32_t const valueCount = Get32(source);
+    std::uint32_t const stringsLength = Get32(source);
+    RegistrySnapshot result;
+    result.strings_.resize(stringsLength);
+    if (stringsLength != 0 &&
+        !source.read(&result.strings_[0], stringsLength))
+    {
+        throw InvalidRegistrySnapshotException();
+    }
+
+    auto checkString = [stringsLength](std::uint32_t offset,
+                                       std::uint32_t length) {
+        if (offset > stringsLength || length > stringsLength - offset)
+        {
+            throw InvalidRegistrySnapshotException();
+        }
+    };
+
+    // Counts come from the file, so the vectors grow as records are read
+    // rather than being reserved up front.
+    std::uint32_t previousFirstValue = 0;
+    for (std::uint32_t idx = 0; idx < keyCount; ++idx)
+    {
+        Key key;
+        key.pathOffset = Get32(source);
+        key.pathLength = Get32(source);
+        key.firstValue = Get32(source);
+        checkString(key.pathOffset, key.pathLength);
+        if (key.firstValue < previousFirstValue || key.firstValue > valueCount)
+        {
+            throw InvalidRegistrySnapshotException();
+        }
+
+        previousFirstValue = key.firstValue;
+        result.keys_.push_back(key);
+    }
+
+    for (std::uint32_t idx = 0; idx < valueCount; ++idx)
+    {
+        Value value;
+        value.nameOffset = Get32(source);
+        value.nameLength = Get32(source);
+        value.type = Get32(source);
+        value.hash = Get64(source);
+        checkString(value.nameOffset, value.nameLength);
+        result.values_.push_back(value);
+    }
+
+    return result;
+}
+
+std::size_t RegistrySnapshot::GetKeyCount() const
+{
+    return keys_.size();
+}
+
+std::size_t RegistrySnapshot::GetValueCount() const
+{
+    return values_.size();
+}
+
+boost::string_ref RegistrySnapshot::GetKeyPath(std::size_t index) const
+{
+    Key const& key = keys_[index];
+    return boost::string_ref(strings_.data() + key.pathOffset, key.pathLength);
+}
+
+void RegistrySnapshot::GetValueRange(std::size_t index,
+                                     std::size_t& first,
+                                     std::size_t& last) const
+{
+    first = keys_[index].firstValue;
+    last = index + 1 == keys_.size() ? values_.size()
+                                      : keys_[index + 1].firstValue;
+}
+
+RegistrySnapshot::Value const&
+RegistrySnapshot::GetValue(std::size_t index) const
+{
+    return values_[index];
+}
+
+boost::string_ref RegistrySnapshot::GetValueName(std::size_t index) const
+{
+    Value const& value = values_[index];
+    return boost::string_ref(strings_.data() + value.nameOffset,
+                             value.nameLength);
+}
+
+static void DiffValues(RegistrySnapshot const& before,
+                       std::size_t beforeKey,
+                       RegistrySnapshot const& after,
+                       std::size_t afterKey,
+                       std::function<void(RegistryChange const&)> const& sink)
+{
+    std::size_t beforeIdx, beforeEnd, afterIdx, afterEnd;
+    before.GetValueRange(beforeKey, beforeIdx, beforeEnd);
+    after.GetValueRange(afterKey, afterIdx, afterEnd);
+    RegistryChange change;
+    change.key = after.GetKeyPath(afterKey);
+    while (beforeIdx != beforeEnd || afterIdx != afterEnd)
+    {
+        int comparison;
+        if (beforeIdx == beforeEnd)
+        {
+            comparison = 1;
+        }
+        else if (afterIdx == afterEnd)
+        {
+            comparison = -1;
+        }
+        else
+        {
+            comparison = CompareIgnoreCase(before.GetValueName(beforeIdx),
+                                           after.GetValueName(afterIdx));
+        }
+
+        if (comparison < 0)
+        {
+            change.type = RegistryChangeType::ValueRemoved;
+            change.value = before.GetValueName(beforeIdx++);
+            sink(change);
+        }
+        else if (comparison > 0)
+        {
+            change.type = RegistryChangeType::ValueAdded;
+            change.value = after.GetValueName(afterIdx++);
+            sink(change);
+        }
+        else
+        {
+            RegistrySnapshot::Value const& oldValue = before.GetValue(beforeIdx);
+            RegistrySnapshot::Value const& newValue = after.GetValue(afterIdx);
+            if (oldValue.type != newValue.type || oldValue.hash != newValue.hash)
+            {
+                change.type = RegistryChangeType::ValueChanged;
+                change.value = after.GetValueName(afterIdx);
+                sink(change);
+            }
+
+            ++beforeIdx;
+            ++afterIdx;
+        }
+    }
+}
+
+void DiffRegistrySnapshots(
+    RegistrySnapshot const& before,
+    RegistrySnapshot const& after,
+    std::function<void(RegistryChange const&)> const& sink)
+{
+    std::size_t beforeIdx = 0;
+    std::size_t afterIdx = 0;
+    std::size_t const beforeEnd = before.GetKeyCount();
+    std::size_t const afterEnd = after.GetKeyCount();
+    RegistryChange change;
+    while (beforeIdx != beforeEnd || afterIdx != afterEnd)
+    {
+        int comparison;
+        if (beforeIdx == beforeEnd)
+        {
+            comparison = 1;
+        }
+        else if (afterIdx == afterEnd)
+        {
+            comparison = -1;
+        }
+        else
+        {
+            comparison = CompareIgnoreCase(before.GetKeyPath(beforeIdx),
+                                           after.GetKeyPath(afterIdx));
+        }
+
+        if (comparison < 0)
+        {
+            change.type = RegistryChangeType::KeyRemoved;
+            change.key = before.GetKeyPath(beforeIdx++);
+            change.value.clear();
+            sink(change);
+        }
+        else if (comparison > 0)
+        {
+            change.type = RegistryChangeType::KeyAdded;
+            change.key = after.GetKeyPath(afterIdx++);
+            change.value.clear();
+            sink(change);
+        }
+        else
+        {
+            DiffValues(before, beforeIdx++, after, afterIdx++, sink);
+        }
+    }
+}
+
+void WriteRegistrySnapshotDiff(log_sink& output,
+                               RegistrySnapshot const& before,
+                               RegistrySnapshot const& after)
+{
+    DiffRegistrySnapshots(before, after, [&output](RegistryChange const& change) {
+        switch (change.type)
+        {
+        case RegistryChangeType::KeyAdded:
+            writeln(output, "Key added: ", change.key);
+            break;
+        case RegistryChangeType::KeyRemoved:
+            writeln(output, "Key removed: ", change.key);
+            break;
+        case RegistryChangeType::ValueAdded:
+            writeln(output, "Value added: ", change.key, " [", change.value, ']');
+            break;
+        case RegistryChangeType::ValueRemoved:
+            writeln(output, "Value removed: ", change.key, " [", change.value, ']');
+            break;
+        case RegistryChangeType::ValueChanged:
+            writeln(output, "Value changed: ", change.key, " [", change.value, ']');
+            break;
+        }
+    });
+}
+}
+}
@@ -0,0 +1,179 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <boost/utility/string_ref.hpp>
+#include "LogSink.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    Exception for signaling a snapshot stream which is truncated or
+///         was not written by RegistrySnapshot::Save.
+struct InvalidRegistrySnapshotException : public std::exception
+{
+    virtual char const* what() const
+    {
+        return "Invalid Registry Snapshot";
+    }
+};
+
+/// @brief    A compact, comparable record of one or more registry subtrees.
+///
+/// @remarks Key paths are held in a single string table, sorted case
+///          insensitively; each key owns a run of values sorted the same way.
+///          Values are recorded as their type and a 64 bit hash of their data
+///          rather than the data itself, so a snapshot costs a few dozen bytes
+///          per key and value, and two snapshots can be compared with a single
+///          merge pass.
+class RegistrySnapshot
+{
+    public:
+    struct Key
+    {
+        std::uint32_t pathOffset;
+        std::uint32_t pathLength;
+        std::uint32_t firstValue;
+    };
+
+    struct Value
+    {
+        std::uint32_t nameOffset;
+        std::uint32_t nameLength;
+        DWORD type;
+        std::uint64_t hash;
+    };
+
+    private:
+    std::string strings_;
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+
+    public:
+    /// @brief    Default constructor. Constructs an empty snapshot.
+    RegistrySnapshot();
+
+    /// @brief    Move constructor.
+    ///
+    /// @param [in,out]    other    The snapshot being moved from.
+    RegistrySnapshot(RegistrySnapshot&& other);
+
+    /// @brief    Assignment operator.
+    ///
+    /// @param    other    The snapshot being assigned from.
+    ///
+    /// @return    *this
+    RegistrySnapshot& operator=(RegistrySnapshot other);
+
+    /// @brief    Records the keys and values under the given roots.
+    ///
+    /// @remarks Roots which do not exist, and sub keys which cannot be opened,
+    ///          are left out of the snapshot. Overlapping roots are recorded
+    ///          once.
+    ///
+    /// @param    roots    Native paths of the subtrees to record, such as
+    ///                    \\Registry\\Machine\\Software\\Microsoft\\Windows.
+    ///
+    /// @return    The snapshot.
+    static RegistrySnapshot Capture(std::vector<std::string> const& roots);
+
+    /// @brief    Writes the snapshot in its binary form.
+    ///
+    /// @param [in,out]    target    The stream to write to. This should be
+    ///                              opened in binary mode.
+    void Save(std::ostream& target) const;
+
+    /// @brief    Reads a snapshot written by Save.
+    ///
+    /// @param [in,out]    source    The stream to read from.
+    ///
+    /// @throws InvalidRegistrySnapshotException The stream does not hold a
+    ///         snapshot.
+    ///
+    /// @return    The snapshot.
+    static RegistrySnapshot Load(std::istream& source);
+
+    /// @brief    Gets the number of keys in the snapshot.
+    std::size_t GetKeyCount() const;
+
+    /// @brief    Gets the number of values in the snapshot.
+    std::size_t GetValueCount() const;
+
+    /// @brief    Gets the path of a key.
+    ///
+    /// @param    index    Zero-based index of the key, in sorted order.
+    boost::string_ref GetKeyPath(std::size_t index) const;
+
+    /// @brief    Gets the range of values belonging to a key.
+    ///
+    /// @param    index    Zero-based index of the key, in sorted order.
+    /// @param [out]    first    Index of the key's first value.
+    /// @param [out]    last     Index one past the key's last value.
+    void GetValueRange(std::size_t index,
+                       std::size_t& first,
+                       std::size_t& last) const;
+
+    /// @brief    Gets a value record.
+    ///
+    /// @param    index    Zero-based index of the value.
+    Value const& GetValue(std::size_t index) const;
+
+    /// @brief    Gets the name of a value.
+    ///
+    /// @param    index    Zero-based index of the value.
+    boost::string_ref GetValueName(std::size_t index) const;
+};
+
+/// @brief    Kinds of difference between two registry snapshots.
+enum class RegistryChangeType
+{
+    KeyAdded,
+    KeyRemoved,
+    ValueAdded,
+    ValueRemoved,
+    ValueChanged
+};
+
+/// @brief    A single difference between two registry snapshots. The strings
+///         refer to the snapshots being compared.
+struct RegistryChange
+{
+    RegistryChangeType type;
+    boost::string_ref key;
+    boost::string_ref value;
+};
+
+/// @brief    Compares two snapshots, reporting each difference in key path
+///         order.
+///
+/// @remarks Runs in time linear in the size of the snapshots and needs no
+///          memory beyond them. Values of an added or removed key are not
+///          reported individually.
+///
+/// @param    before    The earlier snapshot.
+/// @param    after     The later snapshot.
+/// @param    sink      Called once for each difference.
+void DiffRegistrySnapshots(RegistrySnapshot const& before,
+                           RegistrySnapshot const& after,
+                           std::function<void(RegistryChange const&)> const& sink);
+
+/// @brief    Writes the differences between two snapshots, one per line.
+///
+/// @param [out]    output    The log to write to.
+/// @param    before          The earlier snapshot.
+/// @param    after           The later snapshot.
+void WriteRegistrySnapshotDiff(log_sink& output,
+                               RegistrySnapshot const& before,
+                               RegistrySnapshot const& after);
+}
+}
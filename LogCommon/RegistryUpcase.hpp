@@ -0,0 +1,27 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    Upper cases a UTF-16 code unit of a key or value name for case
+///         insensitive comparison of registry names.
+///
+/// @remarks This uses a built in table rather than towupper, which depends on
+///          the C locale, or the system's upcase table, which needs ntdll.
+///          The table holds Unicode 14.0's simple upper case mappings for the
+///          Basic Multilingual Plane, except that nothing outside ASCII maps
+///          into it; the dotless i and long s do not match I and S. Anything
+///          else, including code units above 0xFFFF, is returned unchanged.
+///
+/// @param    character    The code unit to upper case.
+///
+/// @return    The upper case code unit.
+wchar_t UpcaseRegistryCharacter(wchar_t character);
+}
+}
@@ -2,6 +2,12 @@
 // This is under the 2 clause BSD license.
 // See the included LICENSE.TXT file for more details.
 
+#include <algorithm>
+#include <chrono>
+#include <locale>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
 #include <vector>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -19,31 +25,74 @@
 #include "File.hpp"
 #include "Path.hpp"
 #include "ScanningSections.hpp"
+#include "WorkerThreads.hpp"
 
 namespace Instalog
 {
-template <typename Container>
-static bool list_contains(Container const& c, std::string const& input)
+// Upper cases a path so that it can be looked up in a set built the same
+// way, rather than compared against each entry with iequals.
+static std::string FoldProcessPath(std::string const& path)
 {
-    for (auto const& entry : c)
+    return boost::algorithm::to_upper_copy(path, std::locale::classic());
+}
+
+// Gets the log line for a single process. Returns false if the process
+// should not appear in the log.
+static bool GetRunningProcessLine(
+    SystemFacades::Process const& process,
+    std::unordered_set<std::string> const& noPrintSet,
+    std::unordered_set<std::string> const& fullPrintSet,
+    std::string& line)
+{
+    auto executableTry = process.GetExecutablePath();
+    if (!executableTry.is_valid())
+    {
+        line.clear();
+        write(line, "Could not open process PID=", process.GetProcessId());
+        return true;
+    }
+
+    auto executable = executableTry.get();
+    if (boost::starts_with(executable, "\\??\\"))
+    {
+        executable.erase(executable.begin(), executable.begin() + 4);
+    }
+
+    std::string const folded(FoldProcessPath(executable));
+    if (noPrintSet.count(folded) != 0)
+    {
+        return false;
+    }
+
+    if (fullPrintSet.count(folded) == 0)
     {
-        if (boost::algorithm::iequals(entry, input))
+        line = std::move(executable);
+    }
+    else
+    {
+        auto commandTry = process.GetCmdLine();
+        if (commandTry.is_valid())
         {
-            return true;
+            line = std::move(commandTry.get());
+        }
+        else
+        {
+            line = std::move(executable);
         }
     }
 
-    return false;
+    GeneralEscape(line);
+    return true;
 }
 
 void RunningProcesses::Execute(ExecutionOptions options) const
 {
+    using Instalog::SystemFacades::Process;
     using Instalog::SystemFacades::ProcessEnumerator;
-    using Instalog::SystemFacades::ErrorAccessDeniedException;
     using Instalog::SystemFacades::ScopedPrivilege;
 
     std::string winDir = Path::GetWindowsPath();
-    std::vector<std::string> fullPrintList;
+    std::unordered_set<std::string> fullPrintSet;
     char const* const fullPrintSources[] = {
         "System32\\Svchost.exe",
         "System32\\Svchost",
@@ -53,10 +102,10 @@ void RunningProcesses::Execute(ExecutionOptions options) const
 
     for (auto path : fullPrintSources)
     {
-        fullPrintList.emplace_back(Path::Append(winDir, path));
+        fullPrintSet.emplace(FoldProcessPath(Path::Append(winDir, path)));
     }
 
-    std::vector<std::string> noPrintList;
+    std::unordered_set<std::string> noPrintSet;
     char const* const noPrintSources[] = {
         "ntoskrnl.exe",
         "csrss.exe",
@@ -68,66 +117,67 @@ void RunningProcesses::Execute(ExecutionOptions options) const
     std::string system32(Path::Append(winDir, "system32"));
     for (auto path : noPrintSources)
     {
-        noPrintList.emplace_back(Path::Append(system32, path));
+        noPrintSet.emplace(FoldProcessPath(Path::Append(system32, path)));
     }
 
-    noPrintList.emplace_back("System Idle Process");
-    noPrintList.emplace_back("\\Systemroot\\System32\\smss.exe");
+    noPrintSet.emplace(FoldProcessPath("System Idle Process"));
+    noPrintSet.emplace(FoldProcessPath("\\Systemroot\\System32\\smss.exe"));
 
     ScopedPrivilege privilegeHolder(SE_DEBUG_NAME);
+    // Constructing the enumerator loads ntdll on this thread, before any
+    // worker looks it up.
     ProcessEnumerator enumerator;
-    for (ProcessEnumerator::iterator it = enumerator.begin();
-         it != enumerator.end();
-         ++it)
+    std::vector<Process> processes(enumerator.begin(), enumerator.end());
+
+    // Opening a process and reading its PEB is dominated by kernel round
+    // trips, so the processes are queried on a few threads. Results are
+    // kept by index so the log still follows enumeration order.
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    std::vector<std::string> lines(processes.size());
+    std::vector<char> printed(processes.size());
+    ParallelFor(processes.size(), [&](std::size_t index) {
+        printed[index] = GetRunningProcessLine(
+            processes[index], noPrintSet, fullPrintSet, lines[index]);
+    }, workerCount);
+
+    log_sink& output = options.GetOutput();
+    for (std::size_t index = 0; index < lines.size(); ++index)
     {
-        auto executableTry = it->GetExecutablePath();
-        if (executableTry.is_valid())
-        {
-            auto executable = executableTry.get();
-            if (boost::starts_with(executable, "\\??\\"))
-            {
-                executable.erase(executable.begin(), executable.begin() + 4);
-            }
-            if (list_contains(noPrintList, executable))
-            {
-                continue;
-            }
-            
-            executable.begin(), executable.end();
-            std::string pathElement;
-            auto equTest = [&](std::string const & str)->bool
-            {
-                return boost::iequals(executable, str, std::locale());
-            }
-            ;
-            if (std::find_if(fullPrintList.begin(),
-                             fullPrintList.end(),
-                             equTest) == fullPrintList.end())
-            {
-                pathElement = std::move(executable);
-            }
-            else
-            {
-                auto commandTry = it->GetCmdLine();
-                if (commandTry.is_valid())
-                {
-                    pathElement = std::move(commandTry.get());
-                }
-                else
-                {
-                    pathElement = std::move(executable);
-                }
-            }
-            GeneralEscape(pathElement);
-            writeln(options.GetOutput(), pathElement);
-        }
-        else
+        if (printed[index])
         {
-            writeln(options.GetOutput(), "Could not open process PID=", it->GetProcessId());
+            writeln(output, lines[index]);
         }
     }
 }
 
+// Formats the log line for a single service.
+static std::string GetServiceLine(SystemFacades::Service const& service)
+{
+    std::string currentServiceString;
+    write(currentServiceString, service.GetState(), service.GetStart());
+    if (service.IsDamagedSvchost())
+    {
+        currentServiceString.push_back('D');
+    }
+
+    write(currentServiceString, ' ', service.GetServiceName(), ';', service.GetDisplayName(), ';');
+    auto const& svcHostDll = service.GetSvchostDll();
+    string_sink tempSink;
+    if (service.IsSvchostService() && svcHostDll.is_valid())
+    {
+        write(currentServiceString, service.GetSvchostGroup(), "->");
+        WriteDefaultFileOutput(tempSink, svcHostDll.get());
+        currentServiceString.append(tempSink.get());
+    }
+    else
+    {
+        WriteDefaultFileOutput(tempSink, service.GetFilepath());
+    }
+    currentServiceString.append(tempSink.get());
+    return currentServiceString;
+}
+
 void
 ServicesDrivers::Execute(ExecutionOptions options) const
 {
@@ -136,64 +186,51 @@ ServicesDrivers::Execute(ExecutionOptions options) const
 
     ServiceControlManager scm;
     std::vector<Service> services = scm.GetServices();
-    std::vector<std::string> serviceStrings;
 
-    for (auto service = services.begin(); service != services.end(); ++service)
+    // Lines and their sort keys are kept in parallel arrays and an index is
+    // sorted, so each line is case folded once rather than on every
+    // comparison. Formatting stats each service's file, so it is spread
+    // across threads like the queries.
+    std::vector<std::string> serviceStrings(services.size());
+    std::vector<std::string> sortKeys(services.size());
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    ParallelFor(services.size(), [&](std::size_t index) {
+        serviceStrings[index] = GetServiceLine(services[index]);
+        sortKeys[index] =
+            boost::algorithm::to_upper_copy(serviceStrings[index], std::locale());
+    }, workerCount);
+
+    std::vector<std::size_t> order(services.size());
+    for (std::size_t index = 0; index < order.size(); ++index)
     {
-        std::string currentServiceString;
-        write(currentServiceString, service->GetState(), service->GetStart());
-        if (service->IsDamagedSvchost())
-        {
-            currentServiceString.push_back('D');
-        }
-
-        write(currentServiceString, ' ', service->GetServiceName(), ';', service->GetDisplayName(), ';');
-        auto const& svcHostDll = service->GetSvchostDll();
-        string_sink tempSink;
-        if (service->IsSvchostService() && svcHostDll.is_valid())
-        {
-            write(currentServiceString, service->GetSvchostGroup(), "->");
-            WriteDefaultFileOutput(tempSink, svcHostDll.get());
-            currentServiceString.append(tempSink.get());
-        }
-        else
-        {
-            WriteDefaultFileOutput(tempSink, service->GetFilepath());
-        }
-        currentServiceString.append(tempSink.get());
-        serviceStrings.emplace_back(std::move(currentServiceString));
+        order[index] = index;
     }
 
-    std::sort(serviceStrings.begin(),
-              serviceStrings.end(),
-              [](std::string const & a, std::string const & b) {
-        return boost::ilexicographical_compare(a, b);
+    // Compared as char, which is what ilexicographical_compare did, so the
+    // order is unchanged.
+    std::sort(order.begin(),
+              order.end(),
+              [&](std::size_t a, std::size_t b) {
+        return std::lexicographical_compare(sortKeys[a].begin(),
+                                            sortKeys[a].end(),
+                                            sortKeys[b].begin(),
+                                            sortKeys[b].end());
     });
 
-    for (auto const& serviceString : serviceStrings)
+    for (std::size_t index : order)
     {
-        writeln(options.GetOutput(), serviceString);
+        writeln(options.GetOutput(), serviceStrings[index]);
     }
 }
 
 void EventViewer::Execute(ExecutionOptions options) const
 {
+    using Instalog::SystemFacades::EventLog;
     using Instalog::SystemFacades::OldEventLog;
     using Instalog::SystemFacades::XmlEventLog;
     using Instalog::SystemFacades::EventLogEntry;
-
-    // Query the entries
-    std::vector<std::unique_ptr<EventLogEntry>> eventLogEntries;
-    try
-    {
-        XmlEventLog xmlEventLog("System", "Event/System[Level=1 or Level=2]");
-        eventLogEntries = xmlEventLog.ReadEvents();
-    }
-    catch (Instalog::SystemFacades::Win32Exception const&)
-    {
-        OldEventLog eventLog;
-        eventLogEntries = eventLog.ReadEvents();
-    }
+    using Instalog::SystemFacades::MakeEventQuery;
 
     // Calculate the time a week ago
     SYSTEMTIME currentSystemTime;
@@ -209,35 +246,52 @@ void EventViewer::Execute(ExecutionOptions options) const
     ULARGE_INTEGER oneWeekAgo;
     oneWeekAgo.QuadPart = currentTime.QuadPart - 6048000000000ll;
 
-    // Log applicable events
-    for (auto eventLogEntry = eventLogEntries.begin();
-         eventLogEntry != eventLogEntries.end();
-         ++eventLogEntry)
+    // Let the event log service do the filtering where it can, so that only
+    // the handful of matching events are ever rendered. The checks below
+    // still apply, as the legacy log cannot be queried this way.
+    std::string const query = MakeEventQuery(
+        {EventLogEntry::EvtLevelCritical, EventLogEntry::EvtLevelError},
+        7ull * 24 * 60 * 60 * 1000,
+        {1000, 8023, 10010});
+    std::unique_ptr<EventLog> eventLog;
+    bool newestFirst = false;
+    try
     {
-        auto const level = (*eventLogEntry)->level;
-        // Whitelist everything but "Critical" and "Error" messages
-        if (level != EventLogEntry::EvtLevelCritical &&
-            level != EventLogEntry::EvtLevelError)
-            continue;
+        eventLog.reset(new XmlEventLog("System", query.c_str()));
+    }
+    catch (Instalog::SystemFacades::Win32Exception const&)
+    {
+        eventLog.reset(new OldEventLog());
+        newestFirst = true;
+    }
 
-        // Whitelist all events that are older than this week
+    // Log applicable events
+    eventLog->ReadEvents([&](EventLogEntry& eventLogEntry) -> bool {
+        // Whitelist all events that are older than this week. The legacy log
+        // is read newest first, so nothing after this can be logged either.
         ULARGE_INTEGER date;
-        date.LowPart = (*eventLogEntry)->date.dwLowDateTime;
-        date.HighPart = (*eventLogEntry)->date.dwHighDateTime;
+        date.LowPart = eventLogEntry.date.dwLowDateTime;
+        date.HighPart = eventLogEntry.date.dwHighDateTime;
         if (date.QuadPart < oneWeekAgo.QuadPart)
-            continue;
+            return !newestFirst;
+
+        auto const level = eventLogEntry.level;
+        // Whitelist everything but "Critical" and "Error" messages
+        if (level != EventLogEntry::EvtLevelCritical &&
+            level != EventLogEntry::EvtLevelError)
+            return true;
 
         // Whitelist EventIDs 1000, 8023, 10010
-        auto eventId = (*eventLogEntry)->eventId;
+        auto eventId = eventLogEntry.eventId;
         if (eventId == 1000 || eventId == 8023 || eventId == 10010)
-            continue;
+            return true;
 
         // Print the Date
         WriteDefaultDateFormat(options.GetOutput(),
-                               FiletimeToInteger((*eventLogEntry)->date));
+                               FiletimeToInteger(eventLogEntry.date));
 
         // Print the Type
-        switch ((*eventLogEntry)->level)
+        switch (level)
         {
         case EventLogEntry::EvtLevelCritical:
             write(options.GetOutput(), ", Critical: ");
@@ -248,60 +302,46 @@ void EventViewer::Execute(ExecutionOptions options) const
         }
 
         // Print the Source
-        auto const& source = (*eventLogEntry)->GetSource();
+        auto const& source = eventLogEntry.GetSource();
         write(options.GetOutput(), source, " [");
 
         // Print the EventID
         write(options.GetOutput(), eventId, "] ");
 
         // Print the description
-        std::string description = (*eventLogEntry)->GetDescription();
+        std::string description = eventLogEntry.GetDescription();
         GeneralEscape(description);
         if (boost::algorithm::ends_with(description, "#r#n"))
         {
             description.erase(description.end() - 4, description.end());
         }
         writeln(options.GetOutput(), description);
-    }
+        return true;
+    });
 }
 
-void MachineSpecifications::OperatingSystem(log_sink& logOutput) const
+// Gets the single instance a machine specifications query should return.
+static SystemFacades::UniqueComPtr<IWbemClassObject>
+GetSingleInstance(SystemFacades::WmiQueryBatch& wmi, std::size_t query)
 {
-    using namespace SystemFacades;
-
-    UniqueComPtr<IWbemServices> wbemServices(GetWbemServices());
+    auto instances = wmi.GetResults(query);
+    if (instances.empty())
+    {
+        throw std::runtime_error("Unexpected number of returned classes.");
+    }
 
-    UniqueComPtr<IWbemServices> namespaceCimv2;
-    ThrowIfFailed(wbemServices->OpenNamespace(
-        BSTR(L"cimv2"), 0, NULL, namespaceCimv2.PassAsOutParameter(), NULL));
+    return std::move(instances.front());
+}
 
-    UniqueComPtr<IEnumWbemClassObject> enumWin32_OperatingSystem;
-    ThrowIfFailed(namespaceCimv2->CreateInstanceEnum(
-        BSTR(L"Win32_OperatingSystem"),
-        WBEM_FLAG_FORWARD_ONLY,
-        NULL,
-        enumWin32_OperatingSystem.PassAsOutParameter()));
+void MachineSpecifications::OperatingSystem(log_sink& logOutput,
+                                            SystemFacades::WmiQueryBatch& wmi,
+                                            std::size_t query) const
+{
+    using namespace SystemFacades;
 
-    HRESULT hr;
-    ULONG returnCount = 0;
-    UniqueComPtr<IWbemClassObject> response;
+    UniqueComPtr<IWbemClassObject> response(GetSingleInstance(wmi, query));
     UniqueVariant variant;
 
-    hr = enumWin32_OperatingSystem->Next(
-        WBEM_INFINITE, 1, response.PassAsOutParameter(), &returnCount);
-    if (hr == WBEM_S_FALSE)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-    else if (FAILED(hr))
-    {
-        ThrowFromHResult(hr);
-    }
-    else if (returnCount == 0)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-
     ThrowIfFailed(response->Get(
         L"SystemDrive", 0, variant.PassAsOutParameter(), NULL, NULL));
     writeln(logOutput, "Boot Device: ", variant.AsString(GetThrowingErrorReporter()));
@@ -369,50 +409,56 @@ void MachineSpecifications::PerfFormattedData_PerfOS_System(
 
 void MachineSpecifications::Execute(ExecutionOptions options) const
 {
-    OperatingSystem(options.GetOutput());
-    PerfFormattedData_PerfOS_System(options.GetOutput());
-    BaseBoard(options.GetOutput());
-    Processor(options.GetOutput());
-    LogicalDisk(options.GetOutput());
+    using namespace SystemFacades;
+    log_sink& logOutput = options.GetOutput();
+
+    // All of the queries are issued before any results are read, so WMI
+    // answers them concurrently over one connection. A provider which does
+    // not answer before the deadline costs only its own lines.
+    WmiQueryBatch wmi(L"cimv2", std::chrono::seconds(30));
+    std::size_t const operatingSystem = wmi.Add(
+        L"SELECT SystemDrive, InstallDate FROM Win32_OperatingSystem");
+    std::size_t const baseBoard =
+        wmi.Add(L"SELECT Manufacturer, Product FROM Win32_BaseBoard");
+    std::size_t const processor = wmi.Add(L"SELECT Name FROM Win32_Processor");
+    std::size_t const logicalDisk = wmi.Add(
+        L"SELECT DeviceID, DriveType, Size, FreeSpace FROM Win32_LogicalDisk");
+
+    typedef void (MachineSpecifications::*WmiSection)(
+        log_sink&, WmiQueryBatch&, std::size_t) const;
+    auto const writeSection =
+        [&](WmiSection section, std::size_t query, char const* className) {
+        try
+        {
+            (this->*section)(logOutput, wmi, query);
+        }
+        catch (WmiTimeoutException const&)
+        {
+            writeln(logOutput, "(Timed out querying ", className, ')');
+        }
+    };
+
+    writeSection(&MachineSpecifications::OperatingSystem,
+                 operatingSystem,
+                 "Win32_OperatingSystem");
+    PerfFormattedData_PerfOS_System(logOutput);
+    writeSection(
+        &MachineSpecifications::BaseBoard, baseBoard, "Win32_BaseBoard");
+    writeSection(
+        &MachineSpecifications::Processor, processor, "Win32_Processor");
+    writeSection(
+        &MachineSpecifications::LogicalDisk, logicalDisk, "Win32_LogicalDisk");
 }
 
-void MachineSpecifications::BaseBoard(log_sink& logOutput) const
+void MachineSpecifications::BaseBoard(log_sink& logOutput,
+                                      SystemFacades::WmiQueryBatch& wmi,
+                                      std::size_t query) const
 {
     using namespace SystemFacades;
 
-    UniqueComPtr<IWbemServices> wbemServices(GetWbemServices());
-
-    UniqueComPtr<IWbemServices> namespaceCimv2;
-    ThrowIfFailed(wbemServices->OpenNamespace(
-        BSTR(L"cimv2"), 0, NULL, namespaceCimv2.PassAsOutParameter(), NULL));
-
-    UniqueComPtr<IEnumWbemClassObject> enumWin32_BaseBoard;
-    ThrowIfFailed(namespaceCimv2->CreateInstanceEnum(
-        BSTR(L"Win32_BaseBoard"),
-        WBEM_FLAG_FORWARD_ONLY,
-        NULL,
-        enumWin32_BaseBoard.PassAsOutParameter()));
-
-    HRESULT hr;
-    ULONG returnCount = 0;
-    UniqueComPtr<IWbemClassObject> response;
+    UniqueComPtr<IWbemClassObject> response(GetSingleInstance(wmi, query));
     UniqueVariant variant;
 
-    hr = enumWin32_BaseBoard->Next(
-        WBEM_INFINITE, 1, response.PassAsOutParameter(), &returnCount);
-    if (hr == WBEM_S_FALSE)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-    else if (FAILED(hr))
-    {
-        ThrowFromHResult(hr);
-    }
-    else if (returnCount == 0)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-
     ThrowIfFailed(response->Get(
         L"Manufacturer", 0, variant.PassAsOutParameter(), NULL, NULL));
     write(logOutput, "Motherboard: ", variant.AsString(GetThrowingErrorReporter()));
@@ -421,87 +467,30 @@ void MachineSpecifications::BaseBoard(log_sink& logOutput) const
     writeln(logOutput, ' ', variant.AsString(GetThrowingErrorReporter()));
 }
 
-void MachineSpecifications::Processor(log_sink& logOutput) const
+void MachineSpecifications::Processor(log_sink& logOutput,
+                                      SystemFacades::WmiQueryBatch& wmi,
+                                      std::size_t query) const
 {
     using namespace SystemFacades;
 
-    UniqueComPtr<IWbemServices> wbemServices(GetWbemServices());
-
-    UniqueComPtr<IWbemServices> namespaceCimv2;
-    ThrowIfFailed(wbemServices->OpenNamespace(
-        BSTR(L"cimv2"), 0, NULL, namespaceCimv2.PassAsOutParameter(), NULL));
-
-    UniqueComPtr<IEnumWbemClassObject> enumWin32_Processor;
-    ThrowIfFailed(namespaceCimv2->CreateInstanceEnum(
-        BSTR(L"Win32_Processor"),
-        WBEM_FLAG_FORWARD_ONLY,
-        NULL,
-        enumWin32_Processor.PassAsOutParameter()));
-
-    HRESULT hr;
-    ULONG returnCount = 0;
-    UniqueComPtr<IWbemClassObject> response;
+    UniqueComPtr<IWbemClassObject> response(GetSingleInstance(wmi, query));
     UniqueVariant variant;
 
-    hr = enumWin32_Processor->Next(
-        WBEM_INFINITE, 1, response.PassAsOutParameter(), &returnCount);
-    if (hr == WBEM_S_FALSE)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-    else if (FAILED(hr))
-    {
-        ThrowFromHResult(hr);
-    }
-    else if (returnCount == 0)
-    {
-        throw std::runtime_error("Unexpected number of returned classes.");
-    }
-
     ThrowIfFailed(
         response->Get(L"Name", 0, variant.PassAsOutParameter(), NULL, NULL));
     writeln(logOutput, "Processor: ", variant.AsString(GetThrowingErrorReporter()));
 }
 
-void MachineSpecifications::LogicalDisk(log_sink& logOutput) const
+void MachineSpecifications::LogicalDisk(log_sink& logOutput,
+                                        SystemFacades::WmiQueryBatch& wmi,
+                                        std::size_t query) const
 {
     using namespace SystemFacades;
 
-    UniqueComPtr<IWbemServices> wbemServices(GetWbemServices());
-
-    UniqueComPtr<IWbemServices> namespaceCimv2;
-    ThrowIfFailed(wbemServices->OpenNamespace(
-        BSTR(L"cimv2"), 0, NULL, namespaceCimv2.PassAsOutParameter(), NULL));
-
-    UniqueComPtr<IEnumWbemClassObject> enumWin32_LogicalDisk;
-    ThrowIfFailed(namespaceCimv2->CreateInstanceEnum(
-        BSTR(L"Win32_LogicalDisk"),
-        WBEM_FLAG_FORWARD_ONLY,
-        NULL,
-        enumWin32_LogicalDisk.PassAsOutParameter()));
-
-    for (;;)
+    for (auto& response : wmi.GetResults(query))
     {
-        HRESULT hr;
-        ULONG returnCount = 0;
-        UniqueComPtr<IWbemClassObject> response;
         UniqueVariant variant;
 
-        hr = enumWin32_LogicalDisk->Next(
-            WBEM_INFINITE, 1, response.PassAsOutParameter(), &returnCount);
-        if (hr == WBEM_S_FALSE)
-        {
-            break;
-        }
-        else if (FAILED(hr))
-        {
-            ThrowFromHResult(hr);
-        }
-        else if (returnCount == 0)
-        {
-            throw std::runtime_error("Unexpected number of returned classes.");
-        }
-
         ThrowIfFailed(response->Get(
             L"DeviceID", 0, variant.PassAsOutParameter(), NULL, NULL));
         write(logOutput, variant.AsString(GetThrowingErrorReporter()), " is ");
@@ -604,86 +593,76 @@ void InstalledPrograms::Enumerate(log_sink& logOutput,
         Win32Exception::ThrowFromNtError(::GetLastError());
     }
 
-    std::vector<RegistryKey> uninstallKeys(rootKey.EnumerateSubKeys());
+    // Only entries with a display name are listed, so other sub keys are
+    // passed over without reading their values.
     std::vector<std::string> entries;
-
-    for (auto uninstallKey = uninstallKeys.begin();
-         uninstallKey != uninstallKeys.end();
-         ++uninstallKey)
-    {
+    rootKey.ForEachSubKey({"DisplayName"},
+                          [&](std::string const&,
+                              RegistryKey const& uninstallKey) {
         std::string currentEntry;
-        try
-        {
-            uninstallKey->GetValue("ParentKeyName");
-            continue;
-        }
-        catch (ErrorFileNotFoundException const&)
+        if (uninstallKey.TryGetValue("ParentKeyName").is_valid())
         {
-            // Expected behavior
+            return;
         }
-        try
+        auto systemComponent = uninstallKey.TryGetValue("SystemComponent");
+        if (systemComponent.is_valid())
         {
-            if (uninstallKey->GetValue("SystemComponent").GetDWord() == 1)
+            try
             {
-                continue;
+                if (systemComponent.get().GetDWord() == 1)
+                {
+                    return;
+                }
+            }
+            catch (InvalidRegistryDataTypeException const&)
+            {
+                // Expected behavior
             }
         }
-        catch (ErrorFileNotFoundException const&)
+        auto displayName = uninstallKey.TryGetValue("DisplayName");
+        if (!displayName.is_valid())
         {
-            // Expected behavior
+            return;
         }
-        catch (InvalidRegistryDataTypeException const&)
+        currentEntry = displayName.get().GetString();
+        // A common bug in programs is that they set their display name to end with a null in the registry.
+        if (!currentEntry.empty() && currentEntry.back() == '\0')
         {
-            // Expected behavior
+            currentEntry.pop_back();
         }
-        try
-        {
-            RegistryValue displayName(uninstallKey->GetValue("DisplayName"));
-            currentEntry = displayName.GetString();
-            // A common bug in programs is that they set their display name to end with a null in the registry.
-            if (!currentEntry.empty() && currentEntry.back() == '\0')
-            {
-                currentEntry.pop_back();
-            }
 
-            GeneralEscape(currentEntry);
-        }
-        catch (ErrorFileNotFoundException const&)
-        {
-            continue;
-        }
+        GeneralEscape(currentEntry);
 
-        try
+        auto versionMajor = uninstallKey.TryGetValue("VersionMajor");
+        if (versionMajor.is_valid())
         {
-            RegistryValue versionMajor(uninstallKey->GetValue("VersionMajor"));
-            RegistryValue versionMinor(uninstallKey->GetValue("VersionMinor"));
-
-            currentEntry += " (version ";
-            if (versionMajor.GetType() == REG_DWORD)
-            {
-                write(currentEntry, versionMajor.GetDWord());
-            }
-            else
-            {
-                currentEntry += versionMajor.GetString();
-            }
-            currentEntry.push_back('.');
-            if (versionMinor.GetType() == REG_DWORD)
-            {
-                write(currentEntry, versionMinor.GetDWord());
-            }
-            else
+            auto versionMinor = uninstallKey.TryGetValue("VersionMinor");
+            if (versionMinor.is_valid())
             {
-                currentEntry += versionMinor.GetString();
+                currentEntry += " (version ";
+                if (versionMajor.get().GetType() == REG_DWORD)
+                {
+                    write(currentEntry, versionMajor.get().GetDWord());
+                }
+                else
+                {
+                    currentEntry += versionMajor.get().GetString();
+                }
+                currentEntry.push_back('.');
+                if (versionMinor.get().GetType() == REG_DWORD)
+                {
+                    write(currentEntry, versionMinor.get().GetDWord());
+                }
+                else
+                {
+                    currentEntry += versionMinor.get().GetString();
+                }
+                currentEntry.push_back(')');
             }
-            currentEntry.push_back(')');
-        }
-        catch (ErrorFileNotFoundException const&)
-        {
         }
 
         entries.emplace_back(std::move(currentEntry));
-    }
+    });
     std::sort(entries.begin(),
               entries.end(),
               [](std::string const & a, std::string const & b) {
@@ -7,6 +7,11 @@
 
 namespace Instalog
 {
+namespace SystemFacades
+{
+class WmiQueryBatch;
+}
+
 /// @brief    Running processes scanning section
 struct RunningProcesses : public ISectionDefinition
 {
@@ -80,11 +85,19 @@ struct MachineSpecifications : public ISectionDefinition
     virtual void Execute(ExecutionOptions options) const override;
 
     private:
-    void OperatingSystem(log_sink& logOutput) const;
+    void OperatingSystem(log_sink& logOutput,
+                         SystemFacades::WmiQueryBatch& wmi,
+                         std::size_t query) const;
     void PerfFormattedData_PerfOS_System(log_sink& logOutput) const;
-    void BaseBoard(log_sink& logOutput) const;
-    void Processor(log_sink& logOutput) const;
-    void LogicalDisk(log_sink& logOutput) const;
+    void BaseBoard(log_sink& logOutput,
+                   SystemFacades::WmiQueryBatch& wmi,
+                   std::size_t query) const;
+    void Processor(log_sink& logOutput,
+                   SystemFacades::WmiQueryBatch& wmi,
+                   std::size_t query) const;
+    void LogicalDisk(log_sink& logOutput,
+                     SystemFacades::WmiQueryBatch& wmi,
+                     std::size_t query) const;
 };
 
 /// @brief    Restore points scanning section
@@ -4,10 +4,15 @@
 
 #include <clocale>
 #include <algorithm>
+#include <chrono>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include "EventMessageCache.hpp"
+#include "FileMetadataCache.hpp"
+#include "Process.hpp"
+#include "Registry.hpp"
 #include "Scripting.hpp"
 #include "StockOutputFormats.hpp"
 #include "StringUtilities.hpp"
@@ -124,6 +129,11 @@ Script::GetSections() const
 void Script::Run(log_sink& logOutput, IUserInterface* ui) const
 {
     ui->LogMessage("Starting Execution");
+    SystemFacades::RegistryHandleCache registryCache;
+    SystemFacades::GetFileMetadataCache().Clear();
+    // Processes which start or exit while the scan runs, such as ones which
+    // respawn when killed, are reported once the log is written.
+    SystemFacades::ProcessSampler processSampler(std::chrono::seconds(1));
     auto startTime = Instalog::GetLocalTime();
     WriteScriptHeader(logOutput, startTime);
     typedef std::pair<ScriptSection, std::vector<std::string>> contained;
@@ -154,6 +164,23 @@ void Script::Run(log_sink& logOutput, IUserInterface* ui) const
 
     writeln(logOutput);
     WriteScriptFooter(logOutput, startTime);
+    ui->LogMessage(
+        "Registry handle cache saved " +
+        std::to_string(registryCache.GetOpensSaved()) + " opens, " +
+        std::to_string(registryCache.GetRelativeOpens()) +
+        " opened relative to a cached parent");
+    ui->LogMessage(
+        "Event message cache: " +
+        format_value(SystemFacades::GetEventMessageCache().GetStatistics()));
+    processSampler.Stop();
+    for (SystemFacades::ProcessChange const& change :
+         processSampler.TakeChanges())
+    {
+        ui->LogMessage(std::string(change.started ? "Process started"
+                                                  : "Process exited") +
+                       " during scan: " + change.imageName + " (PID " +
+                       std::to_string(change.processId) + ")");
+    }
     ui->ReportFinished();
 }
 
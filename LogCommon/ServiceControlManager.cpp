@@ -4,6 +4,7 @@
 
 #include <type_traits>
 #include <algorithm>
+#include <memory>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/find.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -13,6 +14,7 @@
 #include "Registry.hpp"
 #include "File.hpp"
 #include "Utf8.hpp"
+#include "WorkerThreads.hpp"
 
 namespace Instalog
 {
@@ -221,7 +223,6 @@ ServiceControlManager::~ServiceControlManager()
 std::vector<Service> ServiceControlManager::GetServices() const
 {
     DWORD const bufferSize = 65536;
-    std::vector<Service> services;
 
     // 64k bytes stack buffer size aligned for ENUM_SERVICE_STATUSW structures.
     typedef std::aligned_storage<
@@ -235,6 +236,9 @@ std::vector<Service> ServiceControlManager::GetServices() const
     DWORD resumeHandle = 0;
     BOOL status = false;
     DWORD error = ERROR_MORE_DATA;
+    std::vector<std::string> serviceNames;
+    std::vector<std::string> displayNames;
+    std::vector<SERVICE_STATUS> statuses;
 
     do
     {
@@ -255,13 +259,34 @@ std::vector<Service> ServiceControlManager::GetServices() const
         for (auto enumServiceStatus = servicesBuffer; servicesReturned > 0;
              --servicesReturned, ++enumServiceStatus)
         {
-            services.emplace_back(utf8::ToUtf8(enumServiceStatus->lpServiceName),
-                                  utf8::ToUtf8(enumServiceStatus->lpDisplayName),
-                                  enumServiceStatus->ServiceStatus,
-                                  scmHandle);
+            serviceNames.emplace_back(
+                utf8::ToUtf8(enumServiceStatus->lpServiceName));
+            displayNames.emplace_back(
+                utf8::ToUtf8(enumServiceStatus->lpDisplayName));
+            statuses.push_back(enumServiceStatus->ServiceStatus);
         }
     } while (status == false && error == ERROR_MORE_DATA);
 
+    // Each service costs several round trips to the service control manager
+    // and the registry, plus file system lookups to resolve its path, so
+    // the services are built on a few threads sharing this manager's handle.
+    std::vector<std::unique_ptr<Service>> built(serviceNames.size());
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    ParallelFor(built.size(), [&](std::size_t index) {
+        built[index].reset(new Service(serviceNames[index],
+                                       displayNames[index],
+                                       statuses[index],
+                                       scmHandle));
+    }, workerCount);
+
+    std::vector<Service> services;
+    services.reserve(built.size());
+    for (std::unique_ptr<Service>& service : built)
+    {
+        services.emplace_back(std::move(*service));
+    }
+
     return services;
 }
 }
@@ -151,6 +151,9 @@ class ServiceControlManager
 
     /// @brief    Enumerates all of the services running on the machine.
     ///
+    /// @remarks The services are queried on several threads, all using this
+    ///          instance's handle; the result is in enumeration order.
+    ///
     /// @return    A vector of Service objects
     ///
     /// @throw    Win32Exception on error
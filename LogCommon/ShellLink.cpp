@@ -0,0 +1,617 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstring>
+#include "ShellLink.hpp"
+#include "Utf8.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+// Layout constants for MS-SHLLINK. Offsets are relative to the start of the
+// structure named in the constant.
+static std::size_t const headerSize = 0x4C;
+static std::size_t const headerFlagsOffset = 0x14;
+static unsigned char const linkClsid[16] = {0x01, 0x14, 0x02, 0x00,
+                                            0x00, 0x00, 0x00, 0x00,
+                                            0xC0, 0x00, 0x00, 0x00,
+                                            0x00, 0x00, 0x00, 0x46};
+
+static std::uint32_t const hasLinkTargetIdList = 0x00000001;
+static std::uint32_t const hasLinkInfo = 0x00000002;
+static std::uint32_t const hasName = 0x00000004;
+static std::uint32_t const hasRelativePath = 0x00000008;
+static std::uint32_t const hasWorkingDir = 0x00000010;
+static std::uint32_t const hasArguments = 0x00000020;
+static std::uint32_t const hasIconLocation = 0x00000040;
+static std::uint32_t const isUnicode = 0x00000080;
+static std::uint32_t const forceNoLinkInfo = 0x00000100;
+static std::uint32_t const hasExpString = 0x00000200;
+
+static std::size_t const linkInfoMinimumHeaderSize = 0x1C;
+static std::size_t const linkInfoUnicodeHeaderSize = 0x24;
+static std::size_t const linkInfoFlagsOffset = 0x08;
+static std::size_t const linkInfoLocalBasePathOffset = 0x10;
+static std::size_t const linkInfoNetworkLinkOffset = 0x14;
+static std::size_t const linkInfoCommonPathSuffixOffset = 0x18;
+static std::size_t const linkInfoLocalBasePathUnicodeOffset = 0x1C;
+static std::size_t const linkInfoCommonPathSuffixUnicodeOffset = 0x20;
+static std::uint32_t const volumeIdAndLocalBasePath = 0x00000001;
+static std::uint32_t const commonNetworkRelativeLinkAndPathSuffix = 0x00000002;
+static std::size_t const networkLinkMinimumSize = 0x14;
+static std::size_t const networkLinkNetNameOffset = 0x08;
+static std::size_t const networkLinkNetNameUnicodeOffset = 0x14;
+
+static std::uint32_t const environmentVariableDataBlock = 0xA0000001;
+static std::size_t const environmentBlockSize = 0x314;
+static std::size_t const environmentTargetAnsiOffset = 0x08;
+static std::size_t const environmentTargetUnicodeOffset = 0x10C;
+static std::size_t const environmentTargetCharacters = 260;
+
+// Shell items in the target ID list. The class type is the high nibble of
+// the item's type byte.
+static unsigned char const rootFolderItem = 0x1F;
+static unsigned char const itemClassMask = 0x70;
+static unsigned char const volumeItemClass = 0x20;
+static unsigned char const fileEntryItemClass = 0x30;
+static unsigned char const fileEntryUnicodeFlag = 0x04;
+static std::size_t const volumeNameOffset = 3;
+static std::size_t const fileEntryPrimaryNameOffset = 14;
+static std::uint32_t const fileEntryExtensionSignature = 0xBEEF0004;
+
+// Windows-1252 assigns these characters to 0x80 through 0x9F; zero marks
+// the bytes it leaves undefined, which are read as their Latin-1 control
+// characters.
+static std::uint16_t const windows1252High[32] = {
+    0x20AC, 0,      0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0,      0x017D, 0,
+    0,      0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0,      0x017E, 0x0178};
+
+static std::uint16_t ReadU16(unsigned char const* source)
+{
+    std::uint16_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint32_t ReadU32(unsigned char const* source)
+{
+    std::uint32_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::string ReadAnsi(unsigned char const* source, std::size_t length)
+{
+    std::wstring result;
+    result.reserve(length);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        unsigned char const ch = source[idx];
+        if (ch >= 0x80 && ch <= 0x9F && windows1252High[ch - 0x80] != 0)
+        {
+            result.push_back(static_cast<wchar_t>(windows1252High[ch - 0x80]));
+        }
+        else
+        {
+            result.push_back(static_cast<wchar_t>(ch));
+        }
+    }
+
+    return utf8::ToUtf8(result);
+}
+
+static std::string ReadUnicode(unsigned char const* source, std::size_t length)
+{
+    // Links are untrusted, so unpaired surrogates become U+FFFD rather than
+    // failing the conversion.
+    std::wstring result;
+    result.reserve(length);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        std::uint16_t const ch = ReadU16(source + idx * 2);
+        if (ch < 0xD800 || ch > 0xDFFF)
+        {
+            result.push_back(static_cast<wchar_t>(ch));
+            continue;
+        }
+
+        if (ch <= 0xDBFF && idx + 1 < length)
+        {
+            std::uint16_t const low = ReadU16(source + (idx + 1) * 2);
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+                result.push_back(static_cast<wchar_t>(ch));
+                result.push_back(static_cast<wchar_t>(low));
+                ++idx;
+                continue;
+            }
+        }
+
+        result.push_back(static_cast<wchar_t>(0xFFFD));
+    }
+
+    return utf8::ToUtf8(result);
+}
+
+// Finds the length of a null terminated ANSI string which must end before
+// limit.
+static bool FindAnsiZ(unsigned char const* first,
+                      std::size_t offset,
+                      std::size_t limit,
+                      std::size_t& length)
+{
+    if (offset >= limit)
+    {
+        return false;
+    }
+
+    void const* const terminator =
+        std::memchr(first + offset, 0, limit - offset);
+    if (terminator == nullptr)
+    {
+        return false;
+    }
+
+    length = static_cast<unsigned char const*>(terminator) - (first + offset);
+    return true;
+}
+
+// Finds the length, in characters, of a null terminated UTF-16 string which
+// must end before limit.
+static bool FindUnicodeZ(unsigned char const* first,
+                         std::size_t offset,
+                         std::size_t limit,
+                         std::size_t& length)
+{
+    length = 0;
+    for (;;)
+    {
+        if (limit < offset || (limit - offset) / 2 <= length)
+        {
+            return false;
+        }
+
+        if (ReadU16(first + offset + length * 2) == 0)
+        {
+            return true;
+        }
+
+        ++length;
+    }
+}
+
+static bool ReadAnsiZ(unsigned char const* first,
+                      std::size_t offset,
+                      std::size_t limit,
+                      std::string& result)
+{
+    std::size_t length;
+    if (!FindAnsiZ(first, offset, limit, length))
+    {
+        return false;
+    }
+
+    result = ReadAnsi(first + offset, length);
+    return true;
+}
+
+static bool ReadUnicodeZ(unsigned char const* first,
+                         std::size_t offset,
+                         std::size_t limit,
+                         std::string& result)
+{
+    std::size_t length;
+    if (!FindUnicodeZ(first, offset, limit, length))
+    {
+        return false;
+    }
+
+    result = ReadUnicode(first + offset, length);
+    return true;
+}
+
+static void AppendPathComponent(std::string& path, std::string const& component)
+{
+    if (!path.empty() && path.back() != '\\')
+    {
+        path.push_back('\\');
+    }
+
+    path.append(component);
+}
+
+// Gets the long name from a file entry's 0xBEEF0004 extension block, whose
+// layout grew with each version.
+static bool ReadLongName(unsigned char const* item,
+                         std::size_t offset,
+                         std::size_t itemSize,
+                         std::string& longName)
+{
+    if (itemSize < offset || itemSize - offset < 8)
+    {
+        return false;
+    }
+
+    std::size_t const extensionSize = ReadU16(item + offset);
+    std::uint16_t const version = ReadU16(item + offset + 2);
+    if (extensionSize > itemSize - offset ||
+        ReadU32(item + offset + 4) != fileEntryExtensionSignature ||
+        version < 3)
+    {
+        return false;
+    }
+
+    std::size_t nameOffset;
+    if (version >= 9)
+    {
+        nameOffset = 46;
+    }
+    else if (version == 8)
+    {
+        nameOffset = 42;
+    }
+    else if (version == 7)
+    {
+        nameOffset = 38;
+    }
+    else
+    {
+        nameOffset = 20;
+    }
+
+    return ReadUnicodeZ(
+               item + offset, nameOffset, extensionSize, longName) &&
+           !longName.empty();
+}
+
+// Spells out the file system path named by a target ID list: a volume item
+// followed by file entry items. Lists which name anything else, such as
+// control panel items, have no path.
+static std::string ParseIdList(unsigned char const* first, std::size_t size)
+{
+    std::string path;
+    std::size_t offset = 0;
+    while (offset + 2 <= size)
+    {
+        std::size_t const itemSize = ReadU16(first + offset);
+        if (itemSize == 0)
+        {
+            return path;
+        }
+
+        if (itemSize < 3 || itemSize > size - offset)
+        {
+            return std::string();
+        }
+
+        unsigned char const* const item = first + offset;
+        unsigned char const type = item[2];
+        std::string component;
+        if (type == rootFolderItem && path.empty())
+        {
+            // Computer, the desktop, or another root; paths start at the
+            // volume which follows.
+        }
+        else if ((type & itemClassMask) == volumeItemClass)
+        {
+            if (!ReadAnsiZ(item, volumeNameOffset, itemSize, component))
+            {
+                return std::string();
+            }
+
+            path = component;
+        }
+        else if ((type & itemClassMask) == fileEntryItemClass &&
+                 !path.empty())
+        {
+            // The primary name is the short name, unless the item is
+            // Unicode. ANSI names are padded to a 16 bit boundary.
+            std::size_t length;
+            std::size_t extensionOffset;
+            if (type & fileEntryUnicodeFlag)
+            {
+                if (!FindUnicodeZ(
+                        item, fileEntryPrimaryNameOffset, itemSize, length))
+                {
+                    return std::string();
+                }
+
+                component =
+                    ReadUnicode(item + fileEntryPrimaryNameOffset, length);
+                extensionOffset = fileEntryPrimaryNameOffset + (length + 1) * 2;
+            }
+            else
+            {
+                if (!FindAnsiZ(
+                        item, fileEntryPrimaryNameOffset, itemSize, length))
+                {
+                    return std::string();
+                }
+
+                component = ReadAnsi(item + fileEntryPrimaryNameOffset, length);
+                extensionOffset = fileEntryPrimaryNameOffset +
+                                  ((length + 2) & ~static_cast<std::size_t>(1));
+            }
+
+            std::string longName;
+            if (ReadLongName(item, extensionOffset, itemSize, longName))
+            {
+                component = longName;
+            }
+
+            AppendPathComponent(path, component);
+        }
+        else
+        {
+            return std::string();
+        }
+
+        offset += itemSize;
+    }
+
+    return std::string();
+}
+
+// Reads the LinkInfo path: the local base path, or the network share, with
+// the common path suffix appended.
+static std::string ParseLinkInfo(unsigned char const* first, std::size_t size)
+{
+    std::size_t const headerLength = ReadU32(first + 4);
+    if (headerLength < linkInfoMinimumHeaderSize || headerLength > size)
+    {
+        throw InvalidShellLinkException();
+    }
+
+    std::uint32_t const flags = ReadU32(first + linkInfoFlagsOffset);
+    bool const unicode = headerLength >= linkInfoUnicodeHeaderSize;
+    std::string path;
+    std::string suffix;
+    bool valid = true;
+
+    if (flags & volumeIdAndLocalBasePath)
+    {
+        valid = unicode
+                    ? ReadUnicodeZ(first,
+                                   ReadU32(first + linkInfoLocalBasePathUnicodeOffset),
+                                   size,
+                                   path)
+                    : ReadAnsiZ(first,
+                                ReadU32(first + linkInfoLocalBasePathOffset),
+                                size,
+                                path);
+    }
+    else if (flags & commonNetworkRelativeLinkAndPathSuffix)
+    {
+        std::size_t const networkOffset =
+            ReadU32(first + linkInfoNetworkLinkOffset);
+        if (networkOffset > size || size - networkOffset < networkLinkMinimumSize)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        unsigned char const* const network = first + networkOffset;
+        std::size_t const networkSize =
+            (std::min)(static_cast<std::size_t>(ReadU32(network)),
+                       size - networkOffset);
+        std::size_t const netNameOffset =
+            ReadU32(network + networkLinkNetNameOffset);
+        if (netNameOffset > networkLinkMinimumSize &&
+            networkSize >= networkLinkNetNameUnicodeOffset + 4)
+        {
+            valid = ReadUnicodeZ(
+                network,
+                ReadU32(network + networkLinkNetNameUnicodeOffset),
+                networkSize,
+                path);
+        }
+        else
+        {
+            valid = ReadAnsiZ(network, netNameOffset, networkSize, path);
+        }
+    }
+
+    if ((flags & (volumeIdAndLocalBasePath |
+                  commonNetworkRelativeLinkAndPathSuffix)) == 0)
+    {
+        return path;
+    }
+
+    valid = valid &&
+            (unicode ? ReadUnicodeZ(
+                           first,
+                           ReadU32(first + linkInfoCommonPathSuffixUnicodeOffset),
+                           size,
+                           suffix)
+                     : ReadAnsiZ(first,
+                                 ReadU32(first + linkInfoCommonPathSuffixOffset),
+                                 size,
+                                 suffix));
+    if (!valid)
+    {
+        throw InvalidShellLinkException();
+    }
+
+    if (!suffix.empty())
+    {
+        AppendPathComponent(path, suffix);
+    }
+
+    return path;
+}
+
+ShellLink::ShellLink(unsigned char const* first, unsigned char const* last)
+{
+    std::size_t const size = static_cast<std::size_t>(last - first);
+    if (size < headerSize || ReadU32(first) != headerSize ||
+        std::memcmp(first + 4, linkClsid, sizeof(linkClsid)) != 0)
+    {
+        throw InvalidShellLinkException();
+    }
+
+    std::uint32_t const flags = ReadU32(first + headerFlagsOffset);
+    std::size_t offset = headerSize;
+
+    if (flags & hasLinkTargetIdList)
+    {
+        if (size - offset < 2)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        std::size_t const idListSize = ReadU16(first + offset);
+        offset += 2;
+        if (size - offset < idListSize)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        idListPath = ParseIdList(first + offset, idListSize);
+        offset += idListSize;
+    }
+
+    if (flags & hasLinkInfo)
+    {
+        if (size - offset < 8)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        std::size_t const linkInfoSize = ReadU32(first + offset);
+        if (linkInfoSize < 8 || size - offset < linkInfoSize)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        if ((flags & forceNoLinkInfo) == 0)
+        {
+            linkInfoPath = ParseLinkInfo(first + offset, linkInfoSize);
+        }
+
+        offset += linkInfoSize;
+    }
+
+    std::uint32_t const stringFlags[] = {
+        hasName, hasRelativePath, hasWorkingDir, hasArguments, hasIconLocation};
+    std::string* const strings[] = {
+        &name, &relativePath, &workingDirectory, &arguments, &iconLocation};
+    std::size_t const characterSize = (flags & isUnicode) ? 2 : 1;
+    for (std::size_t idx = 0; idx < 5; ++idx)
+    {
+        if ((flags & stringFlags[idx]) == 0)
+        {
+            continue;
+        }
+
+        if (size - offset < 2)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        std::size_t const characters = ReadU16(first + offset);
+        offset += 2;
+        if ((size - offset) / characterSize < characters)
+        {
+            throw InvalidShellLinkException();
+        }
+
+        *strings[idx] = characterSize == 2
+                            ? ReadUnicode(first + offset, characters)
+                            : ReadAnsi(first + offset, characters);
+        offset += characters * characterSize;
+    }
+
+    // Extra data blocks end with a block smaller than 4 bytes. A truncated
+    // tail is tolerated, as the shell tolerates it.
+    while (size - offset >= 8)
+    {
+        std::size_t const blockSize = ReadU32(first + offset);
+        if (blockSize < 8 || blockSize > size - offset)
+        {
+            break;
+        }
+
+        if (ReadU32(first + offset + 4) == environmentVariableDataBlock &&
+            blockSize >= environmentBlockSize && (flags & hasExpString))
+        {
+            unsigned char const* const block = first + offset;
+            std::size_t const unicodeLimit = environmentTargetUnicodeOffset +
+                                             environmentTargetCharacters * 2;
+            if (!ReadUnicodeZ(block,
+                              environmentTargetUnicodeOffset,
+                              unicodeLimit,
+                              environmentTarget) ||
+                environmentTarget.empty())
+            {
+                ReadAnsiZ(block,
+                          environmentTargetAnsiOffset,
+                          environmentTargetUnicodeOffset,
+                          environmentTarget);
+            }
+        }
+
+        offset += blockSize;
+    }
+}
+
+std::string const& ShellLink::GetTarget() const
+{
+    if (!environmentTarget.empty())
+    {
+        return environmentTarget;
+    }
+
+    if (!linkInfoPath.empty())
+    {
+        return linkInfoPath;
+    }
+
+    return idListPath;
+}
+
+std::string const& ShellLink::GetIdListPath() const
+{
+    return idListPath;
+}
+
+std::string const& ShellLink::GetLinkInfoPath() const
+{
+    return linkInfoPath;
+}
+
+std::string const& ShellLink::GetName() const
+{
+    return name;
+}
+
+std::string const& ShellLink::GetRelativePath() const
+{
+    return relativePath;
+}
+
+std::string const& ShellLink::GetWorkingDirectory() const
+{
+    return workingDirectory;
+}
+
+std::string const& ShellLink::GetArguments() const
+{
+    return arguments;
+}
+
+std::string const& ShellLink::GetIconLocation() const
+{
+    return iconLocation;
+}
+
+std::string const& ShellLink::GetEnvironmentTarget() const
+{
+    return environmentTarget;
+}
+}
+}
@@ -0,0 +1,101 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <boost/config.hpp>
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    Exception for signaling a file which is not a shell link.
+struct InvalidShellLinkException : public std::exception
+{
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return "Invalid Shell Link";
+    }
+};
+
+/// @brief    A shell link (.lnk file), read directly from the MS-SHLLINK
+///         binary format.
+///
+/// @remarks Nothing is resolved through the shell, so no COM apartment is
+///          needed, instances may be used from any thread, and targets which
+///          no longer exist are reported as the link names them. ANSI strings
+///          are read as Windows-1252.
+class ShellLink
+{
+    std::string idListPath;
+    std::string linkInfoPath;
+    std::string name;
+    std::string relativePath;
+    std::string workingDirectory;
+    std::string arguments;
+    std::string iconLocation;
+    std::string environmentTarget;
+
+    public:
+    /// @brief    Constructor. Parses a shell link in memory.
+    ///
+    /// @param    first    Pointer to the start of the link.
+    /// @param    last     Pointer one past the end of the link.
+    ///
+    /// @throws InvalidShellLinkException The data is not a shell link.
+    ShellLink(unsigned char const* first, unsigned char const* last);
+
+    /// @brief    Reads a shell link from a file.
+    ///
+    /// @param    path    Full path of the .lnk file.
+    ///
+    /// @return    The shell link.
+    ///
+    /// @throws Win32Exception The file could not be mapped.
+    /// @throws InvalidShellLinkException The file is not a shell link.
+    static ShellLink Load(std::string const& path);
+
+    /// @brief    Gets the target path, as IShellLink::GetPath does with
+    ///         SLGP_RAWPATH.
+    ///
+    /// @remarks This is the environment variable target if the link has one,
+    ///          with variables unexpanded, then the LinkInfo path, then the
+    ///          path spelled out by the target ID list.
+    ///
+    /// @return    The target path, or an empty string if the link does not
+    ///            target a file system path.
+    std::string const& GetTarget() const;
+
+    /// @brief    Gets the file system path spelled out by the target ID list,
+    ///         or an empty string if there is none.
+    std::string const& GetIdListPath() const;
+
+    /// @brief    Gets the local base path, or the network share name, joined
+    ///         with the common path suffix from the LinkInfo structure.
+    std::string const& GetLinkInfoPath() const;
+
+    /// @brief    Gets the description string.
+    std::string const& GetName() const;
+
+    /// @brief    Gets the target's path relative to the link.
+    std::string const& GetRelativePath() const;
+
+    /// @brief    Gets the working directory.
+    std::string const& GetWorkingDirectory() const;
+
+    /// @brief    Gets the command line arguments.
+    std::string const& GetArguments() const;
+
+    /// @brief    Gets the icon location.
+    std::string const& GetIconLocation() const;
+
+    /// @brief    Gets the target from the environment variable data block,
+    ///         with variables unexpanded.
+    std::string const& GetEnvironmentTarget() const;
+};
+}
+}
@@ -0,0 +1,22 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// ShellLink::Load lives apart from the parser so that ShellLink.cpp builds
+// without windows.h.
+
+#include "File.hpp"
+#include "ShellLink.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+ShellLink ShellLink::Load(std::string const& path)
+{
+    MemoryMappedFile file(path);
+    return ShellLink(file.cbegin(), file.cend());
+}
+}
+}
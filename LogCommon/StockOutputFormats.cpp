@@ -2,6 +2,7 @@
 // This is under the 2 clause BSD license.
 // See the included LICENSE.TXT file for more details.
 
+#include <algorithm>
 #include <boost/config.hpp>
 #include <windows.h>
 #include "Registry.hpp"
@@ -9,14 +10,16 @@
 #include "Library.hpp"
 #include "Path.hpp"
 #include "File.hpp"
+#include "FileMetadataCache.hpp"
 #include "StringUtilities.hpp"
 #include "StockOutputFormats.hpp"
+#include "WorkerThreads.hpp"
 
 using Instalog::SystemFacades::RegistryKey;
 using Instalog::SystemFacades::Win32Exception;
-using Instalog::SystemFacades::ErrorFileNotFoundException;
-using Instalog::SystemFacades::ErrorPathNotFoundException;
 using Instalog::SystemFacades::File;
+using Instalog::SystemFacades::FileMetadata;
+using Instalog::SystemFacades::GetFileMetadataCache;
 
 namespace Instalog
 {
@@ -66,36 +69,44 @@ void WriteDefaultFileOutput(log_sink& str, std::string targetFile)
         write(str, targetFile, " [x]");
         return;
     }
-    std::string companyInfo(1, ' ');
-    try
-    {
-        companyInfo.append(File::GetCompany(targetFile));
-    }
-    catch (Win32Exception const&)
-    {
-        companyInfo.clear();
-    }
+
+    FileMetadata const& metadata = GetFileMetadataCache().Get(targetFile);
     write(str, targetFile);
-    try
+    if (!metadata.exists)
     {
-        WIN32_FILE_ATTRIBUTE_DATA fad = File::GetExtendedAttributes(targetFile);
-        std::uint64_t size =
-            static_cast<std::uint64_t>(fad.nFileSizeHigh) << 32 | fad.nFileSizeLow;
-        write(str, " [", size, ' ');
-        std::uint64_t ctime =
-            static_cast<std::uint64_t>(fad.ftCreationTime.dwHighDateTime) << 32 |
-            fad.ftCreationTime.dwLowDateTime;
-        WriteDefaultDateFormat(str, ctime);
-        write(str, companyInfo, "]");
+        write(str, " [?]");
+        return;
     }
-    catch (ErrorFileNotFoundException const&)
+
+    write(str, " [", metadata.size, ' ');
+    WriteDefaultDateFormat(str, metadata.creationTime);
+    if (metadata.hasCompany)
     {
-        write(str, " [?]");
+        write(str, ' ', metadata.company);
     }
-    catch (ErrorPathNotFoundException const&)
+
+    write(str, "]");
+}
+
+void PrefetchDefaultFileOutput(std::vector<std::string> targetFiles)
+{
+    std::size_t const workerCount =
+        (std::min)(GetDefaultWorkerCount(), static_cast<std::size_t>(8));
+    std::vector<char> resolved(targetFiles.size());
+    ParallelFor(targetFiles.size(), [&](std::size_t index) {
+        resolved[index] = Path::ResolveFromCommandLine(targetFiles[index]);
+    }, workerCount);
+
+    std::vector<std::string> paths;
+    for (std::size_t index = 0; index < targetFiles.size(); ++index)
     {
-        write(str, " [?]");
+        if (resolved[index])
+        {
+            paths.emplace_back(std::move(targetFiles[index]));
+        }
     }
+
+    GetFileMetadataCache().Prefetch(paths);
 }
 
 void WriteFileListingFile(log_sink& str, std::string const& targetFile)
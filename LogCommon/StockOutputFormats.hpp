@@ -40,9 +40,19 @@ void WriteFileAttributes(log_sink& str, std::uint32_t attributes);
 
 /// @brief    Writes the default representation of a file
 ///
+/// @remarks The file's metadata comes from the run's FileMetadataCache, so
+///          files which appear in several sections are read once.
+///
 /// @param [out]    str            The string stream to write the attributes to
 /// @param    targetFile            Target file.
 void WriteDefaultFileOutput(log_sink& str, std::string targetFile);
+
+/// @brief    Loads the metadata of several files in parallel ahead of calls
+///         to WriteDefaultFileOutput for them.
+///
+/// @param    targetFiles    Target files, as they would be passed to
+///                          WriteDefaultFileOutput.
+void PrefetchDefaultFileOutput(std::vector<std::string> targetFiles);
 void WriteFileListingFile(log_sink& str, std::string const& targetFile);
 void WriteFileListingFromFindData(log_sink& str,
                                   SystemFacades::FindFilesRecord const& info);
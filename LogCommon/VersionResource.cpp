@@ -0,0 +1,615 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cstring>
+#include "Utf8.hpp"
+#include "VersionResource.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+// Layout constants for PE images. Offsets are relative to the start of the
+// structure named in the constant.
+static std::size_t const dosLfanewOffset = 0x3C;
+static std::uint32_t const peSignature = 0x00004550;
+static std::size_t const fileHeaderOffset = 4;
+static std::size_t const fileHeaderSize = 20;
+static std::size_t const fileNumberOfSectionsOffset = 2;
+static std::size_t const fileSizeOfOptionalHeaderOffset = 16;
+static std::uint16_t const pe32Magic = 0x10B;
+static std::uint16_t const pe32PlusMagic = 0x20B;
+static std::size_t const pe32DirectoryCountOffset = 92;
+static std::size_t const pe32PlusDirectoryCountOffset = 108;
+static std::size_t const resourceDirectoryIndex = 2;
+static std::size_t const dataDirectorySize = 8;
+static std::size_t const sectionHeaderSize = 40;
+static std::size_t const sectionVirtualSizeOffset = 8;
+static std::size_t const sectionVirtualAddressOffset = 12;
+static std::size_t const sectionRawSizeOffset = 16;
+static std::size_t const sectionRawPointerOffset = 20;
+
+static std::size_t const resourceDirectorySize = 16;
+static std::size_t const resourceNamedEntriesOffset = 12;
+static std::size_t const resourceIdEntriesOffset = 14;
+static std::size_t const resourceEntrySize = 8;
+static std::uint32_t const resourceHighBit = 0x80000000;
+static std::size_t const resourceDataEntrySize = 16;
+static std::uint32_t const rtVersion = 16;
+
+// Version blocks are a length, a value length, a type, a null terminated
+// key, and then the value and child blocks, each aligned to 32 bits.
+static std::size_t const blockHeaderSize = 6;
+static std::uint16_t const blockTypeText = 1;
+
+// Translations tried when the translation table names no string table
+// present: US English in Unicode, in Windows-1252, and code page neutral.
+static std::uint32_t const fallbackTranslations[] = {
+    0x040904B0, 0x040904E4, 0x04090000};
+
+static std::uint16_t ReadU16(unsigned char const* source)
+{
+    std::uint16_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::uint32_t ReadU32(unsigned char const* source)
+{
+    std::uint32_t result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+static std::size_t AlignBlock(std::size_t offset)
+{
+    return (offset + 3) & ~static_cast<std::size_t>(3);
+}
+
+Utf16View::Utf16View() : first(nullptr), length(0)
+{
+}
+
+Utf16View::Utf16View(unsigned char const* characters, std::size_t size)
+    : first(characters), length(size)
+{
+}
+
+std::size_t Utf16View::Size() const
+{
+    return length;
+}
+
+bool Utf16View::Empty() const
+{
+    return length == 0;
+}
+
+std::uint16_t Utf16View::operator[](std::size_t index) const
+{
+    return ReadU16(first + index * 2);
+}
+
+bool Utf16View::EqualsIgnoreCase(char const* ascii) const
+{
+    std::size_t idx = 0;
+    for (; idx < length; ++idx)
+    {
+        std::uint16_t ch = (*this)[idx];
+        std::uint16_t other = static_cast<unsigned char>(ascii[idx]);
+        if (other == 0)
+        {
+            return false;
+        }
+
+        if (ch >= 'a' && ch <= 'z')
+        {
+            ch -= 'a' - 'A';
+        }
+
+        if (other >= 'a' && other <= 'z')
+        {
+            other -= 'a' - 'A';
+        }
+
+        if (ch != other)
+        {
+            return false;
+        }
+    }
+
+    return ascii[idx] == '\0';
+}
+
+std::string Utf16View::ToUtf8() const
+{
+    // Images are untrusted, so unpaired surrogates become U+FFFD rather
+    // than failing the conversion.
+    std::wstring wide;
+    wide.reserve(length);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        std::uint16_t const ch = (*this)[idx];
+        if (ch < 0xD800 || ch > 0xDFFF)
+        {
+            wide.push_back(static_cast<wchar_t>(ch));
+        }
+        else if (ch <= 0xDBFF && idx + 1 < length && (*this)[idx + 1] >= 0xDC00 &&
+                 (*this)[idx + 1] <= 0xDFFF)
+        {
+            wide.push_back(static_cast<wchar_t>(ch));
+            wide.push_back(static_cast<wchar_t>((*this)[++idx]));
+        }
+        else
+        {
+            wide.push_back(static_cast<wchar_t>(0xFFFD));
+        }
+    }
+
+    return utf8::ToUtf8(wide);
+}
+
+namespace
+{
+
+// One block of a version resource, bounded by its length.
+struct VersionBlock
+{
+    Utf16View key;
+    unsigned char const* value;
+    std::size_t valueSize;
+    unsigned char const* children;
+    std::size_t childrenSize;
+};
+
+bool ParseBlock(unsigned char const* first,
+                std::size_t available,
+                VersionBlock& block)
+{
+    if (available < blockHeaderSize)
+    {
+        return false;
+    }
+
+    std::size_t const length = ReadU16(first);
+    if (length < blockHeaderSize || length > available)
+    {
+        return false;
+    }
+
+    std::size_t const valueLength = ReadU16(first + 2);
+    std::uint16_t const type = ReadU16(first + 4);
+
+    std::size_t keyEnd = blockHeaderSize;
+    while (keyEnd + 2 <= length && ReadU16(first + keyEnd) != 0)
+    {
+        keyEnd += 2;
+    }
+
+    if (keyEnd + 2 > length)
+    {
+        return false;
+    }
+
+    block.key = Utf16View(first + blockHeaderSize,
+                          (keyEnd - blockHeaderSize) / 2);
+
+    // Text values are measured in characters, binary values in bytes.
+    std::size_t const valueOffset = (std::min)(AlignBlock(keyEnd + 2), length);
+    std::size_t const valueSize =
+        (std::min)(type == blockTypeText ? valueLength * 2 : valueLength,
+                   length - valueOffset);
+    std::size_t const childrenOffset =
+        (std::min)(AlignBlock(valueOffset + valueSize), length);
+    block.value = first + valueOffset;
+    block.valueSize = valueSize;
+    block.children = first + childrenOffset;
+    block.childrenSize = length - childrenOffset;
+    return true;
+}
+
+// Calls visit with each child block, until visit returns false.
+template <typename Visitor>
+void ForEachChild(VersionBlock const& parent, Visitor visit)
+{
+    std::size_t offset = 0;
+    while (offset < parent.childrenSize)
+    {
+        VersionBlock child;
+        if (!ParseBlock(parent.children + offset,
+                        parent.childrenSize - offset,
+                        child))
+        {
+            return;
+        }
+
+        if (!visit(child))
+        {
+            return;
+        }
+
+        offset = AlignBlock(offset + ReadU16(parent.children + offset));
+    }
+}
+
+bool FindChild(VersionBlock const& parent,
+               char const* name,
+               VersionBlock& result)
+{
+    bool found = false;
+    ForEachChild(parent, [&](VersionBlock const& child) {
+        if (child.key.EqualsIgnoreCase(name))
+        {
+            result = child;
+            found = true;
+        }
+
+        return !found;
+    });
+    return found;
+}
+
+// Parses a string table name such as "040904B0".
+bool ParseTranslation(Utf16View const& key, std::uint32_t& translation)
+{
+    if (key.Size() != 8)
+    {
+        return false;
+    }
+
+    translation = 0;
+    for (std::size_t idx = 0; idx < 8; ++idx)
+    {
+        std::uint16_t const ch = key[idx];
+        std::uint32_t digit;
+        if (ch >= '0' && ch <= '9')
+        {
+            digit = ch - '0';
+        }
+        else if (ch >= 'A' && ch <= 'F')
+        {
+            digit = ch - 'A' + 10;
+        }
+        else if (ch >= 'a' && ch <= 'f')
+        {
+            digit = ch - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+
+        translation = translation << 4 | digit;
+    }
+
+    return true;
+}
+
+// Maps the sections of a PE image, to turn relative virtual addresses into
+// offsets in the file.
+class PeImage
+{
+    unsigned char const* first;
+    std::size_t size;
+    unsigned char const* sections;
+    std::size_t sectionCount;
+    std::uint32_t resourceRva;
+    std::uint32_t resourceSize;
+
+    public:
+    PeImage(unsigned char const* imageFirst, unsigned char const* imageLast)
+        : first(imageFirst),
+          size(static_cast<std::size_t>(imageLast - imageFirst)),
+          sections(nullptr),
+          sectionCount(0),
+          resourceRva(0),
+          resourceSize(0)
+    {
+        if (size < dosLfanewOffset + 4 || first[0] != 'M' || first[1] != 'Z')
+        {
+            return;
+        }
+
+        std::size_t const peOffset = ReadU32(first + dosLfanewOffset);
+        if (peOffset > size || size - peOffset < fileHeaderOffset + fileHeaderSize ||
+            ReadU32(first + peOffset) != peSignature)
+        {
+            return;
+        }
+
+        unsigned char const* const fileHeader =
+            first + peOffset + fileHeaderOffset;
+        std::size_t const optionalOffset =
+            peOffset + fileHeaderOffset + fileHeaderSize;
+        std::size_t const optionalSize =
+            ReadU16(fileHeader + fileSizeOfOptionalHeaderOffset);
+        if (size - optionalOffset < optionalSize || optionalSize < 2)
+        {
+            return;
+        }
+
+        unsigned char const* const optional = first + optionalOffset;
+        std::size_t countOffset;
+        switch (ReadU16(optional))
+        {
+        case pe32Magic:
+            countOffset = pe32DirectoryCountOffset;
+            break;
+        case pe32PlusMagic:
+            countOffset = pe32PlusDirectoryCountOffset;
+            break;
+        default:
+            return;
+        }
+
+        std::size_t const directoryOffset =
+            countOffset + 4 + resourceDirectoryIndex * dataDirectorySize;
+        if (optionalSize < directoryOffset + dataDirectorySize ||
+            ReadU32(optional + countOffset) <= resourceDirectoryIndex)
+        {
+            return;
+        }
+
+        std::size_t const sectionsOffset = optionalOffset + optionalSize;
+        std::size_t const count =
+            ReadU16(fileHeader + fileNumberOfSectionsOffset);
+        if ((size - sectionsOffset) / sectionHeaderSize < count)
+        {
+            return;
+        }
+
+        sections = first + sectionsOffset;
+        sectionCount = count;
+        resourceRva = ReadU32(optional + directoryOffset);
+        resourceSize = ReadU32(optional + directoryOffset + 4);
+    }
+
+    // Gets the bytes at a relative virtual address, or nullptr if they are
+    // not all in the file.
+    unsigned char const* Translate(std::uint32_t rva, std::size_t length) const
+    {
+        for (std::size_t idx = 0; idx < sectionCount; ++idx)
+        {
+            unsigned char const* const section =
+                sections + idx * sectionHeaderSize;
+            std::uint32_t const address =
+                ReadU32(section + sectionVirtualAddressOffset);
+            std::uint32_t const rawSize =
+                ReadU32(section + sectionRawSizeOffset);
+            std::uint32_t const virtualSize =
+                ReadU32(section + sectionVirtualSizeOffset);
+            std::uint32_t const extent = (std::max)(rawSize, virtualSize);
+            if (rva < address || rva - address >= extent)
+            {
+                continue;
+            }
+
+            std::size_t const delta = rva - address;
+            std::size_t const rawOffset =
+                ReadU32(section + sectionRawPointerOffset);
+            if (delta > rawSize || rawSize - delta < length ||
+                rawOffset > size || size - rawOffset < delta + length)
+            {
+                return nullptr;
+            }
+
+            return first + rawOffset + delta;
+        }
+
+        return nullptr;
+    }
+
+    // Finds the first RT_VERSION resource, of any name and language.
+    bool FindVersionResource(unsigned char const*& resource,
+                             std::size_t& resourceLength) const
+    {
+        if (resourceSize < resourceDirectorySize)
+        {
+            return false;
+        }
+
+        unsigned char const* const root =
+            Translate(resourceRva, resourceSize);
+        if (root == nullptr)
+        {
+            return false;
+        }
+
+        // Type, then name, then language.
+        std::uint32_t entry;
+        if (!FindEntry(root, 0, true, entry) ||
+            (entry & resourceHighBit) == 0 ||
+            !FindEntry(root, entry & ~resourceHighBit, false, entry) ||
+            (entry & resourceHighBit) == 0 ||
+            !FindEntry(root, entry & ~resourceHighBit, false, entry) ||
+            (entry & resourceHighBit) != 0 ||
+            entry > resourceSize ||
+            resourceSize - entry < resourceDataEntrySize)
+        {
+            return false;
+        }
+
+        std::uint32_t const dataRva = ReadU32(root + entry);
+        std::uint32_t const dataSize = ReadU32(root + entry + 4);
+        resource = Translate(dataRva, dataSize);
+        resourceLength = dataSize;
+        return resource != nullptr;
+    }
+
+    private:
+    // Finds the RT_VERSION entry of the type directory, or the first entry of
+    // any other directory.
+    bool FindEntry(unsigned char const* root,
+                   std::uint32_t directoryOffset,
+                   bool isTypeDirectory,
+                   std::uint32_t& target) const
+    {
+        if (directoryOffset > resourceSize ||
+            resourceSize - directoryOffset < resourceDirectorySize)
+        {
+            return false;
+        }
+
+        unsigned char const* const directory = root + directoryOffset;
+        std::size_t const named =
+            ReadU16(directory + resourceNamedEntriesOffset);
+        std::size_t const ids = ReadU16(directory + resourceIdEntriesOffset);
+        std::size_t const entriesAvailable =
+            (resourceSize - directoryOffset - resourceDirectorySize) /
+            resourceEntrySize;
+        std::size_t const total = (std::min)(named + ids, entriesAvailable);
+        // Named entries precede ID entries, and RT_VERSION is an ID.
+        for (std::size_t idx = isTypeDirectory ? named : 0; idx < total; ++idx)
+        {
+            unsigned char const* const entry =
+                directory + resourceDirectorySize + idx * resourceEntrySize;
+            if (isTypeDirectory && ReadU32(entry) != rtVersion)
+            {
+                continue;
+            }
+
+            target = ReadU32(entry + 4);
+            return true;
+        }
+
+        return false;
+    }
+};
+}
+
+VersionResource::VersionResource(unsigned char const* first,
+                                 unsigned char const* last)
+    : info(nullptr),
+      strings(nullptr),
+      stringsSize(0),
+      translation(0)
+{
+    unsigned char const* resource;
+    std::size_t resourceLength;
+    VersionBlock root;
+    if (!PeImage(first, last).FindVersionResource(resource, resourceLength) ||
+        !ParseBlock(resource, resourceLength, root))
+    {
+        return;
+    }
+
+    info = resource;
+
+    VersionBlock stringFileInfo;
+    if (!FindChild(root, "StringFileInfo", stringFileInfo))
+    {
+        return;
+    }
+
+    // Candidates in order of preference: the translation table, the
+    // fallbacks, and then whichever table comes first.
+    std::uint32_t candidates[64];
+    std::size_t candidateCount = 0;
+    VersionBlock varFileInfo;
+    VersionBlock translationTable;
+    if (FindChild(root, "VarFileInfo", varFileInfo) &&
+        FindChild(varFileInfo, "Translation", translationTable))
+    {
+        for (std::size_t offset = 0;
+             offset + 4 <= translationTable.valueSize &&
+                 candidateCount + 3 < sizeof(candidates) / sizeof(candidates[0]);
+             offset += 4)
+        {
+            std::uint32_t const language =
+                ReadU16(translationTable.value + offset);
+            std::uint32_t const codePage =
+                ReadU16(translationTable.value + offset + 2);
+            candidates[candidateCount++] = language << 16 | codePage;
+        }
+    }
+
+    for (std::uint32_t fallback : fallbackTranslations)
+    {
+        candidates[candidateCount++] = fallback;
+    }
+
+    // Tables which are not candidates rank after every candidate, so the
+    // first of them is kept only if no candidate is present.
+    std::size_t bestRank = candidateCount + 1;
+    ForEachChild(stringFileInfo, [&](VersionBlock const& table) {
+        std::uint32_t tableTranslation;
+        if (!ParseTranslation(table.key, tableTranslation))
+        {
+            return true;
+        }
+
+        std::size_t rank = 0;
+        while (rank < candidateCount && candidates[rank] != tableTranslation)
+        {
+            ++rank;
+        }
+
+        if (rank < bestRank)
+        {
+            bestRank = rank;
+            translation = tableTranslation;
+            strings = table.children;
+            stringsSize = table.childrenSize;
+        }
+
+        return bestRank != 0;
+    });
+}
+
+std::uint32_t VersionResource::GetTranslation() const
+{
+    return translation;
+}
+
+bool VersionResource::HasVersionInfo() const
+{
+    return info != nullptr;
+}
+
+expected<Utf16View> VersionResource::GetString(char const* name) const
+{
+    if (strings == nullptr)
+    {
+        return expected<Utf16View>();
+    }
+
+    VersionBlock table = {Utf16View(), strings, 0, strings, stringsSize};
+    VersionBlock entry;
+    if (!FindChild(table, name, entry))
+    {
+        return expected<Utf16View>();
+    }
+
+    // Values normally count their terminator, but not always.
+    std::size_t length = entry.valueSize / 2;
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        if (ReadU16(entry.value + idx * 2) == 0)
+        {
+            length = idx;
+            break;
+        }
+    }
+
+    return Utf16View(entry.value, length);
+}
+
+expected<Utf16View> VersionResource::GetCompanyName() const
+{
+    return GetString("CompanyName");
+}
+
+expected<Utf16View> VersionResource::GetProductName() const
+{
+    return GetString("ProductName");
+}
+
+expected<Utf16View> VersionResource::GetFileDescription() const
+{
+    return GetString("FileDescription");
+}
+}
+}
@@ -0,0 +1,103 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Expected.hpp"
+
+namespace Instalog
+{
+namespace SystemFacades
+{
+
+/// @brief    A little endian UTF-16 string inside a mapped image. Nothing is
+///         copied until the string is converted.
+class Utf16View
+{
+    unsigned char const* first;
+    std::size_t length;
+
+    public:
+    /// @brief    Default constructor. Constructs an empty view.
+    Utf16View();
+
+    /// @brief    Constructor.
+    ///
+    /// @param    characters    Pointer to the first character.
+    /// @param    size          The number of UTF-16 code units.
+    Utf16View(unsigned char const* characters, std::size_t size);
+
+    /// @brief    Gets the number of UTF-16 code units in the string.
+    std::size_t Size() const;
+
+    /// @brief    Checks whether the string is empty.
+    bool Empty() const;
+
+    /// @brief    Gets one UTF-16 code unit.
+    ///
+    /// @param    index    Zero-based index of the code unit.
+    std::uint16_t operator[](std::size_t index) const;
+
+    /// @brief    Compares the string with an ASCII string, ignoring case.
+    ///
+    /// @param    ascii    The null terminated ASCII string.
+    bool EqualsIgnoreCase(char const* ascii) const;
+
+    /// @brief    Converts the string to UTF-8.
+    std::string ToUtf8() const;
+};
+
+/// @brief    Reads the version resource of a PE image without loading it.
+///
+/// @remarks Only the resource directory path to RT_VERSION and the
+///          StringFileInfo block are read; the image is neither copied nor
+///          mapped by the loader, so this works on any platform, and on
+///          images for other architectures. The string table used is the
+///          first one named in the VarFileInfo translation table, falling
+///          back to US English in Unicode, Windows-1252 or neutral code
+///          pages, then to whichever table comes first. Malformed images are
+///          treated as having no version resource.
+class VersionResource
+{
+    unsigned char const* info;
+    unsigned char const* strings;
+    std::size_t stringsSize;
+    std::uint32_t translation;
+
+    public:
+    /// @brief    Constructor. Finds the version resource in an image.
+    ///
+    /// @param    first    Pointer to the start of the image, as it is on
+    ///                    disk. The image must outlive this instance.
+    /// @param    last     Pointer one past the end of the image.
+    VersionResource(unsigned char const* first, unsigned char const* last);
+
+    /// @brief    Checks whether the image has a version resource.
+    bool HasVersionInfo() const;
+
+    /// @brief    Gets the language and code page of the string table in use,
+    ///         as in "040904B0", or zero if there is no string table.
+    std::uint32_t GetTranslation() const;
+
+    /// @brief    Gets a string from the version resource.
+    ///
+    /// @param    name    The name of the string, such as "CompanyName".
+    ///                   Names are compared without regard to case.
+    ///
+    /// @return    The string, or an empty expected if it is not present.
+    expected<Utf16View> GetString(char const* name) const;
+
+    /// @brief    Gets the CompanyName string.
+    expected<Utf16View> GetCompanyName() const;
+
+    /// @brief    Gets the ProductName string.
+    expected<Utf16View> GetProductName() const;
+
+    /// @brief    Gets the FileDescription string.
+    expected<Utf16View> GetFileDescription() const;
+};
+}
+}
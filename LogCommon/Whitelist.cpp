@@ -0,0 +1,87 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <cstring>
+#include "Whitelist.hpp"
+
+namespace Instalog
+{
+
+// The finalizer of MurmurHash3, which spreads every input bit over the whole
+// result.
+static std::uint64_t MixWhitelistHash(std::uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+std::uint64_t HashWhitelistPath(std::uint64_t seed, boost::string_ref path)
+{
+    // FNV-1a, mixed afterward as FNV's low bits are weak.
+    std::uint64_t hash = 0xCBF29CE484222325ull ^ seed;
+    for (char ch : path)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 0x100000001B3ull;
+    }
+
+    return MixWhitelistHash(hash);
+}
+
+std::size_t GetWhitelistBucket(std::uint64_t hash, std::size_t bucketCount)
+{
+    return static_cast<std::size_t>((hash & 0xFFFFFFFFu) % bucketCount);
+}
+
+std::size_t GetWhitelistSlot(std::uint64_t hash,
+                             std::uint32_t displacement,
+                             std::size_t entryCount)
+{
+    return static_cast<std::size_t>(MixWhitelistHash(hash ^ displacement) %
+                                    entryCount);
+}
+
+expected<int> GetWhitelistLevel(WhitelistTable const& table,
+                                boost::string_ref normalizedPath)
+{
+    std::uint64_t const hash = HashWhitelistPath(table.seed, normalizedPath);
+    std::uint32_t const displacement =
+        table.displacements[GetWhitelistBucket(hash, table.bucketCount)];
+    WhitelistEntry const& entry =
+        table.entries[GetWhitelistSlot(hash, displacement, table.entryCount)];
+    if (entry.path == nullptr || entry.length != normalizedPath.size() ||
+        std::memcmp(entry.path, normalizedPath.data(), entry.length) != 0)
+    {
+        return expected<int>();
+    }
+
+    return entry.level;
+}
+
+expected<int> MatchWhitelistPatterns(PatternWhitelistTable const& table,
+                                     boost::string_ref normalizedText)
+{
+    std::size_t state = 1;
+    for (char ch : normalizedText)
+    {
+        state = table.transitions[state * table.classCount +
+                                  table.classes[static_cast<unsigned char>(ch)]];
+        if (state == 0)
+        {
+            return expected<int>();
+        }
+    }
+
+    if (table.levels[state] < 0)
+    {
+        return expected<int>();
+    }
+
+    return table.levels[state];
+}
+}
@@ -0,0 +1,137 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <boost/utility/string_ref.hpp>
+#include "Expected.hpp"
+
+namespace Instalog
+{
+
+/// @brief    One slot of a compiled whitelist table.
+struct WhitelistEntry
+{
+    /// @summary The normalized path, or nullptr for an empty slot.
+    char const* path;
+    /// @summary The length of path in bytes.
+    std::size_t length;
+    /// @summary The whitelist level; the entry is hidden unless the log's
+    ///          verbosity is above it.
+    int level;
+};
+
+/// @brief    A read-only whitelist compiled at build time into a perfect hash
+///         table, so that a lookup is one hash of the path and one compare.
+///
+/// @remarks This is a plain aggregate so that generated tables are constant
+///          initialized. The bucket of a path picks a displacement, and the
+///          path's hash mixed with the displacement picks its slot; see
+///          WhitelistCompiler.hpp for how displacements are chosen.
+struct WhitelistTable
+{
+    /// @summary The seed the paths were hashed with.
+    std::uint64_t seed;
+    /// @summary The displacement of each bucket.
+    std::uint32_t const* displacements;
+    /// @summary The number of buckets.
+    std::size_t bucketCount;
+    /// @summary The slots of the table.
+    WhitelistEntry const* entries;
+    /// @summary The number of slots.
+    std::size_t entryCount;
+};
+
+/// @brief    Hashes a normalized path for a whitelist table.
+///
+/// @param    seed    The seed of the table.
+/// @param    path    The path.
+std::uint64_t HashWhitelistPath(std::uint64_t seed, boost::string_ref path);
+
+/// @brief    Gets the bucket of a path's hash.
+std::size_t GetWhitelistBucket(std::uint64_t hash, std::size_t bucketCount);
+
+/// @brief    Gets the slot of a path's hash, given its bucket's displacement.
+std::size_t GetWhitelistSlot(std::uint64_t hash,
+                             std::uint32_t displacement,
+                             std::size_t entryCount);
+
+/// @brief    Looks up the whitelist level of a path.
+///
+/// @param    table             The table to search.
+/// @param    normalizedPath    The path, upper cased and with common
+///                             directories replaced by their environment
+///                             variables, as in Whitelist.sql.
+///
+/// @return    The whitelist level, or an empty expected if the path is not
+///            whitelisted.
+expected<int> GetWhitelistLevel(WhitelistTable const& table,
+                                boost::string_ref normalizedPath);
+
+/// @brief    A read-only set of whitelist patterns compiled at build time
+///         into a deterministic automaton, so that matching costs one table
+///         lookup per character however many patterns there are.
+///
+/// @remarks Patterns match whole strings; '*' matches any run of characters,
+///          backslashes included, and '?' matches any one character. Bytes
+///          which appear in no pattern share a character class, keeping the
+///          transition table narrow. State 0 is the dead state, which no
+///          pattern can match from, and state 1 is the start state.
+struct PatternWhitelistTable
+{
+    /// @summary The character class of each byte.
+    unsigned char const* classes;
+    /// @summary The number of character classes.
+    std::size_t classCount;
+    /// @summary The next state for each state and character class, indexed
+    ///          by state * classCount + class.
+    std::uint16_t const* transitions;
+    /// @summary The whitelist level of each state, or -1 if no pattern
+    ///          matches strings ending in the state.
+    int const* levels;
+    /// @summary The number of states.
+    std::size_t stateCount;
+};
+
+/// @brief    Matches a string against whitelist patterns.
+///
+/// @param    table             The patterns to match.
+/// @param    normalizedText    The path or registry line, normalized as the
+///                             patterns are.
+///
+/// @return    The whitelist level of the best matching pattern, or an empty
+///            expected if none match.
+expected<int> MatchWhitelistPatterns(PatternWhitelistTable const& table,
+                                     boost::string_ref normalizedText);
+
+/// @brief    The Files table of Whitelist.sql, compiled at build time.
+extern WhitelistTable const fileWhitelist;
+
+/// @brief    The Patterns table of Whitelist.sql, compiled at build time.
+extern PatternWhitelistTable const patternWhitelist;
+
+/// @brief    Looks up the whitelist level of a path or registry line in the
+///         compiled whitelist.
+///
+/// @remarks An exact entry in the Files table wins over any pattern. This is
+///          inline so that WhitelistCompiler, which generates the tables,
+///          can link Whitelist.cpp without them.
+///
+/// @param    normalizedText    The path or registry line, normalized as in
+///                             Whitelist.sql.
+///
+/// @return    The whitelist level, or an empty expected if the text is not
+///            whitelisted.
+inline expected<int> GetWhitelistLevel(boost::string_ref normalizedText)
+{
+    expected<int> const exact = GetWhitelistLevel(fileWhitelist, normalizedText);
+    if (exact.is_valid())
+    {
+        return exact;
+    }
+
+    return MatchWhitelistPatterns(patternWhitelist, normalizedText);
+}
+}
@@ -1,3 +1,8 @@
+-- This file is compiled into LogCommon by WhitelistCompiler, which reads
+-- CREATE statements (and skips them) and INSERT INTO Files or Patterns
+-- statements with literal values. As in SQL, backslashes in strings are not
+-- escapes.
+--
 -- Files table. Entries will be whitelisted (or not) based on whether they have
 -- an entry in this table.
 --
@@ -15,7 +20,28 @@ CREATE TABLE Files (
 -- Only show explorer.exe when whitelisting is off.
 
 INSERT INTO FILES (Path, WhitelistLevel) VALUES (
-    "%WINDIR%\\EXPLORER.EXE",
+    '%WINDIR%\EXPLORER.EXE',
     5
 );
 
+-- Patterns table. Paths and registry lines which have no entry in Files are
+-- whitelisted by the most specific pattern matching them in this table, that
+-- is, the one with the most characters other than wildcards.
+--
+-- Patterns are normalized as paths are, and match whole paths or lines: '*'
+-- matches any run of characters, backslashes included, and '?' matches any
+-- single character. All patterns are compiled into a single automaton, so
+-- adding patterns does not slow matching down.
+
+CREATE TABLE Patterns (
+    Pattern STRING NOT NULL PRIMARY KEY,
+    WhitelistLevel INTEGER NOT NULL    -- As in Files.
+) WITHOUT ROWID;
+
+-- Side by side assemblies are serviced by Windows; only show them when
+-- whitelisting is off.
+
+INSERT INTO Patterns (Pattern, WhitelistLevel) VALUES (
+    '%WINDIR%\WINSXS\*',
+    5
+);
@@ -0,0 +1,970 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include "WhitelistCompiler.hpp"
+
+namespace Instalog
+{
+
+// The number of rows per bucket the table aims for.
+static std::size_t const rowsPerBucket = 4;
+
+// Displacements tried for a bucket before the table is rebuilt with a new
+// seed.
+static std::uint32_t const maximumDisplacement = 1u << 20;
+
+// Seeds tried before giving up; each attempt fails with negligible
+// probability, so running out means the hash is broken.
+static std::uint64_t const maximumSeed = 64;
+
+// The most automaton states the patterns may need, so that states fit in
+// the 16 bit transition table.
+static std::size_t const maximumPatternStates = 0xFFFF;
+
+namespace
+{
+
+// Checks for ASCII lower case letters, which normalized text never has.
+bool HasLowerCaseLetters(std::string const& text)
+{
+    return std::any_of(text.begin(), text.end(), [](char ch) {
+        return ch >= 'a' && ch <= 'z';
+    });
+}
+
+enum TokenType
+{
+    Word,
+    Number,
+    Text,
+    Punctuation,
+    End
+};
+
+struct Token
+{
+    TokenType type;
+    std::string value;
+};
+
+class SqlTokenizer
+{
+    std::string const& sql;
+    std::size_t position;
+    std::size_t line;
+
+    void SkipSpaceAndComments()
+    {
+        while (position < sql.size())
+        {
+            char const ch = sql[position];
+            if (ch == '\n')
+            {
+                ++line;
+                ++position;
+            }
+            else if (std::isspace(static_cast<unsigned char>(ch)))
+            {
+                ++position;
+            }
+            else if (sql.compare(position, 2, "--") == 0)
+            {
+                position = sql.find('\n', position);
+                if (position == std::string::npos)
+                {
+                    position = sql.size();
+                }
+            }
+            else if (sql.compare(position, 2, "/*") == 0)
+            {
+                std::size_t const close = sql.find("*/", position + 2);
+                if (close == std::string::npos)
+                {
+                    Fail("Unterminated comment");
+                }
+
+                line += std::count(sql.begin() + position,
+                                   sql.begin() + close,
+                                   '\n');
+                position = close + 2;
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    public:
+    explicit SqlTokenizer(std::string const& sql)
+        : sql(sql), position(0), line(1)
+    {
+    }
+
+    void Fail(std::string const& message) const
+    {
+        throw WhitelistParseException(line, message);
+    }
+
+    Token Next()
+    {
+        SkipSpaceAndComments();
+        Token result;
+        if (position == sql.size())
+        {
+            result.type = End;
+            return result;
+        }
+
+        char const ch = sql[position];
+        if (std::isalpha(static_cast<unsigned char>(ch)) || ch == '_')
+        {
+            result.type = Word;
+            while (position < sql.size() &&
+                   (std::isalnum(static_cast<unsigned char>(sql[position])) ||
+                    sql[position] == '_'))
+            {
+                result.value.push_back(sql[position++]);
+            }
+        }
+        else if (std::isdigit(static_cast<unsigned char>(ch)) || ch == '-')
+        {
+            result.type = Number;
+            result.value.push_back(sql[position++]);
+            while (position < sql.size() &&
+                   std::isdigit(static_cast<unsigned char>(sql[position])))
+            {
+                result.value.push_back(sql[position++]);
+            }
+
+            if (result.value == "-")
+            {
+                Fail("Expected a number");
+            }
+        }
+        else if (ch == '\'' || ch == '"')
+        {
+            result.type = Text;
+            for (++position;; ++position)
+            {
+                if (position == sql.size())
+                {
+                    Fail("Unterminated string");
+                }
+
+                if (sql[position] == ch)
+                {
+                    if (position + 1 == sql.size() || sql[position + 1] != ch)
+                    {
+                        ++position;
+                        break;
+                    }
+
+                    ++position;
+                }
+                else if (sql[position] == '\n')
+                {
+                    ++line;
+                }
+
+                result.value.push_back(sql[position]);
+            }
+        }
+        else
+        {
+            result.type = Punctuation;
+            result.value.push_back(sql[position++]);
+        }
+
+        return result;
+    }
+};
+
+class WhitelistSqlParser
+{
+    SqlTokenizer tokenizer;
+    Token current;
+    std::set<std::string> paths;
+    std::set<std::string> patterns;
+
+    static bool IsWord(Token const& token, char const* word)
+    {
+        if (token.type != Word)
+        {
+            return false;
+        }
+
+        std::size_t const length = std::char_traits<char>::length(word);
+        if (token.value.size() != length)
+        {
+            return false;
+        }
+
+        for (std::size_t idx = 0; idx < length; ++idx)
+        {
+            if (std::toupper(static_cast<unsigned char>(token.value[idx])) !=
+                std::toupper(static_cast<unsigned char>(word[idx])))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Advance()
+    {
+        current = tokenizer.Next();
+    }
+
+    void Expect(char const* word)
+    {
+        if (!IsWord(current, word))
+        {
+            tokenizer.Fail(std::string("Expected ") + word);
+        }
+
+        Advance();
+    }
+
+    void ExpectPunctuation(char punctuation)
+    {
+        if (current.type != Punctuation || current.value[0] != punctuation)
+        {
+            tokenizer.Fail(std::string("Expected '") + punctuation + "'");
+        }
+
+        Advance();
+    }
+
+    bool IsPunctuation(char punctuation) const
+    {
+        return current.type == Punctuation && current.value[0] == punctuation;
+    }
+
+    void SkipStatement()
+    {
+        while (current.type != End && !IsPunctuation(';'))
+        {
+            Advance();
+        }
+    }
+
+    void ParseInsert(WhitelistSql& result)
+    {
+        Expect("INSERT");
+        Expect("INTO");
+        bool const isPatterns = IsWord(current, "Patterns");
+        if (!isPatterns && !IsWord(current, "Files"))
+        {
+            tokenizer.Fail("Only the Files and Patterns tables can be "
+                           "inserted into");
+        }
+
+        char const* const keyName = isPatterns ? "Pattern" : "Path";
+        Advance();
+        ExpectPunctuation('(');
+        std::vector<std::string> columns;
+        for (;;)
+        {
+            if (current.type != Word)
+            {
+                tokenizer.Fail("Expected a column name");
+            }
+
+            columns.push_back(current.value);
+            Advance();
+            if (IsPunctuation(')'))
+            {
+                break;
+            }
+
+            ExpectPunctuation(',');
+        }
+
+        Advance();
+        std::size_t keyColumn = columns.size();
+        std::size_t levelColumn = columns.size();
+        for (std::size_t idx = 0; idx < columns.size(); ++idx)
+        {
+            Token column;
+            column.type = Word;
+            column.value = columns[idx];
+            if (IsWord(column, keyName))
+            {
+                keyColumn = idx;
+            }
+            else if (IsWord(column, "WhitelistLevel"))
+            {
+                levelColumn = idx;
+            }
+            else
+            {
+                tokenizer.Fail("Unknown column " + columns[idx]);
+            }
+        }
+
+        if (keyColumn == columns.size() || levelColumn == columns.size())
+        {
+            tokenizer.Fail(std::string("Both ") + keyName +
+                           " and WhitelistLevel must be given");
+        }
+
+        Expect("VALUES");
+        for (;;)
+        {
+            ExpectPunctuation('(');
+            std::string key;
+            int level = 0;
+            for (std::size_t idx = 0; idx < columns.size(); ++idx)
+            {
+                if (idx != 0)
+                {
+                    ExpectPunctuation(',');
+                }
+
+                if (idx == keyColumn)
+                {
+                    if (current.type != Text)
+                    {
+                        tokenizer.Fail(std::string(keyName) +
+                                       " must be a string");
+                    }
+
+                    key = current.value;
+                    if (HasLowerCaseLetters(key))
+                    {
+                        tokenizer.Fail(std::string(keyName) +
+                                       " must be upper case: " + key);
+                    }
+                }
+                else
+                {
+                    if (current.type != Number || current.value[0] == '-')
+                    {
+                        tokenizer.Fail(
+                            "WhitelistLevel must be a non-negative integer");
+                    }
+
+                    level = std::stoi(current.value);
+                }
+
+                Advance();
+            }
+
+            if (isPatterns)
+            {
+                if (key.empty())
+                {
+                    tokenizer.Fail("Patterns must not be empty");
+                }
+
+                if (!patterns.insert(key).second)
+                {
+                    tokenizer.Fail("Duplicate pattern " + key);
+                }
+
+                WhitelistPattern pattern;
+                pattern.pattern = key;
+                pattern.level = level;
+                result.patterns.push_back(pattern);
+            }
+            else
+            {
+                if (!paths.insert(key).second)
+                {
+                    tokenizer.Fail("Duplicate path " + key);
+                }
+
+                WhitelistFile file;
+                file.path = key;
+                file.level = level;
+                result.files.push_back(file);
+            }
+
+            ExpectPunctuation(')');
+            if (!IsPunctuation(','))
+            {
+                break;
+            }
+
+            Advance();
+        }
+
+        if (current.type != End && !IsPunctuation(';'))
+        {
+            tokenizer.Fail("Expected ';'");
+        }
+    }
+
+    public:
+    explicit WhitelistSqlParser(std::string const& sql) : tokenizer(sql)
+    {
+        Advance();
+    }
+
+    WhitelistSql Parse()
+    {
+        WhitelistSql result;
+        while (current.type != End)
+        {
+            if (IsPunctuation(';'))
+            {
+                Advance();
+            }
+            else if (IsWord(current, "CREATE"))
+            {
+                SkipStatement();
+            }
+            else if (IsWord(current, "INSERT"))
+            {
+                ParseInsert(result);
+            }
+            else
+            {
+                tokenizer.Fail("Unsupported statement " + current.value);
+            }
+        }
+
+        return result;
+    }
+};
+}
+
+WhitelistParseException::WhitelistParseException(std::size_t line,
+                                                 std::string const& description)
+    : message("Line " + std::to_string(line) + ": " + description)
+{
+}
+
+WhitelistSql ParseWhitelistSql(std::string const& sql)
+{
+    return WhitelistSqlParser(sql).Parse();
+}
+
+std::vector<WhitelistEntry> CompiledWhitelist::GetEntries() const
+{
+    std::vector<WhitelistEntry> entries;
+    entries.reserve(slots.size());
+    for (WhitelistFile const& slot : slots)
+    {
+        WhitelistEntry entry;
+        entry.path = slot.level < 0 ? nullptr : slot.path.data();
+        entry.length = slot.path.size();
+        entry.level = slot.level;
+        entries.push_back(entry);
+    }
+
+    return entries;
+}
+
+// Places every bucket with the given seed, or returns false if some bucket
+// cannot be placed.
+static bool TryCompileWhitelist(std::vector<WhitelistFile> const& files,
+                                CompiledWhitelist& result)
+{
+    std::size_t const bucketCount =
+        (std::max)(static_cast<std::size_t>(1),
+                   (files.size() + rowsPerBucket - 1) / rowsPerBucket);
+    std::size_t const slotCount = files.size() + files.size() / 5 + 1;
+
+    std::vector<std::uint64_t> hashes;
+    std::vector<std::vector<std::size_t>> buckets(bucketCount);
+    for (std::size_t idx = 0; idx < files.size(); ++idx)
+    {
+        std::uint64_t const hash = HashWhitelistPath(result.seed, files[idx].path);
+        hashes.push_back(hash);
+        buckets[GetWhitelistBucket(hash, bucketCount)].push_back(idx);
+    }
+
+    std::vector<std::size_t> order(bucketCount);
+    for (std::size_t idx = 0; idx < bucketCount; ++idx)
+    {
+        order[idx] = idx;
+    }
+
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&](std::size_t lhs, std::size_t rhs)
+                     {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    WhitelistFile emptySlot;
+    emptySlot.level = -1;
+    result.displacements.assign(bucketCount, 0);
+    result.slots.assign(slotCount, emptySlot);
+    std::vector<std::size_t> placed;
+    for (std::size_t bucketIndex : order)
+    {
+        std::vector<std::size_t> const& bucket = buckets[bucketIndex];
+        if (bucket.empty())
+        {
+            break;
+        }
+
+        std::uint32_t displacement = 0;
+        for (;; ++displacement)
+        {
+            if (displacement == maximumDisplacement)
+            {
+                return false;
+            }
+
+            placed.clear();
+            for (std::size_t file : bucket)
+            {
+                std::size_t const slot =
+                    GetWhitelistSlot(hashes[file], displacement, slotCount);
+                if (result.slots[slot].level >= 0 ||
+                    std::find(placed.begin(), placed.end(), slot) != placed.end())
+                {
+                    break;
+                }
+
+                placed.push_back(slot);
+            }
+
+            if (placed.size() == bucket.size())
+            {
+                break;
+            }
+        }
+
+        result.displacements[bucketIndex] = displacement;
+        for (std::size_t idx = 0; idx < bucket.size(); ++idx)
+        {
+            result.slots[placed[idx]] = files[bucket[idx]];
+        }
+    }
+
+    return true;
+}
+
+CompiledWhitelist CompileWhitelist(std::vector<WhitelistFile> const& files)
+{
+    std::set<std::string> paths;
+    for (WhitelistFile const& file : files)
+    {
+        if (!paths.insert(file.path).second)
+        {
+            throw std::invalid_argument("Duplicate whitelist path " +
+                                        file.path);
+        }
+    }
+
+    CompiledWhitelist result;
+    for (result.seed = 0; result.seed != maximumSeed; ++result.seed)
+    {
+        if (TryCompileWhitelist(files, result))
+        {
+            return result;
+        }
+    }
+
+    throw std::logic_error("No perfect hash found for the whitelist.");
+}
+
+namespace
+{
+
+// A node of the trie the patterns are read into. The trie is a
+// nondeterministic automaton: a node reached through '*' also loops on every
+// character, and entering a node also enters its '*' child, which matches
+// nothing. Node 0 is the root, so 0 also stands for a missing child.
+struct PatternNode
+{
+    std::map<unsigned char, std::size_t> children;
+    std::size_t anyChild;
+    std::size_t starChild;
+    bool isStar;
+    // The most specific pattern ending here, or a level of -1 for none.
+    std::size_t literalCount;
+    int level;
+};
+
+typedef std::set<std::size_t> PatternNodeSet;
+
+class PatternAutomatonBuilder
+{
+    std::vector<PatternNode> nodes;
+
+    std::size_t AddNode(bool isStar)
+    {
+        PatternNode node;
+        node.anyChild = 0;
+        node.starChild = 0;
+        node.isStar = isStar;
+        node.literalCount = 0;
+        node.level = -1;
+        nodes.push_back(node);
+        return nodes.size() - 1;
+    }
+
+    // Enters a node; '*' is never followed by another '*' in the trie, so
+    // the closure is at most one step deep.
+    void Enter(PatternNodeSet& states, std::size_t node) const
+    {
+        states.insert(node);
+        if (nodes[node].starChild != 0)
+        {
+            states.insert(nodes[node].starChild);
+        }
+    }
+
+    public:
+    PatternAutomatonBuilder()
+    {
+        AddNode(false);
+    }
+
+    void Add(WhitelistPattern const& pattern)
+    {
+        std::size_t node = 0;
+        std::size_t literalCount = 0;
+        for (char ch : pattern.pattern)
+        {
+            if (ch == '*')
+            {
+                if (nodes[node].isStar)
+                {
+                    continue;
+                }
+
+                if (nodes[node].starChild == 0)
+                {
+                    std::size_t const child = AddNode(true);
+                    nodes[node].starChild = child;
+                }
+
+                node = nodes[node].starChild;
+            }
+            else if (ch == '?')
+            {
+                if (nodes[node].anyChild == 0)
+                {
+                    std::size_t const child = AddNode(false);
+                    nodes[node].anyChild = child;
+                }
+
+                node = nodes[node].anyChild;
+            }
+            else
+            {
+                unsigned char const byte = static_cast<unsigned char>(ch);
+                auto const existing = nodes[node].children.find(byte);
+                if (existing == nodes[node].children.end())
+                {
+                    std::size_t const child = AddNode(false);
+                    nodes[node].children[byte] = child;
+                    node = child;
+                }
+                else
+                {
+                    node = existing->second;
+                }
+
+                ++literalCount;
+            }
+        }
+
+        // Patterns which differ only in repeated '*'s end at the same node.
+        PatternNode& end = nodes[node];
+        if (end.level < 0 || literalCount > end.literalCount ||
+            (literalCount == end.literalCount && pattern.level < end.level))
+        {
+            end.literalCount = literalCount;
+            end.level = pattern.level;
+        }
+    }
+
+    // Gives each byte which appears in some pattern a class of its own, and
+    // every other byte class 0. Returns the class count.
+    std::size_t GetClasses(std::vector<unsigned char>& classes) const
+    {
+        std::vector<bool> isLiteral(256, false);
+        for (PatternNode const& node : nodes)
+        {
+            for (auto const& child : node.children)
+            {
+                isLiteral[child.first] = true;
+            }
+        }
+
+        std::size_t const literalCount =
+            std::count(isLiteral.begin(), isLiteral.end(), true);
+        std::size_t classCount = literalCount == 256 ? 0 : 1;
+        classes.assign(256, 0);
+        for (std::size_t byte = 0; byte < 256; ++byte)
+        {
+            if (isLiteral[byte])
+            {
+                classes[byte] = static_cast<unsigned char>(classCount++);
+            }
+        }
+
+        return classCount;
+    }
+
+    PatternNodeSet GetStart() const
+    {
+        PatternNodeSet states;
+        Enter(states, 0);
+        return states;
+    }
+
+    PatternNodeSet Step(PatternNodeSet const& states, unsigned char byte) const
+    {
+        PatternNodeSet next;
+        for (std::size_t state : states)
+        {
+            PatternNode const& node = nodes[state];
+            auto const child = node.children.find(byte);
+            if (child != node.children.end())
+            {
+                Enter(next, child->second);
+            }
+
+            if (node.anyChild != 0)
+            {
+                Enter(next, node.anyChild);
+            }
+
+            if (node.isStar)
+            {
+                next.insert(state);
+            }
+        }
+
+        return next;
+    }
+
+    // The level of the most specific pattern ending in any of the states;
+    // ties go to the lowest level.
+    int GetLevel(PatternNodeSet const& states) const
+    {
+        std::size_t bestLiteralCount = 0;
+        int bestLevel = -1;
+        for (std::size_t state : states)
+        {
+            PatternNode const& node = nodes[state];
+            if (node.level < 0)
+            {
+                continue;
+            }
+
+            if (bestLevel < 0 || node.literalCount > bestLiteralCount ||
+                (node.literalCount == bestLiteralCount && node.level < bestLevel))
+            {
+                bestLiteralCount = node.literalCount;
+                bestLevel = node.level;
+            }
+        }
+
+        return bestLevel;
+    }
+};
+}
+
+PatternWhitelistTable CompiledPatternWhitelist::GetTable() const
+{
+    PatternWhitelistTable table;
+    table.classes = classes.data();
+    table.classCount = classCount;
+    table.transitions = transitions.data();
+    table.levels = levels.data();
+    table.stateCount = levels.size();
+    return table;
+}
+
+CompiledPatternWhitelist CompileWhitelistPatterns(
+    std::vector<WhitelistPattern> const& patterns)
+{
+    PatternAutomatonBuilder builder;
+    std::set<std::string> seen;
+    for (WhitelistPattern const& pattern : patterns)
+    {
+        if (!seen.insert(pattern.pattern).second)
+        {
+            throw std::invalid_argument("Duplicate whitelist pattern " +
+                                        pattern.pattern);
+        }
+
+        builder.Add(pattern);
+    }
+
+    CompiledPatternWhitelist result;
+    result.classCount = builder.GetClasses(result.classes);
+    std::vector<unsigned char> representatives(result.classCount);
+    for (std::size_t byte = 256; byte-- != 0;)
+    {
+        representatives[result.classes[byte]] = static_cast<unsigned char>(byte);
+    }
+
+    // Subset construction; every state of the automaton is a set of trie
+    // nodes, numbered in the order they are first reached.
+    std::map<PatternNodeSet, std::size_t> stateIds;
+    std::vector<PatternNodeSet> states;
+    states.push_back(PatternNodeSet());
+    states.push_back(builder.GetStart());
+    stateIds[states[0]] = 0;
+    stateIds[states[1]] = 1;
+    for (std::size_t state = 0; state < states.size(); ++state)
+    {
+        for (std::size_t cls = 0; cls < result.classCount; ++cls)
+        {
+            PatternNodeSet next(
+                builder.Step(states[state], representatives[cls]));
+            auto const existing = stateIds.find(next);
+            std::size_t nextId;
+            if (existing == stateIds.end())
+            {
+                nextId = states.size();
+                if (nextId > maximumPatternStates)
+                {
+                    throw std::length_error(
+                        "The whitelist patterns need too many automaton "
+                        "states.");
+                }
+
+                stateIds[next] = nextId;
+                states.push_back(next);
+            }
+            else
+            {
+                nextId = existing->second;
+            }
+
+            result.transitions.push_back(static_cast<std::uint16_t>(nextId));
+        }
+
+        result.levels.push_back(builder.GetLevel(states[state]));
+    }
+
+    return result;
+}
+
+// Writes a string literal, escaping anything which is not printable ASCII.
+// Octal escapes are used as they cannot run into following digits.
+static void WriteStringLiteral(std::ostream& output, std::string const& text)
+{
+    output << '"';
+    for (char ch : text)
+    {
+        unsigned char const byte = static_cast<unsigned char>(ch);
+        if (ch == '\\' || ch == '"')
+        {
+            output << '\\' << ch;
+        }
+        else if (byte < 0x20 || byte >= 0x7F || ch == '?')
+        {
+            output << '\\' << static_cast<char>('0' + (byte >> 6))
+                   << static_cast<char>('0' + ((byte >> 3) & 7))
+                   << static_cast<char>('0' + (byte & 7));
+        }
+        else
+        {
+            output << ch;
+        }
+    }
+
+    output << '"';
+}
+
+// Writes a static array of numbers, a few to a line.
+template <typename Number>
+static void WriteNumberArray(std::ostream& output,
+                             char const* type,
+                             std::string const& name,
+                             std::vector<Number> const& values,
+                             std::size_t perLine,
+                             char const* suffix)
+{
+    output << "static " << type << " const " << name << "[] = {";
+    for (std::size_t idx = 0; idx < values.size(); ++idx)
+    {
+        output << (idx % perLine == 0 ? "\n    " : " ")
+               << static_cast<long>(values[idx]) << suffix << ',';
+    }
+
+    output << "\n};\n"
+              "\n";
+}
+
+void WriteWhitelistSource(std::ostream& output,
+                          CompiledWhitelist const& files,
+                          CompiledPatternWhitelist const& patterns)
+{
+    output << "// Generated by WhitelistCompiler. Do not edit.\n"
+              "\n"
+              "#include \"Whitelist.hpp\"\n"
+              "\n"
+              "namespace Instalog\n"
+              "{\n"
+              "\n";
+    WriteNumberArray(output,
+                     "std::uint32_t",
+                     "fileWhitelistDisplacements",
+                     files.displacements,
+                     8,
+                     "u");
+    output << "static WhitelistEntry const fileWhitelistEntries[] = {";
+    for (WhitelistFile const& slot : files.slots)
+    {
+        output << "\n    {";
+        if (slot.level < 0)
+        {
+            output << "nullptr, 0, -1},";
+            continue;
+        }
+
+        WriteStringLiteral(output, slot.path);
+        output << ", " << slot.path.size() << ", " << slot.level << "},";
+    }
+
+    output << "\n};\n"
+              "\n"
+              "extern WhitelistTable const fileWhitelist = {\n    "
+           << files.seed << "ull,\n"
+              "    fileWhitelistDisplacements,\n    "
+           << files.displacements.size()
+           << ",\n"
+              "    fileWhitelistEntries,\n    "
+           << files.slots.size() << "};\n"
+              "\n";
+
+    WriteNumberArray(output,
+                     "unsigned char",
+                     "patternWhitelistClasses",
+                     patterns.classes,
+                     16,
+                     "");
+    WriteNumberArray(output,
+                     "std::uint16_t",
+                     "patternWhitelistTransitions",
+                     patterns.transitions,
+                     16,
+                     "");
+    WriteNumberArray(output,
+                     "int",
+                     "patternWhitelistLevels",
+                     patterns.levels,
+                     16,
+                     "");
+    output << "extern PatternWhitelistTable const patternWhitelist = {\n"
+              "    patternWhitelistClasses,\n    "
+           << patterns.classCount
+           << ",\n"
+              "    patternWhitelistTransitions,\n"
+              "    patternWhitelistLevels,\n    "
+           << patterns.levels.size() << "};\n"
+              "}\n";
+}
+}
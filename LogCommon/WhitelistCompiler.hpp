@@ -0,0 +1,160 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/config.hpp>
+#include "Whitelist.hpp"
+
+namespace Instalog
+{
+
+/// @brief    Exception for signaling whitelist SQL which cannot be compiled.
+class WhitelistParseException : public std::exception
+{
+    std::string message;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    line           The line number at which the error occurred.
+    /// @param    description    Description of the error.
+    WhitelistParseException(std::size_t line, std::string const& description);
+
+    virtual char const* what() const BOOST_NOEXCEPT_OR_NOTHROW
+    {
+        return message.c_str();
+    }
+};
+
+/// @brief    One row of the Files table.
+struct WhitelistFile
+{
+    /// @summary The normalized path.
+    std::string path;
+    /// @summary The whitelist level.
+    int level;
+};
+
+/// @brief    One row of the Patterns table.
+struct WhitelistPattern
+{
+    /// @summary The pattern, normalized as paths are; see
+    ///          PatternWhitelistTable.
+    std::string pattern;
+    /// @summary The whitelist level.
+    int level;
+};
+
+/// @brief    The tables of Whitelist.sql.
+struct WhitelistSql
+{
+    /// @summary The rows of the Files table, in the order they were inserted.
+    std::vector<WhitelistFile> files;
+    /// @summary The rows of the Patterns table, in the order they were
+    ///          inserted.
+    std::vector<WhitelistPattern> patterns;
+};
+
+/// @brief    Reads the rows of the Files and Patterns tables from
+///         Whitelist.sql.
+///
+/// @remarks Only the subset of SQL the file uses is understood: comments,
+///          CREATE statements, which are skipped, and INSERT INTO Files or
+///          Patterns statements with literal values. Strings may be quoted
+///          with single or double quotes, and as in SQL, a doubled quote is
+///          the only escape.
+///          Paths and patterns are compared byte for byte with normalized
+///          text, so they must already be upper case; as the compiler has no
+///          upcase table, only ASCII letters are checked.
+///
+/// @param    sql    The contents of Whitelist.sql.
+///
+/// @return    The rows.
+///
+/// @throws WhitelistParseException The SQL is not understood, inserts
+///         a path or pattern twice, or inserts one with lower case letters.
+WhitelistSql ParseWhitelistSql(std::string const& sql);
+
+/// @brief    A whitelist laid out as a perfect hash table.
+struct CompiledWhitelist
+{
+    /// @summary The seed the paths were hashed with.
+    std::uint64_t seed;
+    /// @summary The displacement of each bucket.
+    std::vector<std::uint32_t> displacements;
+    /// @summary The row in each slot; empty slots have a level of -1.
+    std::vector<WhitelistFile> slots;
+
+    /// @brief    Gets the slots as table entries, which refer to the paths
+    ///         in this instance.
+    std::vector<WhitelistEntry> GetEntries() const;
+};
+
+/// @brief    Lays out whitelist rows as a perfect hash table.
+///
+/// @remarks Rows are hashed into buckets of about four. Buckets are placed
+///          largest first, each trying displacements from zero until every
+///          row in it lands in a free slot; there are a fifth more slots
+///          than rows so that the last buckets are placed quickly. If a
+///          bucket cannot be placed, the table is rebuilt with a new seed.
+///
+/// @param    files    The rows.
+///
+/// @return    The table.
+///
+/// @throws std::invalid_argument A path appears more than once.
+CompiledWhitelist CompileWhitelist(std::vector<WhitelistFile> const& files);
+
+/// @brief    Whitelist patterns compiled into a deterministic automaton.
+struct CompiledPatternWhitelist
+{
+    /// @summary The character class of each byte.
+    std::vector<unsigned char> classes;
+    /// @summary The number of character classes.
+    std::size_t classCount;
+    /// @summary The next state for each state and character class.
+    std::vector<std::uint16_t> transitions;
+    /// @summary The whitelist level of each state, or -1.
+    std::vector<int> levels;
+
+    /// @brief    Gets the automaton as a table, which refers to the arrays in
+    ///         this instance.
+    PatternWhitelistTable GetTable() const;
+};
+
+/// @brief    Compiles whitelist patterns into a deterministic automaton.
+///
+/// @remarks The patterns are read into a trie, sharing common prefixes,
+///          which is then determinized by subset construction. Where several
+///          patterns match a string, the one with the most literal
+///          characters wins, so that specific patterns override broad ones;
+///          ties go to the lowest level. '*' and '?' cannot be matched
+///          literally.
+///
+/// @param    patterns    The rows.
+///
+/// @return    The automaton.
+///
+/// @throws std::invalid_argument A pattern appears more than once.
+/// @throws std::length_error The automaton needs more states than fit in its
+///         transition table.
+CompiledPatternWhitelist CompileWhitelistPatterns(
+    std::vector<WhitelistPattern> const& patterns);
+
+/// @brief    Writes a C++ source file defining the compiled whitelist as
+///         fileWhitelist and patternWhitelist.
+///
+/// @param [in,out]    output    The stream to write to.
+/// @param    files       The compiled Files table.
+/// @param    patterns    The compiled Patterns table.
+void WriteWhitelistSource(std::ostream& output,
+                          CompiledWhitelist const& files,
+                          CompiledPatternWhitelist const& patterns);
+}
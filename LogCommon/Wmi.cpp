@@ -2,6 +2,7 @@
 // This is under the 2 clause BSD license.
 // See the included LICENSE.TXT file for more details.
 
+#include <stdexcept>
 #include "Win32Exception.hpp"
 #include "Wmi.hpp"
 
@@ -72,5 +73,80 @@ FILETIME WmiDateStringToFiletime(std::wstring const& datestring)
 
     return utcFileTime;
 }
+
+WmiQueryBatch::WmiQueryBatch(std::wstring const& namespaceName,
+                             std::chrono::milliseconds timeout)
+    : deadline(std::chrono::steady_clock::now() + timeout)
+{
+    UniqueComPtr<IWbemServices> root(GetWbemServices());
+    UniqueBstr name(namespaceName);
+    ThrowIfFailed(root->OpenNamespace(
+        name.AsInput(), 0, NULL, services.PassAsOutParameter(), NULL));
+}
+
+std::size_t WmiQueryBatch::Add(std::wstring const& query)
+{
+    UniqueBstr queryText(query);
+    UniqueComPtr<IEnumWbemClassObject> results;
+    ThrowIfFailed(services->ExecQuery(
+        BSTR(L"WQL"),
+        queryText.AsInput(),
+        WBEM_FLAG_RETURN_IMMEDIATELY | WBEM_FLAG_FORWARD_ONLY,
+        NULL,
+        results.PassAsOutParameter()));
+    queries.emplace_back(std::move(results));
+    return queries.size() - 1;
+}
+
+std::vector<UniqueComPtr<IWbemClassObject>>
+WmiQueryBatch::GetResults(std::size_t index)
+{
+    if (index >= queries.size())
+    {
+        throw std::out_of_range("No such WMI query.");
+    }
+
+    std::vector<UniqueComPtr<IWbemClassObject>> results;
+    for (;;)
+    {
+        // Once the deadline has passed, instances WMI has already delivered
+        // are still collected without waiting; only a query with nothing
+        // left to hand over times out.
+        auto const remaining =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        bool const expired = remaining.count() <= 0;
+
+        ULONG returnCount = 0;
+        UniqueComPtr<IWbemClassObject> instance;
+        HRESULT const hr = queries[index]->Next(
+            expired ? 0 : static_cast<long>(remaining.count()),
+            1,
+            instance.PassAsOutParameter(),
+            &returnCount);
+        if (FAILED(hr))
+        {
+            ThrowFromHResult(hr);
+        }
+
+        if (returnCount != 0)
+        {
+            results.emplace_back(std::move(instance));
+        }
+        else if (hr == WBEM_S_FALSE)
+        {
+            // The enumerator is exhausted.
+            return results;
+        }
+        else if (hr != WBEM_S_TIMEDOUT)
+        {
+            throw std::runtime_error("Unexpected number of returned classes.");
+        }
+        else if (expired)
+        {
+            throw WmiTimeoutException();
+        }
+    }
+}
+}
 }
-}
\ No newline at end of file
@@ -5,7 +5,10 @@
 #pragma once
 #pragma comment(lib, "wbemuuid.lib")
 #include <wbemidl.h>
+#include <chrono>
 #include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
 #include "Com.hpp"
 
 namespace Instalog
@@ -24,5 +27,57 @@ UniqueComPtr<IWbemServices> GetWbemServices();
 ///
 /// @return    The date / time as a FILETIME struct in UTC time
 FILETIME WmiDateStringToFiletime(std::wstring const& datestring);
+
+/// @brief    Exception for signaling a WMI query which did not finish before
+///         its deadline.
+struct WmiTimeoutException : public std::exception
+{
+    virtual char const* what() const
+    {
+        return "WMI query timed out";
+    }
+};
+
+/// @brief    Runs several WMI queries over a single connection.
+///
+/// @remarks Queries are issued semisynchronously as they are added, so WMI
+///          works on all of them while the caller is still reading the
+///          first. Every wait shares one deadline, so a provider which never
+///          answers costs at most the time left rather than stalling the
+///          caller.
+class WmiQueryBatch : boost::noncopyable
+{
+    UniqueComPtr<IWbemServices> services;
+    std::vector<UniqueComPtr<IEnumWbemClassObject>> queries;
+    std::chrono::steady_clock::time_point deadline;
+
+    public:
+    /// @brief    Constructor. Connects to a WMI namespace.
+    ///
+    /// @param    namespaceName    Name of the namespace, relative to ROOT.
+    /// @param    timeout          The time allowed for all queries in the
+    ///                            batch, starting now.
+    WmiQueryBatch(std::wstring const& namespaceName,
+                  std::chrono::milliseconds timeout);
+
+    /// @brief    Issues a WQL query without waiting for its results.
+    ///
+    /// @param    query    The query. Selecting only the properties which are
+    ///                    used saves WMI building whole instances.
+    ///
+    /// @return    The index of the query, to pass to GetResults.
+    std::size_t Add(std::wstring const& query);
+
+    /// @brief    Waits for the results of a query.
+    ///
+    /// @param    index    The index returned by Add.
+    ///
+    /// @return    The instances returned by the query, in the order WMI
+    ///            returned them.
+    ///
+    /// @throws WmiTimeoutException The deadline passed before the query
+    ///         finished, and WMI had no further instances ready for it.
+    std::vector<UniqueComPtr<IWbemClassObject>> GetResults(std::size_t index);
+};
 }
 }
\ No newline at end of file
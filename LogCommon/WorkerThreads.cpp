@@ -0,0 +1,116 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "WorkerThreads.hpp"
+
+namespace Instalog
+{
+
+WorkCounter::WorkCounter(std::size_t count) : next_(0), count_(count)
+{
+}
+
+bool WorkCounter::Next(std::size_t& index)
+{
+    if (next_.load(std::memory_order_relaxed) >= count_)
+    {
+        return false;
+    }
+
+    index = next_.fetch_add(1, std::memory_order_relaxed);
+    return index < count_;
+}
+
+std::size_t GetDefaultWorkerCount()
+{
+    std::size_t hardwareThreads = std::thread::hardware_concurrency();
+    if (hardwareThreads == 0)
+    {
+        return 4;
+    }
+
+    return hardwareThreads;
+}
+
+void RunOnWorkerThreads(std::size_t threadCount,
+                        std::function<void()> const& worker)
+{
+    std::mutex errorLock;
+    std::exception_ptr firstError;
+    auto guardedWorker = [&]() {
+        try
+        {
+            worker();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> guard(errorLock);
+            if (!firstError)
+            {
+                firstError = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    if (threadCount > 1)
+    {
+        threads.reserve(threadCount - 1);
+        for (std::size_t idx = 1; idx < threadCount; ++idx)
+        {
+            try
+            {
+                threads.emplace_back(guardedWorker);
+            }
+            catch (std::system_error const&)
+            {
+                // Out of threads; the ones already running, and this one,
+                // share the work instead. Unwinding here would destroy
+                // joinable threads.
+                break;
+            }
+        }
+    }
+
+    guardedWorker();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (firstError)
+    {
+        std::rethrow_exception(firstError);
+    }
+}
+
+void ParallelFor(std::size_t count,
+                 std::function<void(std::size_t)> const& body,
+                 std::size_t threadCount)
+{
+    WorkCounter counter(count);
+    std::atomic<bool> failed(false);
+    RunOnWorkerThreads((std::min)(count, threadCount), [&]() {
+        std::size_t index;
+        while (!failed.load(std::memory_order_relaxed) && counter.Next(index))
+        {
+            try
+            {
+                body(index);
+            }
+            catch (...)
+            {
+                failed.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    });
+}
+}
@@ -0,0 +1,74 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <boost/noncopyable.hpp>
+
+namespace Instalog
+{
+
+/// @brief    Hands out the indices [0, count) to any number of threads, each
+///         index exactly once.
+class WorkCounter : boost::noncopyable
+{
+    std::atomic<std::size_t> next_;
+    std::size_t const count_;
+
+    public:
+    /// @brief    Constructor.
+    ///
+    /// @param    count    The number of indices to hand out.
+    explicit WorkCounter(std::size_t count);
+
+    /// @brief    Claims the next index.
+    ///
+    /// @param [out]    index    The claimed index.
+    ///
+    /// @return    true if an index was claimed, false if all indices have
+    ///         been handed out.
+    bool Next(std::size_t& index);
+};
+
+/// @brief    Gets the number of worker threads used when a caller does not
+///         ask for a specific number.
+///
+/// @return    The number of hardware threads, or 4 if that is unknown.
+std::size_t GetDefaultWorkerCount();
+
+/// @brief    Runs a function on several threads at once, and waits for all of
+///         them to finish.
+///
+/// @remarks The calling thread is one of the threads which runs the
+///          function. Callers typically share a WorkCounter with the
+///          function to divide up work; this form exists so that the
+///          function can set up per thread state, such as a COM apartment,
+///          once rather than per work item. If the system cannot start
+///          another thread, the function runs on the threads already started,
+///          so callers must not rely on a particular number of invocations.
+///
+/// @param    threadCount    The most threads to run the function on. Zero is
+///                          treated as one.
+/// @param    worker         The function to run.
+///
+/// @throws    The first exception thrown by any invocation of worker, after
+///         all threads have finished.
+void RunOnWorkerThreads(std::size_t threadCount,
+                        std::function<void()> const& worker);
+
+/// @brief    Calls a function for every index in [0, count), spread across
+///         worker threads. No order is guaranteed between calls.
+///
+/// @param    count          The number of indices.
+/// @param    body           The function to call with each index.
+/// @param    threadCount    (optional) The maximum number of threads to use.
+///
+/// @throws    The first exception thrown by any call to body. Once a call
+///         has thrown, indices not yet started are skipped.
+void ParallelFor(std::size_t count,
+                 std::function<void(std::size_t)> const& body,
+                 std::size_t threadCount = GetDefaultWorkerCount());
+}
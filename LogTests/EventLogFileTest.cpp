@@ -0,0 +1,550 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/EventLogFile.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "TestFiles.hpp"
+
+using namespace Instalog::SystemFacades;
+
+// Event levels, as in EventLogEntry::EVT_LEVELS.
+static std::uint16_t const levelCritical = 1;
+static std::uint16_t const levelError = 2;
+static std::uint16_t const levelWarning = 3;
+static std::uint16_t const levelInformation = 4;
+
+// Builds an .evtx image in memory. Every record is an instance of one
+// template, shaped as the event log writes classic events:
+//
+// <Event>
+//   <System>
+//     <Provider Name="%0"/>
+//     <EventID Qualifiers="%1">%2</EventID>
+//     <Level>%3</Level>
+//     <TimeCreated SystemTime="%4"/>
+//   </System>
+//   <EventData>
+//     <Data>%5</Data>
+//     <Data>%6</Data>
+//   </EventData>
+// </Event>
+//
+// The template definition, and the names in it, appear inline in the first
+// record of each chunk; later records refer back to it.
+class EvtxBuilder
+{
+    std::vector<unsigned char> image_;
+    std::size_t chunk_;
+    std::size_t cursor_;
+    std::uint32_t templateOffset_;
+
+    void Byte(unsigned char value)
+    {
+        image_[chunk_ + cursor_++] = value;
+    }
+
+    void U16(std::uint16_t value)
+    {
+        Byte(static_cast<unsigned char>(value & 0xFF));
+        Byte(static_cast<unsigned char>(value >> 8));
+    }
+
+    void U32(std::uint32_t value)
+    {
+        U16(static_cast<std::uint16_t>(value & 0xFFFF));
+        U16(static_cast<std::uint16_t>(value >> 16));
+    }
+
+    void U64(std::uint64_t value)
+    {
+        U32(static_cast<std::uint32_t>(value & 0xFFFFFFFF));
+        U32(static_cast<std::uint32_t>(value >> 32));
+    }
+
+    void Chars(std::wstring const& text)
+    {
+        for (wchar_t ch : text)
+        {
+            U16(static_cast<std::uint16_t>(ch));
+        }
+    }
+
+    void Put32(std::size_t offset, std::uint32_t value)
+    {
+        std::memcpy(&image_[chunk_ + offset], &value, sizeof(value));
+    }
+
+    void Put64(std::size_t offset, std::uint64_t value)
+    {
+        std::memcpy(&image_[chunk_ + offset], &value, sizeof(value));
+    }
+
+    void NameRef(std::wstring const& name)
+    {
+        // Inline, directly after the offset itself.
+        U32(static_cast<std::uint32_t>(cursor_ + 4));
+        U32(0);
+        U16(0);
+        U16(static_cast<std::uint16_t>(name.size()));
+        Chars(name);
+        U16(0);
+    }
+
+    void OpenElement(std::wstring const& name, bool hasAttributes)
+    {
+        Byte(hasAttributes ? 0x41 : 0x01);
+        U16(0xFFFF);
+        U32(0);
+        NameRef(name);
+        if (hasAttributes)
+        {
+            U32(0);
+        }
+    }
+
+    void Attribute(std::wstring const& name)
+    {
+        Byte(0x06);
+        NameRef(name);
+    }
+
+    void Substitution(std::uint16_t id, unsigned char type)
+    {
+        Byte(0x0E);
+        U16(id);
+        Byte(type);
+    }
+
+    void TemplateBody()
+    {
+        Byte(0x0F);
+        Byte(1);
+        Byte(1);
+        Byte(0);
+        OpenElement(L"Event", false);
+        Byte(0x02);
+        OpenElement(L"System", false);
+        Byte(0x02);
+        OpenElement(L"Provider", true);
+        Attribute(L"Name");
+        Substitution(0, 0x01);
+        Byte(0x03);
+        OpenElement(L"EventID", true);
+        Attribute(L"Qualifiers");
+        Substitution(1, 0x06);
+        Byte(0x02);
+        Substitution(2, 0x06);
+        Byte(0x04);
+        OpenElement(L"Level", false);
+        Byte(0x02);
+        Substitution(3, 0x04);
+        Byte(0x04);
+        OpenElement(L"TimeCreated", true);
+        Attribute(L"SystemTime");
+        Substitution(4, 0x11);
+        Byte(0x03);
+        Byte(0x04);
+        OpenElement(L"EventData", false);
+        Byte(0x02);
+        for (std::uint16_t id = 5; id < 7; ++id)
+        {
+            OpenElement(L"Data", false);
+            Byte(0x02);
+            Substitution(id, 0x01);
+            Byte(0x04);
+        }
+        Byte(0x04);
+        Byte(0x04);
+        Byte(0x00);
+    }
+
+    public:
+    EvtxBuilder() : image_(4096), chunk_(0), cursor_(0), templateOffset_(0)
+    {
+        std::memcpy(&image_[0], "ElfFile", 8);
+    }
+
+    void StartChunk(std::uint64_t firstRecordNumber)
+    {
+        chunk_ = image_.size();
+        image_.resize(image_.size() + 65536);
+        std::memcpy(&image_[chunk_], "ElfChnk", 8);
+        Put64(8, firstRecordNumber);
+        Put32(48, 512);
+        cursor_ = 512;
+        templateOffset_ = 0;
+    }
+
+    void Record(std::uint64_t recordId,
+                std::wstring const& provider,
+                std::uint16_t eventId,
+                std::uint16_t qualifiers,
+                unsigned char level,
+                std::uint64_t created,
+                std::wstring const& first,
+                std::wstring const& second)
+    {
+        std::size_t const start = cursor_;
+        U32(0x00002a2a);
+        U32(0);
+        U64(recordId);
+        U64(created);
+
+        Byte(0x0F);
+        Byte(1);
+        Byte(1);
+        Byte(0);
+        Byte(0x0C);
+        Byte(1);
+        U32(1);
+        if (templateOffset_ == 0)
+        {
+            templateOffset_ = static_cast<std::uint32_t>(cursor_ + 4);
+            U32(templateOffset_);
+            U32(0);
+            for (int idx = 0; idx < 16; ++idx)
+            {
+                Byte(0);
+            }
+            std::size_t const sizeField = cursor_;
+            U32(0);
+            TemplateBody();
+            Put32(sizeField,
+                  static_cast<std::uint32_t>(cursor_ - sizeField - 4));
+        }
+        else
+        {
+            U32(templateOffset_);
+        }
+
+        struct
+        {
+            std::uint16_t size;
+            unsigned char type;
+        } const descriptors[] = {
+            {static_cast<std::uint16_t>(provider.size() * 2), 0x01},
+            {2, 0x06},
+            {2, 0x06},
+            {1, 0x04},
+            {8, 0x11},
+            {static_cast<std::uint16_t>(first.size() * 2), 0x01},
+            {static_cast<std::uint16_t>(second.size() * 2), 0x01},
+        };
+        U32(7);
+        for (auto const& descriptor : descriptors)
+        {
+            U16(descriptor.size);
+            Byte(descriptor.type);
+            Byte(0);
+        }
+        Chars(provider);
+        U16(qualifiers);
+        U16(eventId);
+        Byte(level);
+        U64(created);
+        Chars(first);
+        Chars(second);
+        Byte(0x00);
+
+        std::uint32_t const size = static_cast<std::uint32_t>(cursor_ - start + 4);
+        U32(size);
+        Put32(start + 4, size);
+        Put32(48, static_cast<std::uint32_t>(cursor_));
+    }
+
+    /// Makes the record starting at the given chunk offset undecodable.
+    void CorruptRecord(std::size_t recordStart)
+    {
+        // An unknown token in place of the fragment header.
+        image_[chunk_ + recordStart + 24] = 0x3F;
+    }
+
+    std::size_t GetCursor() const
+    {
+        return cursor_;
+    }
+
+    unsigned char const* begin() const
+    {
+        return image_.data();
+    }
+
+    unsigned char const* end() const
+    {
+        return image_.data() + image_.size();
+    }
+};
+
+// 2014-01-31T12:34:56Z
+static std::uint64_t const sampleTime = 130356452960000000ull;
+
+static EvtxBuilder MakeSample()
+{
+    EvtxBuilder builder;
+    builder.StartChunk(1);
+    builder.Record(1, L"Service Control Manager", 7000, 0xC000, 2, sampleTime,
+                   L"Example", L"Access is denied.");
+    builder.Record(2, L"Disk", 11, 0xC004, 3, sampleTime + 10, L"\\Device", L"");
+    builder.Record(3, L"Service Control Manager", 7031, 0xC000, 1,
+                   sampleTime + 20, L"Other", L"1");
+    return builder;
+}
+
+TEST(EventLogFile, RejectsNonEvtx)
+{
+    std::vector<unsigned char> notEvtx(8192);
+    EXPECT_THROW(EventLogFile(notEvtx.data(), notEvtx.data() + notEvtx.size()),
+                 InvalidEventLogFileException);
+}
+
+TEST(EventLogFile, ReadsEvents)
+{
+    EvtxBuilder const builder(MakeSample());
+    EventLogFile log(builder.begin(), builder.end());
+    ASSERT_EQ(1u, log.GetChunkCount());
+
+    std::vector<EventLogFileEntry> entries(log.ReadChunk(0));
+    ASSERT_EQ(3u, entries.size());
+
+    EXPECT_EQ("Service Control Manager", entries[0].GetSource());
+    EXPECT_EQ(7000u, entries[0].GetEventId());
+    EXPECT_EQ(0xC000, entries[0].GetQualifiers());
+    EXPECT_EQ(levelError, entries[0].GetLevel());
+    EXPECT_EQ(1u, entries[0].GetRecordId());
+    EXPECT_EQ(sampleTime, entries[0].GetCreated());
+    ASSERT_EQ(2u, entries[0].GetStrings().size());
+    EXPECT_EQ("Example", entries[0].GetStrings()[0]);
+    EXPECT_EQ("Access is denied.", entries[0].GetStrings()[1]);
+    EXPECT_EQ("Example; Access is denied.", entries[0].GetDescription());
+
+    // The second and third records refer back to the first one's template.
+    EXPECT_EQ("Disk", entries[1].GetSource());
+    EXPECT_EQ(11u, entries[1].GetEventId());
+    EXPECT_EQ(levelWarning, entries[1].GetLevel());
+    ASSERT_EQ(2u, entries[1].GetStrings().size());
+    EXPECT_EQ("\\Device", entries[1].GetStrings()[0]);
+    EXPECT_EQ("", entries[1].GetStrings()[1]);
+
+    EXPECT_EQ(7031u, entries[2].GetEventId());
+    EXPECT_EQ(levelCritical, entries[2].GetLevel());
+    EXPECT_EQ(3u, entries[2].GetRecordId());
+}
+
+TEST(EventLogFile, FiltersWhileDecoding)
+{
+    EvtxBuilder const builder(MakeSample());
+
+    EventLogFileFilter levels;
+    levels.levels.push_back(levelCritical);
+    levels.levels.push_back(levelError);
+    std::vector<EventLogFileEntry> entries(
+        EventLogFile(builder.begin(), builder.end(), levels).ReadChunk(0));
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(1u, entries[0].GetRecordId());
+    EXPECT_EQ(3u, entries[1].GetRecordId());
+
+    EventLogFileFilter recent;
+    recent.notBefore = sampleTime + 5;
+    recent.excludedEventIds.push_back(7031);
+    entries = EventLogFile(builder.begin(), builder.end(), recent).ReadChunk(0);
+    ASSERT_EQ(1u, entries.size());
+    EXPECT_EQ(2u, entries[0].GetRecordId());
+}
+
+TEST(EventLogFile, VisitsChunksInRecordOrder)
+{
+    EvtxBuilder builder;
+    builder.StartChunk(3);
+    builder.Record(3, L"Later", 2, 0, 2, sampleTime + 20, L"c", L"");
+    builder.StartChunk(1);
+    builder.Record(1, L"Earlier", 1, 0, 2, sampleTime, L"a", L"");
+    builder.Record(2, L"Earlier", 1, 0, 2, sampleTime + 10, L"b", L"");
+
+    EventLogFile log(builder.begin(), builder.end());
+    ASSERT_EQ(2u, log.GetChunkCount());
+    std::vector<std::uint64_t> recordIds;
+    log.ReadEvents([&](EventLogFileEntry& entry) {
+        recordIds.push_back(entry.GetRecordId());
+        return true;
+    });
+
+    ASSERT_EQ(3u, recordIds.size());
+    EXPECT_EQ(1u, recordIds[0]);
+    EXPECT_EQ(2u, recordIds[1]);
+    EXPECT_EQ(3u, recordIds[2]);
+}
+
+TEST(EventLogFile, VisitorCanStopReading)
+{
+    EvtxBuilder const builder(MakeSample());
+    EventLogFile log(builder.begin(), builder.end());
+    std::size_t visited = 0;
+    log.ReadEvents([&](EventLogFileEntry&) {
+        ++visited;
+        return false;
+    });
+
+    EXPECT_EQ(1u, visited);
+}
+
+TEST(EventLogFile, SkipsUndecodableRecords)
+{
+    EvtxBuilder builder(MakeSample());
+    std::size_t const corrupt = builder.GetCursor();
+    builder.Record(4, L"Broken", 1, 0, 2, sampleTime, L"x", L"y");
+    builder.CorruptRecord(corrupt);
+    builder.Record(5, L"Fine", 2, 0, 2, sampleTime, L"z", L"");
+
+    std::vector<EventLogFileEntry> entries(
+        EventLogFile(builder.begin(), builder.end()).ReadChunk(0));
+    ASSERT_EQ(4u, entries.size());
+    EXPECT_EQ(3u, entries[2].GetRecordId());
+    EXPECT_EQ("Fine", entries[3].GetSource());
+}
+
+// Sample.evtx is written by
+// TestProjects/SampleEventLogs/MakeSampleEventLogs.py, which describes the
+// events in it.
+class SampleEventLogTest : public ::testing::Test
+{
+    protected:
+    std::vector<unsigned char> image;
+
+    virtual void SetUp()
+    {
+        image = ReadTestDataFile("Sample.evtx");
+    }
+
+    std::vector<EventLogFileEntry>
+    ReadAll(EventLogFileFilter filter = EventLogFileFilter()) const
+    {
+        std::vector<EventLogFileEntry> entries;
+        EventLogFile(image.data(), image.data() + image.size(), filter)
+            .ReadEvents([&](EventLogFileEntry& entry) {
+                entries.push_back(entry);
+                return true;
+            });
+        return entries;
+    }
+
+    // Record n was created at 2015-01-01 plus n minutes, less a second.
+    static std::uint64_t CreatedTime(std::uint64_t recordId)
+    {
+        return 130645440000000000ull + recordId * 600000000ull - 10000000ull;
+    }
+};
+
+TEST_F(SampleEventLogTest, ReadsWrappedChunksInRecordOrder)
+{
+    EventLogFile log(image.data(), image.data() + image.size());
+    ASSERT_EQ(2u, log.GetChunkCount());
+    EXPECT_EQ(100u, log.ReadChunk(0).size());
+    EXPECT_EQ(40u, log.ReadChunk(1).size());
+
+    std::vector<EventLogFileEntry> const entries(ReadAll());
+    ASSERT_EQ(140u, entries.size());
+    for (std::size_t idx = 0; idx < entries.size(); ++idx)
+    {
+        ASSERT_EQ(idx + 1, entries[idx].GetRecordId());
+        EXPECT_EQ(CreatedTime(idx + 1), entries[idx].GetCreated());
+    }
+}
+
+TEST_F(SampleEventLogTest, ReadsClassicEvents)
+{
+    std::vector<EventLogFileEntry> const entries(ReadAll());
+    ASSERT_EQ(140u, entries.size());
+
+    EventLogFileEntry const& started = entries[0];
+    EXPECT_EQ("Service Control Manager", started.GetSource());
+    EXPECT_EQ(7036u, started.GetEventId());
+    EXPECT_EQ(0x4000, started.GetQualifiers());
+    EXPECT_EQ(levelInformation, started.GetLevel());
+    // The Binary element is not one of the event's strings.
+    ASSERT_EQ(2u, started.GetStrings().size());
+    EXPECT_EQ("Service 1", started.GetStrings()[0]);
+    EXPECT_EQ("running", started.GetStrings()[1]);
+
+    EventLogFileEntry const& failed = entries[1];
+    EXPECT_EQ(7000u, failed.GetEventId());
+    EXPECT_EQ(0xC000, failed.GetQualifiers());
+    EXPECT_EQ(levelError, failed.GetLevel());
+    EXPECT_EQ("Service 2; %%5", failed.GetDescription());
+
+    EventLogFileEntry const& disk = entries[2];
+    EXPECT_EQ("disk", disk.GetSource());
+    EXPECT_EQ(11u, disk.GetEventId());
+    EXPECT_EQ(0xC004, disk.GetQualifiers());
+    ASSERT_EQ(2u, disk.GetStrings().size());
+    EXPECT_EQ("\\Device\\Harddisk3\\DR3", disk.GetStrings()[0]);
+    EXPECT_EQ("", disk.GetStrings()[1]);
+
+    EventLogFileEntry const& uptime = entries[4];
+    EXPECT_EQ("EventLog", uptime.GetSource());
+    EXPECT_EQ(6013u, uptime.GetEventId());
+    EXPECT_EQ("5", uptime.GetStrings()[0]);
+}
+
+TEST_F(SampleEventLogTest, ReadsTypedEventData)
+{
+    std::vector<EventLogFileEntry> const entries(ReadAll());
+    ASSERT_EQ(140u, entries.size());
+    EventLogFileEntry const& boot = entries[3];
+    EXPECT_EQ("Microsoft-Windows-Kernel-General", boot.GetSource());
+    EXPECT_EQ(12u, boot.GetEventId());
+    EXPECT_EQ(0u, boot.GetQualifiers());
+    std::vector<std::string> expected;
+    expected.push_back("6");
+    expected.push_back("1");
+    expected.push_back("7601");
+    expected.push_back("2015-01-01T00:00:04.0000000Z");
+    EXPECT_EQ(expected, boot.GetStrings());
+
+    EventLogFileEntry const& power = entries[139];
+    EXPECT_EQ("Microsoft-Windows-Kernel-Power", power.GetSource());
+    EXPECT_EQ(41u, power.GetEventId());
+    EXPECT_EQ(levelCritical, power.GetLevel());
+    EXPECT_EQ(3u, power.GetStrings().size());
+}
+
+TEST_F(SampleEventLogTest, ReadsNestedUserData)
+{
+    std::vector<EventLogFileEntry> const entries(ReadAll());
+    ASSERT_EQ(140u, entries.size());
+    EventLogFileEntry const& cleared = entries[99];
+    EXPECT_EQ("Microsoft-Windows-Eventlog", cleared.GetSource());
+    EXPECT_EQ(104u, cleared.GetEventId());
+    EXPECT_EQ(levelWarning, cleared.GetLevel());
+    std::vector<std::string> expected;
+    expected.push_back("Administrator");
+    expected.push_back("SAMPLE-PC");
+    expected.push_back("System");
+    expected.push_back("");
+    EXPECT_EQ(expected, cleared.GetStrings());
+}
+
+TEST_F(SampleEventLogTest, FiltersSample)
+{
+    EventLogFileFilter severe;
+    severe.levels.push_back(levelCritical);
+    severe.levels.push_back(levelError);
+    std::vector<EventLogFileEntry> entries(ReadAll(severe));
+    EXPECT_EQ(57u, entries.size());
+    for (auto const& entry : entries)
+    {
+        EXPECT_GE(levelError, entry.GetLevel());
+    }
+
+    EventLogFileFilter recent;
+    recent.notBefore = CreatedTime(100);
+    recent.excludedEventIds.push_back(7036);
+    entries = ReadAll(recent);
+    ASSERT_EQ(33u, entries.size());
+    EXPECT_EQ(100u, entries.front().GetRecordId());
+    EXPECT_EQ(140u, entries.back().GetRecordId());
+}
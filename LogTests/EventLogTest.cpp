@@ -6,6 +6,7 @@
 #include "../LogCommon/EventLog.hpp"
 
 using Instalog::SystemFacades::EventLogEntry;
+using Instalog::SystemFacades::MakeEventQuery;
 using Instalog::SystemFacades::OldEventLog;
 using Instalog::SystemFacades::XmlEventLog;
 
@@ -27,4 +28,50 @@ TEST(XmlEventLog, ReceivedEventLogEntries)
         eventLog.ReadEvents());
 
     ASSERT_TRUE(eventLogEntries.size() > 0);
-}
\ No newline at end of file
+}
+
+TEST(OldEventLog, VisitorCanStopReading)
+{
+    OldEventLog eventLog;
+    std::size_t visited = 0;
+
+    eventLog.ReadEvents([&](EventLogEntry&) {
+        ++visited;
+        return false;
+    });
+
+    ASSERT_EQ(1, visited);
+}
+
+TEST(XmlEventLog, VisitorCanStopReading)
+{
+    XmlEventLog eventLog;
+    std::size_t visited = 0;
+
+    eventLog.ReadEvents([&](EventLogEntry&) {
+        ++visited;
+        return visited < 3;
+    });
+
+    ASSERT_EQ(3, visited);
+}
+
+TEST(XmlEventLog, QueryFiltersLevels)
+{
+    XmlEventLog eventLog("System", MakeEventQuery({2, 3}, 0, {}).c_str());
+
+    eventLog.ReadEvents([&](EventLogEntry& entry) {
+        EXPECT_TRUE(entry.level == EventLogEntry::EvtLevelError ||
+                    entry.level == EventLogEntry::EvtLevelWarning);
+        return true;
+    });
+}
+
+TEST(EventLog, MakeEventQuery)
+{
+    EXPECT_EQ("Event/System[(Level=1)]", MakeEventQuery({1}, 0, {}));
+    EXPECT_EQ("Event/System[(Level=1 or Level=2) and "
+              "TimeCreated[timediff(@SystemTime) <= 604800000] and "
+              "EventID!=1000 and EventID!=8023]",
+              MakeEventQuery({1, 2}, 604800000, {1000, 8023}));
+}
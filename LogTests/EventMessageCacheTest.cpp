@@ -0,0 +1,199 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/ErrorReporter.hpp"
+#include "../LogCommon/EventMessageCache.hpp"
+#include "../LogCommon/Library.hpp"
+#include "../LogCommon/LogSink.hpp"
+
+using Instalog::SystemFacades::EventMessageCache;
+using Instalog::SystemFacades::EventMessageCacheStatistics;
+using Instalog::SystemFacades::FormattedMessageLoader;
+using Instalog::SystemFacades::MessageTemplate;
+using Instalog::GetIgnoreReporter;
+using Instalog::GetThrowingErrorReporter;
+
+TEST(MessageTemplate, SubstitutesInserts)
+{
+    MessageTemplate messageTemplate(
+        L"The %1 service terminated with the following error: %n%2");
+    std::vector<std::wstring> arguments;
+    arguments.emplace_back(L"Example");
+    arguments.emplace_back(L"Access is denied.");
+    EXPECT_EQ("The Example service terminated with the following error: "
+              "\r\nAccess is denied.",
+              messageTemplate.Format(arguments));
+}
+
+TEST(MessageTemplate, InsertsMayRepeatAndSkipFormats)
+{
+    MessageTemplate messageTemplate(L"%2!s! and %1!d! then %2 %12");
+    std::vector<std::wstring> arguments;
+    arguments.emplace_back(L"one");
+    arguments.emplace_back(L"two");
+    EXPECT_EQ("two and one then two %12", messageTemplate.Format(arguments));
+}
+
+TEST(MessageTemplate, Escapes)
+{
+    MessageTemplate messageTemplate(L"100%% done%.%!%t%b%rend%0ignored");
+    EXPECT_EQ("100% done.!\t \rend",
+              messageTemplate.Format(std::vector<std::wstring>()));
+}
+
+TEST(MessageTemplate, TrailingPercent)
+{
+    MessageTemplate messageTemplate(L"50%");
+    EXPECT_EQ("50%", messageTemplate.Format(std::vector<std::wstring>()));
+}
+
+TEST(EventMessageCache, LoadsTemplateOnce)
+{
+    EventMessageCache cache;
+    std::size_t loads = 0;
+    auto const load = [&] {
+        ++loads;
+        return std::wstring(L"Error %1");
+    };
+
+    cache.GetTemplate("Service Control Manager", 7000, 0, load);
+    auto const cached =
+        cache.GetTemplate("Service Control Manager", 7000, 0, load);
+    cache.GetTemplate("Service Control Manager", 7001, 0, load);
+    cache.GetTemplate("Service Control Manager", 7000, 1033, load);
+    cache.GetTemplate("Disk", 7000, 0, load);
+
+    EXPECT_EQ(4u, loads);
+    EXPECT_EQ("Error x",
+              cached->Format(std::vector<std::wstring>(1, L"x")));
+    EventMessageCacheStatistics const statistics = cache.GetStatistics();
+    EXPECT_EQ(1u, statistics.hits);
+    EXPECT_EQ(4u, statistics.misses);
+}
+
+TEST(EventMessageCache, RemembersMissingModules)
+{
+    EventMessageCache cache;
+    std::size_t opens = 0;
+    auto const open = [&] {
+        ++opens;
+        return std::shared_ptr<void>();
+    };
+
+    EXPECT_FALSE(cache.GetPublisherMetadata("Missing", open));
+    EXPECT_FALSE(cache.GetPublisherMetadata("Missing", open));
+    EXPECT_EQ(1u, opens);
+}
+
+TEST(EventMessageCache, FailedLoadsAreRetried)
+{
+    EventMessageCache cache;
+    EXPECT_THROW(cache.GetTemplate("Source", 1, 0, []() -> std::wstring {
+        throw std::runtime_error("load failed");
+    }), std::runtime_error);
+
+    auto const loaded =
+        cache.GetTemplate("Source", 1, 0, [] { return std::wstring(L"ok"); });
+    EXPECT_EQ("ok", loaded->Format(std::vector<std::wstring>()));
+}
+
+TEST(EventMessageCache, LoadersMayUseTheCache)
+{
+    EventMessageCache cache;
+    auto const publisher = cache.GetPublisherMetadata("Provider", [&] {
+        cache.GetTemplate("Provider", 1, 0, [] {
+            return std::wstring(L"Nested");
+        });
+        return std::shared_ptr<void>(new int(1));
+    });
+
+    EXPECT_TRUE(publisher != nullptr);
+    EXPECT_EQ(2u, cache.GetStatistics().misses);
+}
+
+TEST(EventMessageCache, SlowLoadsDoNotBlockOtherKeys)
+{
+    EventMessageCache cache;
+    std::promise<void> slowStarted;
+    std::promise<void> fastLoaded;
+    auto slow = std::async(std::launch::async, [&] {
+        return cache.GetTemplate("Slow", 1, 0, [&] {
+            slowStarted.set_value();
+            fastLoaded.get_future().wait();
+            return std::wstring(L"Slow");
+        });
+    });
+
+    // Were the cache locked while loading, this would wait for the slow
+    // load, which in turn waits for this one.
+    slowStarted.get_future().wait();
+    cache.GetTemplate("Fast", 1, 0, [] { return std::wstring(L"Fast"); });
+    fastLoaded.set_value();
+    EXPECT_EQ("Slow", slow.get()->Format(std::vector<std::wstring>()));
+}
+
+TEST(EventMessageCache, FormatsStatistics)
+{
+    EventMessageCacheStatistics statistics = {9, 1};
+    std::string result;
+    Instalog::write(result, statistics);
+    EXPECT_EQ("9 hits, 1 misses (90% hit rate)", result);
+
+    EventMessageCacheStatistics const empty = {0, 0};
+    result.clear();
+    Instalog::write(result, empty);
+    EXPECT_EQ("0 hits, 0 misses (0% hit rate)", result);
+}
+
+// Formats every message in a range of IDs both through a MessageTemplate and
+// through FormatMessage, and returns how many were compared.
+static std::size_t CompareWithFormatMessage(char const* modulePath,
+                                            DWORD firstId,
+                                            DWORD lastId)
+{
+    FormattedMessageLoader module(GetThrowingErrorReporter(), modulePath);
+    // FormatMessage reads as many arguments as the message refers to.
+    std::vector<std::wstring> arguments;
+    for (int idx = 1; idx <= 99; ++idx)
+    {
+        arguments.push_back(L"<" + std::to_wstring(idx) + L">");
+    }
+
+    std::size_t compared = 0;
+    for (DWORD messageId = firstId; messageId <= lastId; ++messageId)
+    {
+        std::wstring const definition =
+            module.GetMessageDefinition(GetIgnoreReporter(), messageId);
+        // Inserts with a numeric !format! are not strings; FormatMessage
+        // would read the argument pointers as numbers.
+        if (definition.empty() || definition.find(L'!') != std::wstring::npos)
+        {
+            continue;
+        }
+
+        EXPECT_EQ(module.GetFormattedMessage(
+                      GetThrowingErrorReporter(), messageId, arguments),
+                  MessageTemplate(definition).Format(arguments))
+            << modulePath << " message " << messageId;
+        ++compared;
+    }
+
+    return compared;
+}
+
+TEST(MessageTemplate, MatchesFormatMessageOnRealModules)
+{
+    EXPECT_LT(0u,
+              CompareWithFormatMessage(
+                  "C:\\Windows\\System32\\dhcpcore.dll", 50000, 50999));
+    EXPECT_LT(0u,
+              CompareWithFormatMessage(
+                  "C:\\Windows\\System32\\netmsg.dll", 2100, 2999));
+}
@@ -0,0 +1,127 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/FileMetadataCache.hpp"
+#include "../LogCommon/WorkerThreads.hpp"
+
+using Instalog::SystemFacades::FileMetadata;
+using Instalog::SystemFacades::FileMetadataCache;
+
+static FileMetadata MakeMetadata(std::uint64_t size)
+{
+    FileMetadata metadata;
+    metadata.exists = true;
+    metadata.size = size;
+    metadata.creationTime = 130356452960000000ull;
+    metadata.hasCompany = true;
+    metadata.company = "Example Corporation";
+    return metadata;
+}
+
+TEST(FileMetadataCache, LoadsEachPathOnce)
+{
+    std::vector<std::string> loaded;
+    FileMetadataCache cache([&](std::string const& path) {
+        loaded.push_back(path);
+        return MakeMetadata(path.size());
+    });
+
+    EXPECT_EQ(25u, cache.Get("C:\\Windows\\system32\\a.dll").size);
+    EXPECT_EQ(25u, cache.Get("C:\\WINDOWS\\SYSTEM32\\A.DLL").size);
+    EXPECT_EQ(25u, cache.Get("C:\\Windows\\system32\\b.dll").size);
+    ASSERT_EQ(2u, loaded.size());
+    EXPECT_EQ("C:\\Windows\\system32\\a.dll", loaded[0]);
+    EXPECT_EQ("C:\\Windows\\system32\\b.dll", loaded[1]);
+    EXPECT_EQ(2u, cache.GetSize());
+}
+
+TEST(FileMetadataCache, RemembersMissingFiles)
+{
+    std::size_t loads = 0;
+    FileMetadataCache cache([&](std::string const&) {
+        ++loads;
+        return FileMetadata();
+    });
+
+    EXPECT_FALSE(cache.Get("C:\\Missing.exe").exists);
+    EXPECT_FALSE(cache.Get("C:\\Missing.exe").exists);
+    EXPECT_EQ(1u, loads);
+}
+
+TEST(FileMetadataCache, FailedLoadsAreRetried)
+{
+    bool fail = true;
+    FileMetadataCache cache([&](std::string const&) -> FileMetadata {
+        if (fail)
+        {
+            throw std::runtime_error("load failed");
+        }
+
+        return MakeMetadata(42);
+    });
+
+    EXPECT_THROW(cache.Get("C:\\Locked.sys"), std::runtime_error);
+    fail = false;
+    EXPECT_EQ(42u, cache.Get("C:\\Locked.sys").size);
+}
+
+TEST(FileMetadataCache, ClearForgetsMetadata)
+{
+    std::uint64_t size = 1;
+    FileMetadataCache cache([&](std::string const&) {
+        return MakeMetadata(size);
+    });
+
+    EXPECT_EQ(1u, cache.Get("C:\\Windows\\notepad.exe").size);
+    size = 2;
+    EXPECT_EQ(1u, cache.Get("C:\\Windows\\notepad.exe").size);
+    cache.Clear();
+    EXPECT_EQ(0u, cache.GetSize());
+    EXPECT_EQ(2u, cache.Get("C:\\Windows\\notepad.exe").size);
+}
+
+TEST(FileMetadataCache, PrefetchLoadsEveryPathOnce)
+{
+    std::atomic<std::size_t> loads(0);
+    FileMetadataCache cache([&](std::string const& path) -> FileMetadata {
+        ++loads;
+        if (path == "C:\\Locked.sys")
+        {
+            throw std::runtime_error("load failed");
+        }
+
+        return MakeMetadata(path.size());
+    });
+
+    std::vector<std::string> paths;
+    for (std::size_t idx = 0; idx < 64; ++idx)
+    {
+        paths.push_back("C:\\File" + std::to_string(idx % 16) + ".dll");
+    }
+    paths.push_back("C:\\Locked.sys");
+
+    cache.Prefetch(paths);
+    EXPECT_EQ(17u, loads.load());
+    EXPECT_EQ(13u, cache.Get("C:\\File10.dll").size);
+    EXPECT_EQ(17u, loads.load());
+}
+
+TEST(FileMetadataCache, ConcurrentRequestsShareOneLoad)
+{
+    std::atomic<std::size_t> loads(0);
+    FileMetadataCache cache([&](std::string const&) {
+        ++loads;
+        return MakeMetadata(7);
+    });
+
+    Instalog::ParallelFor(256, [&](std::size_t) {
+        EXPECT_EQ(7u, cache.Get("C:\\Windows\\explorer.exe").size);
+    }, 8);
+    EXPECT_EQ(1u, loads.load());
+}
@@ -233,6 +233,27 @@ TEST(File, CanWriteBytes)
     }
 }
 
+TEST(File, CanReadLines)
+{
+    std::string const text("\xFF\xFE" "a\0\r\0\n\0\r\0\n\0b\0", 14);
+    File lines(GetTestPath("CanReadLines.txt"),
+               GENERIC_READ | GENERIC_WRITE,
+               0,
+               0,
+               CREATE_ALWAYS,
+               FILE_FLAG_DELETE_ON_CLOSE);
+    ASSERT_TRUE(lines.WriteBytes(std::vector<char>(text.begin(), text.end())));
+
+    std::vector<std::string> result;
+    for (boost::string_ref line : lines.Lines())
+    {
+        result.emplace_back(line.data(), line.size());
+    }
+
+    std::vector<std::string> const expected = {"a", "", "b"};
+    EXPECT_EQ(expected, result);
+}
+
 TEST(File, CantWriteBytesToReadOnlyFile)
 {
     File fileToWriteTo(GetTestPath("CantWriteBytesToReadOnlyFile.txt"),
@@ -0,0 +1,145 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/HostsScanner.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/LogSink.hpp"
+
+using Instalog::HostsScanner;
+using Instalog::IsLoopbackHostsEntry;
+using Instalog::WriteHostsEntries;
+using Instalog::string_sink;
+
+static std::vector<std::string> Scan(std::string const& text)
+{
+    unsigned char const* const first =
+        reinterpret_cast<unsigned char const*>(text.data());
+    HostsScanner scanner(first, first + text.size());
+    std::vector<std::string> result;
+    boost::string_ref entry;
+    while (scanner.Next(entry))
+    {
+        result.emplace_back(entry.data(), entry.size());
+    }
+
+    return result;
+}
+
+static std::string Write(std::string const& text, std::size_t entryLimit)
+{
+    unsigned char const* const first =
+        reinterpret_cast<unsigned char const*>(text.data());
+    HostsScanner scanner(first, first + text.size());
+    string_sink sink;
+    WriteHostsEntries(sink, scanner, entryLimit);
+    return sink.get();
+}
+
+TEST(HostsScanner, Empty)
+{
+    EXPECT_TRUE(Scan("").empty());
+    EXPECT_TRUE(Scan("\r\n\r\n   \n\t\n").empty());
+}
+
+TEST(HostsScanner, SkipsCommentsAndTrims)
+{
+    std::vector<std::string> const expected = {
+        "127.0.0.1       localhost",
+        "::1 localhost",
+        "10.0.0.1 example.com # trailing comments are kept"};
+    EXPECT_EQ(expected,
+              Scan("# Copyright (c) 1993-2009 Microsoft Corp.\r\n"
+                   "#\r\n"
+                   "  \t127.0.0.1       localhost  \r\n"
+                   "\t# ::1 commented\r\n"
+                   "::1 localhost\r\n"
+                   "\r\n"
+                   "10.0.0.1 example.com # trailing comments are kept"));
+}
+
+TEST(HostsScanner, LineEndings)
+{
+    std::vector<std::string> const expected = {"a", "b", "c", "d"};
+    EXPECT_EQ(expected, Scan("a\nb\rc\r\n\r\nd\n"));
+    EXPECT_EQ(expected, Scan("a\rb\rc\rd"));
+}
+
+TEST(HostsScanner, SkipsUtf8ByteOrderMark)
+{
+    std::vector<std::string> const expected = {"127.0.0.1 localhost"};
+    EXPECT_EQ(expected, Scan("\xEF\xBB\xBF" "127.0.0.1 localhost\r\n"));
+}
+
+TEST(HostsScanner, Utf16)
+{
+    std::string const text("127.0.0.1 caf\xE9\r\n# x\r\n0.0.0.0 ads");
+    std::string withBom("\xFF\xFE", 2);
+    std::string withoutBom;
+    for (char ch : text)
+    {
+        withBom.push_back(ch);
+        withBom.push_back('\0');
+        withoutBom.push_back(ch);
+        withoutBom.push_back('\0');
+    }
+
+    std::vector<std::string> const expected = {"127.0.0.1 caf\xC3\xA9",
+                                               "0.0.0.0 ads"};
+    EXPECT_EQ(expected, Scan(withBom));
+    EXPECT_EQ(expected, Scan(withoutBom));
+}
+
+TEST(HostsScanner, IsLoopback)
+{
+    EXPECT_TRUE(IsLoopbackHostsEntry("127.0.0.1 localhost"));
+    EXPECT_TRUE(IsLoopbackHostsEntry("0.0.0.0\tads.example.com"));
+    EXPECT_TRUE(IsLoopbackHostsEntry("::1 localhost"));
+    EXPECT_FALSE(IsLoopbackHostsEntry("127.0.0.10 localhost"));
+    EXPECT_FALSE(IsLoopbackHostsEntry("10.0.0.1 update.example.com"));
+    EXPECT_FALSE(IsLoopbackHostsEntry(""));
+}
+
+TEST(HostsScanner, WritesAllEntriesUnderTheLimit)
+{
+    EXPECT_EQ("Hosts: 127.0.0.1 localhost\r\n"
+              "Hosts: ::1 localhost\r\n",
+              Write("127.0.0.1 localhost\r\n::1 localhost\r\n", 2));
+}
+
+TEST(HostsScanner, SummarizesEntriesPastTheLimit)
+{
+    EXPECT_EQ("Hosts: 0.0.0.0 a\r\n"
+              "Hosts: 0.0.0.0 b\r\n"
+              "Hosts: 10.0.0.1 d\r\n"
+              "Hosts: 10.0.0.2 e\r\n"
+              "Hosts: 5 more entries not shown (3 to loopback or null "
+              "addresses, 2 to other addresses)\r\n",
+              Write("0.0.0.0 a\n0.0.0.0 b\n0.0.0.0 c\n10.0.0.1 d\n"
+                    "127.0.0.1 x\n10.0.0.2 e\n10.0.0.3 f\n::1 y\n10.0.0.4 g\n",
+                    2));
+}
+
+TEST(HostsScanner, DISABLED_BenchmarkLargeHostsFile)
+{
+    std::string text("# Ad blocking hosts file\r\n");
+    for (std::size_t idx = 0; idx < 300000; ++idx)
+    {
+        text.append("0.0.0.0 ads");
+        text.append(std::to_string(idx));
+        text.append(".example.com\r\n");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string const log = Write(text, 100);
+    auto done = std::chrono::steady_clock::now();
+
+    std::cout << text.size() << " bytes scanned in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     done - start).count()
+              << " ms; " << log.size() << " bytes logged" << std::endl;
+}
@@ -0,0 +1,159 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/LineReader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+using Instalog::LineReader;
+
+static unsigned char const* Bytes(std::string const& text)
+{
+    return reinterpret_cast<unsigned char const*>(text.data());
+}
+
+static std::vector<std::string> ReadLines(LineReader& reader)
+{
+    std::vector<std::string> result;
+    for (boost::string_ref line : reader)
+    {
+        result.emplace_back(line.data(), line.size());
+    }
+
+    return result;
+}
+
+static std::vector<std::string> FromMemory(std::string const& text)
+{
+    LineReader reader(Bytes(text), Bytes(text) + text.size());
+    return ReadLines(reader);
+}
+
+// Reads text through a read function which supplies at most chunkSize bytes
+// at a time, to split lines, line breaks and characters across reads.
+static std::vector<std::string> FromChunks(std::string const& text,
+                                           std::size_t chunkSize)
+{
+    std::size_t offset = 0;
+    LineReader reader([&](unsigned char* buffer, std::size_t size)
+                      {
+                          std::size_t const count = (std::min)(
+                              (std::min)(size, chunkSize), text.size() - offset);
+                          std::memcpy(buffer, text.data() + offset, count);
+                          offset += count;
+                          return count;
+                      });
+    return ReadLines(reader);
+}
+
+static std::string ToUtf16(std::u16string const& text, bool byteOrderMark)
+{
+    std::string result;
+    if (byteOrderMark)
+    {
+        result.append("\xFF\xFE", 2);
+    }
+
+    for (char16_t ch : text)
+    {
+        result.push_back(static_cast<char>(ch & 0xFF));
+        result.push_back(static_cast<char>(ch >> 8));
+    }
+
+    return result;
+}
+
+static void ExpectSameEverywhere(std::string const& text,
+                                 std::vector<std::string> const& expected)
+{
+    EXPECT_EQ(expected, FromMemory(text));
+    for (std::size_t chunkSize : {1, 2, 3, 7, 4096})
+    {
+        EXPECT_EQ(expected, FromChunks(text, chunkSize)) << chunkSize;
+    }
+}
+
+TEST(LineReader, Empty)
+{
+    ExpectSameEverywhere("", {});
+    ExpectSameEverywhere("\xEF\xBB\xBF", {});
+}
+
+TEST(LineReader, LineBreaks)
+{
+    std::vector<std::string> const expected = {"a", "", "b", "c", "", "d"};
+    ExpectSameEverywhere("a\r\n\r\nb\nc\r\rd", expected);
+    ExpectSameEverywhere("a\r\n\r\nb\nc\r\rd\r\n", expected);
+}
+
+TEST(LineReader, FinalLineBreakDoesNotStartALine)
+{
+    std::vector<std::string> const expected = {"a", ""};
+    ExpectSameEverywhere("a\n\n", expected);
+    ExpectSameEverywhere("a\r\n\r", expected);
+}
+
+TEST(LineReader, SkipsUtf8ByteOrderMark)
+{
+    ExpectSameEverywhere("\xEF\xBB\xBF" "caf\xC3\xA9\r\nx",
+                         {"caf\xC3\xA9", "x"});
+}
+
+TEST(LineReader, Utf16)
+{
+    std::u16string const text(u"caf\u00E9\r\n\U0001F600 \u20AC\r\nlast");
+    std::vector<std::string> const expected = {
+        "caf\xC3\xA9", "\xF0\x9F\x98\x80 \xE2\x82\xAC", "last"};
+    ExpectSameEverywhere(ToUtf16(text, true), expected);
+    ExpectSameEverywhere(ToUtf16(u"127.0.0.1 x\r\n", false), {"127.0.0.1 x"});
+}
+
+TEST(LineReader, Utf16UnpairedSurrogates)
+{
+    std::u16string text(u"a?b\r\nc?");
+    text[1] = 0xDC00;
+    text[6] = 0xD800;
+    ExpectSameEverywhere(ToUtf16(text, true),
+                         {"a\xEF\xBF\xBD" "b", "c\xEF\xBF\xBD"});
+}
+
+TEST(LineReader, Utf16OddLength)
+{
+    ExpectSameEverywhere(ToUtf16(u"ab", true) + "c", {"ab"});
+}
+
+TEST(LineReader, LongLinesSpanReads)
+{
+    std::string const longLine(200000, 'x');
+    std::vector<std::string> const expected = {"a", longLine, "b"};
+    EXPECT_EQ(expected, FromChunks("a\r\n" + longLine + "\r\nb", 65536));
+    EXPECT_EQ(expected, FromMemory("a\r\n" + longLine + "\r\nb"));
+}
+
+TEST(LineReader, LinesReferIntoMemory)
+{
+    std::string const text("first\nsecond");
+    LineReader reader(Bytes(text), Bytes(text) + text.size());
+    boost::string_ref line;
+    ASSERT_TRUE(reader.Next(line));
+    ASSERT_TRUE(reader.Next(line));
+    EXPECT_EQ(text.data() + 6, line.data());
+    EXPECT_FALSE(reader.Next(line));
+    EXPECT_FALSE(reader.Next(line));
+}
+
+TEST(LineReader, Move)
+{
+    std::string const text(ToUtf16(u"one\r\ntwo\r\nthree", true));
+    LineReader reader(Bytes(text), Bytes(text) + text.size());
+    boost::string_ref line;
+    ASSERT_TRUE(reader.Next(line));
+    EXPECT_EQ("one", line);
+    LineReader moved(std::move(reader));
+    std::vector<std::string> const expected = {"two", "three"};
+    EXPECT_EQ(expected, ReadLines(moved));
+}
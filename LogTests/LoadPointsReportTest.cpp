@@ -0,0 +1,360 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include "gtest/gtest.h"
+#include "../LogCommon/LoadPointsReport.hpp"
+#include "../LogCommon/MemoryRegistry.hpp"
+#include "../LogCommon/RegistryBackend.hpp"
+
+using namespace Instalog;
+using namespace Instalog::SystemFacades;
+
+#ifdef _M_X64
+static std::string const bits("64");
+#else
+static std::string const bits;
+#endif
+
+// The report requires the parents of the keys it enumerates sub keys of, and
+// the hive list, to exist; everything else in it is optional.
+static char const reportSkeleton[] =
+    "Windows Registry Editor Version 5.00\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\SYSTEM\\CurrentControlSet\\Control\\hivelist]\r\n"
+    "\"\\\\REGISTRY\\\\USER\\\\.DEFAULT\"=\"\"\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Internet Explorer]\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Active Setup]\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows NT\\CurrentVersion\\Winlogon]\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Wow6432Node\\Microsoft\\Internet Explorer]\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Wow6432Node\\Microsoft\\Active Setup]\r\n"
+    "[HKEY_CURRENT_USER\\Software\\Microsoft\\Internet Explorer]\r\n"
+    "[HKEY_CURRENT_USER\\Software\\Wow6432Node\\Microsoft\\Internet Explorer]\r\n";
+
+static char const runKeys[] =
+    "Windows Registry Editor Version 5.00\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Run]\r\n"
+    "\"Updater\"=\"C:\\\\Windows\\\\System32\\\\notepad.exe\"\r\n"
+    "\r\n"
+    "[HKEY_CURRENT_USER\\Software\\Microsoft\\Windows\\CurrentVersion\\Run]\r\n"
+    "\"UserTool\"=\"C:\\\\Windows\\\\System32\\\\calc.exe\"\r\n";
+
+class LoadPointsReportTest : public ::testing::Test
+{
+    protected:
+    MemoryRegistryBackend backend;
+    std::vector<std::string> options;
+    string_sink output;
+
+    void Load(std::string const& text)
+    {
+        std::istringstream source(text);
+        LoadRegFile(backend, source);
+    }
+
+    virtual void SetUp()
+    {
+        Load(reportSkeleton);
+    }
+
+    void Go()
+    {
+        LoadPointsReport report;
+        ISectionDefinition const& definition = report;
+        ScriptSection section(&definition);
+        ScopedRegistryBackend scope(backend);
+        definition.Execute(ExecutionOptions(output, section, options));
+    }
+
+    // Gets the report line starting with the given text, or an empty string.
+    std::string Line(std::string const& start) const
+    {
+        std::istringstream lines(output.get());
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (boost::starts_with(line, start))
+            {
+                return line;
+            }
+        }
+
+        return std::string();
+    }
+
+    // Counts the report lines starting with the given text.
+    std::size_t CountLines(std::string const& start) const
+    {
+        std::istringstream lines(output.get());
+        std::string line;
+        std::size_t count = 0;
+        while (std::getline(lines, line))
+        {
+            count += boost::starts_with(line, start) ? 1 : 0;
+        }
+
+        return count;
+    }
+};
+
+TEST_F(LoadPointsReportTest, ReportsRunKeysFromRegFile)
+{
+    Load(runKeys);
+    Go();
+    EXPECT_TRUE(boost::icontains(Line("Run" + bits + ": [Updater] "),
+                                 "notepad.exe"));
+    std::string const& report = output.get();
+    std::size_t const identity =
+        report.find("Identity: [Default User] .DEFAULT");
+    ASSERT_NE(std::string::npos, identity);
+    std::size_t const userTool =
+        report.find("Run" + bits + ": [UserTool] ", identity);
+    ASSERT_NE(std::string::npos, userTool);
+    EXPECT_TRUE(boost::icontains(report.substr(userTool), "calc.exe"));
+}
+
+static char const nonStringValues[] =
+    "Windows Registry Editor Version 5.00\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Internet Explorer\\Main]\r\n"
+    "\"Start Page\"=dword:0000002a\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies\\System]\r\n"
+    "\"EnableLUA\"=dword:00000001\r\n"
+    "\"LegalNotice\"=hex:01,ff\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Wow6432Node\\Microsoft\\Windows\\CurrentVersion\\Policies\\System]\r\n"
+    "\"EnableLUA\"=dword:00000001\r\n"
+    "\"LegalNotice\"=hex:01,ff\r\n";
+
+TEST_F(LoadPointsReportTest, WritesNonStringValuesAsRendered)
+{
+    Load(nonStringValues);
+    Go();
+    EXPECT_EQ("StartPage" + bits + ": dword:0000002A",
+              Line("StartPage" + bits + ": "));
+    EXPECT_EQ("PoliciesSystem: [EnableLUA] dword:00000001",
+              Line("PoliciesSystem: [EnableLUA] "));
+    EXPECT_EQ("PoliciesSystem: [LegalNotice] hex:01,FF",
+              Line("PoliciesSystem: [LegalNotice] "));
+}
+
+static char const zoneMap[] =
+    "Windows Registry Editor Version 5.00\r\n"
+    "\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains\\example.com\\www]\r\n"
+    "\"http\"=dword:00000002\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains\\example.org]\r\n"
+    "\"https\"=dword:00000002\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains\\example.net]\r\n"
+    "\"*\"=dword:00000002\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Internet Settings\\ZoneMap\\Domains\\blocked.test]\r\n"
+    "\"*\"=dword:00000004\r\n";
+
+TEST_F(LoadPointsReportTest, WritesTrustedZoneInFullByDefault)
+{
+    Load(zoneMap);
+    Go();
+    std::string const prefix("Trusted Zone" + bits + ": ");
+    EXPECT_EQ(prefix + "http://www.example.com",
+              Line(prefix + "http://www.example.com"));
+    EXPECT_EQ(prefix + "https://example.org",
+              Line(prefix + "https://example.org"));
+    EXPECT_EQ(std::string(), Line(prefix + "3 entries"));
+    EXPECT_EQ(std::string(), Line(prefix + "1 entries in Restricted Sites"));
+}
+
+TEST_F(LoadPointsReportTest, SummarizesTrustedZoneLongerThanLimit)
+{
+    Load(zoneMap);
+    options.push_back("ZoneSummary 2");
+    Go();
+    std::string const prefix("Trusted Zone" + bits + ": ");
+    EXPECT_EQ(std::string(), Line(prefix + "http://www.example.com"));
+    EXPECT_EQ(prefix + "3 entries in Trusted Sites",
+              Line(prefix + "3 entries in Trusted Sites"));
+    EXPECT_EQ(prefix + "1 entries in Restricted Sites",
+              Line(prefix + "1 entries in Restricted Sites"));
+}
+
+TEST_F(LoadPointsReportTest, WritesTrustedZoneWithinLimitInFull)
+{
+    Load(zoneMap);
+    options.push_back("ZoneSummary");
+    Go();
+    std::string const prefix("Trusted Zone" + bits + ": ");
+    EXPECT_EQ(prefix + "http://www.example.com",
+              Line(prefix + "http://www.example.com"));
+    EXPECT_EQ(prefix + "1 entries in Restricted Sites",
+              Line(prefix + "1 entries in Restricted Sites"));
+}
+
+TEST_F(LoadPointsReportTest, ZoneSummaryZeroAndOtherNamesWriteInFull)
+{
+    Load(zoneMap);
+    options.push_back("ZoneSummary 0");
+    options.push_back("ZoneSummaryFoo 2");
+    Go();
+    std::string const prefix("Trusted Zone" + bits + ": ");
+    EXPECT_EQ(prefix + "http://www.example.com",
+              Line(prefix + "http://www.example.com"));
+    EXPECT_EQ(std::string(), Line(prefix + "3 entries"));
+}
+
+static std::string Clsid(unsigned int index)
+{
+    std::ostringstream text;
+    text << '{' << std::hex << std::uppercase << std::setw(8)
+         << std::setfill('0') << index << "-0000-0000-0000-000000000000}";
+    return text.str();
+}
+
+static std::string Numbered(char const* name, unsigned int index)
+{
+    std::ostringstream text;
+    text << name << std::setw(6) << std::setfill('0') << index;
+    return text.str();
+}
+
+// Describes a machine with over a million keys, the size of a well used
+// one. Most are COM registrations, as on real machines, and the rest are
+// load points of each kind the report enumerates in bulk, plus keys the
+// report never reads. Siblings are written in sorted order, as regedit
+// exports them.
+static std::string MakeMillionKeyMachine()
+{
+    std::string const hklm("[HKEY_LOCAL_MACHINE\\Software\\");
+    std::string const windows("Microsoft\\Windows\\CurrentVersion\\");
+    std::ostringstream text;
+    text << "Windows Registry Editor Version 5.00\r\n";
+    // 240,000 keys.
+    for (unsigned int idx = 0; idx < 120000; ++idx)
+    {
+        text << hklm << "Classes\\CLSID\\" << Clsid(idx) << "]\r\n"
+             << "@=\"Component " << idx << "\"\r\n"
+             << hklm << "Classes\\CLSID\\" << Clsid(idx)
+             << "\\InprocServer32]\r\n"
+             << "@=\"C:\\\\Windows\\\\System32\\\\component" << idx
+             << ".dll\"\r\n";
+    }
+
+    // 300,000 keys.
+    for (unsigned int idx = 0; idx < 150000; ++idx)
+    {
+        text << hklm << "Classes\\Interface\\" << Clsid(idx) << "]\r\n"
+             << hklm << "Classes\\Interface\\" << Clsid(idx)
+             << "\\ProxyStubClsid32]\r\n"
+             << "@=\"" << Clsid(idx) << "\"\r\n";
+    }
+
+    // 500 browser helper objects, registered above.
+    for (unsigned int idx = 0; idx < 500; ++idx)
+    {
+        text << hklm << windows
+             << "Explorer\\Browser Helper Objects\\" << Clsid(idx * 200)
+             << "]\r\n";
+    }
+
+    // 20,000 keys, 400 of them with debuggers.
+    for (unsigned int idx = 0; idx < 20000; ++idx)
+    {
+        text << hklm << "Microsoft\\Windows NT\\CurrentVersion\\Image File "
+             << "Execution Options\\" << Numbered("program", idx)
+             << ".exe]\r\n";
+        if (idx % 50 == 0)
+        {
+            text << "\"Debugger\"=\"C:\\\\Tools\\\\debugger.exe\"\r\n";
+        }
+    }
+
+    // 5,000 keys.
+    for (unsigned int idx = 0; idx < 5000; ++idx)
+    {
+        text << hklm << "Microsoft\\Active Setup\\Installed Components\\"
+             << Clsid(idx) << "]\r\n"
+             << "\"StubPath\"=\"C:\\\\Windows\\\\System32\\\\setup"
+             << idx << ".exe\"\r\n";
+    }
+
+    // 100 keys.
+    for (unsigned int idx = 0; idx < 100; ++idx)
+    {
+        text << hklm << "Microsoft\\Windows NT\\CurrentVersion\\Winlogon\\"
+             << "Notify\\" << Numbered("notify", idx) << "]\r\n"
+             << "\"DllName\"=\"notify" << idx << ".dll\"\r\n";
+    }
+
+    // 60,000 keys.
+    for (unsigned int idx = 0; idx < 30000; ++idx)
+    {
+        std::string const domain(hklm + windows +
+                                 "Internet Settings\\ZoneMap\\Domains\\" +
+                                 Numbered("example", idx) + ".com");
+        text << domain << "]\r\n" << domain << "\\www]\r\n"
+             << "\"http\"=dword:00000002\r\n";
+    }
+
+    // 120,000 keys.
+    for (unsigned int idx = 0; idx < 60000; ++idx)
+    {
+        text << hklm << "Wow6432Node\\Classes\\CLSID\\" << Clsid(idx)
+             << "]\r\n" << hklm << "Wow6432Node\\Classes\\CLSID\\"
+             << Clsid(idx) << "\\InprocServer32]\r\n"
+             << "@=\"C:\\\\Windows\\\\SysWOW64\\\\component" << idx
+             << ".dll\"\r\n";
+    }
+
+    // 275,500 keys the report never reads.
+    for (unsigned int vendor = 0; vendor < 500; ++vendor)
+    {
+        std::string const vendorKey("[HKEY_CURRENT_USER\\Software\\" +
+                                    Numbered("Vendor", vendor));
+        text << vendorKey << "]\r\n";
+        for (unsigned int product = 0; product < 550; ++product)
+        {
+            text << vendorKey << "\\" << Numbered("Product", product)
+                 << "]\r\n"
+                 << "\"Installed\"=dword:00000001\r\n";
+        }
+    }
+
+    return text.str();
+}
+
+TEST_F(LoadPointsReportTest, DISABLED_BenchmarkMillionKeyMachine)
+{
+    std::string const machine(MakeMillionKeyMachine());
+    auto const start = std::chrono::steady_clock::now();
+    Load(machine);
+    auto const loaded = std::chrono::steady_clock::now();
+    ASSERT_LE(1000000u, backend.GetKeyCount());
+
+    // Files named by load points are still looked for on this machine's
+    // disk, and the report still asks WMI about it; only the registry is
+    // replaced.
+    Go();
+    auto const reported = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(500u, CountLines("BHO"));
+    EXPECT_EQ(400u, CountLines("Ifeo"));
+    EXPECT_EQ(5000u, CountLines("ActiveSetup"));
+    EXPECT_EQ(100u, CountLines("Notify"));
+    EXPECT_EQ(30000u, CountLines("Trusted Zone"));
+    std::cout << backend.GetKeyCount() << " keys. Load: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     loaded - start).count()
+              << " ms, report: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     reported - loaded).count()
+              << " ms" << std::endl;
+}
@@ -0,0 +1,225 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/MemoryRegistry.hpp"
+
+using namespace Instalog::SystemFacades;
+
+static std::int32_t const statusBufferOverflow =
+    static_cast<std::int32_t>(0x80000005);
+static std::int32_t const statusNoMoreEntries =
+    static_cast<std::int32_t>(0x8000001A);
+static std::int32_t const statusBufferTooSmall =
+    static_cast<std::int32_t>(0xC0000023);
+static std::int32_t const statusObjectNameNotFound =
+    static_cast<std::int32_t>(0xC0000034);
+static std::int32_t const statusCannotDelete =
+    static_cast<std::int32_t>(0xC0000121);
+static std::int32_t const statusKeyDeleted =
+    static_cast<std::int32_t>(0xC000017C);
+
+// Drives MemoryRegistryBackend directly, without RegistryKey, so that these
+// tests build anywhere.
+class MemoryRegistryBackendTest : public ::testing::Test
+{
+    protected:
+    MemoryRegistryBackend backend;
+
+    void Load(std::string const& text)
+    {
+        std::istringstream source(text);
+        LoadRegFile(backend, source);
+    }
+
+    std::int32_t Open(void*& key, std::wstring const& path, void* root = 0)
+    {
+        return backend.OpenKey(&key, 0, root, path.data(), path.size());
+    }
+
+    void* Create(std::wstring const& path)
+    {
+        void* key;
+        EXPECT_EQ(0,
+                  backend.CreateKey(&key, 0, 0, path.data(), path.size(), 0));
+        return key;
+    }
+
+    std::wstring SubKeyName(void* key, std::uint32_t index)
+    {
+        std::vector<unsigned char> buffer(sizeof(KeyBasicRecord) + 512);
+        std::uint32_t resultLength;
+        if (backend.EnumerateKey(key,
+                                 index,
+                                 keyBasicInformation,
+                                 buffer.data(),
+                                 static_cast<std::uint32_t>(buffer.size()),
+                                 &resultLength) != 0)
+        {
+            return std::wstring();
+        }
+
+        auto info = reinterpret_cast<KeyBasicRecord const*>(buffer.data());
+        return std::wstring(info->Name, info->NameLength / sizeof(wchar_t));
+    }
+};
+
+TEST_F(MemoryRegistryBackendTest, StartsWithHiveRoots)
+{
+    EXPECT_EQ(4u, backend.GetKeyCount());
+    void* registry;
+    ASSERT_EQ(0, Open(registry, L"\\registry"));
+    void* user;
+    ASSERT_EQ(0, Open(user, L"USER", registry));
+    void* machine;
+    EXPECT_NE(0, Open(machine, L"\\Registry\\Machine", registry));
+    ASSERT_EQ(0, Open(machine, L"\\Registry\\Machine"));
+    EXPECT_EQ(3u, backend.GetOpenHandleCount());
+    EXPECT_EQ(0, backend.Close(machine));
+    EXPECT_EQ(0, backend.Close(user));
+    EXPECT_EQ(0, backend.Close(registry));
+    EXPECT_EQ(0u, backend.GetOpenHandleCount());
+}
+
+TEST_F(MemoryRegistryBackendTest, FollowsNtBufferConventions)
+{
+    Load("Windows Registry Editor Version 5.00\n"
+         "[HKEY_LOCAL_MACHINE\\Software\\Instalog]\n"
+         "\"Answer\"=dword:0000002a\n");
+    EXPECT_EQ(0u, backend.GetOpenHandleCount());
+
+    void* key;
+    ASSERT_EQ(0, Open(key, L"\\Registry\\Machine\\SOFTWARE\\instalog"));
+    std::wstring const name(L"answer");
+    std::uint32_t resultLength = 0;
+    EXPECT_EQ(statusBufferTooSmall,
+              backend.QueryValueKey(key,
+                                    name.data(),
+                                    name.size(),
+                                    keyValuePartialInformation,
+                                    nullptr,
+                                    0,
+                                    &resultLength));
+    std::size_t const fixedLength = offsetof(KeyValuePartialRecord, Data);
+    ASSERT_EQ(fixedLength + 4, resultLength);
+
+    std::vector<unsigned char> buffer(resultLength);
+    EXPECT_EQ(statusBufferOverflow,
+              backend.QueryValueKey(key,
+                                    name.data(),
+                                    name.size(),
+                                    keyValuePartialInformation,
+                                    buffer.data(),
+                                    static_cast<std::uint32_t>(fixedLength),
+                                    &resultLength));
+    ASSERT_EQ(0,
+              backend.QueryValueKey(key,
+                                    name.data(),
+                                    name.size(),
+                                    keyValuePartialInformation,
+                                    buffer.data(),
+                                    resultLength,
+                                    &resultLength));
+    auto info = reinterpret_cast<KeyValuePartialRecord const*>(buffer.data());
+    EXPECT_EQ(4u, info->Type);
+    ASSERT_EQ(4u, info->DataLength);
+    std::uint32_t answer;
+    std::memcpy(&answer, info->Data, sizeof(answer));
+    EXPECT_EQ(42u, answer);
+
+    std::wstring const missing(L"Question");
+    EXPECT_EQ(statusObjectNameNotFound,
+              backend.QueryValueKey(key,
+                                    missing.data(),
+                                    missing.size(),
+                                    keyValuePartialInformation,
+                                    buffer.data(),
+                                    resultLength,
+                                    &resultLength));
+    backend.Close(key);
+}
+
+TEST_F(MemoryRegistryBackendTest, EnumeratesSubKeysCaseInsensitively)
+{
+    backend.Close(Create(L"\\Registry\\Machine\\b"));
+    backend.Close(Create(L"\\Registry\\Machine\\A"));
+    backend.Close(Create(L"\\Registry\\Machine\\c"));
+    void* machine;
+    ASSERT_EQ(0, Open(machine, L"\\Registry\\Machine"));
+    EXPECT_EQ(L"A", SubKeyName(machine, 0));
+    EXPECT_EQ(L"b", SubKeyName(machine, 1));
+    EXPECT_EQ(L"c", SubKeyName(machine, 2));
+    unsigned char buffer[64];
+    std::uint32_t resultLength;
+    EXPECT_EQ(statusNoMoreEntries,
+              backend.EnumerateKey(machine,
+                                   3,
+                                   keyBasicInformation,
+                                   buffer,
+                                   sizeof(buffer),
+                                   &resultLength));
+    backend.Close(machine);
+}
+
+TEST_F(MemoryRegistryBackendTest, OpenHandlesSeeDeletedKeys)
+{
+    void* parent = Create(L"\\Registry\\Machine\\Parent");
+    void* child = Create(L"\\Registry\\Machine\\Parent\\Child");
+    EXPECT_EQ(statusCannotDelete, backend.DeleteKey(parent));
+    EXPECT_EQ(0, backend.DeleteKey(child));
+    EXPECT_EQ(0, backend.DeleteKey(parent));
+    EXPECT_EQ(4u, backend.GetKeyCount());
+
+    unsigned char buffer[64];
+    std::uint32_t resultLength;
+    EXPECT_EQ(statusKeyDeleted,
+              backend.QueryKey(parent,
+                               keyFullInformation,
+                               buffer,
+                               sizeof(buffer),
+                               &resultLength));
+    backend.Close(child);
+    backend.Close(parent);
+    EXPECT_EQ(0u, backend.GetOpenHandleCount());
+}
+
+TEST_F(MemoryRegistryBackendTest, RegFileDeletesTrees)
+{
+    Load("REGEDIT4\n"
+         "[HKEY_LOCAL_MACHINE\\Software\\Vendor\\Product\\Settings]\n"
+         "\"Enabled\"=dword:00000001\n"
+         "[HKEY_LOCAL_MACHINE\\Software\\Other]\n");
+    EXPECT_EQ(9u, backend.GetKeyCount());
+    Load("REGEDIT4\n"
+         "[-HKEY_LOCAL_MACHINE\\Software\\Vendor]\n"
+         "[-HKEY_LOCAL_MACHINE\\Software\\Missing]\n");
+    EXPECT_EQ(6u, backend.GetKeyCount());
+    void* vendor;
+    EXPECT_EQ(statusObjectNameNotFound,
+              Open(vendor, L"\\Registry\\Machine\\Software\\Vendor"));
+    EXPECT_EQ(0u, backend.GetOpenHandleCount());
+}
+
+TEST_F(MemoryRegistryBackendTest, ReportsRejectedChanges)
+{
+    try
+    {
+        Load("REGEDIT4\n"
+             "[-HKEY_LOCAL_MACHINE]\n");
+        FAIL() << "Expected RegFileLoadException";
+    }
+    catch (RegFileLoadException const& ex)
+    {
+        // Hive roots may not be deleted.
+        EXPECT_EQ(static_cast<std::int32_t>(0xC0000022), ex.GetStatus());
+        EXPECT_EQ(std::string("Line 2: The registry rejected the change "
+                              "(NTSTATUS 0xC0000022)"),
+                  ex.what());
+    }
+}
@@ -0,0 +1,363 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/MemoryRegistry.hpp"
+#include "../LogCommon/Registry.hpp"
+#include "../LogCommon/Win32Exception.hpp"
+
+using namespace Instalog::SystemFacades;
+
+static char const sampleRegFile[] =
+    "\xEF\xBB\xBFWindows Registry Editor Version 5.00\r\n"
+    "\r\n"
+    "; Fixture for the Run key\r\n"
+    "[HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows\\CurrentVersion\\Run]\r\n"
+    "@=\"Default\"\r\n"
+    "\"Updater\"=\"C:\\\\Program Files\\\\Updater\\\\update.exe /silent\"\r\n"
+    "\"Quoted \\\"Name\\\"\"=dword:0000002a\r\n"
+    "\"Blob\"=hex:01,02,03,\\\r\n"
+    "  04,05\r\n"
+    "\"Expand\"=hex(2):25,00,41,00,25,00,00,00\r\n"
+    "\r\n"
+    "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\RunOnce]\r\n"
+    "\r\n"
+    "[HKCU\\Software\\Policies]\r\n"
+    "\"Setting\"=dword:00000001\r\n";
+
+class MemoryRegistryTest : public ::testing::Test
+{
+    protected:
+    MemoryRegistryBackend backend;
+    std::unique_ptr<ScopedRegistryBackend> scope;
+
+    void Load(std::string const& text)
+    {
+        std::istringstream source(text);
+        LoadRegFile(backend, source);
+    }
+
+    virtual void SetUp()
+    {
+        Load(sampleRegFile);
+        scope.reset(new ScopedRegistryBackend(backend));
+    }
+
+    virtual void TearDown()
+    {
+        scope.reset();
+    }
+};
+
+TEST_F(MemoryRegistryTest, BackendIsInstalledInScope)
+{
+    EXPECT_EQ(&backend, &GetRegistryBackend());
+    scope.reset();
+    EXPECT_EQ(&GetNtRegistryBackend(), &GetRegistryBackend());
+}
+
+TEST_F(MemoryRegistryTest, ReadsValues)
+{
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion\\Run",
+        KEY_QUERY_VALUE);
+    ASSERT_TRUE(run.Valid());
+    EXPECT_EQ("Default", run[""].GetString());
+    EXPECT_EQ("C:\\Program Files\\Updater\\update.exe /silent",
+              run["updater"].GetString());
+    EXPECT_EQ(42u, run["Quoted \"Name\""].GetDWord());
+    RegistryValue blob = run["Blob"];
+    EXPECT_EQ(REG_BINARY, blob.GetType());
+    EXPECT_EQ(std::vector<unsigned char>({1, 2, 3, 4, 5}),
+              std::vector<unsigned char>(blob.cbegin(), blob.cend()));
+    EXPECT_EQ(static_cast<DWORD>(REG_EXPAND_SZ), run["Expand"].GetType());
+}
+
+TEST_F(MemoryRegistryTest, MissingValueThrows)
+{
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion\\Run",
+        KEY_QUERY_VALUE);
+    EXPECT_THROW(run.GetValue("Nonexistent"), ErrorFileNotFoundException);
+    EXPECT_FALSE(run.TryGetValue("Nonexistent").is_valid());
+}
+
+TEST_F(MemoryRegistryTest, MissingKeyIsInvalid)
+{
+    RegistryKey missing = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Nonexistent", KEY_QUERY_VALUE);
+    EXPECT_TRUE(missing.Invalid());
+    EXPECT_THROW(Win32Exception::ThrowFromNtError(::GetLastError()),
+                 ErrorFileNotFoundException);
+}
+
+TEST_F(MemoryRegistryTest, EnumeratesSubKeysInOrder)
+{
+    RegistryKey currentVersion = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion");
+    std::vector<std::string> expected;
+    expected.push_back("Run");
+    expected.push_back("RunOnce");
+    EXPECT_EQ(expected, currentVersion.EnumerateSubKeyNames());
+}
+
+TEST_F(MemoryRegistryTest, EnumeratesSubKeyNamesIntoBuffer)
+{
+    RegistryKey currentVersion = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion");
+    std::vector<unsigned char> buffer;
+    UNICODE_STRING name;
+    ASSERT_TRUE(currentVersion.EnumerateSubKeyName(1, buffer, name));
+    EXPECT_EQ(L"RunOnce",
+              std::wstring(name.Buffer, name.Length / sizeof(wchar_t)));
+    RegistryKey runOnce(RegistryKey::Open(currentVersion, name));
+    EXPECT_TRUE(runOnce.Valid());
+    EXPECT_FALSE(currentVersion.EnumerateSubKeyName(2, buffer, name));
+}
+
+TEST_F(MemoryRegistryTest, ForEachSubKeyFiltersOnValueNames)
+{
+    Load("REGEDIT4\r\n"
+         "[HKLM\\Software\\Ifeo\\a.exe]\r\n"
+         "\"Debugger\"=\"ntsd.exe\"\r\n"
+         "[HKLM\\Software\\Ifeo\\b.exe]\r\n"
+         "\"GlobalFlag\"=dword:00000002\r\n"
+         "[HKLM\\Software\\Ifeo\\c.exe]\r\n"
+         "\"VerifierDlls\"=\"x.dll\"\r\n"
+         "\"Debugger\"=\"vsjitdebugger.exe\"\r\n");
+    RegistryKey ifeo = RegistryKey::Open("\\Registry\\Machine\\Software\\Ifeo",
+                                         KEY_ENUMERATE_SUB_KEYS);
+    std::size_t const handlesBefore = backend.GetOpenHandleCount();
+    std::vector<std::string> visited;
+    ifeo.ForEachSubKey({"Debugger"},
+                       [&](std::string const& name, RegistryKey const& key) {
+        EXPECT_EQ(handlesBefore + 1, backend.GetOpenHandleCount());
+        visited.push_back(name + "=" + key["Debugger"].GetString());
+    });
+    std::vector<std::string> expected;
+    expected.push_back("a.exe=ntsd.exe");
+    expected.push_back("c.exe=vsjitdebugger.exe");
+    EXPECT_EQ(expected, visited);
+    EXPECT_EQ(handlesBefore, backend.GetOpenHandleCount());
+
+    visited.clear();
+    ifeo.ForEachSubKey(std::vector<std::string>(),
+                       [&](std::string const& name, RegistryKey const&) {
+        visited.push_back(name);
+    });
+    EXPECT_EQ(3u, visited.size());
+}
+
+TEST_F(MemoryRegistryTest, EnumeratesValuesInCreationOrder)
+{
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion\\Run");
+    std::vector<std::string> expected;
+    expected.push_back("");
+    expected.push_back("Updater");
+    expected.push_back("Quoted \"Name\"");
+    expected.push_back("Blob");
+    expected.push_back("Expand");
+    EXPECT_EQ(expected, run.EnumerateValueNames());
+
+    RegistryValueArena arena;
+    run.EnumerateValues(arena);
+    ASSERT_EQ(5u, arena.size());
+    EXPECT_EQ("Blob", arena[3].GetName());
+    EXPECT_EQ(5u, arena[3].size());
+}
+
+TEST_F(MemoryRegistryTest, WritesValuesToSink)
+{
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion\\Run");
+    Instalog::string_sink written;
+    write_registry_value(written, run["Blob"]);
+    write_registry_value(written, run["Quoted \"Name\""]);
+    EXPECT_EQ("hex:01,02,03,04,05dword:0000002A", written.get());
+
+    // Large enough to be rendered in several pieces.
+    std::vector<unsigned char> blob(10000);
+    std::string expected("hex:");
+    for (std::size_t idx = 0; idx < blob.size(); ++idx)
+    {
+        blob[idx] = static_cast<unsigned char>(idx * 7);
+        static char const digits[] = "0123456789ABCDEF";
+        if (idx != 0)
+        {
+            expected.push_back(',');
+        }
+        expected.push_back(digits[blob[idx] >> 4]);
+        expected.push_back(digits[blob[idx] & 0x0F]);
+    }
+
+    run.SetValue("Large", blob, REG_BINARY);
+    Instalog::string_sink large;
+    write_registry_value(large, run["Large"]);
+    EXPECT_EQ(expected, large.get());
+    EXPECT_EQ(expected, run["Large"].GetString());
+}
+
+TEST_F(MemoryRegistryTest, ReportsNamesAndSizes)
+{
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion\\Run");
+    EXPECT_EQ("\\REGISTRY\\MACHINE\\Software\\Microsoft\\Windows\\"
+              "CurrentVersion\\Run",
+              run.GetName());
+    EXPECT_EQ("Run", run.GetLocalName());
+    RegistryKeySizeInformation sizeInfo = run.GetSizeInformation();
+    EXPECT_EQ(0u, sizeInfo.GetNumberOfSubkeys());
+    EXPECT_EQ(5u, sizeInfo.GetNumberOfValues());
+}
+
+TEST_F(MemoryRegistryTest, MapsCurrentUser)
+{
+    RegistryKey policies =
+        RegistryKey::Open("\\Registry\\User\\.DEFAULT\\Software\\Policies");
+    ASSERT_TRUE(policies.Valid());
+    EXPECT_EQ(1u, policies["Setting"].GetDWord());
+}
+
+TEST_F(MemoryRegistryTest, RelativeOpensUseParentBackend)
+{
+    RegistryKey software = RegistryKey::Open("\\Registry\\Machine\\SOFTWARE");
+    scope.reset();
+    RegistryKey microsoft = RegistryKey::Open(software, "microsoft");
+    ASSERT_TRUE(microsoft.Valid());
+    EXPECT_EQ(&backend, &microsoft.GetBackend());
+    std::vector<RegistryKey> subKeys = microsoft.EnumerateSubKeys();
+    ASSERT_EQ(1u, subKeys.size());
+    EXPECT_EQ("Windows", subKeys[0].GetLocalName());
+}
+
+TEST_F(MemoryRegistryTest, DeletesKeysAndValues)
+{
+    Load("REGEDIT4\n"
+         "[HKEY_CURRENT_USER\\Software\\Policies]\n"
+         "\"Setting\"=-\n"
+         "[-HKEY_LOCAL_MACHINE\\Software\\Microsoft\\Windows]\n"
+         "[-HKEY_LOCAL_MACHINE\\Software\\DoesNotExist]\n");
+    RegistryKey policies =
+        RegistryKey::Open("\\Registry\\User\\.DEFAULT\\Software\\Policies");
+    EXPECT_TRUE(policies.EnumerateValueNames().empty());
+    EXPECT_TRUE(
+        RegistryKey::Open("\\Registry\\Machine\\Software\\Microsoft\\Windows")
+            .Invalid());
+    EXPECT_EQ(0u,
+              RegistryKey::Open("\\Registry\\Machine\\Software\\Microsoft")
+                  .GetSizeInformation()
+                  .GetNumberOfSubkeys());
+}
+
+TEST_F(MemoryRegistryTest, HandlesAreClosed)
+{
+    std::size_t const before = backend.GetOpenHandleCount();
+    {
+        RegistryKey run = RegistryKey::Open(
+            "\\Registry\\Machine\\Software\\Microsoft\\Windows\\"
+            "CurrentVersion\\Run");
+        std::vector<RegistryKey> subKeys =
+            RegistryKey::Open("\\Registry\\Machine\\Software")
+                .EnumerateSubKeys();
+        EXPECT_LT(before, backend.GetOpenHandleCount());
+    }
+    EXPECT_EQ(before, backend.GetOpenHandleCount());
+}
+
+TEST_F(MemoryRegistryTest, HandleCacheClosesForgottenHandles)
+{
+    std::size_t const before = backend.GetOpenHandleCount();
+    RegistryHandleCache cache;
+    RegistryKey run = RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Microsoft\\Windows\\"
+        "CurrentVersion\\Run");
+    ASSERT_TRUE(run.Valid());
+    RegistryKey::Open("\\Registry\\Machine\\Software").Close();
+    EXPECT_EQ(before + 2, backend.GetOpenHandleCount());
+    cache.Clear();
+    EXPECT_EQ(before + 1, backend.GetOpenHandleCount());
+    EXPECT_FALSE(run.GetName().empty());
+    run.Close();
+    EXPECT_EQ(before, backend.GetOpenHandleCount());
+}
+
+TEST_F(MemoryRegistryTest, CreatesKeysThroughRegistryKey)
+{
+    RegistryKey created =
+        RegistryKey::Create("\\Registry\\Machine\\Software\\Instalog",
+                            KEY_QUERY_VALUE | KEY_SET_VALUE);
+    ASSERT_TRUE(created.Valid());
+    created.SetValue("Answer", std::string("42"));
+    EXPECT_EQ(
+        "42",
+        RegistryKey::Open("\\Registry\\Machine\\Software\\Instalog")["Answer"]
+            .GetString());
+}
+
+TEST(RegFileParser, RejectsMissingHeader)
+{
+    MemoryRegistryBackend backend;
+    std::istringstream source("[HKEY_LOCAL_MACHINE\\Software]\n");
+    EXPECT_THROW(LoadRegFile(backend, source), RegFileParseException);
+}
+
+TEST(RegFileParser, ReportsLineNumbers)
+{
+    MemoryRegistryBackend backend;
+    std::istringstream source("Windows Registry Editor Version 5.00\n"
+                              "\n"
+                              "[HKEY_LOCAL_MACHINE\\Software]\n"
+                              "\"Bad\"=dword:xyz\n");
+    try
+    {
+        LoadRegFile(backend, source);
+        FAIL() << "Expected RegFileParseException";
+    }
+    catch (RegFileParseException const& ex)
+    {
+        EXPECT_EQ(std::string("Line 4: Invalid dword data"), ex.what());
+    }
+}
+
+TEST(RegFileParser, ReadsUtf16ExportsFromRegedit)
+{
+    std::u16string const text(u"\uFEFFWindows Registry Editor Version 5.00\r\n"
+                              u"\r\n"
+                              u"[HKEY_LOCAL_MACHINE\\Software\\Caf\u00E9]\r\n"
+                              u"\"Answer\"=\"42\"\r\n");
+    std::string bytes;
+    for (char16_t unit : text)
+    {
+        bytes.push_back(static_cast<char>(unit & 0xFF));
+        bytes.push_back(static_cast<char>(unit >> 8));
+    }
+
+    MemoryRegistryBackend backend;
+    std::istringstream source(bytes);
+    LoadRegFile(backend, source);
+    ScopedRegistryBackend scope(backend);
+    RegistryKey key(RegistryKey::Open(
+        "\\Registry\\Machine\\Software\\Caf\xC3\xA9", KEY_QUERY_VALUE));
+    ASSERT_TRUE(key.Valid());
+    EXPECT_EQ("42", key["Answer"].GetString());
+}
+
+TEST(RegFileParser, RejectsUnknownRoots)
+{
+    MemoryRegistryBackend backend;
+    std::istringstream source("REGEDIT4\n[HKEY_NOWHERE\\Software]\n");
+    EXPECT_THROW(LoadRegFile(backend, source), RegFileParseException);
+}
+
+TEST(RegFileParser, RejectsValuesOutsideKeys)
+{
+    MemoryRegistryBackend backend;
+    std::istringstream source("REGEDIT4\n\"Orphan\"=\"value\"\n");
+    EXPECT_THROW(LoadRegFile(backend, source), RegFileParseException);
+}
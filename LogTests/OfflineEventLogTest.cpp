@@ -0,0 +1,156 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// OfflineEventLog maps files and compares against the event log service, so
+// these tests are kept apart from the portable EventLogFileTest.cpp.
+
+#include "../LogCommon/OfflineEventLog.hpp"
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <winevt.h>
+#include "gtest/gtest.h"
+#include "../LogCommon/Utf8.hpp"
+#include "TestFiles.hpp"
+
+#pragma comment(lib, "wevtapi.lib")
+
+using namespace Instalog::SystemFacades;
+
+TEST(OfflineEventLog, MapsSampleFile)
+{
+    OfflineEventLog log(GetTestDataPath("Sample.evtx"));
+    auto const entries = log.ReadEvents();
+    ASSERT_EQ(140u, entries.size());
+
+    // Record 2 is a classic Service Control Manager error, created at
+    // 2015-01-01 00:01:59 UTC.
+    EventLogEntry& failed = *entries[1];
+    EXPECT_EQ(7000u, failed.eventId);
+    EXPECT_EQ(EventLogEntry::EvtLevelError, failed.level);
+    EXPECT_EQ("Service Control Manager", failed.GetSource());
+    EXPECT_EQ("Service 2; %%5", failed.GetDescription());
+    std::uint64_t const created = 130645440000000000ull + 1190000000ull;
+    EXPECT_EQ(static_cast<DWORD>(created >> 32), failed.date.dwHighDateTime);
+    EXPECT_EQ(static_cast<DWORD>(created & 0xFFFFFFFF),
+              failed.date.dwLowDateTime);
+    EXPECT_EQ(0xC000,
+              static_cast<OfflineEventLogEntry&>(failed)
+                  .GetFileEntry()
+                  .GetQualifiers());
+}
+
+TEST(OfflineEventLog, AppliesFilter)
+{
+    EventLogFileFilter filter;
+    filter.levels.push_back(EventLogEntry::EvtLevelCritical);
+    std::size_t count = 0;
+    OfflineEventLog(GetTestDataPath("Sample.evtx"), filter)
+        .ReadEvents([&](EventLogEntry& entry) {
+            EXPECT_EQ(41u, entry.eventId);
+            ++count;
+            return true;
+        });
+    EXPECT_EQ(1u, count);
+}
+
+TEST(OfflineEventLog, MissingFileThrows)
+{
+    EXPECT_ANY_THROW(OfflineEventLog(GetTestDataPath("Missing.evtx")));
+}
+
+// Exports a channel of the running system's event log to an .evtx file, the
+// way the event log service writes them, and deletes the file again on
+// destruction.
+class ExportedLog
+{
+    std::wstring path_;
+    bool exported_;
+
+    public:
+    explicit ExportedLog(wchar_t const* channel) : exported_(false)
+    {
+        wchar_t directory[MAX_PATH];
+        wchar_t file[MAX_PATH];
+        ::GetTempPathW(MAX_PATH, directory);
+        ::GetTempFileNameW(directory, L"evt", 0, file);
+        path_ = file;
+        // EvtExportLog refuses to overwrite the file GetTempFileName made.
+        ::DeleteFileW(file);
+        exported_ = ::EvtExportLog(
+                        nullptr, channel, L"*", file, EvtExportLogChannelPath) !=
+                    FALSE;
+    }
+
+    ~ExportedLog()
+    {
+        ::DeleteFileW(path_.c_str());
+    }
+
+    // false if the channel could not be exported, usually for want of
+    // access to it.
+    bool Exported() const
+    {
+        return exported_;
+    }
+
+    std::string GetPath() const
+    {
+        return utf8::ToUtf8(path_);
+    }
+};
+
+typedef std::tuple<std::string, DWORD, WORD, DWORD, DWORD> EventKey;
+
+static EventKey MakeEventKey(EventLogEntry& entry, DWORD eventId)
+{
+    return EventKey(entry.GetSource(),
+                    eventId,
+                    entry.level,
+                    entry.date.dwHighDateTime,
+                    entry.date.dwLowDateTime);
+}
+
+TEST(OfflineEventLog, MatchesEventLogServiceOnExportedChannel)
+{
+    ExportedLog exported(L"System");
+    if (!exported.Exported())
+    {
+        std::cout << "Could not export the System log (error "
+                  << ::GetLastError() << "); not compared.\n";
+        return;
+    }
+
+    // Events written after the export are in the live channel only, so each
+    // exported event is looked for in the live channel, rather than the two
+    // being compared one to one.
+    std::multiset<EventKey> live;
+    XmlEventLog().ReadEvents([&](EventLogEntry& entry) {
+        live.insert(MakeEventKey(entry, entry.eventId));
+        return true;
+    });
+
+    std::size_t compared = 0;
+    OfflineEventLog(exported.GetPath()).ReadEvents([&](EventLogEntry& entry) {
+        EventLogFileEntry const& fileEntry =
+            static_cast<OfflineEventLogEntry&>(entry).GetFileEntry();
+        // The service reports qualifiers in the high word of the event ID.
+        EventKey const key(MakeEventKey(
+            entry, MAKELONG(entry.eventId, fileEntry.GetQualifiers())));
+        auto const match = live.find(key);
+        EXPECT_NE(live.end(), match)
+            << "Record " << fileEntry.GetRecordId() << " from "
+            << std::get<0>(key) << " with ID " << std::get<1>(key);
+        if (match != live.end())
+        {
+            live.erase(match);
+        }
+        ++compared;
+        return true;
+    });
+
+    EXPECT_LT(0u, compared);
+}
@@ -4,6 +4,7 @@
 
 #include "../LogCommon/Process.hpp"
 #include <algorithm>
+#include <chrono>
 #include <string>
 #include <windows.h>
 #define PSAPI_VERSION 1
@@ -16,6 +17,9 @@
 #pragma comment(lib, "psapi.lib")
 
 using Instalog::SystemFacades::ProcessEnumerator;
+using Instalog::SystemFacades::ProcessView;
+using Instalog::SystemFacades::ProcessSampler;
+using Instalog::SystemFacades::ProcessChange;
 using Instalog::SystemFacades::Process;
 using Instalog::SystemFacades::ErrorAccessDeniedException;
 
@@ -100,3 +104,67 @@ TEST(Process, NtoskrnlIsInTheBuilding)
             p.GetExecutablePath().get()));
     }
 }
+
+TEST(Process, ViewsDescribeCurrentProcess)
+{
+    wchar_t currentProcessExecutable[MAX_PATH];
+    ::GetModuleFileName(NULL, currentProcessExecutable, MAX_PATH);
+    std::wstring executable(currentProcessExecutable);
+    std::wstring baseName(executable.substr(executable.find_last_of(L'\\') + 1));
+    ProcessEnumerator enumerator;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        auto const current = std::find(
+            enumerator.begin(), enumerator.end(), ::GetCurrentProcessId());
+        ASSERT_NE(enumerator.end(), current);
+        ProcessView const view = *current;
+        EXPECT_TRUE(boost::iequals(baseName, view.GetImageName()));
+        EXPECT_LE(1u, view.GetThreadCount());
+        EXPECT_NE(0u, view.GetParentProcessId());
+        EXPECT_NE(0u, view.GetCreateTime());
+        enumerator.Refresh();
+    }
+}
+
+TEST(Process, SamplerSeesChildProcess)
+{
+    ProcessSampler sampler(std::chrono::milliseconds(10));
+    wchar_t commandLine[] = L"cmd.exe /c exit";
+    STARTUPINFOW startupInfo = {sizeof(startupInfo)};
+    PROCESS_INFORMATION processInformation;
+    // The child stays suspended until terminated, so it is alive for at
+    // least one sample however slowly the sampler runs.
+    ASSERT_NE(FALSE, ::CreateProcessW(nullptr, commandLine, nullptr, nullptr,
+        FALSE, CREATE_NO_WINDOW | CREATE_SUSPENDED, nullptr, nullptr,
+        &startupInfo, &processInformation));
+    ::CloseHandle(processInformation.hThread);
+    std::size_t const createdAt = sampler.GetSampleCount();
+    while (sampler.GetSampleCount() < createdAt + 2)
+    {
+        ::Sleep(10);
+    }
+
+    auto const isChild = [&](ProcessChange const& change) {
+        return change.processId == processInformation.dwProcessId;
+    };
+    auto const changesWhileAlive = sampler.TakeChanges();
+    auto const started = std::find_if(
+        changesWhileAlive.begin(), changesWhileAlive.end(), isChild);
+    ASSERT_NE(changesWhileAlive.end(), started);
+    EXPECT_TRUE(started->started);
+    EXPECT_TRUE(boost::iequals("cmd.exe", started->imageName));
+    EXPECT_EQ(::GetCurrentProcessId(), started->parentProcessId);
+
+    ::TerminateProcess(processInformation.hProcess, 0);
+    ::WaitForSingleObject(processInformation.hProcess, INFINITE);
+    ::CloseHandle(processInformation.hProcess);
+    sampler.Stop();
+
+    auto const changesAfterExit = sampler.TakeChanges();
+    auto const exited = std::find_if(
+        changesAfterExit.begin(), changesAfterExit.end(), isChild);
+    ASSERT_NE(changesAfterExit.end(), exited);
+    EXPECT_FALSE(exited->started);
+    EXPECT_TRUE(boost::iequals("cmd.exe", exited->imageName));
+    EXPECT_TRUE(sampler.TakeChanges().empty());
+}
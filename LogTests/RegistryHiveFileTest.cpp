@@ -0,0 +1,142 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// Tests of RegistryHive which need Windows; the parser itself is tested in
+// RegistryHiveTest.cpp.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "gtest/gtest.h"
+#include "../LogCommon/Registry.hpp"
+#include "../LogCommon/RegistryHive.hpp"
+#include "../LogCommon/ScopedPrivilege.hpp"
+#include "../LogCommon/Utf8.hpp"
+#include "../LogCommon/Win32Exception.hpp"
+#include "TestFiles.hpp"
+
+using namespace Instalog::SystemFacades;
+
+TEST(RegistryHiveFile, MapsHiveFile)
+{
+    RegistryHive hive(GetTestDataPath("Sample.hiv"));
+    EXPECT_EQ("Sample", hive.GetRootKey().GetLocalName());
+    EXPECT_EQ(120u, hive.Open("Keys").GetNumberOfSubkeys());
+}
+
+TEST(RegistryHiveFile, MissingFileThrows)
+{
+    EXPECT_THROW(RegistryHive(GetTestDataPath("Nonexistent.hiv")),
+                 Win32Exception);
+}
+
+TEST(RegistryHiveFile, ValuesRenderAsRegistryValues)
+{
+    RegistryHive hive(GetTestDataPath("Sample.hiv"));
+    RegistryHiveValue const answer(hive.GetRootKey().GetValue("Answer"));
+    RegistryValue const rendered(
+        answer.GetType(),
+        std::vector<unsigned char>(answer.cbegin(), answer.cend()));
+    EXPECT_EQ("dword:0000002A", rendered.GetString());
+}
+
+// Saves a key of the running system's registry to a hive file, the way
+// Windows writes hives itself, and deletes the file again on destruction.
+class SavedHive
+{
+    std::wstring path_;
+    bool saved_;
+
+    public:
+    SavedHive(HKEY root, wchar_t const* keyPath) : saved_(false)
+    {
+        wchar_t directory[MAX_PATH];
+        wchar_t file[MAX_PATH];
+        ::GetTempPathW(MAX_PATH, directory);
+        ::GetTempFileNameW(directory, L"hiv", 0, file);
+        path_ = file;
+        // RegSaveKeyEx refuses to overwrite the file GetTempFileName made.
+        ::DeleteFileW(file);
+
+        HKEY key;
+        if (::RegOpenKeyExW(root, keyPath, 0, KEY_READ, &key) != ERROR_SUCCESS)
+        {
+            return;
+        }
+
+        ScopedPrivilege backup(SE_BACKUP_NAME);
+        saved_ = ::RegSaveKeyExW(key, file, nullptr, REG_LATEST_FORMAT) ==
+                 ERROR_SUCCESS;
+        ::RegCloseKey(key);
+    }
+
+    ~SavedHive()
+    {
+        ::DeleteFileW(path_.c_str());
+    }
+
+    // false if the hive could not be saved, usually for want of the backup
+    // privilege.
+    bool Saved() const
+    {
+        return saved_;
+    }
+
+    std::string GetPath() const
+    {
+        return utf8::ToUtf8(path_);
+    }
+};
+
+static std::size_t WalkHiveKey(RegistryHiveKey const& key)
+{
+    std::size_t total = key.EnumerateValues().size();
+    for (RegistryHiveKey const& subKey : key.EnumerateSubKeys())
+    {
+        total += 1 + WalkHiveKey(subKey);
+    }
+
+    return total;
+}
+
+static std::size_t WalkRegistryKey(RegistryKey const& key)
+{
+    std::size_t total = key.EnumerateValues().size();
+    for (RegistryKey const& subKey : key.EnumerateSubKeys())
+    {
+        if (subKey.Valid())
+        {
+            total += 1 + WalkRegistryKey(subKey);
+        }
+    }
+
+    return total;
+}
+
+TEST(RegistryHiveFile, DISABLED_BenchmarkAgainstLiveRegistry)
+{
+    SavedHive saved(HKEY_LOCAL_MACHINE,
+                    L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion");
+    ASSERT_TRUE(saved.Saved()) << "Saving a hive needs the backup privilege.";
+
+    auto start = std::chrono::steady_clock::now();
+    RegistryHive hive(saved.GetPath());
+    std::size_t const hiveTotal = WalkHiveKey(hive.GetRootKey());
+    auto hiveDone = std::chrono::steady_clock::now();
+    std::size_t const liveTotal = WalkRegistryKey(RegistryKey::Open(
+        "\\Registry\\Machine\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion"));
+    auto liveDone = std::chrono::steady_clock::now();
+
+    auto milliseconds = [](std::chrono::steady_clock::duration elapsed)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+            .count();
+    };
+    std::cout << "Hive: " << hiveTotal << " keys and values in "
+              << milliseconds(hiveDone - start) << " ms, live registry: "
+              << liveTotal << " in " << milliseconds(liveDone - hiveDone)
+              << " ms" << std::endl;
+}
@@ -0,0 +1,415 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/RegistryHive.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "TestFiles.hpp"
+
+using namespace Instalog::SystemFacades;
+
+// The registry types used here; winnt.h is not available everywhere.
+static std::uint32_t const regSz = 1;
+static std::uint32_t const regBinary = 3;
+static std::uint32_t const regDword = 4;
+
+static std::uint32_t ReadDWord(RegistryHiveValue const& value)
+{
+    std::uint32_t result = 0;
+    EXPECT_EQ(sizeof(result), value.size());
+    std::memcpy(
+        &result, value.cbegin(), (std::min)(sizeof(result), value.size()));
+    return result;
+}
+
+// Reads a REG_SZ value, dropping the terminating null.
+static std::u16string ReadString(RegistryHiveValue const& value)
+{
+    std::u16string result(value.size() / sizeof(char16_t), u'\0');
+    std::memcpy(&result[0], value.cbegin(), result.size() * sizeof(char16_t));
+    if (!result.empty() && result.back() == u'\0')
+    {
+        result.pop_back();
+    }
+
+    return result;
+}
+
+// Builds a small hive image in memory:
+//
+// ROOT (compressed name)
+//   (default)  REG_SZ     "Default"
+//   Answer     REG_DWORD  42 (stored inline in the value key)
+//   Greeting   REG_SZ     "Hello"
+//   Software   (UTF-16 name)
+//     Empty    REG_BINARY (no data)
+class HiveBuilder
+{
+    std::vector<unsigned char> image_;
+    std::size_t cursor_;
+
+    void Put16(std::size_t offset, std::uint16_t value)
+    {
+        std::memcpy(&image_[4096 + offset], &value, sizeof(value));
+    }
+
+    void Put32(std::size_t offset, std::uint32_t value)
+    {
+        std::memcpy(&image_[4096 + offset], &value, sizeof(value));
+    }
+
+    std::uint32_t Allocate(std::size_t dataLength)
+    {
+        std::size_t cellSize = (dataLength + 4 + 7) & ~std::size_t(7);
+        std::uint32_t cell = static_cast<std::uint32_t>(cursor_);
+        Put32(cell, static_cast<std::uint32_t>(-static_cast<std::int32_t>(cellSize)));
+        cursor_ += cellSize;
+        return cell;
+    }
+
+    std::uint32_t KeyNode(std::wstring const& name,
+                          bool compressed,
+                          std::uint32_t subkeyCount,
+                          std::uint32_t subkeyList,
+                          std::uint32_t valueCount,
+                          std::uint32_t valueList)
+    {
+        std::size_t nameBytes =
+            compressed ? name.size() : name.size() * sizeof(std::uint16_t);
+        std::uint32_t cell = Allocate(76 + nameBytes);
+        std::size_t data = cell + 4;
+        image_[4096 + data] = 'n';
+        image_[4096 + data + 1] = 'k';
+        Put16(data + 2, compressed ? 0x20 : 0);
+        Put32(data + 20, subkeyCount);
+        Put32(data + 28, subkeyCount == 0 ? 0xFFFFFFFF : subkeyList);
+        Put32(data + 36, valueCount);
+        Put32(data + 40, valueCount == 0 ? 0xFFFFFFFF : valueList);
+        Put16(data + 72, static_cast<std::uint16_t>(nameBytes));
+        for (std::size_t idx = 0; idx < name.size(); ++idx)
+        {
+            if (compressed)
+            {
+                image_[4096 + data + 76 + idx] =
+                    static_cast<unsigned char>(name[idx]);
+            }
+            else
+            {
+                Put16(data + 76 + idx * 2, static_cast<std::uint16_t>(name[idx]));
+            }
+        }
+
+        return cell;
+    }
+
+    std::uint32_t ValueKey(std::string const& name,
+                           std::uint32_t type,
+                           std::uint32_t dataSize,
+                           std::uint32_t dataOffset)
+    {
+        std::uint32_t cell = Allocate(20 + name.size());
+        std::size_t data = cell + 4;
+        image_[4096 + data] = 'v';
+        image_[4096 + data + 1] = 'k';
+        Put16(data + 2, static_cast<std::uint16_t>(name.size()));
+        Put32(data + 4, dataSize);
+        Put32(data + 8, dataOffset);
+        Put32(data + 12, type);
+        Put16(data + 16, 1);
+        std::memcpy(&image_[4096 + data + 20], name.data(), name.size());
+        return cell;
+    }
+
+    std::uint32_t StringData(std::wstring const& contents)
+    {
+        std::size_t bytes = (contents.size() + 1) * sizeof(std::uint16_t);
+        std::uint32_t cell = Allocate(bytes);
+        for (std::size_t idx = 0; idx < contents.size(); ++idx)
+        {
+            Put16(cell + 4 + idx * 2, static_cast<std::uint16_t>(contents[idx]));
+        }
+
+        return cell;
+    }
+
+    std::uint32_t OffsetList(std::vector<std::uint32_t> const& cells)
+    {
+        std::uint32_t cell = Allocate(cells.size() * 4);
+        for (std::size_t idx = 0; idx < cells.size(); ++idx)
+        {
+            Put32(cell + 4 + idx * 4, cells[idx]);
+        }
+
+        return cell;
+    }
+
+    std::uint32_t HashLeaf(std::vector<std::uint32_t> const& cells)
+    {
+        std::uint32_t cell = Allocate(4 + cells.size() * 8);
+        image_[4096 + cell + 4] = 'l';
+        image_[4096 + cell + 5] = 'h';
+        Put16(cell + 6, static_cast<std::uint16_t>(cells.size()));
+        for (std::size_t idx = 0; idx < cells.size(); ++idx)
+        {
+            Put32(cell + 8 + idx * 8, cells[idx]);
+        }
+
+        return cell;
+    }
+
+    public:
+    HiveBuilder() : image_(8192), cursor_(32)
+    {
+        std::memcpy(&image_[0], "regf", 4);
+        std::uint32_t const minorVersion = 5;
+        std::memcpy(&image_[24], &minorVersion, sizeof(minorVersion));
+        std::uint32_t const binsSize = 4096;
+        std::memcpy(&image_[40], &binsSize, sizeof(binsSize));
+        std::memcpy(&image_[4096], "hbin", 4);
+        Put32(8, 4096);
+
+        std::uint32_t emptyValue = ValueKey("Empty", regBinary, 0, 0xFFFFFFFF);
+        std::uint32_t softwareValues = OffsetList({emptyValue});
+        std::uint32_t software =
+            KeyNode(L"Software", false, 0, 0, 1, softwareValues);
+        std::uint32_t subkeys = HashLeaf({software});
+
+        std::uint32_t defaultValue = ValueKey(
+            "", regSz, 16, StringData(L"Default"));
+        std::uint32_t answer = ValueKey("Answer", regDword, 0x80000004, 42);
+        std::uint32_t greeting =
+            ValueKey("Greeting", regSz, 12, StringData(L"Hello"));
+        std::uint32_t rootValues =
+            OffsetList({defaultValue, answer, greeting});
+        std::uint32_t root =
+            KeyNode(L"ROOT", true, 1, subkeys, 3, rootValues);
+        std::memcpy(&image_[36], &root, sizeof(root));
+    }
+
+    // Overwrites the root key's value count, leaving its value list alone.
+    void SetRootValueCount(std::uint32_t count)
+    {
+        std::uint32_t root;
+        std::memcpy(&root, &image_[36], sizeof(root));
+        Put32(root + 4 + 36, count);
+    }
+
+    unsigned char const* begin() const
+    {
+        return image_.data();
+    }
+
+    unsigned char const* end() const
+    {
+        return image_.data() + image_.size();
+    }
+};
+
+TEST(RegistryHive, RejectsNonHive)
+{
+    std::vector<unsigned char> junk(8192, 'x');
+    EXPECT_THROW(RegistryHive(junk.data(), junk.data() + junk.size()),
+                 InvalidRegistryHiveException);
+}
+
+TEST(RegistryHive, ReadsRootKey)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    RegistryHiveKey root = hive.GetRootKey();
+    ASSERT_TRUE(root.Valid());
+    EXPECT_EQ("ROOT", root.GetLocalName());
+    EXPECT_TRUE(root.GetNameView().IsCompressed());
+    EXPECT_EQ(1u, root.GetNumberOfSubkeys());
+    EXPECT_EQ(3u, root.GetNumberOfValues());
+}
+
+TEST(RegistryHive, EnumeratesValueNames)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    std::vector<std::string> expected;
+    expected.push_back("");
+    expected.push_back("Answer");
+    expected.push_back("Greeting");
+    EXPECT_EQ(expected, hive.GetRootKey().EnumerateValueNames());
+}
+
+TEST(RegistryHive, ReadsInlineDword)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    RegistryHiveValue answer = hive.GetRootKey().GetValue("answer");
+    EXPECT_EQ(regDword, answer.GetType());
+    EXPECT_EQ(42u, ReadDWord(answer));
+}
+
+TEST(RegistryHive, ReadsStringsWithoutCopying)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    std::vector<RegistryHiveValue> values = hive.GetRootKey().EnumerateValues();
+    ASSERT_EQ(3u, values.size());
+    EXPECT_EQ(u"Default", ReadString(values[0]));
+    EXPECT_EQ("Greeting", values[2].GetName());
+    EXPECT_EQ(u"Hello", ReadString(values[2]));
+    EXPECT_GE(values[2].cbegin(), builder.begin());
+    EXPECT_LE(values[2].cend(), builder.end());
+}
+
+TEST(RegistryHive, MissingValueThrows)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    EXPECT_THROW(hive.GetRootKey().GetValue("Nonexistent"),
+                 RegistryHiveNotFoundException);
+}
+
+TEST(RegistryHive, EnumeratesSubKeys)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    std::vector<std::string> expected(1, "Software");
+    EXPECT_EQ(expected, hive.GetRootKey().EnumerateSubKeyNames());
+    std::vector<RegistryHiveKey> subKeys = hive.GetRootKey().EnumerateSubKeys();
+    ASSERT_EQ(1u, subKeys.size());
+    EXPECT_FALSE(subKeys[0].GetNameView().IsCompressed());
+}
+
+TEST(RegistryHive, OpensSubKeyCaseInsensitively)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    RegistryHiveKey software = hive.Open("\\SOFTWARE");
+    ASSERT_TRUE(software.Valid());
+    RegistryHiveValue empty = software.GetValue("Empty");
+    EXPECT_EQ(regBinary, empty.GetType());
+    EXPECT_TRUE(empty.empty());
+}
+
+TEST(RegistryHive, CantOpenNonexistentKey)
+{
+    HiveBuilder builder;
+    RegistryHive hive(builder.begin(), builder.end());
+    EXPECT_TRUE(hive.Open("Software\\Nonexistent").Invalid());
+}
+
+TEST(RegistryHive, RejectsCountsPastTheirList)
+{
+    HiveBuilder builder;
+    // Multiplied by 4, this wraps to 4 on 32 bit builds.
+    builder.SetRootValueCount(0x40000001);
+    RegistryHive hive(builder.begin(), builder.end());
+    EXPECT_THROW(hive.GetRootKey().EnumerateValueNames(),
+                 InvalidRegistryHiveException);
+}
+
+// The sample hives are written by
+// TestProjects/SampleHives/MakeSampleHives.py, in the layouts Windows uses
+// for format 1.5 and 1.3 hives.
+class SampleHiveTest : public ::testing::TestWithParam<char const*>
+{
+    protected:
+    std::vector<unsigned char> image;
+
+    virtual void SetUp()
+    {
+        image = ReadTestDataFile(GetParam());
+    }
+
+    unsigned char const* begin() const
+    {
+        return image.data();
+    }
+
+    unsigned char const* end() const
+    {
+        return image.data() + image.size();
+    }
+};
+
+INSTANTIATE_TEST_CASE_P(RegistryHive,
+                        SampleHiveTest,
+                        ::testing::Values("Sample.hiv", "SampleV13.hiv"));
+
+TEST_P(SampleHiveTest, ReadsRootValues)
+{
+    RegistryHive hive(begin(), end());
+    RegistryHiveKey root = hive.GetRootKey();
+    // 2015-01-01
+    EXPECT_EQ(130645440000000000ull, root.GetLastWriteTime());
+    std::vector<std::string> expected;
+    expected.push_back("");
+    expected.push_back("Answer");
+    expected.push_back("Big");
+    expected.push_back("Empty");
+    expected.push_back("Greeting");
+    expected.push_back("\xCE\x94" "elta");
+    EXPECT_EQ(expected, root.EnumerateValueNames());
+    EXPECT_EQ(u"Default", ReadString(root.GetValue("")));
+    EXPECT_EQ(42u, ReadDWord(root.GetValue("Answer")));
+    EXPECT_TRUE(root.GetValue("Empty").empty());
+    EXPECT_EQ(u"Hello", ReadString(root.GetValue("greeting")));
+}
+
+TEST_P(SampleHiveTest, ReadsBigData)
+{
+    RegistryHive hive(begin(), end());
+    RegistryHiveValue const big(hive.GetRootKey().GetValue("Big"));
+    EXPECT_EQ(regBinary, big.GetType());
+    ASSERT_EQ(20000u, big.size());
+    for (std::size_t idx = 0; idx < big.size(); ++idx)
+    {
+        ASSERT_EQ(static_cast<unsigned char>(idx * 7), big.cbegin()[idx])
+            << "at " << idx;
+    }
+}
+
+TEST_P(SampleHiveTest, WalksIndexRoot)
+{
+    RegistryHive hive(begin(), end());
+    RegistryHiveKey keys = hive.Open("Keys");
+    ASSERT_TRUE(keys.Valid());
+    EXPECT_EQ(120u, keys.GetNumberOfSubkeys());
+    std::vector<std::string> const names(keys.EnumerateSubKeyNames());
+    ASSERT_EQ(120u, names.size());
+    EXPECT_EQ("Key000", names.front());
+    EXPECT_EQ("Key119", names.back());
+    EXPECT_TRUE(std::is_sorted(names.begin(), names.end()));
+
+    RegistryHiveKey last = hive.Open("KEYS\\key119");
+    ASSERT_TRUE(last.Valid());
+    EXPECT_EQ(119u, ReadDWord(last.GetValue("INDEX")));
+    EXPECT_TRUE(hive.Open("Keys\\Key120").Invalid());
+}
+
+TEST_P(SampleHiveTest, ComparesUtf16NamesIgnoringCase)
+{
+    RegistryHive hive(begin(), end());
+    // Lower case delta against the stored upper case Delta.
+    RegistryHiveValue const delta(
+        hive.GetRootKey().GetValue("\xCE\xB4" "ELTA"));
+    EXPECT_FALSE(delta.GetNameView().IsCompressed());
+    EXPECT_EQ(4u, ReadDWord(delta));
+
+    // Lower case "ключ" against the stored "Ключ".
+    RegistryHiveKey key =
+        hive.Open("\xD0\xBA\xD0\xBB\xD1\x8E\xD1\x87");
+    ASSERT_TRUE(key.Valid());
+    EXPECT_FALSE(key.GetNameView().IsCompressed());
+    EXPECT_EQ("\xD0\x9A\xD0\xBB\xD1\x8E\xD1\x87", key.GetLocalName());
+    EXPECT_EQ(u"\u0417\u043D\u0430\u0447\u0435\u043D\u0438\u0435",
+              ReadString(key.GetValue("Value")));
+}
+
+TEST_P(SampleHiveTest, RejectsTruncatedImage)
+{
+    // Cut inside the Keys key's subkeys, so the walk leaves the bins.
+    RegistryHive hive(begin(), begin() + 8192);
+    EXPECT_THROW(hive.Open("Keys\\Key119"), InvalidRegistryHiveException);
+}
@@ -0,0 +1,167 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/MemoryRegistry.hpp"
+#include "../LogCommon/RegistrySnapshot.hpp"
+
+using namespace Instalog;
+using namespace Instalog::SystemFacades;
+
+static char const runRoot[] =
+    "\\Registry\\Machine\\Software\\Microsoft\\Windows\\CurrentVersion";
+
+static RegistrySnapshot SnapshotOf(std::string const& regFile)
+{
+    MemoryRegistryBackend backend;
+    std::istringstream source("Windows Registry Editor Version 5.00\n" +
+                              regFile);
+    LoadRegFile(backend, source);
+    ScopedRegistryBackend scope(backend);
+    return RegistrySnapshot::Capture(std::vector<std::string>(1, runRoot));
+}
+
+static std::string DiffText(RegistrySnapshot const& before,
+                            RegistrySnapshot const& after)
+{
+    string_sink output;
+    WriteRegistrySnapshotDiff(output, before, after);
+    return output.get();
+}
+
+static char const baseline[] =
+    "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\Run]\n"
+    "\"Updater\"=\"C:\\\\updater.exe\"\n"
+    "\"Sound\"=\"C:\\\\sound.exe\"\n"
+    "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\RunOnce]\n"
+    "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies]\n"
+    "\"NoDrives\"=dword:00000000\n";
+
+TEST(RegistrySnapshot, CapturesSortedKeysAndValues)
+{
+    RegistrySnapshot snapshot(SnapshotOf(baseline));
+    ASSERT_EQ(4u, snapshot.GetKeyCount());
+    EXPECT_EQ(runRoot, snapshot.GetKeyPath(0).to_string());
+    EXPECT_EQ(std::string(runRoot) + "\\Policies",
+              snapshot.GetKeyPath(1).to_string());
+    EXPECT_EQ(std::string(runRoot) + "\\Run",
+              snapshot.GetKeyPath(2).to_string());
+    std::size_t first, last;
+    snapshot.GetValueRange(2, first, last);
+    ASSERT_EQ(2u, last - first);
+    EXPECT_EQ("Sound", snapshot.GetValueName(first).to_string());
+    EXPECT_EQ("Updater", snapshot.GetValueName(first + 1).to_string());
+    EXPECT_EQ(static_cast<DWORD>(REG_SZ), snapshot.GetValue(first).type);
+}
+
+TEST(RegistrySnapshot, MissingRootIsEmpty)
+{
+    MemoryRegistryBackend backend;
+    ScopedRegistryBackend scope(backend);
+    RegistrySnapshot snapshot(RegistrySnapshot::Capture(
+        std::vector<std::string>(1, "\\Registry\\Machine\\Nonexistent")));
+    EXPECT_EQ(0u, snapshot.GetKeyCount());
+}
+
+TEST(RegistrySnapshot, IdenticalSnapshotsHaveNoDifferences)
+{
+    EXPECT_EQ("", DiffText(SnapshotOf(baseline), SnapshotOf(baseline)));
+}
+
+TEST(RegistrySnapshot, ReportsChangesInPathOrder)
+{
+    RegistrySnapshot before(SnapshotOf(baseline));
+    RegistrySnapshot after(SnapshotOf(
+        "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\Run]\n"
+        "\"updater\"=\"C:\\\\malware.exe\"\n"
+        "\"Tray\"=\"C:\\\\tray.exe\"\n"
+        "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\Policies]\n"
+        "\"NoDrives\"=dword:00000000\n"
+        "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\Explorer]\n"));
+    std::string const root(runRoot);
+    EXPECT_EQ("Key added: " + root + "\\Explorer\r\n"
+              "Value removed: " + root + "\\Run [Sound]\r\n"
+              "Value added: " + root + "\\Run [Tray]\r\n"
+              "Value changed: " + root + "\\Run [updater]\r\n"
+              "Key removed: " + root + "\\RunOnce\r\n",
+              DiffText(before, after));
+}
+
+TEST(RegistrySnapshot, TypeChangeIsReported)
+{
+    RegistrySnapshot before(SnapshotOf(
+        "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion]\n"
+        "\"Value\"=hex:01,00,00,00\n"));
+    RegistrySnapshot after(SnapshotOf(
+        "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion]\n"
+        "\"Value\"=dword:00000001\n"));
+    std::vector<RegistryChangeType> changes;
+    DiffRegistrySnapshots(before, after, [&](RegistryChange const& change) {
+        changes.push_back(change.type);
+    });
+    ASSERT_EQ(1u, changes.size());
+    EXPECT_EQ(RegistryChangeType::ValueChanged, changes[0]);
+}
+
+TEST(RegistrySnapshot, RoundTripsThroughStream)
+{
+    RegistrySnapshot original(SnapshotOf(baseline));
+    std::stringstream stream;
+    original.Save(stream);
+    RegistrySnapshot loaded(RegistrySnapshot::Load(stream));
+    EXPECT_EQ(original.GetKeyCount(), loaded.GetKeyCount());
+    EXPECT_EQ(original.GetValueCount(), loaded.GetValueCount());
+    EXPECT_EQ("", DiffText(original, loaded));
+}
+
+TEST(RegistrySnapshot, RejectsTruncatedStream)
+{
+    std::stringstream stream;
+    SnapshotOf(baseline).Save(stream);
+    std::string data(stream.str());
+    data.resize(data.size() - 1);
+    std::istringstream truncated(data);
+    EXPECT_THROW(RegistrySnapshot::Load(truncated),
+                 InvalidRegistrySnapshotException);
+    std::istringstream junk("Not a snapshot");
+    EXPECT_THROW(RegistrySnapshot::Load(junk),
+                 InvalidRegistrySnapshotException);
+}
+
+TEST(RegistrySnapshot, DISABLED_BenchmarkMillionKeyDiff)
+{
+    std::ostringstream before;
+    std::ostringstream after;
+    for (int idx = 0; idx < 1000000; ++idx)
+    {
+        std::ostringstream key;
+        key << "[HKLM\\Software\\Microsoft\\Windows\\CurrentVersion\\K"
+            << std::setw(7) << std::setfill('0') << idx << "]\n";
+        before << key.str() << "@=dword:00000000\n";
+        if (idx % 1000 != 0)
+        {
+            after << key.str() << "@=dword:0000000" << (idx % 2000 == 1) << "\n";
+        }
+    }
+
+    RegistrySnapshot beforeSnapshot(SnapshotOf(before.str()));
+    RegistrySnapshot afterSnapshot(SnapshotOf(after.str()));
+    std::size_t changes = 0;
+    auto start = std::chrono::steady_clock::now();
+    DiffRegistrySnapshots(beforeSnapshot,
+                          afterSnapshot,
+                          [&changes](RegistryChange const&) { ++changes; });
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_EQ(1000u + 500u, changes);
+    std::cout << "Diff: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count()
+              << " ms" << std::endl;
+}
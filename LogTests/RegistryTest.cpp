@@ -4,7 +4,9 @@
 
 #include "../LogCommon/Registry.hpp"
 #include <array>
+#include <chrono>
 #include <functional>
+#include <iostream>
 #include <windows.h>
 #include "sddl.h"
 #include "gtest/gtest.h"
@@ -236,6 +238,116 @@ TEST(Registry, CanGetSubKeysOpened)
     CheckVectorContainsUserSubkeys(names);
 }
 
+TEST(Registry, HandleCacheIsActiveInScope)
+{
+    EXPECT_EQ(nullptr, RegistryHandleCache::GetActive());
+    {
+        RegistryHandleCache outer;
+        EXPECT_EQ(&outer, RegistryHandleCache::GetActive());
+        {
+            RegistryHandleCache inner;
+            EXPECT_EQ(&inner, RegistryHandleCache::GetActive());
+        }
+        EXPECT_EQ(&outer, RegistryHandleCache::GetActive());
+    }
+    EXPECT_EQ(nullptr, RegistryHandleCache::GetActive());
+}
+
+TEST(Registry, HandleCacheSavesRepeatedOpens)
+{
+    RegistryHandleCache cache;
+    std::string const software(GetCurrentUserRelativeKeyPath("\\Software"));
+    RegistryKey first(RegistryKey::Open(software, KEY_QUERY_VALUE));
+    ASSERT_TRUE(first.Valid());
+    EXPECT_EQ(0u, cache.GetOpensSaved());
+    RegistryKey second(RegistryKey::Open(software, KEY_QUERY_VALUE));
+    ASSERT_TRUE(second.Valid());
+    EXPECT_EQ(1u, cache.GetOpensSaved());
+    EXPECT_EQ(first.GetHkey(), second.GetHkey());
+    EXPECT_FALSE(first.OwnsHandle());
+    EXPECT_FALSE(second.OwnsHandle());
+}
+
+TEST(Registry, HandleCacheKeepsHandlesOfClosedKeys)
+{
+    RegistryHandleCache cache;
+    std::string const software(GetCurrentUserRelativeKeyPath("\\Software"));
+    RegistryKey::Open(software, KEY_QUERY_VALUE).Close();
+    RegistryKey reopened(RegistryKey::Open(software, KEY_QUERY_VALUE));
+    ASSERT_TRUE(reopened.Valid());
+    EXPECT_EQ(1u, cache.GetOpensSaved());
+    EXPECT_FALSE(reopened.GetName().empty());
+}
+
+TEST(Registry, HandleCacheComparesPathsIgnoringCase)
+{
+    RegistryHandleCache cache;
+    RegistryKey first(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software"), KEY_QUERY_VALUE));
+    RegistryKey second(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\SOFTWARE"), KEY_QUERY_VALUE));
+    ASSERT_TRUE(second.Valid());
+    EXPECT_EQ(1u, cache.GetOpensSaved());
+}
+
+TEST(Registry, HandleCacheRemembersFailures)
+{
+    RegistryHandleCache cache;
+    std::string const missing(GetCurrentUserRelativeKeyPath(
+        "\\Software\\Microsoft\\NonexistentTestKeyHere"));
+    EXPECT_TRUE(RegistryKey::Open(missing, KEY_QUERY_VALUE).Invalid());
+    DWORD const firstError = ::GetLastError();
+    EXPECT_TRUE(RegistryKey::Open(missing, KEY_QUERY_VALUE).Invalid());
+    EXPECT_EQ(firstError, ::GetLastError());
+    EXPECT_EQ(1u, cache.GetOpensSaved());
+}
+
+TEST(Registry, HandleCacheOpensRelativeToCachedParent)
+{
+    RegistryHandleCache cache;
+    RegistryKey parent(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software"), KEY_QUERY_VALUE));
+    ASSERT_TRUE(parent.Valid());
+    RegistryKey child(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software\\Microsoft"),
+        KEY_QUERY_VALUE));
+    ASSERT_TRUE(child.Valid());
+    EXPECT_EQ(1u, cache.GetRelativeOpens());
+    EXPECT_EQ(RegistryKey::Open(parent, "Microsoft", KEY_QUERY_VALUE).GetName(),
+              child.GetName());
+}
+
+TEST(Registry, HandleCacheDoesNotOpenRelativeToOtherAccess)
+{
+    RegistryHandleCache cache;
+    RegistryKey parent(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software"), KEY_QUERY_VALUE));
+    ASSERT_TRUE(parent.Valid());
+    RegistryKey child(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software\\Microsoft"),
+        KEY_ENUMERATE_SUB_KEYS | KEY_WOW64_32KEY));
+    ASSERT_TRUE(child.Valid());
+    EXPECT_EQ(0u, cache.GetRelativeOpens());
+}
+
+TEST(Registry, HandleCacheIsFlushedByCreate)
+{
+    RegistryHandleCache cache;
+    std::string const path(GetCurrentUserRelativeKeyPath(
+        "\\Software\\Microsoft\\NonexistentTestKeyHere"));
+    RegistryKey software(RegistryKey::Open(
+        GetCurrentUserRelativeKeyPath("\\Software"), KEY_QUERY_VALUE));
+    ASSERT_TRUE(software.Valid());
+    EXPECT_TRUE(RegistryKey::Open(path, KEY_QUERY_VALUE).Invalid());
+    RegistryKey created(
+        RegistryKey::Create(path, KEY_QUERY_VALUE | DELETE));
+    ASSERT_TRUE(created.Valid());
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_TRUE(RegistryKey::Open(path, KEY_QUERY_VALUE).Valid());
+    EXPECT_FALSE(software.GetName().empty());
+    created.Delete();
+}
+
 static wchar_t exampleData[] =
     L"example example example test test example \0 embedded";
 static auto exampleDataCasted = reinterpret_cast<BYTE const*>(exampleData);
@@ -461,6 +573,60 @@ TEST_F(RegistryValueTest, CanGetLongValueData)
     ASSERT_TRUE(std::equal(data.cbegin(), data.cend(), exampleLongDataCasted));
 }
 
+TEST_F(RegistryValueTest, TryGetValueFindsExistingValue)
+{
+    expected<RegistryValue> data = keyUnderTest.TryGetValue("ExampleData");
+    ASSERT_TRUE(data.is_valid());
+    EXPECT_EQ(REG_SZ, data.get().GetType());
+    EXPECT_EQ(sizeof(exampleData), data.get().size());
+}
+
+TEST_F(RegistryValueTest, TryGetValueDoesNotThrowForMissingValue)
+{
+    expected<RegistryValue> data = keyUnderTest.TryGetValue("NonexistentValue");
+    EXPECT_FALSE(data.is_valid());
+    EXPECT_THROW(data.get(), ErrorFileNotFoundException);
+}
+
+// Compares the cost of probing for missing values by catching exceptions with
+// the cost of using TryGetValue. Run with --gtest_also_run_disabled_tests.
+TEST_F(RegistryValueTest, DISABLED_BenchmarkMissingValueLookup)
+{
+    std::size_t const iterations = 100000;
+    std::size_t misses = 0;
+    auto const throwingStart = std::chrono::high_resolution_clock::now();
+    for (std::size_t idx = 0; idx < iterations; ++idx)
+    {
+        try
+        {
+            keyUnderTest.GetValue("NonexistentValue");
+        }
+        catch (ErrorFileNotFoundException const&)
+        {
+            ++misses;
+        }
+    }
+
+    auto const expectedStart = std::chrono::high_resolution_clock::now();
+    for (std::size_t idx = 0; idx < iterations; ++idx)
+    {
+        if (!keyUnderTest.TryGetValue("NonexistentValue").is_valid())
+        {
+            ++misses;
+        }
+    }
+
+    auto const end = std::chrono::high_resolution_clock::now();
+    EXPECT_EQ(iterations * 2, misses);
+    std::cout << "GetValue + catch: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     expectedStart - throwingStart).count()
+              << " ms\nTryGetValue:      "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - expectedStart).count()
+              << " ms\n";
+}
+
 TEST_F(RegistryValueTest, CanEnumerateValueNames)
 {
     auto names = keyUnderTest.EnumerateValueNames();
@@ -503,6 +669,56 @@ TEST_F(RegistryValueTest, CanEnumerateValuesAndData)
         namesData[6].cbegin(), namesData[6].cend(), exampleLongDataCasted));
 }
 
+TEST_F(RegistryValueTest, CanEnumerateValuesIntoArena)
+{
+    std::vector<RegistryValueAndData> expected(GetAndSort());
+    RegistryValueArena arena;
+    keyUnderTest.EnumerateValues(arena);
+    ASSERT_EQ(expected.size(), arena.size());
+    std::vector<RegistryValueView> views(arena.begin(), arena.end());
+    std::sort(views.begin(), views.end());
+    for (std::size_t idx = 0; idx < views.size(); ++idx)
+    {
+        EXPECT_EQ(expected[idx].GetName(), views[idx].GetName());
+        EXPECT_EQ(expected[idx].GetType(), views[idx].GetType());
+        EXPECT_TRUE(std::equal(views[idx].cbegin(),
+                               views[idx].cend(),
+                               expected[idx].cbegin(),
+                               expected[idx].cend()));
+    }
+}
+
+TEST_F(RegistryValueTest, ArenaViewsDoNotCopy)
+{
+    RegistryValueArena arena;
+    keyUnderTest.EnumerateValues(arena);
+    std::string formatted;
+    for (RegistryValueView const& view : arena)
+    {
+        boost::wstring_ref const name(view.GetNameView());
+        EXPECT_EQ(view.GetNameData(), name.data());
+        EXPECT_EQ(view.GetName(), utf8::ToUtf8(name.data(), name.size()));
+
+        // AppendString appends, and formats as GetString does.
+        formatted = "prefix";
+        view.AppendString(formatted);
+        EXPECT_EQ("prefix" + view.GetString(), formatted);
+    }
+}
+
+TEST_F(RegistryValueTest, ArenaIsReusedAcrossKeys)
+{
+    RegistryValueArena arena;
+    keyUnderTest.EnumerateValues(arena);
+    conversionsKey.EnumerateValues(arena);
+    EXPECT_EQ(conversionsKey.EnumerateValueNames().size(), arena.size());
+    std::size_t const capacity = arena.capacity();
+    keyUnderTest.EnumerateValues(arena);
+    EXPECT_EQ(keyUnderTest.EnumerateValueNames().size(), arena.size());
+    conversionsKey.EnumerateValues(arena);
+    EXPECT_EQ(capacity, arena.capacity());
+}
+
 TEST_F(RegistryValueTest, CanSortValuesAndData)
 {
     auto namesData = keyUnderTest.EnumerateValues();
@@ -561,6 +777,17 @@ TEST_F(RegistryValueTest, StringizeWorks)
     EXPECT_EQ(stringized[9], "qword:BADC0FFEEBADBAD1");
 }
 
+TEST_F(RegistryValueTest, WriteMatchesStringize)
+{
+    auto underTest = GetAndSort();
+    for (auto const& value : underTest)
+    {
+        Instalog::string_sink written;
+        write_registry_value(written, value);
+        EXPECT_EQ(value.GetString(), written.get());
+    }
+}
+
 TEST_F(RegistryValueTest, StrictStringize)
 {
     auto underTest = GetAndSort();
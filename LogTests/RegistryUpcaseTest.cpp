@@ -0,0 +1,44 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "gtest/gtest.h"
+#include "../LogCommon/RegistryUpcase.hpp"
+
+using Instalog::SystemFacades::UpcaseRegistryCharacter;
+
+TEST(RegistryUpcase, UpcasesAscii)
+{
+    EXPECT_EQ(L'A', UpcaseRegistryCharacter(L'a'));
+    EXPECT_EQ(L'Z', UpcaseRegistryCharacter(L'z'));
+    EXPECT_EQ(L'A', UpcaseRegistryCharacter(L'A'));
+    EXPECT_EQ(L'{', UpcaseRegistryCharacter(L'{'));
+    EXPECT_EQ(L'\\', UpcaseRegistryCharacter(L'\\'));
+}
+
+TEST(RegistryUpcase, UpcasesRuns)
+{
+    // Latin-1, stride 1 and stride 2 runs, and Cyrillic.
+    EXPECT_EQ(0x00C0, UpcaseRegistryCharacter(0x00E0));
+    EXPECT_EQ(0x00F7, UpcaseRegistryCharacter(0x00F7));
+    EXPECT_EQ(0x0178, UpcaseRegistryCharacter(0x00FF));
+    EXPECT_EQ(0x0100, UpcaseRegistryCharacter(0x0101));
+    EXPECT_EQ(0x0100, UpcaseRegistryCharacter(0x0100));
+    EXPECT_EQ(0x0394, UpcaseRegistryCharacter(0x03B4));
+    EXPECT_EQ(0x03A3, UpcaseRegistryCharacter(0x03C2));
+    EXPECT_EQ(0x041A, UpcaseRegistryCharacter(0x043A));
+    EXPECT_EQ(0xFF21, UpcaseRegistryCharacter(0xFF41));
+}
+
+TEST(RegistryUpcase, DoesNotMapIntoAscii)
+{
+    EXPECT_EQ(0x0131, UpcaseRegistryCharacter(0x0131));
+    EXPECT_EQ(0x017F, UpcaseRegistryCharacter(0x017F));
+}
+
+TEST(RegistryUpcase, LeavesUnmappedCharactersAlone)
+{
+    EXPECT_EQ(0x00DF, UpcaseRegistryCharacter(0x00DF));
+    EXPECT_EQ(0x4E2D, UpcaseRegistryCharacter(0x4E2D));
+    EXPECT_EQ(0xFFFF, UpcaseRegistryCharacter(0xFFFF));
+}
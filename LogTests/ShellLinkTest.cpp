@@ -0,0 +1,361 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/ShellLink.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace Instalog::SystemFacades;
+
+// Builds .lnk files in memory, in the order MS-SHLLINK lays them out.
+class LnkBuilder
+{
+    std::vector<unsigned char> idList_;
+    std::vector<unsigned char> linkInfo_;
+    std::vector<unsigned char> strings_;
+    std::vector<unsigned char> extraData_;
+    std::uint32_t flags_;
+
+    static void U16(std::vector<unsigned char>& target, std::uint16_t value)
+    {
+        target.push_back(static_cast<unsigned char>(value & 0xFF));
+        target.push_back(static_cast<unsigned char>(value >> 8));
+    }
+
+    static void U32(std::vector<unsigned char>& target, std::uint32_t value)
+    {
+        U16(target, static_cast<std::uint16_t>(value & 0xFFFF));
+        U16(target, static_cast<std::uint16_t>(value >> 16));
+    }
+
+    static void Chars(std::vector<unsigned char>& target,
+                      std::wstring const& text)
+    {
+        for (wchar_t ch : text)
+        {
+            U16(target, static_cast<std::uint16_t>(ch));
+        }
+    }
+
+    static void Put16(std::vector<unsigned char>& target,
+                      std::size_t offset,
+                      std::uint16_t value)
+    {
+        std::memcpy(&target[offset], &value, sizeof(value));
+    }
+
+    static void Put32(std::vector<unsigned char>& target,
+                      std::size_t offset,
+                      std::uint32_t value)
+    {
+        std::memcpy(&target[offset], &value, sizeof(value));
+    }
+
+    void Item(std::vector<unsigned char> const& item)
+    {
+        U16(idList_, static_cast<std::uint16_t>(item.size() + 2));
+        idList_.insert(idList_.end(), item.begin(), item.end());
+    }
+
+    public:
+    LnkBuilder() : flags_(0x80)
+    {
+    }
+
+    LnkBuilder& Ansi()
+    {
+        flags_ &= ~0x80u;
+        return *this;
+    }
+
+    LnkBuilder& MyComputer()
+    {
+        std::vector<unsigned char> item(18);
+        item[0] = 0x1F;
+        item[1] = 0x50;
+        flags_ |= 0x01;
+        Item(item);
+        return *this;
+    }
+
+    LnkBuilder& Volume(std::string const& drive)
+    {
+        std::vector<unsigned char> item(1, 0x2F);
+        item.insert(item.end(), drive.begin(), drive.end());
+        item.resize(23);
+        Item(item);
+        return *this;
+    }
+
+    // A file entry with an 8.3 primary name and, if it differs, a version 9
+    // extension block carrying the long name.
+    LnkBuilder& FileEntry(std::string const& shortName,
+                          std::wstring const& longName)
+    {
+        std::vector<unsigned char> item(12);
+        item[0] = 0x31;
+        item.insert(item.end(), shortName.begin(), shortName.end());
+        item.push_back(0);
+        if (item.size() % 2 != 0)
+        {
+            item.push_back(0);
+        }
+
+        std::size_t const extension = item.size();
+        U16(item, 0);
+        U16(item, 9);
+        U32(item, 0xBEEF0004);
+        item.resize(extension + 46);
+        Chars(item, longName);
+        U16(item, 0);
+        U16(item, static_cast<std::uint16_t>(extension));
+        Put16(item, extension, static_cast<std::uint16_t>(item.size() - extension));
+        Item(item);
+        return *this;
+    }
+
+    LnkBuilder& LocalBasePath(std::string const& path, std::string const& suffix)
+    {
+        linkInfo_.assign(0x1C, 0);
+        Put32(linkInfo_, 4, 0x1C);
+        Put32(linkInfo_, 8, 1);
+        Put32(linkInfo_, 0x0C, 0x1C);
+        // An empty volume ID.
+        U32(linkInfo_, 0x10);
+        U32(linkInfo_, 3);
+        U32(linkInfo_, 0);
+        U32(linkInfo_, 0x10);
+        Put32(linkInfo_, 0x10, static_cast<std::uint32_t>(linkInfo_.size()));
+        linkInfo_.insert(linkInfo_.end(), path.begin(), path.end());
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0x18, static_cast<std::uint32_t>(linkInfo_.size()));
+        linkInfo_.insert(linkInfo_.end(), suffix.begin(), suffix.end());
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0, static_cast<std::uint32_t>(linkInfo_.size()));
+        flags_ |= 0x02;
+        return *this;
+    }
+
+    LnkBuilder& UnicodeLocalBasePath(std::wstring const& path)
+    {
+        linkInfo_.assign(0x24, 0);
+        Put32(linkInfo_, 4, 0x24);
+        Put32(linkInfo_, 8, 1);
+        Put32(linkInfo_, 0x10, static_cast<std::uint32_t>(linkInfo_.size()));
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0x18, static_cast<std::uint32_t>(linkInfo_.size()));
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0x1C, static_cast<std::uint32_t>(linkInfo_.size()));
+        Chars(linkInfo_, path);
+        U16(linkInfo_, 0);
+        Put32(linkInfo_, 0x20, static_cast<std::uint32_t>(linkInfo_.size()));
+        U16(linkInfo_, 0);
+        Put32(linkInfo_, 0, static_cast<std::uint32_t>(linkInfo_.size()));
+        flags_ |= 0x02;
+        return *this;
+    }
+
+    LnkBuilder& NetworkPath(std::string const& share, std::string const& suffix)
+    {
+        linkInfo_.assign(0x1C, 0);
+        Put32(linkInfo_, 4, 0x1C);
+        Put32(linkInfo_, 8, 2);
+        Put32(linkInfo_, 0x14, 0x1C);
+        U32(linkInfo_, 0);
+        U32(linkInfo_, 0);
+        U32(linkInfo_, 0x14);
+        U32(linkInfo_, 0);
+        U32(linkInfo_, 0x00020000);
+        linkInfo_.insert(linkInfo_.end(), share.begin(), share.end());
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0x1C, static_cast<std::uint32_t>(linkInfo_.size() - 0x1C));
+        Put32(linkInfo_, 0x18, static_cast<std::uint32_t>(linkInfo_.size()));
+        linkInfo_.insert(linkInfo_.end(), suffix.begin(), suffix.end());
+        linkInfo_.push_back(0);
+        Put32(linkInfo_, 0, static_cast<std::uint32_t>(linkInfo_.size()));
+        flags_ |= 0x02;
+        return *this;
+    }
+
+    // Adds StringData; flag is the LinkFlags bit of the string, and strings
+    // must be added in the order their bits are numbered.
+    LnkBuilder& String(std::uint32_t flag, std::wstring const& text)
+    {
+        U16(strings_, static_cast<std::uint16_t>(text.size()));
+        if (flags_ & 0x80)
+        {
+            Chars(strings_, text);
+        }
+        else
+        {
+            for (wchar_t ch : text)
+            {
+                strings_.push_back(static_cast<unsigned char>(ch));
+            }
+        }
+
+        flags_ |= flag;
+        return *this;
+    }
+
+    LnkBuilder& Arguments(std::wstring const& text)
+    {
+        return String(0x20, text);
+    }
+
+    LnkBuilder& EnvironmentTarget(std::wstring const& target)
+    {
+        std::size_t const block = extraData_.size();
+        U32(extraData_, 0x314);
+        U32(extraData_, 0xA0000001);
+        extraData_.insert(extraData_.end(), target.begin(), target.end());
+        extraData_.resize(block + 0x10C);
+        Chars(extraData_, target);
+        extraData_.resize(block + 0x314);
+        flags_ |= 0x200;
+        return *this;
+    }
+
+    std::vector<unsigned char> Build() const
+    {
+        std::vector<unsigned char> result(0x4C);
+        Put32(result, 0, 0x4C);
+        unsigned char const clsid[16] = {0x01, 0x14, 0x02, 0x00, 0x00, 0x00,
+                                         0x00, 0x00, 0xC0, 0x00, 0x00, 0x00,
+                                         0x00, 0x00, 0x00, 0x46};
+        std::memcpy(&result[4], clsid, sizeof(clsid));
+        Put32(result, 0x14, flags_);
+        if (flags_ & 0x01)
+        {
+            U16(result, static_cast<std::uint16_t>(idList_.size() + 2));
+            result.insert(result.end(), idList_.begin(), idList_.end());
+            U16(result, 0);
+        }
+
+        result.insert(result.end(), linkInfo_.begin(), linkInfo_.end());
+        result.insert(result.end(), strings_.begin(), strings_.end());
+        result.insert(result.end(), extraData_.begin(), extraData_.end());
+        U32(result, 0);
+        return result;
+    }
+};
+
+static ShellLink Parse(std::vector<unsigned char> const& data)
+{
+    return ShellLink(data.data(), data.data() + data.size());
+}
+
+TEST(ShellLink, LocalBasePathAndArguments)
+{
+    ShellLink const link(Parse(LnkBuilder()
+                                   .LocalBasePath("C:\\Program Files\\Example",
+                                                  "app.exe")
+                                   .String(0x04, L"Example application")
+                                   .Arguments(L"/minimized")
+                                   .Build()));
+    EXPECT_EQ("C:\\Program Files\\Example\\app.exe", link.GetTarget());
+    EXPECT_EQ("Example application", link.GetName());
+    EXPECT_EQ("/minimized", link.GetArguments());
+    EXPECT_EQ("", link.GetEnvironmentTarget());
+}
+
+TEST(ShellLink, UnicodeLocalBasePath)
+{
+    ShellLink const link(Parse(
+        LnkBuilder().UnicodeLocalBasePath(L"C:\\Caf\u00E9\\app.exe").Build()));
+    EXPECT_EQ("C:\\Caf\xC3\xA9\\app.exe", link.GetLinkInfoPath());
+    EXPECT_EQ(link.GetLinkInfoPath(), link.GetTarget());
+}
+
+TEST(ShellLink, NetworkPath)
+{
+    ShellLink const link(Parse(
+        LnkBuilder().NetworkPath("\\\\server\\share", "tools\\app.exe").Build()));
+    EXPECT_EQ("\\\\server\\share\\tools\\app.exe", link.GetTarget());
+}
+
+TEST(ShellLink, IdListPath)
+{
+    ShellLink const link(Parse(LnkBuilder()
+                                   .MyComputer()
+                                   .Volume("C:\\")
+                                   .FileEntry("PROGRA~1", L"Program Files")
+                                   .FileEntry("app.exe", L"app.exe")
+                                   .Arguments(L"-x")
+                                   .Build()));
+    EXPECT_EQ("C:\\Program Files\\app.exe", link.GetIdListPath());
+    EXPECT_EQ("C:\\Program Files\\app.exe", link.GetTarget());
+    EXPECT_EQ("-x", link.GetArguments());
+}
+
+TEST(ShellLink, LinkInfoIsPreferredToIdList)
+{
+    ShellLink const link(Parse(LnkBuilder()
+                                   .MyComputer()
+                                   .Volume("C:\\")
+                                   .FileEntry("OLD~1", L"Old")
+                                   .LocalBasePath("D:\\New\\app.exe", "")
+                                   .Build()));
+    EXPECT_EQ("C:\\Old", link.GetIdListPath());
+    EXPECT_EQ("D:\\New\\app.exe", link.GetTarget());
+}
+
+TEST(ShellLink, EnvironmentTargetIsPreferred)
+{
+    ShellLink const link(
+        Parse(LnkBuilder()
+                  .LocalBasePath("C:\\Program Files\\Example\\app.exe", "")
+                  .EnvironmentTarget(L"%ProgramFiles%\\Example\\app.exe")
+                  .Build()));
+    EXPECT_EQ("%ProgramFiles%\\Example\\app.exe", link.GetTarget());
+    EXPECT_EQ("C:\\Program Files\\Example\\app.exe", link.GetLinkInfoPath());
+}
+
+TEST(ShellLink, AnsiStrings)
+{
+    ShellLink const link(Parse(LnkBuilder()
+                                   .Ansi()
+                                   .LocalBasePath("C:\\app.exe", "")
+                                   .Arguments(L"\x80 5")
+                                   .Build()));
+    EXPECT_EQ("\xE2\x82\xAC 5", link.GetArguments());
+}
+
+TEST(ShellLink, RejectsOtherFiles)
+{
+    std::string const text("[.ShellClassInfo]\r\nLocalizedResourceName=Startup"
+                           "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n");
+    EXPECT_THROW(
+        ShellLink(reinterpret_cast<unsigned char const*>(text.data()),
+                  reinterpret_cast<unsigned char const*>(text.data()) +
+                      text.size()),
+        InvalidShellLinkException);
+}
+
+TEST(ShellLink, TruncatedLinks)
+{
+    std::vector<unsigned char> const data(
+        LnkBuilder()
+            .MyComputer()
+            .Volume("C:\\")
+            .FileEntry("PROGRA~1", L"Program Files")
+            .LocalBasePath("C:\\Program Files\\app.exe", "")
+            .Arguments(L"/quiet")
+            .EnvironmentTarget(L"%ProgramFiles%\\app.exe")
+            .Build());
+    for (std::size_t size = 0; size < data.size(); ++size)
+    {
+        try
+        {
+            ShellLink(data.data(), data.data() + size);
+        }
+        catch (InvalidShellLinkException const&)
+        {
+        }
+    }
+
+    EXPECT_EQ("%ProgramFiles%\\app.exe", Parse(data).GetTarget());
+}
@@ -0,0 +1,31 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#pragma once
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Unlike TestSupport.hpp, this needs no Windows, so that parsers which build
+// anywhere can be tested on sample files anywhere. The build points
+// INSTALOG_TEST_DATA_DIR at LogTests/TestData.
+
+inline std::string GetTestDataPath(std::string const& file)
+{
+    return std::string(INSTALOG_TEST_DATA_DIR).append(file);
+}
+
+inline std::vector<unsigned char> ReadTestDataFile(std::string const& file)
+{
+    std::ifstream stream(GetTestDataPath(file).c_str(), std::ios::binary);
+    if (!stream)
+    {
+        throw std::runtime_error("Test data file not found: " + file);
+    }
+
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(stream),
+                                      std::istreambuf_iterator<char>());
+}
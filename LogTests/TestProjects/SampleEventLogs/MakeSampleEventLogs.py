@@ -0,0 +1,433 @@
+# Copyright © Jacob Snyder, Billy O'Neal III
+# This is under the 2 clause BSD license.
+# See the included LICENSE.TXT file for more details.
+
+"""Writes the sample event log in LogTests/TestData.
+
+The log follows the .evtx layout the event log service uses: a checksummed
+file header, 64 KiB chunks with string and template tables, and records whose
+binary XML instantiates templates defined inline the first time a chunk uses
+them. The file is a ring which has wrapped, so the newest chunk comes first.
+
+Events, by record number (1 to 140):
+  n % 5 == 0  EventLog 6013, information, classic (uptime in seconds: n)
+  n % 5 == 1  Service Control Manager 7036, information, classic
+              ("Service n", "running"), with binary data
+  n % 5 == 2  Service Control Manager 7000, error, classic
+              ("Service n", "%%5")
+  n % 5 == 3  disk 11, error, classic ("\\Device\\Harddisk<n>\\DR<n>")
+  n % 5 == 4  Microsoft-Windows-Kernel-General 12, information, manifest
+              based, with typed EventData
+  except that record 100 is Microsoft-Windows-Eventlog 104, warning, with
+  its values in UserData, and record 140 is Microsoft-Windows-Kernel-Power
+  41, critical.
+
+Records 1 to 100 are in the second chunk of the file, and 101 to 140 in the
+first. Each record was written at 2015-01-01 plus n minutes; the time created
+is one second earlier.
+
+Usage: python MakeSampleEventLogs.py <TestData directory>
+"""
+
+import os
+import struct
+import sys
+import zlib
+
+CHUNK_SIZE = 65536
+BASE_TIME = 130645440000000000  # 2015-01-01
+TICKS_PER_SECOND = 10000000
+
+NULL, STRING, UINT8, UINT16, UINT32, UINT64 = 0x00, 0x01, 0x04, 0x06, 0x08, \
+    0x0A
+BINARY, GUID, FILETIME, SID, HEX64, BINXML = 0x0E, 0x0F, 0x11, 0x13, 0x15, \
+    0x21
+
+EVENT_NS = 'http://schemas.microsoft.com/win/2004/08/events/event'
+
+
+def crc32(data):
+    return zlib.crc32(bytes(data)) & 0xFFFFFFFF
+
+
+def name_hash(name):
+    result = 0
+    for c in name:
+        result = (result * 65599 + ord(c)) & 0xFFFFFFFF
+    return result & 0xFFFF
+
+
+def guid_bytes(text):
+    parts = text.strip('{}').split('-')
+    return struct.pack('<IHH', int(parts[0], 16), int(parts[1], 16),
+                       int(parts[2], 16)) + bytes.fromhex(parts[3] + parts[4])
+
+
+def sid_bytes(text):
+    parts = [int(part) for part in text.split('-')[1:]]
+    return struct.pack('<BB', parts[0], len(parts) - 2) + \
+        parts[1].to_bytes(6, 'big') + \
+        b''.join(struct.pack('<I', part) for part in parts[2:])
+
+
+def utf16(text):
+    return text.encode('utf-16-le')
+
+
+# Template bodies are nested tuples describing elements:
+#   (name, [attributes], [content])
+# where attributes are (name, value), and content and values are literal
+# strings, substitutions, or (content only) further elements.
+
+def sub(index, kind, optional=False):
+    return ('sub', index, kind, optional)
+
+
+CLASSIC_SYSTEM = [
+    ('Provider', [('Name', sub(0, STRING)), ('Guid', sub(1, GUID, True)),
+                  ('EventSourceName', sub(2, STRING, True))], []),
+    ('EventID', [('Qualifiers', sub(3, UINT16, True))],
+     [sub(4, UINT16)]),
+    ('Version', [], [sub(5, UINT8)]),
+    ('Level', [], [sub(6, UINT8)]),
+    ('Task', [], [sub(7, UINT16)]),
+    ('Opcode', [], [sub(8, UINT8)]),
+    ('Keywords', [], [sub(9, HEX64)]),
+    ('TimeCreated', [('SystemTime', sub(10, FILETIME))], []),
+    ('EventRecordID', [], [sub(11, UINT64)]),
+    ('Correlation', [('ActivityID', sub(12, GUID, True)),
+                     ('RelatedActivityID', sub(13, GUID, True))], []),
+    ('Execution', [('ProcessID', sub(14, UINT32)),
+                   ('ThreadID', sub(15, UINT32))], []),
+    ('Channel', [], [sub(16, STRING)]),
+    ('Computer', [], [sub(17, STRING)]),
+    ('Security', [('UserID', sub(18, SID, True))], []),
+]
+
+SYSTEM_VALUES = 19
+
+
+def event(data):
+    return ('Event', [('xmlns', EVENT_NS)],
+            [('System', [], CLASSIC_SYSTEM)] + data)
+
+
+# Classic events: two insertion strings and binary data.
+CLASSIC_TEMPLATE = event([('EventData', [], [
+    ('Data', [], [sub(19, STRING)]),
+    ('Data', [], [sub(20, STRING)]),
+    ('Binary', [], [sub(21, BINARY, True)]),
+])])
+
+# Manifest based events with named, typed EventData.
+KERNEL_GENERAL_TEMPLATE = event([('EventData', [], [
+    ('Data', [('Name', 'MajorVersion')], [sub(19, UINT32)]),
+    ('Data', [('Name', 'MinorVersion')], [sub(20, UINT32)]),
+    ('Data', [('Name', 'BuildVersion')], [sub(21, UINT32)]),
+    ('Data', [('Name', 'StartTime')], [sub(22, FILETIME)]),
+])])
+
+KERNEL_POWER_TEMPLATE = event([('EventData', [], [
+    ('Data', [('Name', 'BugcheckCode')], [sub(19, UINT32)]),
+    ('Data', [('Name', 'SleepInProgress')], [sub(20, UINT8)]),
+    ('Data', [('Name', 'PowerButtonTimestamp')],
+     [sub(21, UINT64)]),
+])])
+
+# UserData is a nested fragment, passed as a BinXml value.
+USER_DATA_TEMPLATE = event([('UserData', [], [sub(19, BINXML)])])
+
+LOG_CLEARED_TEMPLATE = ('LogFileCleared', [
+    ('xmlns', 'http://manifests.microsoft.com/win/2004/08/windows/eventlog'),
+], [
+    ('SubjectUserName', [], [sub(0, STRING)]),
+    ('SubjectDomainName', [], [sub(1, STRING)]),
+    ('Channel', [], [sub(2, STRING)]),
+    ('BackupPath', [], [sub(3, STRING)]),
+])
+
+
+class ChunkWriter(object):
+    def __init__(self):
+        self.buf = bytearray(CHUNK_SIZE)
+        self.pos = 512
+        self.names = {}
+        self.templates = {}
+        self.string_table = [0] * 64
+        self.template_table = [0] * 32
+
+    def emit(self, data):
+        self.buf[self.pos:self.pos + len(data)] = data
+        self.pos += len(data)
+
+    def u8(self, value):
+        self.emit(struct.pack('<B', value))
+
+    def u16(self, value):
+        self.emit(struct.pack('<H', value))
+
+    def u32(self, value):
+        self.emit(struct.pack('<I', value))
+
+    def name_ref(self, name):
+        if name in self.names:
+            self.u32(self.names[name])
+            return
+        offset = self.pos + 4
+        self.u32(offset)
+        self.names[name] = offset
+        bucket = name_hash(name) % 64
+        self.emit(struct.pack('<IHH', self.string_table[bucket],
+                              name_hash(name), len(name)) + utf16(name) +
+                  b'\0\0')
+        self.string_table[bucket] = offset
+
+    def text(self, value):
+        if isinstance(value, tuple):
+            _, index, kind, optional = value
+            self.u8(0x0E if optional else 0x0D)
+            self.u16(index)
+            self.u8(kind)
+        else:
+            self.u8(0x05)
+            self.u8(STRING)
+            self.u16(len(value))
+            self.emit(utf16(value))
+
+    def element(self, node):
+        name, attributes, content = node
+        start = self.pos
+        dependency = 0xFFFF
+        self.u8(0x41 if attributes else 0x01)
+        self.u16(dependency)
+        size_field = self.pos
+        self.u32(0)
+        self.name_ref(name)
+        if attributes:
+            list_field = self.pos
+            self.u32(0)
+            list_start = self.pos
+            for idx, (attribute, value) in enumerate(attributes):
+                self.u8(0x46 if idx + 1 < len(attributes) else 0x06)
+                self.name_ref(attribute)
+                self.text(value)
+            struct.pack_into('<I', self.buf, list_field, self.pos - list_start)
+        if content:
+            self.u8(0x02)
+            for item in content:
+                if isinstance(item, list):
+                    raise ValueError(item)
+                if isinstance(item, tuple) and item[0] != 'sub':
+                    self.element(item)
+                else:
+                    self.text(item)
+            self.u8(0x04)
+        else:
+            self.u8(0x03)
+        struct.pack_into('<I', self.buf, size_field, self.pos - start - 7)
+
+    def fragment_header(self):
+        self.emit(b'\x0F\x01\x01\x00')
+
+    def template_instance(self, key, body, values):
+        self.u8(0x0C)
+        self.u8(0x01)
+        if key in self.templates:
+            offset, identifier = self.templates[key]
+            self.u32(identifier)
+            self.u32(offset)
+        else:
+            guid = struct.pack('<I', zlib.crc32(key.encode())) + \
+                bytes(range(12))
+            identifier = struct.unpack('<I', guid[:4])[0]
+            self.u32(identifier)
+            offset = self.pos + 4
+            self.u32(offset)
+            self.templates[key] = (offset, identifier)
+            bucket = identifier % 32
+            self.u32(self.template_table[bucket])
+            self.emit(guid)
+            size_field = self.pos
+            self.u32(0)
+            body_start = self.pos
+            self.fragment_header()
+            self.element(body)
+            self.u8(0x00)
+            struct.pack_into('<I', self.buf, size_field, self.pos - body_start)
+            self.template_table[bucket] = offset
+
+        self.u32(len(values))
+        encoded = []
+        for kind, value in values:
+            if kind == BINXML:
+                # Written in place below, once its position is known.
+                encoded.append((kind, value))
+            else:
+                encoded.append((kind, encode_value(kind, value)))
+        descriptors = self.pos
+        self.emit(bytes(4 * len(values)))
+        for idx, (kind, value) in enumerate(encoded):
+            start = self.pos
+            if kind == BINXML:
+                nested_key, nested_body, nested_values = value
+                self.fragment_header()
+                self.template_instance(nested_key, nested_body, nested_values)
+                self.u8(0x00)
+            else:
+                self.emit(value)
+            struct.pack_into('<HBB', self.buf, descriptors + idx * 4,
+                             self.pos - start, kind, 0)
+
+    def record(self, number, written, key, body, values):
+        start = self.pos
+        self.u32(0x00002A2A)
+        self.u32(0)
+        self.emit(struct.pack('<QQ', number, written))
+        self.fragment_header()
+        self.template_instance(key, body, values)
+        self.u8(0x00)
+        size = self.pos - start + 4
+        self.u32(size)
+        struct.pack_into('<I', self.buf, start + 4, size)
+        return start
+
+    def finish(self, first, last, last_record_offset):
+        struct.pack_into('<8sQQQQIII', self.buf, 0, b'ElfChnk\0', first,
+                         last, first, last, 128, last_record_offset, self.pos)
+        struct.pack_into('<I', self.buf, 52, crc32(self.buf[512:self.pos]))
+        struct.pack_into('<64I', self.buf, 128, *self.string_table)
+        struct.pack_into('<32I', self.buf, 384, *self.template_table)
+        struct.pack_into('<I', self.buf, 124,
+                         crc32(self.buf[:120] + self.buf[128:512]))
+        return self.buf
+
+
+def encode_value(kind, value):
+    if value is None:
+        return b''
+    if kind == STRING:
+        return utf16(value)
+    if kind == UINT8:
+        return struct.pack('<B', value)
+    if kind == UINT16:
+        return struct.pack('<H', value)
+    if kind == UINT32:
+        return struct.pack('<I', value)
+    if kind in (UINT64, HEX64, FILETIME):
+        return struct.pack('<Q', value)
+    if kind == GUID:
+        return guid_bytes(value)
+    if kind == SID:
+        return sid_bytes(value)
+    if kind == BINARY:
+        return value
+    raise ValueError(kind)
+
+
+def system_values(number, provider, guid, source, qualifiers, event_id,
+                  level, keywords):
+    created = BASE_TIME + number * 60 * TICKS_PER_SECOND - TICKS_PER_SECOND
+    return [
+        (STRING, provider),
+        (GUID, guid) if guid else (NULL, None),
+        (STRING, source) if source else (NULL, None),
+        (UINT16, qualifiers) if qualifiers is not None else (NULL, None),
+        (UINT16, event_id),
+        (UINT8, 0),
+        (UINT8, level),
+        (UINT16, 0),
+        (UINT8, 0),
+        (HEX64, keywords),
+        (FILETIME, created),
+        (UINT64, number),
+        (NULL, None),
+        (NULL, None),
+        (UINT32, 500 + number % 7),
+        (UINT32, 4000 + number),
+        (STRING, 'System'),
+        (STRING, 'SAMPLE-PC'),
+        (SID, 'S-1-5-18') if guid else (NULL, None),
+    ]
+
+
+SCM = ('Service Control Manager', '{555908d1-a6d7-4695-8e1e-26931d2012f4}',
+       'Service Control Manager')
+
+
+def make_event(number):
+    if number == 100:
+        values = system_values(number, 'Microsoft-Windows-Eventlog',
+                               '{fc65ddd8-d6ef-4962-83d5-6e5cfe9ce148}', None,
+                               None, 104, 3, 0x8000000000000000)
+        values.append((BINXML, ('LogFileCleared', LOG_CLEARED_TEMPLATE, [
+            (STRING, 'Administrator'),
+            (STRING, 'SAMPLE-PC'),
+            (STRING, 'System'),
+            (STRING, ''),
+        ])))
+        return 'UserData', USER_DATA_TEMPLATE, values
+    if number == 140:
+        values = system_values(number, 'Microsoft-Windows-Kernel-Power',
+                               '{331c3b3a-2005-44c2-ac5e-77220c37d6b4}', None,
+                               None, 41, 1, 0x8000000000000002)
+        values += [(UINT32, 0), (UINT8, 0), (UINT64, 0)]
+        return 'KernelPower', KERNEL_POWER_TEMPLATE, values
+
+    kind = number % 5
+    if kind == 4:
+        values = system_values(number, 'Microsoft-Windows-Kernel-General',
+                               '{a68ca8b7-004f-d7b6-a698-07e2de0f1f5d}', None,
+                               None, 12, 4, 0x8000000000000000)
+        values += [(UINT32, 6), (UINT32, 1), (UINT32, 7601),
+                   (FILETIME, BASE_TIME + number * TICKS_PER_SECOND)]
+        return 'KernelGeneral', KERNEL_GENERAL_TEMPLATE, values
+
+    if kind == 0:
+        values = system_values(number, 'EventLog', None, None, 0x8000, 6013,
+                               4, 0x80000000000000)
+        strings = [str(number), '']
+        data = b''
+    elif kind == 1:
+        values = system_values(number, SCM[0], SCM[1], SCM[2], 0x4000, 7036,
+                               4, 0x8080000000000000)
+        strings = ['Service %d' % number, 'running']
+        data = utf16('Svc%d' % number) + b'/4\0\0'
+    elif kind == 2:
+        values = system_values(number, SCM[0], SCM[1], SCM[2], 0xC000, 7000,
+                               2, 0x8080000000000000)
+        strings = ['Service %d' % number, '%%5']
+        data = b''
+    else:
+        values = system_values(number, 'disk', None, None, 0xC004, 11, 2,
+                               0x80000000000000)
+        strings = ['\\Device\\Harddisk%d\\DR%d' % (number, number), '']
+        data = bytes(range(16))
+    values += [(STRING, strings[0]), (STRING, strings[1]),
+               (BINARY, data) if data else (NULL, None)]
+    return 'Classic', CLASSIC_TEMPLATE, values
+
+
+def write_chunk(first, last):
+    writer = ChunkWriter()
+    last_record = 0
+    for number in range(first, last + 1):
+        key, body, values = make_event(number)
+        written = BASE_TIME + number * 60 * TICKS_PER_SECOND
+        last_record = writer.record(number, written, key, body, values)
+    return writer.finish(first, last, last_record)
+
+
+def main(directory):
+    chunks = [write_chunk(101, 140), write_chunk(1, 100)]
+    header = bytearray(4096)
+    struct.pack_into('<8sQQQIHHHH', header, 0, b'ElfFile\0', 1, 0, 141, 128,
+                     1, 3, 4096, len(chunks))
+    struct.pack_into('<I', header, 124, crc32(header[:120]))
+    with open(os.path.join(directory, 'Sample.evtx'), 'wb') as output:
+        output.write(header)
+        for chunk in chunks:
+            output.write(chunk)
+
+
+if __name__ == '__main__':
+    main(sys.argv[1])
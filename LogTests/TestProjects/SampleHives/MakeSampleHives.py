@@ -0,0 +1,253 @@
+# Copyright © Jacob Snyder, Billy O'Neal III
+# This is under the 2 clause BSD license.
+# See the included LICENSE.TXT file for more details.
+
+"""Writes the sample registry hives in LogTests/TestData.
+
+The hives follow the regf layout Windows uses when saving a key: a checksummed
+base block, 4 KiB aligned hive bins, a shared security cell, hashed subkey
+lists and, for format 1.5, big data values split into segments.
+
+Usage: python MakeSampleHives.py <TestData directory>
+"""
+
+import os
+import struct
+import sys
+
+BLOCK = 4096
+NO_CELL = 0xFFFFFFFF
+FILETIME = 130645440000000000  # 2015-01-01
+
+REG_SZ = 1
+REG_BINARY = 3
+REG_DWORD = 4
+
+
+def is_latin1(name):
+    return all(ord(c) < 0x100 for c in name)
+
+
+def encode_name(name):
+    if is_latin1(name):
+        return name.encode('latin-1'), True
+    return name.encode('utf-16-le'), False
+
+
+def lh_hash(name):
+    result = 0
+    for c in name:
+        result = (result * 37 + ord(c.upper())) & 0xFFFFFFFF
+    return result
+
+
+def lf_hint(name):
+    raw = name.encode('utf-16-le')[:8:2] if not is_latin1(name) else \
+        name.encode('latin-1')[:4]
+    return raw.ljust(4, b'\0')
+
+
+class Key(object):
+    def __init__(self, name):
+        self.name = name
+        self.values = []
+        self.subkeys = []
+
+    def value(self, name, kind, data):
+        self.values.append((name, kind, data))
+        return self
+
+    def subkey(self, name):
+        child = Key(name)
+        self.subkeys.append(child)
+        return child
+
+
+class HiveWriter(object):
+    def __init__(self, minor, leaf, index_leaf, leaf_size):
+        self.minor = minor
+        self.leaf = leaf
+        self.index_leaf = index_leaf
+        self.leaf_size = leaf_size
+        self.bins = bytearray()
+        self.bin_start = 0
+
+    def _new_bin(self, size):
+        self.bin_start = len(self.bins)
+        header = struct.pack('<4sIIQQI', b'hbin', self.bin_start, size, 0,
+                             FILETIME if self.bin_start == 0 else 0, 0)
+        self.bins += header + bytes(size - len(header))
+        self.cursor = self.bin_start + len(header)
+        self.bin_end = self.bin_start + size
+
+    def alloc(self, data):
+        size = (len(data) + 4 + 7) & ~7
+        if not self.bins or self.cursor + size > self.bin_end:
+            if self.bins and self.cursor < self.bin_end:
+                # The rest of the bin becomes a free cell.
+                struct.pack_into('<i', self.bins, self.cursor,
+                                 self.bin_end - self.cursor)
+            self._new_bin(max(BLOCK, (size + 32 + BLOCK - 1) & ~(BLOCK - 1)))
+        cell = self.cursor
+        struct.pack_into('<i', self.bins, cell, -size)
+        self.bins[cell + 4:cell + 4 + len(data)] = data
+        self.cursor += size
+        return cell
+
+    def patch(self, cell, offset, fmt, *values):
+        struct.pack_into(fmt, self.bins, cell + 4 + offset, *values)
+
+    def security(self):
+        everyone = struct.pack('<BB6sI', 1, 1, b'\0\0\0\0\0\1', 0)
+        system = struct.pack('<BB6sI', 1, 1, b'\0\0\0\0\0\5', 18)
+        ace = struct.pack('<BBHI', 0, 3, 8 + len(everyone), 0x000F003F) + \
+            everyone
+        acl = struct.pack('<BBHHH', 2, 0, 8 + len(ace), 1, 0) + ace
+        owner = 20
+        group = owner + len(system)
+        dacl = group + len(system)
+        descriptor = struct.pack('<BBHIIII', 1, 0, 0x8004, owner, group, 0,
+                                 dacl) + system + system + acl
+        return descriptor
+
+    def write_data(self, data):
+        if self.minor >= 4 and len(data) > 16344:
+            segments = [self.alloc(data[idx:idx + 16344])
+                        for idx in range(0, len(data), 16344)]
+            segment_list = self.alloc(struct.pack('<%dI' % len(segments),
+                                                  *segments))
+            return self.alloc(struct.pack('<2sHI', b'db', len(segments),
+                                          segment_list))
+        return self.alloc(data)
+
+    def write_value(self, name, kind, data):
+        raw_name, compressed = encode_name(name)
+        if len(data) <= 4:
+            size = 0x80000000 | len(data)
+            offset = struct.unpack('<I', data.ljust(4, b'\0'))[0]
+        else:
+            size = len(data)
+            offset = self.write_data(data)
+        return self.alloc(struct.pack('<2sHIIIHH', b'vk', len(raw_name), size,
+                                      offset, kind, 1 if compressed else 0,
+                                      0) + raw_name)
+
+    def write_leaf(self, kind, cells, names):
+        if kind == 'li':
+            body = b''.join(struct.pack('<I', cell) for cell in cells)
+        elif kind == 'lf':
+            body = b''.join(struct.pack('<I', cell) + lf_hint(name)
+                            for cell, name in zip(cells, names))
+        else:
+            body = b''.join(struct.pack('<II', cell, lh_hash(name))
+                            for cell, name in zip(cells, names))
+        header = struct.pack('<2sH', kind.encode(), len(cells))
+        return self.alloc(header + body)
+
+    def write_key(self, key, parent, sk, root=False):
+        raw_name, compressed = encode_name(key.name)
+        flags = (0x0C if root else 0) | (0x20 if compressed else 0)
+        cell = self.alloc(struct.pack('<2sHQIIIIIIIIIIIIIIIHH', b'nk', flags,
+                                      FILETIME, 0, parent, 0, 0, NO_CELL,
+                                      NO_CELL, 0, NO_CELL, sk, NO_CELL, 0, 0,
+                                      0, 0, 0, len(raw_name), 0) + raw_name)
+
+        if key.values:
+            cells = [self.write_value(*value) for value in key.values]
+            value_list = self.alloc(struct.pack('<%dI' % len(cells), *cells))
+            self.patch(cell, 36, '<II', len(cells), value_list)
+            self.patch(cell, 60, '<II',
+                       max(len(encode_name(v[0])[0]) for v in key.values),
+                       max(len(v[2]) for v in key.values))
+
+        if key.subkeys:
+            ordered = sorted(key.subkeys, key=lambda k: k.name.upper())
+            cells = [self.write_key(child, cell, sk) for child in ordered]
+            names = [child.name for child in ordered]
+            if len(cells) <= self.leaf_size:
+                subkey_list = self.write_leaf(self.leaf, cells, names)
+            else:
+                leaves = [self.write_leaf(self.index_leaf,
+                                          cells[idx:idx + self.leaf_size],
+                                          names[idx:idx + self.leaf_size])
+                          for idx in range(0, len(cells), self.leaf_size)]
+                subkey_list = self.alloc(
+                    struct.pack('<2sH', b'ri', len(leaves)) +
+                    struct.pack('<%dI' % len(leaves), *leaves))
+            self.patch(cell, 20, '<I', len(cells))
+            self.patch(cell, 28, '<I', subkey_list)
+            self.patch(cell, 52, '<I',
+                       max(len(encode_name(n)[0]) for n in names))
+
+        return cell
+
+    def write(self, path, root, file_name):
+        descriptor = self.security()
+        sk = self.alloc(struct.pack('<2sHIIII', b'sk', 0, 0, 0, 0,
+                                    len(descriptor)) + descriptor)
+        self.patch(sk, 4, '<II', sk, sk)
+        root_cell = self.write_key(root, NO_CELL, sk, root=True)
+        self.patch(sk, 12, '<I', count_keys(root))
+        if self.cursor < self.bin_end:
+            struct.pack_into('<i', self.bins, self.cursor,
+                             self.bin_end - self.cursor)
+
+        base = bytearray(BLOCK)
+        struct.pack_into('<4sIIQIIIIIII', base, 0, b'regf', 1, 1, FILETIME, 1,
+                         self.minor, 0, 1, root_cell, len(self.bins), 1)
+        raw_file_name = file_name.encode('utf-16-le')[:64]
+        base[48:48 + len(raw_file_name)] = raw_file_name
+        checksum = 0
+        for idx in range(127):
+            checksum ^= struct.unpack_from('<I', base, idx * 4)[0]
+        if checksum == 0:
+            checksum = 1
+        elif checksum == 0xFFFFFFFF:
+            checksum = 0xFFFFFFFE
+        struct.pack_into('<I', base, 508, checksum)
+
+        with open(path, 'wb') as output:
+            output.write(base + self.bins)
+
+
+def count_keys(key):
+    return 1 + sum(count_keys(child) for child in key.subkeys)
+
+
+def big_data(length):
+    return bytes((idx * 7) & 0xFF for idx in range(length))
+
+
+def sample_root(name):
+    root = Key(name)
+    root.value('', REG_SZ, 'Default\0'.encode('utf-16-le'))
+    root.value('Answer', REG_DWORD, struct.pack('<I', 42))
+    root.value('Big', REG_BINARY, big_data(20000))
+    root.value('Empty', REG_BINARY, b'')
+    root.value('Greeting', REG_SZ, 'Hello\0'.encode('utf-16-le'))
+    # Not Latin-1, so the name is stored as UTF-16.
+    root.value(u'Δelta', REG_DWORD, struct.pack('<I', 4))
+    keys = root.subkey('Keys')
+    for idx in range(120):
+        keys.subkey('Key%03d' % idx).value('Index', REG_DWORD,
+                                           struct.pack('<I', idx))
+    root.subkey(u'Ключ').value('Value', REG_SZ,
+                               u'Значение\0'.encode('utf-16-le'))
+    return root
+
+
+def main(directory):
+    # Format 1.5, as current Windows writes: hashed leaves, also under an
+    # index root, and big data split into segments.
+    HiveWriter(5, 'lh', 'lh', 50).write(
+        os.path.join(directory, 'Sample.hiv'), sample_root('Sample'),
+        'Sample.hiv')
+    # Format 1.3: name hint leaves, plain leaves under an index root, and
+    # big data in a single cell.
+    HiveWriter(3, 'lf', 'li', 50).write(
+        os.path.join(directory, 'SampleV13.hiv'), sample_root('SampleV13'),
+        'SampleV13.hiv')
+
+
+if __name__ == '__main__':
+    main(sys.argv[1])
@@ -0,0 +1,116 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+// Tests of VersionResource which read images from disk, and so depend on
+// Windows; VersionResourceTest.cpp holds the portable ones.
+
+#include "../LogCommon/VersionResource.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "gtest/gtest.h"
+#include "../LogCommon/File.hpp"
+#include "TestSupport.hpp"
+
+#pragma comment(lib, "Version.lib")
+
+using Instalog::expected;
+using namespace Instalog::SystemFacades;
+
+static std::vector<unsigned char> ReadTestFile(std::string const& name)
+{
+    std::ifstream file(GetTestFilePath(name), std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+                                      std::istreambuf_iterator<char>());
+}
+
+TEST(VersionResource, ReadsTestApplication)
+{
+    std::vector<unsigned char> image(ReadTestFile("TestVerInfoApp.exe"));
+    VersionResource version(image.data(), image.data() + image.size());
+    ASSERT_TRUE(version.HasVersionInfo());
+    EXPECT_EQ(0x040904B0u, version.GetTranslation());
+    EXPECT_EQ("Expected Company Name", version.GetCompanyName().get().ToUtf8());
+    EXPECT_EQ("Testing Resources Product",
+              version.GetProductName().get().ToUtf8());
+    EXPECT_EQ("Expected Description",
+              version.GetFileDescription().get().ToUtf8());
+    EXPECT_EQ("1.5.6.1", version.GetString("fileversion").get().ToUtf8());
+    EXPECT_FALSE(version.GetString("Comments").is_valid());
+}
+
+TEST(VersionResource, TruncatedImagesAreRejected)
+{
+    std::vector<unsigned char> const image(ReadTestFile("TestVerInfoApp.exe"));
+    for (std::size_t size = 0; size < image.size(); size += 7)
+    {
+        std::vector<unsigned char> truncated(image.begin(),
+                                             image.begin() + size);
+        VersionResource version(truncated.data(),
+                                truncated.data() + truncated.size());
+        auto const company = version.GetCompanyName();
+        if (company.is_valid())
+        {
+            EXPECT_EQ("Expected Company Name", company.get().ToUtf8());
+        }
+    }
+}
+
+TEST(VersionResource, DISABLED_BenchmarkAgainstGetFileVersionInfo)
+{
+    char const* const files[] = {"C:\\Windows\\explorer.exe",
+                                 "C:\\Windows\\System32\\kernel32.dll",
+                                 "C:\\Windows\\System32\\ntdll.dll",
+                                 "C:\\Windows\\System32\\shell32.dll",
+                                 "C:\\Windows\\System32\\svchost.exe"};
+    std::size_t const iterations = 200;
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t parsed = 0;
+    for (std::size_t idx = 0; idx < iterations; ++idx)
+    {
+        for (char const* file : files)
+        {
+            parsed += File::GetCompany(file).size();
+        }
+    }
+    auto parserDone = std::chrono::steady_clock::now();
+
+    std::size_t queried = 0;
+    for (std::size_t idx = 0; idx < iterations; ++idx)
+    {
+        for (char const* file : files)
+        {
+            std::wstring const name(utf8::ToUtf16(file));
+            DWORD const size = ::GetFileVersionInfoSizeW(name.c_str(), nullptr);
+            std::vector<unsigned char> block(size);
+            ::GetFileVersionInfoW(name.c_str(), 0, size, block.data());
+            void* company;
+            UINT length;
+            if (::VerQueryValueW(block.data(),
+                                 L"\\StringFileInfo\\040904B0\\CompanyName",
+                                 &company,
+                                 &length) != 0 &&
+                length != 0)
+            {
+                queried += utf8::ToUtf8(static_cast<wchar_t*>(company),
+                                        length - 1).size();
+            }
+        }
+    }
+    auto win32Done = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(queried, parsed);
+    std::cout << "VersionResource: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     parserDone - start).count()
+              << " ms, GetFileVersionInfo: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     win32Done - parserDone).count()
+              << " ms" << std::endl;
+}
@@ -0,0 +1,231 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/VersionResource.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+using Instalog::expected;
+using namespace Instalog::SystemFacades;
+
+static void Append16(std::vector<unsigned char>& target, std::uint16_t value)
+{
+    target.push_back(static_cast<unsigned char>(value & 0xFF));
+    target.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void Append32(std::vector<unsigned char>& target, std::uint32_t value)
+{
+    Append16(target, static_cast<std::uint16_t>(value & 0xFFFF));
+    Append16(target, static_cast<std::uint16_t>(value >> 16));
+}
+
+static void Align32(std::vector<unsigned char>& target)
+{
+    while (target.size() % 4 != 0)
+    {
+        target.push_back(0);
+    }
+}
+
+// Builds one block of a version resource.
+static std::vector<unsigned char>
+VersionBlock(std::wstring const& key,
+             std::vector<unsigned char> const& value,
+             bool isText,
+             std::vector<std::vector<unsigned char>> const& children)
+{
+    std::vector<unsigned char> block(6);
+    for (wchar_t ch : key)
+    {
+        Append16(block, static_cast<std::uint16_t>(ch));
+    }
+
+    Append16(block, 0);
+    Align32(block);
+    block.insert(block.end(), value.begin(), value.end());
+    for (auto const& child : children)
+    {
+        Align32(block);
+        block.insert(block.end(), child.begin(), child.end());
+    }
+
+    std::uint16_t const length = static_cast<std::uint16_t>(block.size());
+    std::uint16_t const valueLength =
+        static_cast<std::uint16_t>(isText ? value.size() / 2 : value.size());
+    std::memcpy(&block[0], &length, 2);
+    std::memcpy(&block[2], &valueLength, 2);
+    block[4] = isText ? 1 : 0;
+    return block;
+}
+
+static std::vector<unsigned char> VersionString(std::wstring const& name,
+                                                std::wstring const& text)
+{
+    std::vector<unsigned char> value;
+    for (wchar_t ch : text)
+    {
+        Append16(value, static_cast<std::uint16_t>(ch));
+    }
+
+    Append16(value, 0);
+    return VersionBlock(name, value, true, {});
+}
+
+static std::vector<unsigned char>
+StringTable(std::wstring const& translation, std::wstring const& company)
+{
+    return VersionBlock(
+        translation, {}, true, {VersionString(L"CompanyName", company)});
+}
+
+static std::vector<unsigned char>
+VersionInfo(std::vector<std::vector<unsigned char>> const& tables,
+            std::vector<std::uint32_t> const& translations)
+{
+    std::vector<std::vector<unsigned char>> children;
+    children.push_back(VersionBlock(L"StringFileInfo", {}, true, tables));
+    if (!translations.empty())
+    {
+        std::vector<unsigned char> value;
+        for (std::uint32_t translation : translations)
+        {
+            Append16(value, static_cast<std::uint16_t>(translation >> 16));
+            Append16(value, static_cast<std::uint16_t>(translation & 0xFFFF));
+        }
+
+        children.push_back(VersionBlock(
+            L"VarFileInfo",
+            {},
+            true,
+            {VersionBlock(L"Translation", value, false, {})}));
+    }
+
+    return VersionBlock(
+        L"VS_VERSION_INFO", std::vector<unsigned char>(52), false, children);
+}
+
+// Builds a PE32 image with a single .rsrc section holding one RT_VERSION
+// resource.
+static std::vector<unsigned char>
+PeImage(std::vector<unsigned char> const& versionInfo)
+{
+    std::uint32_t const sectionRva = 0x1000;
+    std::uint32_t const sectionOffset = 0x200;
+
+    std::vector<unsigned char> resources;
+    // Type directory, with RT_VERSION.
+    resources.resize(12);
+    Append16(resources, 0);
+    Append16(resources, 1);
+    Append32(resources, 16);
+    Append32(resources, 0x80000000 | 0x18);
+    // Name directory, with ID 1.
+    resources.resize(0x18 + 12);
+    Append16(resources, 0);
+    Append16(resources, 1);
+    Append32(resources, 1);
+    Append32(resources, 0x80000000 | 0x30);
+    // Language directory, with US English.
+    resources.resize(0x30 + 12);
+    Append16(resources, 0);
+    Append16(resources, 1);
+    Append32(resources, 0x409);
+    Append32(resources, 0x48);
+    // Data entry.
+    Append32(resources, sectionRva + 0x58);
+    Append32(resources, static_cast<std::uint32_t>(versionInfo.size()));
+    resources.resize(0x58);
+    resources.insert(resources.end(), versionInfo.begin(), versionInfo.end());
+    Align32(resources);
+
+    std::vector<unsigned char> image;
+    image.push_back('M');
+    image.push_back('Z');
+    image.resize(0x3C);
+    Append32(image, 0x40);
+    Append32(image, 0x00004550);
+    // File header.
+    Append16(image, 0x14C);
+    Append16(image, 1);
+    image.resize(image.size() + 12);
+    Append16(image, 224);
+    Append16(image, 0x102);
+    // Optional header.
+    std::size_t const optional = image.size();
+    Append16(image, 0x10B);
+    image.resize(optional + 92);
+    Append32(image, 16);
+    image.resize(optional + 96 + 2 * 8);
+    Append32(image, sectionRva);
+    Append32(image, static_cast<std::uint32_t>(resources.size()));
+    image.resize(optional + 224);
+    // Section header.
+    char const name[8] = ".rsrc";
+    image.insert(image.end(), name, name + 8);
+    Append32(image, static_cast<std::uint32_t>(resources.size()));
+    Append32(image, sectionRva);
+    Append32(image, static_cast<std::uint32_t>(resources.size()));
+    Append32(image, sectionOffset);
+    image.resize(sectionOffset);
+    image.insert(image.end(), resources.begin(), resources.end());
+    return image;
+}
+
+static std::string CompanyOf(std::vector<unsigned char> const& image)
+{
+    VersionResource version(image.data(), image.data() + image.size());
+    expected<Utf16View> company = version.GetCompanyName();
+    return company.is_valid() ? company.get().ToUtf8() : "<none>";
+}
+
+TEST(VersionResource, PrefersTranslationTable)
+{
+    std::vector<unsigned char> image(
+        PeImage(VersionInfo({StringTable(L"040904B0", L"English"),
+                             StringTable(L"040704b0", L"Deutsch")},
+                            {0x040704B0, 0x040904B0})));
+    EXPECT_EQ("Deutsch", CompanyOf(image));
+}
+
+TEST(VersionResource, FallsBackToUsEnglish)
+{
+    std::vector<unsigned char> image(
+        PeImage(VersionInfo({StringTable(L"041104B0", L"Japanese"),
+                             StringTable(L"040904E4", L"English")},
+                            {0x040C04B0})));
+    VersionResource version(image.data(), image.data() + image.size());
+    EXPECT_EQ(0x040904E4u, version.GetTranslation());
+    EXPECT_EQ("English", CompanyOf(image));
+}
+
+TEST(VersionResource, FallsBackToFirstTable)
+{
+    std::vector<unsigned char> image(PeImage(VersionInfo(
+        {StringTable(L"041104B0", L"Japanese"),
+         StringTable(L"040C04B0", L"French")},
+        {})));
+    EXPECT_EQ("Japanese", CompanyOf(image));
+}
+
+TEST(VersionResource, ReplacesUnpairedSurrogates)
+{
+    std::vector<unsigned char> image(PeImage(VersionInfo(
+        {StringTable(L"040904B0", std::wstring(L"A") + wchar_t(0xD800) + L"B")},
+        {})));
+    EXPECT_EQ("A\xEF\xBF\xBD" "B", CompanyOf(image));
+}
+
+TEST(VersionResource, NotAnImage)
+{
+    std::string const text("MZ, but not really an image at all.");
+    VersionResource version(
+        reinterpret_cast<unsigned char const*>(text.data()),
+        reinterpret_cast<unsigned char const*>(text.data()) + text.size());
+    EXPECT_FALSE(version.HasVersionInfo());
+    EXPECT_FALSE(version.GetCompanyName().is_valid());
+}
@@ -0,0 +1,557 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include "../LogCommon/Whitelist.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/WhitelistCompiler.hpp"
+#include "../ThirdParty/sqlite-amalgamation/sqlite3.h"
+
+using namespace Instalog;
+
+// A compiled whitelist together with the table which refers into it.
+struct TestWhitelist
+{
+    CompiledWhitelist compiled;
+    std::vector<WhitelistEntry> entries;
+    WhitelistTable table;
+
+    explicit TestWhitelist(std::vector<WhitelistFile> const& files)
+        : compiled(CompileWhitelist(files)), entries(compiled.GetEntries())
+    {
+        table.seed = compiled.seed;
+        table.displacements = compiled.displacements.data();
+        table.bucketCount = compiled.displacements.size();
+        table.entries = entries.data();
+        table.entryCount = entries.size();
+    }
+};
+
+static std::vector<WhitelistFile> GeneratePaths(std::size_t count)
+{
+    std::vector<WhitelistFile> files;
+    for (std::size_t idx = 0; idx < count; ++idx)
+    {
+        WhitelistFile file;
+        file.path = "%PROGRAMFILES%\\VENDOR" + std::to_string(idx % 97) +
+                    "\\PRODUCT\\FILE" + std::to_string(idx) + ".DLL";
+        file.level = static_cast<int>(idx % 5);
+        files.push_back(file);
+    }
+
+    return files;
+}
+
+// Matches a pattern the slow way, for checking the automaton.
+static bool NaiveMatch(char const* pattern, char const* text)
+{
+    if (*pattern == '\0')
+    {
+        return *text == '\0';
+    }
+
+    if (*pattern == '*')
+    {
+        return NaiveMatch(pattern + 1, text) ||
+               (*text != '\0' && NaiveMatch(pattern, text + 1));
+    }
+
+    return *text != '\0' && (*pattern == '?' || *pattern == *text) &&
+           NaiveMatch(pattern + 1, text + 1);
+}
+
+static expected<int> MatchPatterns(std::vector<WhitelistPattern> const& patterns,
+                                   std::string const& text)
+{
+    return MatchWhitelistPatterns(CompileWhitelistPatterns(patterns).GetTable(),
+                                  text);
+}
+
+static WhitelistPattern MakePattern(std::string const& pattern, int level)
+{
+    WhitelistPattern result;
+    result.pattern = pattern;
+    result.level = level;
+    return result;
+}
+
+TEST(Whitelist, ParsesSql)
+{
+    WhitelistSql const tables(ParseWhitelistSql(
+        "-- Comment\n"
+        "CREATE TABLE Files (\n"
+        "    Path STRING NOT NULL PRIMARY KEY, -- The path; see above.\n"
+        "    WhitelistLevel INTEGER NOT NULL\n"
+        ") WITHOUT ROWID;\n"
+        "/* Block\n comment */\n"
+        "insert into FILES (Path, WhitelistLevel) values\n"
+        "    ('%WINDIR%\\EXPLORER.EXE', 5),\n"
+        "    (\"%WINDIR%\\IT'S \"\"QUOTED\"\"\", 0);\n"
+        "INSERT INTO Files (WhitelistLevel, Path) VALUES (3, 'C:\\IT''S');\n"
+        "INSERT INTO Patterns (Pattern, WhitelistLevel) VALUES\n"
+        "    ('%WINDIR%\\WINSXS\\*', 4), ('C:\\IT''S', 1);\n"));
+    std::vector<WhitelistFile> const& files = tables.files;
+    ASSERT_EQ(3u, files.size());
+    EXPECT_EQ("%WINDIR%\\EXPLORER.EXE", files[0].path);
+    EXPECT_EQ(5, files[0].level);
+    EXPECT_EQ("%WINDIR%\\IT'S \"QUOTED\"", files[1].path);
+    EXPECT_EQ(0, files[1].level);
+    EXPECT_EQ("C:\\IT'S", files[2].path);
+    EXPECT_EQ(3, files[2].level);
+    ASSERT_EQ(2u, tables.patterns.size());
+    EXPECT_EQ("%WINDIR%\\WINSXS\\*", tables.patterns[0].pattern);
+    EXPECT_EQ(4, tables.patterns[0].level);
+    EXPECT_EQ("C:\\IT'S", tables.patterns[1].pattern);
+    EXPECT_EQ(1, tables.patterns[1].level);
+}
+
+TEST(Whitelist, ParseErrors)
+{
+    char const* const invalid[] = {
+        "INSERT INTO Registry (Path, WhitelistLevel) VALUES ('A', 1);",
+        "INSERT INTO Files (Path) VALUES ('A');",
+        "INSERT INTO Files (Path, Level) VALUES ('A', 1);",
+        "INSERT INTO Files (Path, WhitelistLevel) VALUES ('A', -1);",
+        "INSERT INTO Files (Path, WhitelistLevel) VALUES (1, 1);",
+        "INSERT INTO Files (Path, WhitelistLevel) VALUES ('A, 1);",
+        "INSERT INTO Files (Path, WhitelistLevel) VALUES ('A', 1) 'B';",
+        "INSERT INTO Patterns (Path, WhitelistLevel) VALUES ('A', 1);",
+        "INSERT INTO Patterns (Pattern, WhitelistLevel) VALUES ('', 1);",
+        "INSERT INTO Files (Path, WhitelistLevel) VALUES ('%WINDIR%\\a', 1);",
+        "INSERT INTO Patterns (Pattern, WhitelistLevel) VALUES ('*.exe', 1);",
+        "DELETE FROM Files;",
+        "/* Unterminated"};
+    for (char const* sql : invalid)
+    {
+        EXPECT_THROW(ParseWhitelistSql(sql), WhitelistParseException) << sql;
+    }
+
+    try
+    {
+        ParseWhitelistSql("INSERT INTO Files (Path, WhitelistLevel)\n"
+                          "VALUES ('A', 1), ('B', 2),\n"
+                          "('A', 3);");
+        FAIL() << "Duplicate paths were accepted";
+    }
+    catch (WhitelistParseException const& ex)
+    {
+        EXPECT_STREQ("Line 3: Duplicate path A", ex.what());
+    }
+
+    try
+    {
+        ParseWhitelistSql("INSERT INTO Patterns (Pattern, WhitelistLevel)\n"
+                          "VALUES ('A*', 1), ('A*', 2);");
+        FAIL() << "Duplicate patterns were accepted";
+    }
+    catch (WhitelistParseException const& ex)
+    {
+        EXPECT_STREQ("Line 2: Duplicate pattern A*", ex.what());
+    }
+
+    try
+    {
+        ParseWhitelistSql("INSERT INTO Files (Path, WhitelistLevel)\n"
+                          "VALUES ('A', 1),\n"
+                          "('%WINDIR%\\Explorer.exe', 2);");
+        FAIL() << "A lower case path was accepted";
+    }
+    catch (WhitelistParseException const& ex)
+    {
+        EXPECT_STREQ("Line 3: Path must be upper case: %WINDIR%\\Explorer.exe",
+                     ex.what());
+    }
+}
+
+TEST(Whitelist, FindsEveryPath)
+{
+    std::vector<WhitelistFile> const files(GeneratePaths(10000));
+    TestWhitelist const whitelist(files);
+    for (WhitelistFile const& file : files)
+    {
+        expected<int> const level = GetWhitelistLevel(whitelist.table, file.path);
+        ASSERT_TRUE(level.is_valid()) << file.path;
+        EXPECT_EQ(file.level, level.get());
+    }
+
+    EXPECT_FALSE(GetWhitelistLevel(whitelist.table, "").is_valid());
+    EXPECT_FALSE(GetWhitelistLevel(whitelist.table, "%PROGRAMFILES%").is_valid());
+    EXPECT_FALSE(
+        GetWhitelistLevel(whitelist.table, files[0].path + "X").is_valid());
+    EXPECT_FALSE(GetWhitelistLevel(whitelist.table,
+                                   files[0].path.substr(1)).is_valid());
+}
+
+TEST(Whitelist, EmptyWhitelist)
+{
+    TestWhitelist const whitelist(std::vector<WhitelistFile>{});
+    EXPECT_FALSE(GetWhitelistLevel(whitelist.table, "").is_valid());
+    EXPECT_FALSE(GetWhitelistLevel(whitelist.table, "A").is_valid());
+}
+
+TEST(Whitelist, DuplicatePathsAreRejected)
+{
+    std::vector<WhitelistFile> files(GeneratePaths(2));
+    files[1].path = files[0].path;
+    EXPECT_THROW(CompileWhitelist(files), std::invalid_argument);
+}
+
+TEST(Whitelist, WritesSource)
+{
+    WhitelistFile file;
+    file.path = "C:\\\"A\"?\xC3\xA9";
+    file.level = 2;
+    std::ostringstream source;
+    WriteWhitelistSource(
+        source,
+        CompileWhitelist(std::vector<WhitelistFile>(1, file)),
+        CompileWhitelistPatterns(
+            std::vector<WhitelistPattern>(1, MakePattern("A*", 3))));
+    std::string const text(source.str());
+    EXPECT_NE(std::string::npos,
+              text.find("{\"C:\\\\\\\"A\\\"\\077\\303\\251\", 9, 2},"));
+    EXPECT_NE(std::string::npos, text.find("{nullptr, 0, -1},"));
+    EXPECT_NE(std::string::npos,
+              text.find("extern WhitelistTable const fileWhitelist = {"));
+    // The dead state, the start state, the state after 'A', and the state
+    // after any more characters.
+    EXPECT_NE(std::string::npos,
+              text.find("patternWhitelistLevels[] = {\n    -1, -1, 3, 3,\n};"));
+    EXPECT_NE(std::string::npos,
+              text.find("extern PatternWhitelistTable const patternWhitelist = {"));
+}
+
+TEST(Whitelist, FileWhitelistIsCompiledIn)
+{
+    expected<int> const explorer =
+        GetWhitelistLevel(fileWhitelist, "%WINDIR%\\EXPLORER.EXE");
+    ASSERT_TRUE(explorer.is_valid());
+    EXPECT_EQ(5, explorer.get());
+    EXPECT_FALSE(
+        GetWhitelistLevel(fileWhitelist, "%WINDIR%\\\\EXPLORER.EXE").is_valid());
+}
+
+TEST(Whitelist, PatternsMatchWholeStrings)
+{
+    std::vector<WhitelistPattern> patterns;
+    patterns.push_back(MakePattern("%WINDIR%\\WINSXS\\*", 4));
+    patterns.push_back(MakePattern("%WINDIR%\\SYSTEM32\\DRIVERS\\????.SYS", 2));
+    patterns.push_back(MakePattern("%PROGRAMFILES%\\*\\UNINSTALL.EXE", 1));
+    patterns.push_back(MakePattern(
+        "HKLM\\SOFTWARE\\MICROSOFT\\WINDOWS\\CURRENTVERSION\\RUN: [*] "
+        "%WINDIR%\\*",
+        3));
+    patterns.push_back(MakePattern("%WINDIR%\\EXPLORER.EXE", 0));
+
+    EXPECT_EQ(4, MatchPatterns(patterns, "%WINDIR%\\WINSXS\\").get());
+    EXPECT_EQ(4, MatchPatterns(patterns, "%WINDIR%\\WINSXS\\X86\\A.DLL").get());
+    EXPECT_FALSE(MatchPatterns(patterns, "%WINDIR%\\WINSXS").is_valid());
+    EXPECT_EQ(2,
+              MatchPatterns(patterns, "%WINDIR%\\SYSTEM32\\DRIVERS\\NTFS.SYS")
+                  .get());
+    EXPECT_FALSE(
+        MatchPatterns(patterns, "%WINDIR%\\SYSTEM32\\DRIVERS\\NDIS2.SYS")
+            .is_valid());
+    EXPECT_EQ(1,
+              MatchPatterns(patterns,
+                            "%PROGRAMFILES%\\VENDOR\\APP\\UNINSTALL.EXE")
+                  .get());
+    EXPECT_FALSE(
+        MatchPatterns(patterns, "%PROGRAMFILES%\\UNINSTALL.EXE").is_valid());
+    EXPECT_FALSE(
+        MatchPatterns(patterns, "%PROGRAMFILES%\\A\\UNINSTALL.EXE.MUI")
+            .is_valid());
+    EXPECT_EQ(3,
+              MatchPatterns(patterns,
+                            "HKLM\\SOFTWARE\\MICROSOFT\\WINDOWS\\"
+                            "CURRENTVERSION\\RUN: [Tray] %WINDIR%\\TRAY.EXE")
+                  .get());
+    EXPECT_EQ(0, MatchPatterns(patterns, "%WINDIR%\\EXPLORER.EXE").get());
+    EXPECT_FALSE(MatchPatterns(patterns, "%WINDIR%\\EXPLORER.EX").is_valid());
+    EXPECT_FALSE(MatchPatterns(patterns, "").is_valid());
+}
+
+TEST(Whitelist, MostSpecificPatternWins)
+{
+    std::vector<WhitelistPattern> patterns;
+    patterns.push_back(MakePattern("%WINDIR%\\*", 4));
+    patterns.push_back(MakePattern("%WINDIR%\\TEMP\\*", 0));
+    patterns.push_back(MakePattern("*.EXE", 2));
+    patterns.push_back(MakePattern("%WINDIR%\\*.???", 3));
+    patterns.push_back(MakePattern("%WINDIR%\\?.INI", 2));
+    patterns.push_back(MakePattern("%WINDIR%\\A*INI", 1));
+
+    EXPECT_EQ(4, MatchPatterns(patterns, "%WINDIR%\\README").get());
+    EXPECT_EQ(3, MatchPatterns(patterns, "%WINDIR%\\A.EXE").get());
+    EXPECT_EQ(0, MatchPatterns(patterns, "%WINDIR%\\TEMP\\A.EXE").get());
+    EXPECT_EQ(2, MatchPatterns(patterns, "C:\\A.EXE").get());
+    EXPECT_EQ(2, MatchPatterns(patterns, "%WINDIR%\\B.INI").get());
+    // Ties on literal characters go to the lowest level.
+    EXPECT_EQ(1, MatchPatterns(patterns, "%WINDIR%\\A.INI").get());
+}
+
+TEST(Whitelist, RepeatedStarsAreOneStar)
+{
+    std::vector<WhitelistPattern> patterns;
+    patterns.push_back(MakePattern("A**B", 2));
+    patterns.push_back(MakePattern("A*B", 1));
+    EXPECT_EQ(1, MatchPatterns(patterns, "AB").get());
+    EXPECT_EQ(1, MatchPatterns(patterns, "AXXB").get());
+}
+
+TEST(Whitelist, EmptyPatterns)
+{
+    std::vector<WhitelistPattern> const patterns;
+    EXPECT_FALSE(MatchPatterns(patterns, "").is_valid());
+    EXPECT_FALSE(MatchPatterns(patterns, "A").is_valid());
+}
+
+TEST(Whitelist, DuplicatePatternsAreRejected)
+{
+    std::vector<WhitelistPattern> patterns;
+    patterns.push_back(MakePattern("A*", 1));
+    patterns.push_back(MakePattern("A*", 2));
+    EXPECT_THROW(CompileWhitelistPatterns(patterns), std::invalid_argument);
+}
+
+TEST(Whitelist, PatternsAgreeWithNaiveMatching)
+{
+    std::mt19937 random(42);
+    char const alphabet[] = "AB\\*?";
+    for (int round = 0; round < 200; ++round)
+    {
+        std::vector<WhitelistPattern> patterns;
+        std::size_t const patternCount = random() % 6;
+        for (std::size_t idx = 0; idx < patternCount; ++idx)
+        {
+            std::string pattern;
+            std::size_t const length = 1 + random() % 6;
+            for (std::size_t ch = 0; ch < length; ++ch)
+            {
+                pattern.push_back(alphabet[random() % 5]);
+            }
+
+            // The level records which pattern matched.
+            patterns.push_back(MakePattern(pattern, static_cast<int>(idx)));
+        }
+
+        for (std::size_t idx = 0; idx < patterns.size(); ++idx)
+        {
+            for (std::size_t other = 0; other < idx; ++other)
+            {
+                if (patterns[idx].pattern == patterns[other].pattern)
+                {
+                    patterns.erase(patterns.begin() + idx--);
+                    break;
+                }
+            }
+        }
+
+        CompiledPatternWhitelist const compiled(
+            CompileWhitelistPatterns(patterns));
+        for (int query = 0; query < 50; ++query)
+        {
+            std::string text;
+            std::size_t const length = random() % 8;
+            for (std::size_t ch = 0; ch < length; ++ch)
+            {
+                text.push_back("AB\\C"[random() % 4]);
+            }
+
+            int expectedLevel = -1;
+            std::size_t expectedLiterals = 0;
+            for (WhitelistPattern const& pattern : patterns)
+            {
+                if (!NaiveMatch(pattern.pattern.c_str(), text.c_str()))
+                {
+                    continue;
+                }
+
+                std::size_t const literals =
+                    pattern.pattern.size() -
+                    std::count(pattern.pattern.begin(), pattern.pattern.end(), '*') -
+                    std::count(pattern.pattern.begin(), pattern.pattern.end(), '?');
+                if (expectedLevel < 0 || literals > expectedLiterals ||
+                    (literals == expectedLiterals && pattern.level < expectedLevel))
+                {
+                    expectedLevel = pattern.level;
+                    expectedLiterals = literals;
+                }
+            }
+
+            expected<int> const level =
+                MatchWhitelistPatterns(compiled.GetTable(), text);
+            EXPECT_EQ(expectedLevel, level.is_valid() ? level.get() : -1) << text;
+        }
+    }
+}
+
+TEST(Whitelist, PatternWhitelistIsCompiledIn)
+{
+    expected<int> const winsxs =
+        GetWhitelistLevel("%WINDIR%\\WINSXS\\X86_MICROSOFT.VC90.CRT\\MSVCR90.DLL");
+    ASSERT_TRUE(winsxs.is_valid());
+    EXPECT_EQ(5, winsxs.get());
+    EXPECT_EQ(5, GetWhitelistLevel("%WINDIR%\\EXPLORER.EXE").get());
+    EXPECT_FALSE(GetWhitelistLevel("%WINDIR%\\NOTEPAD.EXE").is_valid());
+}
+
+TEST(Whitelist, DISABLED_BenchmarkPatterns)
+{
+    std::vector<WhitelistPattern> patterns;
+    for (int idx = 0; idx < 500; ++idx)
+    {
+        std::string const vendor = "%PROGRAMFILES%\\VENDOR" + std::to_string(idx);
+        patterns.push_back(MakePattern(vendor + "\\*", idx % 5));
+        patterns.push_back(MakePattern(vendor + "\\BIN\\*.EXE", idx % 3));
+    }
+
+    CompiledPatternWhitelist const compiled(CompileWhitelistPatterns(patterns));
+    PatternWhitelistTable const table(compiled.GetTable());
+
+    std::vector<std::string> queries;
+    for (int idx = 0; idx < 1000; ++idx)
+    {
+        queries.push_back("%PROGRAMFILES%\\VENDOR" + std::to_string(idx * 7 % 1000) +
+                          "\\BIN\\TOOL.EXE");
+    }
+
+    std::size_t const lookups = 200000;
+    auto start = std::chrono::steady_clock::now();
+    int automatonTotal = 0;
+    for (std::size_t idx = 0; idx < lookups; ++idx)
+    {
+        expected<int> const level =
+            MatchWhitelistPatterns(table, queries[idx % queries.size()]);
+        automatonTotal += level.is_valid() ? level.get() + 1 : 0;
+    }
+    auto automatonDone = std::chrono::steady_clock::now();
+
+    std::size_t const naiveLookups = lookups / 100;
+    int naiveMatches = 0;
+    for (std::size_t idx = 0; idx < naiveLookups; ++idx)
+    {
+        std::string const& query = queries[idx % queries.size()];
+        for (WhitelistPattern const& pattern : patterns)
+        {
+            naiveMatches += NaiveMatch(pattern.pattern.c_str(), query.c_str());
+        }
+    }
+    auto naiveDone = std::chrono::steady_clock::now();
+
+    EXPECT_NE(0, automatonTotal);
+    EXPECT_NE(0, naiveMatches);
+
+    auto perSecond = [&](std::size_t count,
+                         std::chrono::steady_clock::duration elapsed)
+    {
+        return static_cast<double>(count) /
+               std::chrono::duration<double>(elapsed).count();
+    };
+    std::cout << compiled.levels.size() << " states, "
+              << compiled.classCount << " classes. Automaton: "
+              << perSecond(lookups, automatonDone - start)
+              << " lookups/s, pattern by pattern: "
+              << perSecond(naiveLookups, naiveDone - automatonDone)
+              << " lookups/s" << std::endl;
+}
+
+TEST(Whitelist, DISABLED_BenchmarkAgainstSqlite)
+{
+    std::vector<WhitelistFile> const files(GeneratePaths(100000));
+    TestWhitelist const whitelist(files);
+    std::size_t const lookups = 1000000;
+
+    sqlite3* db;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(":memory:", &db));
+    ASSERT_EQ(SQLITE_OK,
+              sqlite3_exec(db,
+                           "CREATE TABLE Files (Path STRING NOT NULL PRIMARY "
+                           "KEY, WhitelistLevel INTEGER NOT NULL) WITHOUT "
+                           "ROWID; BEGIN;",
+                           nullptr,
+                           nullptr,
+                           nullptr));
+    sqlite3_stmt* insert;
+    sqlite3_prepare_v2(db,
+                       "INSERT INTO Files (Path, WhitelistLevel) VALUES (?, ?)",
+                       -1,
+                       &insert,
+                       nullptr);
+    for (WhitelistFile const& file : files)
+    {
+        sqlite3_bind_text(insert,
+                          1,
+                          file.path.data(),
+                          static_cast<int>(file.path.size()),
+                          SQLITE_STATIC);
+        sqlite3_bind_int(insert, 2, file.level);
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+    }
+
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_stmt* select;
+    sqlite3_prepare_v2(db,
+                       "SELECT WhitelistLevel FROM Files WHERE Path = ?",
+                       -1,
+                       &select,
+                       nullptr);
+
+    // Every other lookup misses.
+    std::vector<std::string> queries;
+    for (std::size_t idx = 0; idx < 1000; ++idx)
+    {
+        queries.push_back(files[idx * 97 % files.size()].path);
+        queries.push_back(queries.back() + ".MUI");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int tableTotal = 0;
+    for (std::size_t idx = 0; idx < lookups; ++idx)
+    {
+        expected<int> const level =
+            GetWhitelistLevel(whitelist.table, queries[idx % queries.size()]);
+        tableTotal += level.is_valid() ? level.get() + 1 : 0;
+    }
+    auto tableDone = std::chrono::steady_clock::now();
+
+    int sqliteTotal = 0;
+    for (std::size_t idx = 0; idx < lookups; ++idx)
+    {
+        std::string const& query = queries[idx % queries.size()];
+        sqlite3_bind_text(select,
+                          1,
+                          query.data(),
+                          static_cast<int>(query.size()),
+                          SQLITE_STATIC);
+        if (sqlite3_step(select) == SQLITE_ROW)
+        {
+            sqliteTotal += sqlite3_column_int(select, 0) + 1;
+        }
+
+        sqlite3_reset(select);
+    }
+    auto sqliteDone = std::chrono::steady_clock::now();
+
+    sqlite3_finalize(select);
+    sqlite3_close(db);
+    EXPECT_EQ(sqliteTotal, tableTotal);
+
+    auto perSecond = [&](std::chrono::steady_clock::duration elapsed)
+    {
+        return static_cast<double>(lookups) /
+               std::chrono::duration<double>(elapsed).count();
+    };
+    std::cout << "Perfect hash: " << perSecond(tableDone - start)
+              << " lookups/s, SQLite: " << perSecond(sqliteDone - tableDone)
+              << " lookups/s" << std::endl;
+}
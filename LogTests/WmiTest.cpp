@@ -0,0 +1,70 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include "gtest/gtest.h"
+#include "../LogCommon/ErrorReporter.hpp"
+#include "../LogCommon/Win32Exception.hpp"
+#include "../LogCommon/Wmi.hpp"
+
+using namespace Instalog;
+using namespace Instalog::SystemFacades;
+
+class WmiQueryBatchTest : public ::testing::Test
+{
+    protected:
+    static void SetUpTestCase()
+    {
+        // COM security may be set only once per process.
+        static Com com(COINIT_APARTMENTTHREADED, GetThrowingErrorReporter());
+    }
+
+    static std::wstring GetString(UniqueComPtr<IWbemClassObject>& instance,
+                                  wchar_t const* property)
+    {
+        UniqueVariant variant;
+        ThrowIfFailed(
+            instance->Get(property, 0, variant.PassAsOutParameter(), NULL, NULL));
+        return variant.AsString(GetThrowingErrorReporter());
+    }
+};
+
+TEST_F(WmiQueryBatchTest, ReturnsEveryResultSetOfABatch)
+{
+    WmiQueryBatch wmi(L"cimv2", std::chrono::seconds(30));
+    std::size_t const operatingSystem =
+        wmi.Add(L"SELECT SystemDrive FROM Win32_OperatingSystem");
+    std::size_t const computerSystem =
+        wmi.Add(L"SELECT Name FROM Win32_ComputerSystem");
+
+    auto operatingSystems = wmi.GetResults(operatingSystem);
+    ASSERT_EQ(1u, operatingSystems.size());
+    EXPECT_EQ(2u, GetString(operatingSystems.front(), L"SystemDrive").size());
+
+    auto computerSystems = wmi.GetResults(computerSystem);
+    ASSERT_EQ(1u, computerSystems.size());
+    EXPECT_FALSE(GetString(computerSystems.front(), L"Name").empty());
+}
+
+TEST_F(WmiQueryBatchTest, ReturnsResultSetsInAnyOrder)
+{
+    WmiQueryBatch wmi(L"cimv2", std::chrono::seconds(30));
+    std::size_t const operatingSystem =
+        wmi.Add(L"SELECT SystemDrive FROM Win32_OperatingSystem");
+    std::size_t const computerSystem =
+        wmi.Add(L"SELECT Name FROM Win32_ComputerSystem");
+
+    EXPECT_EQ(1u, wmi.GetResults(computerSystem).size());
+    EXPECT_EQ(1u, wmi.GetResults(operatingSystem).size());
+}
+
+TEST_F(WmiQueryBatchTest, RejectsUnknownIndex)
+{
+    WmiQueryBatch wmi(L"cimv2", std::chrono::seconds(30));
+    wmi.Add(L"SELECT Name FROM Win32_ComputerSystem");
+    EXPECT_THROW(wmi.GetResults(1), std::out_of_range);
+}
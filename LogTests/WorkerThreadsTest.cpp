@@ -0,0 +1,74 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../LogCommon/WorkerThreads.hpp"
+
+using namespace Instalog;
+
+TEST(WorkerThreads, WorkCounterHandsOutEachIndexOnce)
+{
+    WorkCounter counter(3);
+    std::size_t index;
+    ASSERT_TRUE(counter.Next(index));
+    EXPECT_EQ(0u, index);
+    ASSERT_TRUE(counter.Next(index));
+    EXPECT_EQ(1u, index);
+    ASSERT_TRUE(counter.Next(index));
+    EXPECT_EQ(2u, index);
+    EXPECT_FALSE(counter.Next(index));
+    EXPECT_FALSE(counter.Next(index));
+}
+
+TEST(WorkerThreads, RunsWorkerOnEachThread)
+{
+    std::atomic<std::size_t> calls(0);
+    RunOnWorkerThreads(4, [&]() { ++calls; });
+    EXPECT_EQ(4u, calls.load());
+}
+
+TEST(WorkerThreads, ZeroThreadsRunsOnCallingThread)
+{
+    std::atomic<std::size_t> calls(0);
+    RunOnWorkerThreads(0, [&]() { ++calls; });
+    EXPECT_EQ(1u, calls.load());
+}
+
+TEST(WorkerThreads, ParallelForVisitsEveryIndex)
+{
+    std::vector<std::atomic<int>> visits(1000);
+    for (auto& visit : visits)
+    {
+        visit = 0;
+    }
+
+    ParallelFor(visits.size(), [&](std::size_t index) { ++visits[index]; }, 8);
+    for (auto const& visit : visits)
+    {
+        EXPECT_EQ(1, visit.load());
+    }
+}
+
+TEST(WorkerThreads, ParallelForOfNothingDoesNothing)
+{
+    bool called = false;
+    ParallelFor(0, [&](std::size_t) { called = true; });
+    EXPECT_FALSE(called);
+}
+
+TEST(WorkerThreads, ParallelForRethrows)
+{
+    EXPECT_THROW(ParallelFor(100,
+                             [](std::size_t index) {
+                                 if (index == 42)
+                                 {
+                                     throw std::runtime_error("Example");
+                                 }
+                             },
+                             4),
+                 std::runtime_error);
+}
@@ -0,0 +1,65 @@
+// Copyright © Jacob Snyder, Billy O'Neal III
+// This is under the 2 clause BSD license.
+// See the included LICENSE.TXT file for more details.
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "../LogCommon/WhitelistCompiler.hpp"
+
+using namespace Instalog;
+
+// Compiles the Files table of Whitelist.sql into a C++ source file which
+// defines it as a perfect hash table, and the Patterns table into an
+// automaton.
+//
+// Usage: WhitelistCompiler <Whitelist.sql> <output.cpp>
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::fputs("Usage: WhitelistCompiler <Whitelist.sql> <output.cpp>\n",
+                   stderr);
+        return 2;
+    }
+
+    try
+    {
+        std::ifstream input(argv[1], std::ios::binary);
+        if (!input)
+        {
+            std::fprintf(stderr, "%s: Could not be opened.\n", argv[1]);
+            return 1;
+        }
+
+        std::string const sql((std::istreambuf_iterator<char>(input)),
+                              std::istreambuf_iterator<char>());
+        WhitelistSql const tables(ParseWhitelistSql(sql));
+        CompiledWhitelist const files(CompileWhitelist(tables.files));
+        CompiledPatternWhitelist const patterns(
+            CompileWhitelistPatterns(tables.patterns));
+
+        // Write to memory first so that a failure does not leave a partial
+        // file behind for the build to pick up.
+        std::ostringstream source;
+        WriteWhitelistSource(source, files, patterns);
+        std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+        output << source.str();
+        if (!output.flush())
+        {
+            std::fprintf(stderr, "%s: Could not be written.\n", argv[2]);
+            return 1;
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::fprintf(stderr, "%s: %s\n", argv[1], ex.what());
+        return 1;
+    }
+
+    return 0;
+}